@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ast.h"
+#include "batch.h"
+#include "interp.h"
+#include "precc.h"
+#include "str_pool.h"
+#include "sym_table.h"
+
+//
+// Rows per second of a scoring formula run once per row with `interp`,
+// against the whole batch at once with `batch_eval`
+//
+
+#define PARAMS 4
+
+static const char PROGRAM[] =
+    "int main(int a, int b, int c, int d) {\n"
+    "    int s;\n"
+    "    int t;\n"
+    "    s = a * 3 + b * 5 + 7;\n"
+    "    t = (c + d) * (a + 2) + s * 11;\n"
+    "    s = s * t + (b + c * 13) * 17 + 2 * 21;\n"
+    "    return s + t * d;\n"
+    "}\n";
+
+static uint64_t rng = 42;
+
+// splitmix64
+static uint64_t _next() {
+    uint64_t z = (rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static double _now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// runs `main` on every row, binding its parameters before each call
+static bool _run_interp(
+    PreccSession session,
+    const int64_t *const *inputs,
+    size_t rows,
+    int64_t *results) {
+    Ast ast = precc_session_ast(session);
+    NodeID root = precc_session_root(session);
+    StrPool strs = precc_session_strs(session);
+
+    for (size_t row = 0; row < rows; ++row) {
+        SymTable syms = symtable_initialize();
+        if (syms == NULL) {
+            return false;
+        }
+
+        size_t p = 0;
+        for (NodeID id = ast->data[root].data.MAIN.params; id != NO_ID;
+             id = ast->data[id].header.stmt_next, ++p) {
+            StrID var = ast->data[id].data.DECL.var;
+            if (!symtable_add_symbol(syms, var, ast->data[id].data.DECL.type)) {
+                symtable_release(syms);
+                return false;
+            }
+            symnode_get_symbol(symtable_get_info(syms, var))->value.v_int =
+                inputs[p][row];
+        }
+
+        results[row] = interp(ast, root, strs, syms, NULL).value.v_int;
+        symtable_release(syms);
+    }
+    return true;
+}
+
+static void _usage(const char *prog) {
+    fprintf(
+        stderr, "usage: %s [--rows N] [--interp-rows N] [--reps N]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    size_t rows = 1 << 22;
+    size_t interp_rows = 1 << 16;
+    int reps = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--rows") == 0 && has_value) {
+            rows = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--interp-rows") == 0 && has_value) {
+            interp_rows = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--reps") == 0 && has_value) {
+            reps = atoi(argv[++i]);
+        } else {
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+    if (rows == 0 || reps <= 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+    interp_rows = interp_rows < rows ? interp_rows : rows;
+
+    PreccSession session = precc_session_create();
+    if (session == NULL) {
+        return 1;
+    }
+    if (precc_session_compile(session, PROGRAM, strlen(PROGRAM)) != Status_OK) {
+        fputs(precc_session_diagnostics(session), stderr);
+        return 1;
+    }
+
+    int64_t *columns[PARAMS];
+    for (size_t p = 0; p < PARAMS; ++p) {
+        columns[p] = malloc(rows * sizeof(*columns[p]));
+        if (columns[p] == NULL) {
+            return 1;
+        }
+        for (size_t row = 0; row < rows; ++row) {
+            columns[p][row] = (int64_t)_next();
+        }
+    }
+    const int64_t *const *inputs = (const int64_t *const *)columns;
+    int64_t *expected = malloc(interp_rows * sizeof(*expected));
+    int64_t *results = malloc(rows * sizeof(*results));
+
+    Batch batch =
+        batch_compile(precc_session_ast(session), precc_session_root(session));
+    if (expected == NULL || results == NULL || batch == NULL) {
+        return 1;
+    }
+
+    // best of the repetitions, each one over every row
+    double interp_ns = 0, batch_ns = 0;
+    for (int i = 0; i < reps; ++i) {
+        double start = _now();
+        if (!_run_interp(session, inputs, interp_rows, expected)) {
+            return 1;
+        }
+        double elapsed = _now() - start;
+        interp_ns = i == 0 || elapsed < interp_ns ? elapsed : interp_ns;
+
+        start = _now();
+        if (batch_eval(batch, inputs, rows, results) != Status_OK) {
+            return 1;
+        }
+        elapsed = _now() - start;
+        batch_ns = i == 0 || elapsed < batch_ns ? elapsed : batch_ns;
+    }
+
+    int status = 0;
+    for (size_t row = 0; row < interp_rows; ++row) {
+        if (results[row] != expected[row]) {
+            printf(
+                "row %zu: batch_eval returned %" PRIi64 ", interp %" PRIi64
+                "\n",
+                row,
+                results[row],
+                expected[row]);
+            status = 1;
+            break;
+        }
+    }
+
+    double interp_rate = interp_rows / (interp_ns / 1e9);
+    double batch_rate = rows / (batch_ns / 1e9);
+    printf("%-12s %12s %16s\n", "evaluator", "rows", "rows/s");
+    printf("%-12s %12zu %16.0f\n", "interp", interp_rows, interp_rate);
+    printf("%-12s %12zu %16.0f\n", "batch_eval", rows, batch_rate);
+    printf("speedup: %.1fx\n", batch_rate / interp_rate);
+
+    batch_release(batch);
+    precc_session_destroy(session);
+    for (size_t p = 0; p < PARAMS; ++p) {
+        free(columns[p]);
+    }
+    free(expected);
+    free(results);
+    return status;
+}
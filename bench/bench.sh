@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# End-to-end scaling benchmark: runs precc over generated programs of
+# increasing size and reports per-phase throughput and peak RSS.
+#
+# Environment:
+#   PRECC        compiler under test (default ./precc)
+#   GEN          program generator (default bench/gen)
+#   BENCH_SIZES  statement counts to sweep (default 10^2 .. 10^7)
+#   GEN_FLAGS    extra knobs for the generator, see `bench/gen -h`
+#   PRECC_FLAGS  extra flags for the compiler, e.g. --fused
+
+PRECC=${PRECC:-./precc}
+GEN=${GEN:-bench/gen}
+BENCH_SIZES=${BENCH_SIZES:-"100 1000 10000 100000 1000000 10000000"}
+PHASES="lex yyparse ast_display sempass initpass interp fused"
+
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# phase_field <json> <phase> -> "wall_s cpu_s peak_rss_kb"
+phase_field() {
+    sed -n "s/.*\"$2\":{\"wall_s\":\([^,]*\),\"cpu_s\":\([^,]*\),\"peak_rss_kb\":\([0-9]*\).*/\1 \2 \3/p" "$1"
+}
+
+printf "%10s %12s %12s %12s %14s %12s\n" \
+    "stmts" "phase" "wall (ms)" "cpu (ms)" "kstmt/s" "peak rss (MB)"
+
+for n in $BENCH_SIZES; do
+    src="$TMP/prog_$n.txt"
+    # shellcheck disable=SC2086
+    "$GEN" -n "$n" $GEN_FLAGS > "$src" || exit 1
+
+    # shellcheck disable=SC2086
+    "$PRECC" --time-report=json $PRECC_FLAGS < "$src" > /dev/null 2> "$TMP/report"
+    status=$?
+    if [ $status -ne 0 ]; then
+        if [ $status -gt 128 ]; then
+            reason="killed by signal $((status - 128))"
+        else
+            reason="exit status $status"
+        fi
+        printf "%10s %12s FAILED (%s)\n" "$n" "-" "$reason"
+        continue
+    fi
+
+    tail -n 1 "$TMP/report" > "$TMP/json"
+    for phase in $PHASES; do
+        phase_field "$TMP/json" "$phase" | awk -v n="$n" -v p="$phase" '{
+            rate = $1 > 0 ? n / $1 / 1e3 : 0
+            printf "%10s %12s %12.3f %12.3f %14.1f %12.1f\n",
+                n, p, $1 * 1e3, $2 * 1e3, rate, $3 / 1024
+        }'
+    done
+    rm -f "$src"
+done
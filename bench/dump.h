@@ -0,0 +1,134 @@
+#ifndef _DUMP_H
+#define _DUMP_H
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "precc.h"
+#include "str_pool.h"
+#include "type_table.h"
+
+//
+// Text dump of the result of a session, shared by the harnesses that compare
+// two sessions
+//
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+static void _append(Buffer *buf, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void _append(Buffer *buf, const char *fmt, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, fmt);
+        size_t room = buf->capacity - buf->size;
+        int n = vsnprintf(buf->data + buf->size, room, fmt, args);
+        va_end(args);
+
+        if ((size_t)n < room) {
+            buf->size += n;
+            return;
+        }
+
+        buf->capacity = buf->capacity == 0 ? 4096 : 2 * buf->capacity;
+        while (buf->capacity - buf->size <= (size_t)n) {
+            buf->capacity *= 2;
+        }
+        buf->data = realloc(buf->data, buf->capacity);
+        if (buf->data == NULL) {
+            abort();
+        }
+    }
+}
+
+// the AST of the session in source order, with its locations and, if it's
+// valid, its types
+static void _dump_expr(PreccSession s, NodeID id, Buffer *out) {
+    Ast ast = precc_session_ast(s);
+    const AstNode *e = &ast->data[id];
+    Type type = precc_session_status(s) == Status_OK
+        ? type_table_get(precc_session_types(s), id)
+        : Type_VOID;
+
+    switch (e->kind) {
+    case AstNodeKind_BOOL_CONSTANT:
+        _append(out, "%s", e->data.BOOL_CONSTANT ? "true" : "false");
+        break;
+    case AstNodeKind_INT_CONSTANT:
+        _append(out, "%" PRIi64, (int64_t)e->data.INT_CONSTANT);
+        break;
+    case AstNodeKind_VAR:
+        _append(out, "%s", str_pool_get(precc_session_strs(s), e->data.VAR));
+        break;
+    case AstNodeKind_BINOP:
+        _append(out, "(");
+        _dump_expr(s, e->data.BINOP.lhs, out);
+        _append(out, e->data.BINOP.op == BinOp_ADD ? " + " : " * ");
+        _dump_expr(s, e->data.BINOP.rhs, out);
+        _append(out, ")");
+        break;
+    default:
+        _append(out, "?");
+        break;
+    }
+    _append(out, "@%u:%d", e->loc, (int)type);
+}
+
+static void _dump_seq(PreccSession s, NodeID id, Buffer *out) {
+    Ast ast = precc_session_ast(s);
+    StrPool strs = precc_session_strs(s);
+
+    for (; id != NO_ID; id = ast->data[id].header.stmt_next) {
+        const AstNode *stmt = &ast->data[id];
+        _append(out, "%u ", stmt->loc);
+
+        switch (stmt->kind) {
+        case AstNodeKind_DECL:
+            _append(
+                out, "decl %d %s", (int)stmt->data.DECL.type,
+                str_pool_get(strs, stmt->data.DECL.var));
+            break;
+        case AstNodeKind_ASGN:
+            _append(out, "%s = ", str_pool_get(strs, stmt->data.ASGN.var));
+            _dump_expr(s, stmt->data.ASGN.expr, out);
+            break;
+        case AstNodeKind_RET:
+            _append(out, "return ");
+            if (stmt->data.RET != NO_ID) {
+                _dump_expr(s, stmt->data.RET, out);
+            }
+            break;
+        default:
+            _append(out, "?");
+            break;
+        }
+        _append(out, "\n");
+    }
+}
+
+static void _dump(PreccSession s, Buffer *out) {
+    out->size = 0;
+    _append(out, "status %d\n%s", precc_session_status(s),
+            precc_session_diagnostics(s));
+
+    NodeID root = precc_session_root(s);
+    if (root == NO_ID) {
+        return;
+    }
+
+    const AstNode *main = &precc_session_ast(s)->data[root];
+    _append(out, "%u main %d\n", main->loc, (int)main->data.MAIN.ret_type);
+    _dump_seq(s, main->data.MAIN.params, out);
+    _append(out, "{\n");
+    _dump_seq(s, main->data.MAIN.body, out);
+}
+
+#endif /* _DUMP_H */
@@ -0,0 +1,315 @@
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dump.h"
+#include "precc.h"
+
+//
+// Latency of single line edits with `precc_session_edit`, against compiling
+// the whole edited source again, for programs of growing size. With
+// --verify every edit is checked against a fresh `precc_session_compile` of
+// the edited source, parsed with pratt as the edits are
+//
+
+// variables an expression may read, counting back from the last one
+#define WINDOW 8
+
+typedef struct {
+    Buffer src;
+    // offset and length of every line of the body, without its newline
+    size_t *offsets;
+    size_t *lens;
+    size_t lines;
+} Program;
+
+static uint64_t rng = 42;
+
+// splitmix64
+static uint64_t _next() {
+    uint64_t z = (rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static double _now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// `v<k> = <expr>;` reading variables declared before `k`
+static void _expr(Buffer *buf, size_t k) {
+    size_t terms = 1 + _next() % 3;
+    for (size_t t = 0; t < terms; ++t) {
+        if (t > 0) {
+            _append(buf, _next() % 2 == 0 ? " + " : " * ");
+        }
+        if (k == 0 || _next() % 4 == 0) {
+            _append(buf, "%" PRIu64, _next() % 100);
+        } else {
+            size_t window = k < WINDOW ? k : WINDOW;
+            _append(buf, "v%zu", k - 1 - (size_t)(_next() % window));
+        }
+    }
+}
+
+// a declaration and an assignment per variable, then a return
+static void _generate(Program *p, size_t stmts) {
+    p->lines = 0;
+    p->offsets = malloc((stmts + 1) * sizeof(*p->offsets));
+    p->lens = malloc((stmts + 1) * sizeof(*p->lens));
+    if (p->offsets == NULL || p->lens == NULL) {
+        abort();
+    }
+
+    _append(&p->src, "int main(int p) {\n");
+    size_t vars = stmts / 2;
+    for (size_t i = 0; i + 1 < stmts; ++i) {
+        size_t k = i / 2;
+        _append(&p->src, "    ");
+        p->offsets[p->lines] = p->src.size;
+        if (i % 2 == 0) {
+            _append(&p->src, "int v%zu;", k);
+        } else {
+            _append(&p->src, "v%zu = ", k);
+            if (k == 0) {
+                _append(&p->src, "p");
+            } else {
+                _expr(&p->src, k);
+            }
+            _append(&p->src, ";");
+        }
+        p->lens[p->lines] = p->src.size - p->offsets[p->lines];
+        ++p->lines;
+        _append(&p->src, "\n");
+    }
+    _append(&p->src, "    return %s;\n}\n", vars > 0 ? "v0" : "p");
+}
+
+//
+// verification
+//
+
+// compares the session against a whole compilation of the edited source
+static bool _verify(
+    PreccSession edited,
+    PreccSession fresh,
+    const Buffer *expected,
+    Buffer *lhs,
+    Buffer *rhs) {
+    size_t len;
+    const char *src = precc_session_source(edited, &len);
+    if (src == NULL || len != expected->size ||
+        memcmp(src, expected->data, len) != 0) {
+        fputs("edited source differs\n", stderr);
+        return false;
+    }
+
+    precc_session_compile(fresh, src, len);
+    _dump(edited, lhs);
+    _dump(fresh, rhs);
+    if (lhs->size != rhs->size || memcmp(lhs->data, rhs->data, lhs->size)) {
+        fprintf(
+            stderr, "edit differs from a whole compilation:\n%.*s---\n%.*s",
+            (int)lhs->size, lhs->data, (int)rhs->size, rhs->data);
+        return false;
+    }
+    return true;
+}
+
+//
+// edits
+//
+
+typedef struct {
+    size_t offset;
+    size_t removed;
+    char text[64];
+} Edit;
+
+// replaces a line of the body, inserts one before it or deletes it
+static Edit _pick(const Program *p) {
+    size_t line = (size_t)(_next() % p->lines);
+    size_t k = line / 2;
+    Edit edit = { .offset = p->offsets[line], .removed = p->lens[line] };
+
+    switch (_next() % 6) {
+    case 0:
+        // reads the variable before its assignment, if it's the first one
+        snprintf(edit.text, sizeof(edit.text), "v%zu = v%zu + 1;", k, k);
+        break;
+    case 1:
+        snprintf(edit.text, sizeof(edit.text), "v%zu = * 2;", k);
+        break;
+    case 2:
+        snprintf(edit.text, sizeof(edit.text), "bool v%zu;", k);
+        break;
+    case 3:
+        snprintf(edit.text, sizeof(edit.text), "int v%zu;\n    ", k / 2);
+        edit.removed = 0;
+        break;
+    case 4:
+        // the line, its newline and the indent of the next one
+        edit.removed += 5;
+        break;
+    default:
+        snprintf(edit.text, sizeof(edit.text), "v%zu = %zu;", k, line);
+        break;
+    }
+    return edit;
+}
+
+static void _apply(Buffer *buf, size_t offset, size_t removed,
+                   const char *text, size_t len) {
+    size_t size = buf->size - removed + len;
+    if (size + 1 > buf->capacity) {
+        buf->capacity = size + 1;
+        buf->data = realloc(buf->data, buf->capacity);
+        if (buf->data == NULL) {
+            abort();
+        }
+    }
+    memmove(
+        buf->data + offset + len, buf->data + offset + removed,
+        buf->size - offset - removed);
+    memcpy(buf->data + offset, text, len);
+    buf->size = size;
+}
+
+static int _by_value(const void *lhs, const void *rhs) {
+    double a = *(const double *)lhs, b = *(const double *)rhs;
+    return a < b ? -1 : a > b;
+}
+
+// edits the program and takes them back, `edits` times each
+static bool _run(size_t stmts, size_t edits, bool verify) {
+    Program p = { 0 };
+    _generate(&p, stmts);
+
+    PreccSession session = precc_session_create();
+    PreccSession fresh = precc_session_create();
+    if (session == NULL || fresh == NULL) {
+        return false;
+    }
+    precc_session_set_parser(fresh, Parser_PRATT);
+
+    double start = _now();
+    Status s = precc_session_open(session, p.src.data, p.src.size);
+    double open_ns = _now() - start;
+    if (s != Status_OK) {
+        fputs(precc_session_diagnostics(session), stderr);
+        return false;
+    }
+
+    start = _now();
+    precc_session_compile(fresh, p.src.data, p.src.size);
+    double compile_ns = _now() - start;
+
+    Buffer expected = { 0 }, lhs = { 0 }, rhs = { 0 };
+    if (verify) {
+        _apply(&expected, 0, 0, p.src.data, p.src.size);
+    }
+
+    double *times = malloc(2 * edits * sizeof(*times));
+    if (times == NULL) {
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < edits && ok; ++i) {
+        Edit edit = _pick(&p);
+        size_t len = strlen(edit.text);
+        char undo[128];
+        memcpy(undo, p.src.data + edit.offset, edit.removed);
+
+        start = _now();
+        precc_session_edit(
+            session, edit.offset, edit.removed, edit.text, len);
+        times[2 * i] = _now() - start;
+        if (verify) {
+            _apply(&expected, edit.offset, edit.removed, edit.text, len);
+            ok = _verify(session, fresh, &expected, &lhs, &rhs);
+        }
+
+        start = _now();
+        precc_session_edit(session, edit.offset, len, undo, edit.removed);
+        times[2 * i + 1] = _now() - start;
+        if (verify && ok) {
+            _apply(&expected, edit.offset, len, undo, edit.removed);
+            ok = _verify(session, fresh, &expected, &lhs, &rhs);
+        }
+    }
+
+    if (ok && precc_session_status(session) != Status_OK) {
+        fputs("edits taken back left errors\n", stderr);
+        ok = false;
+    }
+
+    size_t n = 2 * edits;
+    qsort(times, n, sizeof(*times), _by_value);
+    printf(
+        "%10zu %12.2f %12.2f %12.2f %12.2f %12.2f\n", stmts,
+        compile_ns / 1e6, open_ns / 1e6, times[n / 2] / 1e3,
+        times[n * 99 / 100] / 1e3, times[n - 1] / 1e3);
+
+    free(times);
+    free(expected.data);
+    free(lhs.data);
+    free(rhs.data);
+    free(p.src.data);
+    free(p.offsets);
+    free(p.lens);
+    precc_session_destroy(session);
+    precc_session_destroy(fresh);
+    return ok;
+}
+
+static void _usage(const char *prog) {
+    fprintf(
+        stderr, "usage: %s [--max N] [--edits N] [--seed N] [--verify]\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    size_t max = 1000000;
+    size_t edits = 1000;
+    bool verify = false;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--max") == 0 && has_value) {
+            max = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--edits") == 0 && has_value) {
+            edits = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            rng = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else {
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+    if (max < 100 || edits == 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    printf(
+        "%10s %12s %12s %12s %12s %12s\n", "statements", "compile ms",
+        "open ms", "edit p50 us", "edit p99 us", "edit max us");
+    for (size_t stmts = 100; stmts <= max; stmts *= 10) {
+        if (!_run(stmts, edits, verify)) {
+            return 1;
+        }
+    }
+    return 0;
+}
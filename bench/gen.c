@@ -0,0 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//
+// Deterministic generator of valid precc programs
+//
+
+typedef struct {
+    uint64_t stmts;
+    uint64_t idents;
+    unsigned depth;
+    unsigned width;
+    double decl_ratio;
+    uint64_t dead;
+    uint64_t seed;
+} Knobs;
+
+typedef struct {
+    uint64_t rng;
+    uint64_t declared;
+    // declared identifiers that have been assigned, v0..v(assigned - 1)
+    // are kept in `order` in the order they were assigned
+    uint64_t *order;
+    bool *is_assigned;
+    uint64_t assigned;
+} Gen;
+
+// splitmix64
+static uint64_t _next(Gen *g) {
+    uint64_t z = (g->rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static uint64_t _below(Gen *g, uint64_t n) {
+    return _next(g) % n;
+}
+
+static double _unit(Gen *g) {
+    return (_next(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void _leaf(Gen *g, FILE *out) {
+    if (g->assigned > 0 && _below(g, 2) == 0) {
+        fprintf(out, "v%" PRIu64, g->order[_below(g, g->assigned)]);
+    } else {
+        fprintf(out, "%" PRIu64, _below(g, 100));
+    }
+}
+
+static void _expr(Gen *g, const Knobs *k, unsigned depth, FILE *out) {
+    if (depth == 0) {
+        _leaf(g, out);
+        return;
+    }
+
+    fputc('(', out);
+    for (unsigned i = 0; i < k->width; ++i) {
+        if (i > 0) {
+            fputs(_below(g, 2) ? " + " : " * ", out);
+        }
+        _expr(g, k, depth - 1, out);
+    }
+    fputc(')', out);
+}
+
+static void _stmt(Gen *g, const Knobs *k, FILE *out) {
+    bool can_declare = g->declared < k->idents;
+
+    if (can_declare && (g->declared == 0 || _unit(g) < k->decl_ratio)) {
+        fprintf(out, "    int v%" PRIu64 ";\n", g->declared++);
+        return;
+    }
+
+    uint64_t target = _below(g, g->declared);
+    fprintf(out, "    v%" PRIu64 " = ", target);
+    _expr(g, k, k->depth, out);
+    fputs(";\n", out);
+
+    if (!g->is_assigned[target]) {
+        g->is_assigned[target] = true;
+        g->order[g->assigned++] = target;
+    }
+}
+
+static void _usage(const char *prog) {
+    fprintf(
+        stderr,
+        "usage: %s [-n stmts] [-i idents] [-d depth] [-w width] "
+        "[-r decl ratio] [-D dead stmts] [-s seed]\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    Knobs k = {
+        .stmts = 1000,
+        .idents = 1000,
+        .depth = 2,
+        .width = 2,
+        .decl_ratio = 0.1,
+        .dead = 0,
+        .seed = 42,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:i:d:w:r:D:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            k.stmts = strtoull(optarg, NULL, 10);
+            break;
+        case 'i':
+            k.idents = strtoull(optarg, NULL, 10);
+            break;
+        case 'd':
+            k.depth = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            k.width = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            k.decl_ratio = strtod(optarg, NULL);
+            break;
+        case 'D':
+            k.dead = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            k.seed = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (k.idents == 0 || k.width == 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    Gen g = {
+        .rng = k.seed,
+        .order = malloc(k.idents * sizeof(*g.order)),
+        .is_assigned = calloc(k.idents, sizeof(*g.is_assigned)),
+    };
+    if (g.order == NULL || g.is_assigned == NULL) {
+        return 1;
+    }
+
+    FILE *out = stdout;
+    fputs("int main() {\n", out);
+    for (uint64_t i = 0; i < k.stmts; ++i) {
+        _stmt(&g, &k, out);
+    }
+
+    if (g.assigned > 0) {
+        fprintf(out, "    return v%" PRIu64 ";\n", g.order[g.assigned - 1]);
+    } else {
+        fputs("    return 0;\n", out);
+    }
+
+    for (uint64_t i = 0; i < k.dead; ++i) {
+        _stmt(&g, &k, out);
+    }
+    fputs("}\n", out);
+
+    free(g.order);
+    free(g.is_assigned);
+    return 0;
+}
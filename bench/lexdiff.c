@@ -0,0 +1,364 @@
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "scanner.h"
+#include "str_pool.h"
+#include "tokens.h"
+#include "util.h"
+
+//
+// Differential test of the hand-written scanner against flex: every source
+// is lexed with `Lexer_FLEX` on one thread as the reference, then with flex
+// on many threads and with `Lexer_SIMD` on one and many threads with each of
+// the scalar, SSE2 and AVX2 spans, comparing every token's kind, value and
+// location. Sources are edge cases, programs from bench/gen and copies of
+// them with random bytes spliced in
+//
+
+// bytes spliced into the generated programs, the edge cases of the lexer
+static const char NOISE[] = { ' ', '\t', '\r', '\n', '\0', '\x80', '\xff',
+                              'a', 'Z', '9', ';', '_', '#' };
+
+static uint64_t rng = 42;
+
+// splitmix64
+static uint64_t _next() {
+    uint64_t z = (rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+typedef struct {
+    const char *name;
+    Lexer lexer;
+    ScannerSpan span;
+    // 0 for the number of threads asked for
+    unsigned threads;
+} Config;
+
+static const Config CONFIGS[] = {
+    { "flex/tN", Lexer_FLEX, ScannerSpan_AUTO, 0 },
+    { "simd/scalar/t1", Lexer_SIMD, ScannerSpan_SCALAR, 1 },
+    { "simd/scalar/tN", Lexer_SIMD, ScannerSpan_SCALAR, 0 },
+    { "simd/sse2/t1", Lexer_SIMD, ScannerSpan_SSE2, 1 },
+    { "simd/sse2/tN", Lexer_SIMD, ScannerSpan_SSE2, 0 },
+    { "simd/avx2/t1", Lexer_SIMD, ScannerSpan_AVX2, 1 },
+    { "simd/avx2/tN", Lexer_SIMD, ScannerSpan_AVX2, 0 },
+};
+
+#define N_CONFIGS (sizeof(CONFIGS) / sizeof(CONFIGS[0]))
+
+typedef struct {
+    Tokens tokens;
+    StrPool strs;
+} Lexed;
+
+static bool _lex(
+    Lexed *out, const char *src, size_t len, Lexer lexer, unsigned threads) {
+    tokens_clear(out->tokens);
+    str_pool_release(out->strs);
+    out->strs = str_pool_init();
+    return out->strs != NULL &&
+           tokens_lex(
+               out->tokens, src, len, out->strs, lexer, threads, stderr) ==
+               Status_OK;
+}
+
+static bool _same_token(const Lexed *a, const Lexed *b, size_t i) {
+    const Token *x = &a->tokens->data[i];
+    const Token *y = &b->tokens->data[i];
+    if (x->kind != y->kind || x->loc != y->loc) {
+        return false;
+    }
+    if (x->kind == TOK_IDENT) {
+        return strcmp(
+                   str_pool_get(a->strs, x->value.ident),
+                   str_pool_get(b->strs, y->value.ident)) == 0;
+    }
+    return x->kind != TOK_NUM || x->value.num == y->value.num;
+}
+
+static void _print_token(const char *who, const Lexed *l, size_t i) {
+    if (i >= l->tokens->size) {
+        fprintf(stderr, "  %-16s none\n", who);
+        return;
+    }
+
+    const Token *tok = &l->tokens->data[i];
+    fprintf(
+        stderr, "  %-16s kind %d at %" PRIu32, who, tok->kind, (uint32_t)tok->loc);
+    if (tok->kind == TOK_IDENT) {
+        const char *ident = str_pool_get(l->strs, tok->value.ident);
+        size_t len = strlen(ident);
+        fprintf(
+            stderr, " `%.40s%s` (%zu bytes)", ident, len > 40 ? "..." : "", len);
+    } else if (tok->kind == TOK_NUM) {
+        fprintf(stderr, " %" PRIi64, tok->value.num);
+    }
+    fprintf(stderr, "\n");
+}
+
+// lexes `src` with every config, false on the first token that differs from
+// flex on one thread
+static bool _check(
+    const char *name,
+    const char *src,
+    size_t len,
+    unsigned threads,
+    Lexed *ref,
+    Lexed *got,
+    size_t *tokens) {
+    scanner_set_span(ScannerSpan_AUTO);
+    if (!_lex(ref, src, len, Lexer_FLEX, 1)) {
+        fprintf(stderr, "%s: flex failed\n", name);
+        return false;
+    }
+    *tokens += ref->tokens->size;
+
+    for (size_t c = 0; c < N_CONFIGS; ++c) {
+        const Config *config = &CONFIGS[c];
+        // spans the CPU lacks were reported once already
+        if (!scanner_set_span(config->span)) {
+            continue;
+        }
+
+        unsigned n = config->threads != 0 ? config->threads : threads;
+        if (!_lex(got, src, len, config->lexer, n)) {
+            fprintf(stderr, "%s: %s failed\n", name, config->name);
+            return false;
+        }
+
+        size_t size = ref->tokens->size > got->tokens->size
+            ? ref->tokens->size
+            : got->tokens->size;
+        for (size_t i = 0; i < size; ++i) {
+            if (i < ref->tokens->size && i < got->tokens->size &&
+                _same_token(ref, got, i)) {
+                continue;
+            }
+
+            fprintf(
+                stderr, "%s: %s differs from flex/t1 at token %zu\n", name,
+                config->name, i);
+            _print_token("flex/t1", ref, i);
+            _print_token(config->name, got, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// sources
+//
+
+typedef struct {
+    const char *name;
+    const char *src;
+    size_t len;
+} EdgeCase;
+
+// sources may hold NUL bytes
+#define EDGE(name, src) { (name), (src), sizeof(src) - 1 }
+
+static const EdgeCase EDGE_CASES[] = {
+    EDGE("empty", ""),
+    EDGE("blank", " \t \t  "),
+    EDGE("crlf-runs", "int\r\nx\n\r;\r\n\r\n\n\rx\n\n\r\r\n=\r\n1;\n"),
+    EDGE("lone-cr", "int x;\rx = 1;\r\r"),
+    EDGE("nul", "int x\0;x = 1\0\0;\0"),
+    EDGE("non-ascii", "int \xc3\xa9t\xc3\xa9; x\x80 = \xff 1;"),
+    EDGE("keyword-prefixes", "mainx returns voidy bool1 int2 truee false0 in"),
+    EDGE("overflow",
+         "x = 9223372036854775807 9223372036854775808 "
+         "99999999999999999999999999999999;"),
+    EDGE("leading-zeros", "x = 0000000000000000000000000000042;"),
+    EDGE("punctuation", "(){}+*=;,,;;==**++"),
+    EDGE("illegal", "x = 1 - 2 / 3 % 4 @ # $ _y;"),
+    EDGE("unterminated", "void main() { int x; x = 1"),
+    EDGE("no-semicolons", "int x int y x = 1 y = 2 return x"),
+};
+
+#define N_EDGE_CASES (sizeof(EDGE_CASES) / sizeof(EDGE_CASES[0]))
+
+// identifiers and numbers longer than any SIMD block, around a `;` so that
+// chunks split there
+static char *_long_runs(size_t *len) {
+    size_t run = 100000;
+    char *src = malloc(4 * run + 16);
+    if (src == NULL) {
+        return NULL;
+    }
+
+    size_t n = 0;
+    memset(src + n, 'a', run);
+    n += run;
+    memcpy(src + n, "9 = ", 4);
+    n += 4;
+    memset(src + n, '7', run);
+    n += run;
+    src[n++] = ';';
+    memset(src + n, ' ', run);
+    n += run;
+    memset(src + n, 'Z', run);
+    n += run;
+    src[n++] = ';';
+    *len = n;
+    return src;
+}
+
+// runs bench/gen with the given seed
+static char *_generate(const char *gen, size_t stmts, uint64_t seed, size_t *len) {
+    char cmd[1024];
+    snprintf(
+        cmd, sizeof(cmd), "%s -n %zu -s %" PRIu64, gen, stmts, seed);
+    FILE *pipe = popen(cmd, "r");
+    if (pipe == NULL) {
+        return NULL;
+    }
+
+    char *src = u_read_all(pipe, len);
+    if (pclose(pipe) != 0) {
+        free(src);
+        return NULL;
+    }
+    return src;
+}
+
+// splices a byte of `NOISE` in about every 64 bytes
+static char *_mutate(const char *src, size_t len, size_t *out_len) {
+    char *out = malloc(2 * len + 1);
+    if (out == NULL) {
+        return NULL;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (_next() % 64 == 0) {
+            out[n++] = NOISE[_next() % sizeof(NOISE)];
+        }
+        out[n++] = src[i];
+    }
+    *out_len = n;
+    return out;
+}
+
+static void _usage(const char *prog) {
+    fprintf(
+        stderr,
+        "usage: %s [--gen PATH] [--programs N] [--stmts N] [--threads N] "
+        "[--seed N]\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *gen = "./bench/gen";
+    size_t programs = 100;
+    size_t stmts = 2000;
+    unsigned threads = 4;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--gen") == 0 && has_value) {
+            gen = argv[++i];
+        } else if (strcmp(argv[i], "--programs") == 0 && has_value) {
+            programs = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--stmts") == 0 && has_value) {
+            stmts = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+            threads = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            rng = strtoull(argv[++i], NULL, 10);
+        } else {
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+    if (threads < 2) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    static const struct {
+        ScannerSpan span;
+        const char *name;
+    } SPANS[] = {
+        { ScannerSpan_SSE2, "SSE2" },
+        { ScannerSpan_AVX2, "AVX2" },
+    };
+    for (size_t i = 0; i < sizeof(SPANS) / sizeof(SPANS[0]); ++i) {
+        if (!scanner_set_span(SPANS[i].span)) {
+            printf("%s spans not supported here, skipped\n", SPANS[i].name);
+        }
+    }
+
+    Lexed ref = { .tokens = tokens_initialize() };
+    Lexed got = { .tokens = tokens_initialize() };
+    if (ref.tokens == NULL || got.tokens == NULL) {
+        return 1;
+    }
+
+    bool ok = true;
+    size_t sources = 0;
+    size_t tokens = 0;
+    for (size_t i = 0; i < N_EDGE_CASES && ok; ++i) {
+        const EdgeCase *e = &EDGE_CASES[i];
+        ok = _check(e->name, e->src, e->len, threads, &ref, &got, &tokens);
+        ++sources;
+    }
+
+    size_t len;
+    char *src = _long_runs(&len);
+    if (ok && src == NULL) {
+        ok = false;
+    } else if (ok) {
+        ok = _check("long-runs", src, len, threads, &ref, &got, &tokens);
+        ++sources;
+    }
+    free(src);
+
+    for (size_t k = 0; k < programs && ok; ++k) {
+        char name[64];
+        uint64_t seed = _next();
+        if ((src = _generate(gen, stmts, seed, &len)) == NULL) {
+            fprintf(stderr, "%s failed for seed %" PRIu64 "\n", gen, seed);
+            ok = false;
+            break;
+        }
+        snprintf(name, sizeof(name), "gen seed %" PRIu64, seed);
+        ok = _check(name, src, len, threads, &ref, &got, &tokens);
+
+        size_t mutated_len;
+        char *mutated = _mutate(src, len, &mutated_len);
+        free(src);
+        if (ok && mutated == NULL) {
+            ok = false;
+        } else if (ok) {
+            snprintf(name, sizeof(name), "mutated gen seed %" PRIu64, seed);
+            ok = _check(
+                name, mutated, mutated_len, threads, &ref, &got, &tokens);
+        }
+        free(mutated);
+        sources += 2;
+    }
+
+    if (ok) {
+        printf(
+            "%zu sources, %zu tokens: every lexer agrees with flex\n", sources,
+            tokens);
+    }
+
+    tokens_release(ref.tokens);
+    tokens_release(got.tokens);
+    str_pool_release(ref.strs);
+    str_pool_release(got.strs);
+    return ok ? 0 : 1;
+}
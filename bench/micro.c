@@ -0,0 +1,943 @@
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "ast.h"
+#include "ast_visitor.h"
+#include "bytecode.h"
+#include "interp.h"
+#include "sempass.h"
+#include "shared_str_pool.h"
+#include "str_pool.h"
+#include "sym_table.h"
+#include "trace.h"
+#include "vm.h"
+
+//
+// Micro-benchmarks of the core data structures
+//
+
+#define KEYS 4096
+#define OPS 100000
+
+typedef enum {
+    Dist_SEQUENTIAL,
+    Dist_UNIFORM,
+    Dist_ZIPF,
+} Dist;
+
+typedef struct {
+    const char *name;
+    Dist dist;
+    void *(*setup)(Dist dist);
+    // performs OPS operations on the state returned by `setup`
+    void (*run)(void *state);
+    void (*teardown)(void *state);
+} Bench;
+
+typedef struct {
+    double p50;
+    double p90;
+    double p99;
+    double min;
+    double max;
+    double cycles;
+    double cache_misses;
+    bool has_perf;
+} Result;
+
+//
+// key distributions
+//
+
+static char keys[KEYS][16];
+static uint32_t sequence[OPS];
+static uint64_t rng = 42;
+
+// splitmix64
+static uint64_t _next() {
+    uint64_t z = (rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// fills `sequence` with OPS key indices following `dist`
+static void _fill_sequence(Dist dist) {
+    static double zipf_cdf[KEYS];
+
+    rng = 42;
+    switch (dist) {
+    case Dist_SEQUENTIAL:
+        for (size_t i = 0; i < OPS; ++i) {
+            sequence[i] = i % KEYS;
+        }
+        break;
+
+    case Dist_UNIFORM:
+        for (size_t i = 0; i < OPS; ++i) {
+            sequence[i] = _next() % KEYS;
+        }
+        break;
+
+    case Dist_ZIPF: {
+        double sum = 0;
+        for (size_t k = 0; k < KEYS; ++k) {
+            sum += 1.0 / pow(k + 1, 1.1);
+            zipf_cdf[k] = sum;
+        }
+        for (size_t i = 0; i < OPS; ++i) {
+            double u = (_next() >> 11) * (1.0 / 9007199254740992.0) * sum;
+            size_t lo = 0, hi = KEYS - 1;
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (zipf_cdf[mid] < u) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            sequence[i] = lo;
+        }
+        break;
+    }
+    }
+}
+
+//
+// str_pool
+//
+
+static void *_pool_setup(Dist dist) {
+    _fill_sequence(dist);
+    return str_pool_init();
+}
+
+static void *_pool_filled_setup(Dist dist) {
+    StrPool strs = _pool_setup(dist);
+    for (size_t k = 0; k < KEYS; ++k) {
+        str_pool_put(strs, keys[k]);
+    }
+    return strs;
+}
+
+static void _pool_teardown(void *state) {
+    str_pool_release(state);
+}
+
+static void _pool_put(void *state) {
+    for (size_t i = 0; i < OPS; ++i) {
+        str_pool_put(state, keys[sequence[i]]);
+    }
+}
+
+static void _pool_get(void *state) {
+    volatile char sink = 0;
+    for (size_t i = 0; i < OPS; ++i) {
+        sink ^= *str_pool_get(state, sequence[i]);
+    }
+    (void)sink;
+}
+
+//
+// contended interning
+//
+
+typedef struct {
+    unsigned threads;
+    SharedStrPool shared;
+    StrPool strs;
+    pthread_mutex_t lock;
+} Contention;
+
+typedef struct {
+    Contention *c;
+    size_t first;
+    size_t count;
+} Interner;
+
+// every thread interns its share of the same sequence into an empty pool,
+// racing to add the keys they have in common
+static void *_contention_setup(Dist dist, unsigned threads) {
+    _fill_sequence(dist);
+    Contention *c = malloc(sizeof(*c));
+    c->threads = threads;
+    c->shared = shared_str_pool_init();
+    c->strs = str_pool_init();
+    pthread_mutex_init(&c->lock, NULL);
+    return c;
+}
+
+static void *_contention_setup_1(Dist dist) {
+    return _contention_setup(dist, 1);
+}
+
+static void *_contention_setup_2(Dist dist) {
+    return _contention_setup(dist, 2);
+}
+
+static void *_contention_setup_4(Dist dist) {
+    return _contention_setup(dist, 4);
+}
+
+static void *_contention_setup_8(Dist dist) {
+    return _contention_setup(dist, 8);
+}
+
+static void _contention_teardown(void *state) {
+    Contention *c = state;
+    shared_str_pool_release(c->shared);
+    str_pool_release(c->strs);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+static void *_shared_put_worker(void *arg) {
+    Interner *in = arg;
+    for (size_t i = in->first; i < in->first + in->count; ++i) {
+        shared_str_pool_put(in->c->shared, keys[sequence[i]]);
+    }
+    return NULL;
+}
+
+static void *_locked_put_worker(void *arg) {
+    Interner *in = arg;
+    for (size_t i = in->first; i < in->first + in->count; ++i) {
+        pthread_mutex_lock(&in->c->lock);
+        str_pool_put(in->c->strs, keys[sequence[i]]);
+        pthread_mutex_unlock(&in->c->lock);
+    }
+    return NULL;
+}
+
+// splits the OPS operations among the threads, the calling one included
+static void _contend(Contention *c, void *(*fn)(void *)) {
+    pthread_t threads[c->threads];
+    Interner interners[c->threads];
+
+    for (unsigned t = 0; t < c->threads; ++t) {
+        interners[t] = (Interner){
+            .c = c,
+            .first = OPS * t / c->threads,
+            .count = OPS * (t + 1) / c->threads - OPS * t / c->threads,
+        };
+    }
+    for (unsigned t = 1; t < c->threads; ++t) {
+        pthread_create(&threads[t], NULL, fn, &interners[t]);
+    }
+    fn(&interners[0]);
+    for (unsigned t = 1; t < c->threads; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+}
+
+static void _shared_put(void *state) {
+    _contend(state, _shared_put_worker);
+}
+
+static void _locked_put(void *state) {
+    _contend(state, _locked_put_worker);
+}
+
+//
+// sym_table
+//
+
+static void *_syms_setup(Dist dist) {
+    _fill_sequence(dist);
+    return symtable_initialize();
+}
+
+static void *_syms_filled_setup(Dist dist) {
+    SymTable syms = _syms_setup(dist);
+    for (size_t k = 0; k < KEYS; ++k) {
+        symtable_add_symbol(syms, k, Type_INT);
+    }
+    return syms;
+}
+
+static void _syms_teardown(void *state) {
+    symtable_release(state);
+}
+
+static void _syms_add(void *state) {
+    for (size_t i = 0; i < OPS; ++i) {
+        symtable_add_symbol(state, sequence[i], Type_INT);
+    }
+}
+
+static void _syms_get(void *state) {
+    volatile uintptr_t sink = 0;
+    for (size_t i = 0; i < OPS; ++i) {
+        sink ^= (uintptr_t)symtable_get_info(state, sequence[i]);
+    }
+    (void)sink;
+}
+
+//
+// ast
+//
+
+static void *_ast_setup(Dist dist) {
+    (void)dist;
+    return ast_initialize();
+}
+
+static void _ast_teardown(void *state) {
+    ast_release(state);
+}
+
+// x = 1 + 2; with OPS nodes in total
+static void _ast_push(void *state) {
+    Ast ast = state;
+    Location loc = 0;
+    NodeID prev = NO_ID;
+    for (size_t i = 0; i + 4 <= OPS; i += 4) {
+        NodeID lhs = ast_mk_int(ast, loc, 1);
+        NodeID rhs = ast_mk_int(ast, loc, 2);
+        NodeID expr = ast_mk_binop(ast, loc, lhs, rhs, BinOp_ADD);
+        prev = ast_mk_asgn(ast, loc, prev, 0, expr);
+    }
+}
+
+//
+// visitor dispatch
+//
+
+typedef struct {
+    Ast ast;
+    NodeID root;
+} Program;
+
+static Status _noop(Visitor v, NodeID id) {
+    (void)v, (void)id;
+    return Status_OK;
+}
+
+static Status _walk_binop(Visitor v, NodeID id) {
+    AstNode *node = ast_get_expr(visitor_get_ast(v), id);
+    visit_expr(v, node->data.BINOP.lhs);
+    return visit_expr(v, node->data.BINOP.rhs);
+}
+
+static Status _walk_asgn(Visitor v, NodeID id) {
+    AstNode *node = ast_get_stmt(visitor_get_ast(v), id);
+    return visit_expr(v, node->data.ASGN.expr);
+}
+
+static Status _walk_main(Visitor v, NodeID id) {
+    AstNode *node = ast_get_stmt(visitor_get_ast(v), id);
+    return visit_stmt(v, node->data.MAIN.body);
+}
+
+// a few statements with deep expressions
+static void *_visit_setup(Dist dist) {
+    (void)dist;
+    Program *p = malloc(sizeof(*p));
+    p->ast = ast_initialize();
+
+    Location loc = 0;
+    NodeID body = NO_ID, prev = NO_ID;
+    for (size_t stmt = 0; stmt < 64; ++stmt) {
+        NodeID expr = ast_mk_var(p->ast, loc, 0);
+        for (size_t i = 0; i < (OPS / 64 - 2) / 2; ++i) {
+            NodeID rhs = ast_mk_int(p->ast, loc, i);
+            expr = ast_mk_binop(p->ast, loc, expr, rhs, BinOp_MUL);
+        }
+        prev = ast_mk_asgn(p->ast, loc, prev, 0, expr);
+        body = body == NO_ID ? prev : body;
+    }
+    p->root = ast_mk_main(p->ast, loc, Type_VOID, NO_ID, body);
+    return p;
+}
+
+static void _visit_teardown(void *state) {
+    Program *p = state;
+    ast_release(p->ast);
+    free(p);
+}
+
+static void _visit(void *state) {
+    Program *p = state;
+    Visitor v = init_visitor(
+        p->ast,
+        NULL,
+        NULL,
+        _noop,
+        _noop,
+        _noop,
+        _walk_binop,
+        _noop,
+        _walk_asgn,
+        _noop,
+        _walk_main);
+    ast_visit(v, p->root);
+    visitor_release(v);
+}
+
+typedef struct {
+    size_t dispatches;
+} Walk;
+
+#define WALK_NAME _bench_walk
+#define WALK_CTX Walk
+#define WALK_ON_DISPATCH(w) (++(w)->dispatches)
+#include "ast_walk.h"
+
+// same traversal as `_visit`, through the switch dispatched walker
+static void _walk(void *state) {
+    Program *p = state;
+    Walk w = { 0 };
+    _bench_walk_stmt(&w, p->ast, p->root);
+
+    volatile size_t sink = w.dispatches;
+    (void)sink;
+}
+
+//
+// sempass
+//
+
+typedef struct {
+    Ast ast;
+    NodeID root;
+    StrPool strs;
+    TypeTable types;
+} Typed;
+
+// x = ((x * 1) + (2 * x)) + ...; with OPS nodes in total
+static void *_sempass_setup(Dist dist) {
+    (void)dist;
+    Typed *t = malloc(sizeof(*t));
+    t->ast = ast_initialize();
+    t->strs = str_pool_init();
+    t->types = type_table_initialize();
+
+    Location loc = 0;
+    StrID x = str_pool_put(t->strs, "x");
+    NodeID body = ast_mk_decl(t->ast, loc, NO_ID, Type_INT, x);
+    NodeID prev = body;
+    while (t->ast->size + 16 < OPS) {
+        NodeID expr = ast_mk_var(t->ast, loc, x);
+        for (int64_t i = 0; i < 6; ++i) {
+            NodeID lhs = ast_mk_int(t->ast, loc, i);
+            NodeID rhs = ast_mk_binop(t->ast, loc, lhs, expr, BinOp_MUL);
+            NodeID var = ast_mk_var(t->ast, loc, x);
+            expr = ast_mk_binop(t->ast, loc, rhs, var, BinOp_ADD);
+        }
+        prev = ast_mk_asgn(t->ast, loc, prev, x, expr);
+    }
+    t->root = ast_mk_main(t->ast, loc, Type_VOID, NO_ID, body);
+    return t;
+}
+
+static void _sempass_teardown(void *state) {
+    Typed *t = state;
+    ast_release(t->ast);
+    str_pool_release(t->strs);
+    type_table_release(t->types);
+    free(t);
+}
+
+static void _sempass_walk(void *state) {
+    Typed *t = state;
+    sempass_report(t->ast, t->root, t->strs, t->types, stderr);
+}
+
+static void _sempass_sweep(void *state) {
+    Typed *t = state;
+    sempass_linear(t->ast, t->root, t->strs, t->types, stderr);
+}
+
+//
+// interp & vm
+//
+
+// OPS statements in the style of examples/basic.txt over a few variables,
+// x = x + 3; y = x * y; z = y + 7; y = z; ...
+static NodeID _basic_program(Ast ast, StrPool strs) {
+    Location loc = 0;
+    StrID vars[4] = {
+        str_pool_put(strs, "x"),
+        str_pool_put(strs, "y"),
+        str_pool_put(strs, "z"),
+        str_pool_put(strs, "w"),
+    };
+
+    NodeID body = ast_mk_decl(ast, loc, NO_ID, Type_INT, vars[0]);
+    NodeID prev = body;
+    for (size_t i = 1; i < 4; ++i) {
+        prev = ast_mk_decl(ast, loc, prev, Type_INT, vars[i]);
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        prev = ast_mk_asgn(ast, loc, prev, vars[i], ast_mk_int(ast, loc, i));
+    }
+
+    for (size_t stmt = 8; stmt + 1 < OPS; ++stmt) {
+        StrID x = vars[stmt % 4], y = vars[(stmt + 1) % 4];
+        NodeID expr;
+        switch (stmt % 4) {
+        case 0:
+            expr = ast_mk_binop(
+                ast,
+                loc,
+                ast_mk_var(ast, loc, x),
+                ast_mk_int(ast, loc, 3),
+                BinOp_ADD);
+            break;
+        case 1:
+            expr = ast_mk_binop(
+                ast,
+                loc,
+                ast_mk_var(ast, loc, x),
+                ast_mk_var(ast, loc, y),
+                BinOp_MUL);
+            break;
+        case 2:
+            expr = ast_mk_binop(
+                ast,
+                loc,
+                ast_mk_binop(
+                    ast,
+                    loc,
+                    ast_mk_var(ast, loc, x),
+                    ast_mk_var(ast, loc, y),
+                    BinOp_ADD),
+                ast_mk_int(ast, loc, 7),
+                BinOp_MUL);
+            break;
+        default:
+            expr = ast_mk_var(ast, loc, y);
+            break;
+        }
+        prev = ast_mk_asgn(ast, loc, prev, x, expr);
+    }
+    ast_mk_ret(ast, loc, prev, ast_mk_var(ast, loc, vars[0]));
+    return ast_mk_main(ast, loc, Type_INT, NO_ID, body);
+}
+
+typedef struct {
+    Ast ast;
+    NodeID root;
+    StrPool strs;
+    TraceText text;
+    FILE *null;
+    TraceRing ring;
+    Tracer hooks;
+    // NULL to run without tracing
+    const Tracer *tracer;
+} Interp;
+
+static Interp *_interp_setup() {
+    Interp *in = calloc(1, sizeof(*in));
+    in->ast = ast_initialize();
+    in->strs = str_pool_init();
+    in->root = _basic_program(in->ast, in->strs);
+    return in;
+}
+
+static void *_interp_untraced_setup(Dist dist) {
+    (void)dist;
+    return _interp_setup();
+}
+
+// what the text tracer writes is thrown away, only formatting it is timed
+static void *_interp_text_setup(Dist dist) {
+    (void)dist;
+    Interp *in = _interp_setup();
+    in->null = fopen("/dev/null", "w");
+    in->text = trace_text_initialize(in->strs, in->null);
+    in->hooks = trace_text_tracer(in->text);
+    in->tracer = &in->hooks;
+    return in;
+}
+
+static void *_interp_ring_setup(Dist dist) {
+    (void)dist;
+    Interp *in = _interp_setup();
+    in->ring = trace_ring_initialize(64 * 1024);
+    in->hooks = trace_ring_tracer(in->ring);
+    in->tracer = &in->hooks;
+    return in;
+}
+
+static void _interp_teardown(void *state) {
+    Interp *in = state;
+    if (in->text != NULL) {
+        trace_text_release(in->text);
+        fclose(in->null);
+    }
+    trace_ring_release(in->ring);
+    ast_release(in->ast);
+    str_pool_release(in->strs);
+    free(in);
+}
+
+static void _interp_run(void *state) {
+    Interp *in = state;
+    SymTable syms = symtable_initialize();
+    Sym result = interp(in->ast, in->root, in->strs, syms, in->tracer);
+    symtable_release(syms);
+
+    volatile int64_t sink = result.value.v_int;
+    (void)sink;
+}
+
+static Bytecode _vm_compile(bool fuse) {
+    Ast ast = ast_initialize();
+    StrPool strs = str_pool_init();
+    NodeID root = _basic_program(ast, strs);
+
+    // the bytecode doesn't point into the AST nor the pool
+    Bytecode bytecode = bytecode_compile(ast, root, strs, fuse);
+    ast_release(ast);
+    str_pool_release(strs);
+    return bytecode;
+}
+
+static void *_vm_plain_setup(Dist dist) {
+    (void)dist;
+    return _vm_compile(false);
+}
+
+static void *_vm_fused_setup(Dist dist) {
+    (void)dist;
+    return _vm_compile(true);
+}
+
+static void _vm_teardown(void *state) {
+    bytecode_release(state);
+}
+
+static void _vm_run(void *state) {
+    Sym result;
+    vm_run(bytecode_chunk(state), NULL, &result);
+
+    volatile int64_t sink = result.value.v_int;
+    (void)sink;
+}
+
+static const Bench BENCHES[] = {
+    { "str_pool_put/new/seq", Dist_SEQUENTIAL, _pool_setup, _pool_put, _pool_teardown },
+    { "str_pool_put/hit/uniform", Dist_UNIFORM, _pool_filled_setup, _pool_put, _pool_teardown },
+    { "str_pool_put/hit/zipf", Dist_ZIPF, _pool_filled_setup, _pool_put, _pool_teardown },
+    { "str_pool_get/uniform", Dist_UNIFORM, _pool_filled_setup, _pool_get, _pool_teardown },
+    { "str_pool_put/locked/t1", Dist_UNIFORM, _contention_setup_1, _locked_put, _contention_teardown },
+    { "str_pool_put/locked/t2", Dist_UNIFORM, _contention_setup_2, _locked_put, _contention_teardown },
+    { "str_pool_put/locked/t4", Dist_UNIFORM, _contention_setup_4, _locked_put, _contention_teardown },
+    { "str_pool_put/locked/t8", Dist_UNIFORM, _contention_setup_8, _locked_put, _contention_teardown },
+    { "shared_str_pool_put/t1", Dist_UNIFORM, _contention_setup_1, _shared_put, _contention_teardown },
+    { "shared_str_pool_put/t2", Dist_UNIFORM, _contention_setup_2, _shared_put, _contention_teardown },
+    { "shared_str_pool_put/t4", Dist_UNIFORM, _contention_setup_4, _shared_put, _contention_teardown },
+    { "shared_str_pool_put/t8", Dist_UNIFORM, _contention_setup_8, _shared_put, _contention_teardown },
+    { "symtable_add_symbol/seq", Dist_SEQUENTIAL, _syms_setup, _syms_add, _syms_teardown },
+    { "symtable_get_info/uniform", Dist_UNIFORM, _syms_filled_setup, _syms_get, _syms_teardown },
+    { "symtable_get_info/zipf", Dist_ZIPF, _syms_filled_setup, _syms_get, _syms_teardown },
+    { "ast_mk/push_growth", Dist_SEQUENTIAL, _ast_setup, _ast_push, _ast_teardown },
+    { "visitor/dispatch", Dist_SEQUENTIAL, _visit_setup, _visit, _visit_teardown },
+    { "walker/dispatch", Dist_SEQUENTIAL, _visit_setup, _walk, _visit_teardown },
+    { "sempass/walk", Dist_SEQUENTIAL, _sempass_setup, _sempass_walk, _sempass_teardown },
+    { "sempass/sweep", Dist_SEQUENTIAL, _sempass_setup, _sempass_sweep, _sempass_teardown },
+    { "interp/untraced", Dist_SEQUENTIAL, _interp_untraced_setup, _interp_run, _interp_teardown },
+    { "interp/text", Dist_SEQUENTIAL, _interp_text_setup, _interp_run, _interp_teardown },
+    { "interp/ring", Dist_SEQUENTIAL, _interp_ring_setup, _interp_run, _interp_teardown },
+    { "vm_run/plain", Dist_SEQUENTIAL, _vm_plain_setup, _vm_run, _vm_teardown },
+    { "vm_run/fused", Dist_SEQUENTIAL, _vm_fused_setup, _vm_run, _vm_teardown },
+};
+
+#define N_BENCHES (sizeof(BENCHES) / sizeof(BENCHES[0]))
+
+//
+// hardware counters
+//
+
+typedef struct {
+    int cycles;
+    int misses;
+} Perf;
+
+#ifdef __linux__
+static int _perf_open(uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static bool _perf_init(Perf *perf) {
+    perf->cycles = _perf_open(PERF_COUNT_HW_CPU_CYCLES, -1);
+    perf->misses = perf->cycles == -1
+                       ? -1
+                       : _perf_open(PERF_COUNT_HW_CACHE_MISSES, perf->cycles);
+    if (perf->misses == -1) {
+        if (perf->cycles != -1) {
+            close(perf->cycles);
+        }
+        return false;
+    }
+    return true;
+}
+
+static void _perf_start(const Perf *perf) {
+    ioctl(perf->cycles, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf->cycles, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static void _perf_stop(const Perf *perf, uint64_t *cycles, uint64_t *misses) {
+    ioctl(perf->cycles, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read(perf->cycles, cycles, sizeof(*cycles)) != sizeof(*cycles) ||
+        read(perf->misses, misses, sizeof(*misses)) != sizeof(*misses)) {
+        *cycles = *misses = 0;
+    }
+}
+#else
+static bool _perf_init(Perf *perf) {
+    (void)perf;
+    return false;
+}
+
+static void _perf_start(const Perf *perf) {
+    (void)perf;
+}
+
+static void _perf_stop(const Perf *perf, uint64_t *cycles, uint64_t *misses) {
+    (void)perf;
+    *cycles = *misses = 0;
+}
+#endif
+
+//
+// driver
+//
+
+static double _now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int _cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double _percentile(const double *sorted, size_t n, double p) {
+    size_t rank = (size_t)ceil(p / 100 * n);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static Result _measure(const Bench *b, int warmup, int reps, const Perf *perf) {
+    double *samples = malloc(reps * sizeof(*samples));
+    uint64_t cycles = 0, misses = 0;
+    Result res = { .has_perf = perf != NULL };
+
+    for (int i = -warmup; i < reps; ++i) {
+        void *state = b->setup(b->dist);
+
+        if (perf != NULL) {
+            _perf_start(perf);
+        }
+        double start = _now();
+        b->run(state);
+        double elapsed = _now() - start;
+        if (perf != NULL) {
+            uint64_t c, m;
+            _perf_stop(perf, &c, &m);
+            if (i >= 0) {
+                cycles += c;
+                misses += m;
+            }
+        }
+
+        b->teardown(state);
+        if (i >= 0) {
+            samples[i] = elapsed / OPS;
+        }
+    }
+
+    qsort(samples, reps, sizeof(*samples), _cmp_double);
+    res.min = samples[0];
+    res.max = samples[reps - 1];
+    res.p50 = _percentile(samples, reps, 50);
+    res.p90 = _percentile(samples, reps, 90);
+    res.p99 = _percentile(samples, reps, 99);
+    res.cycles = (double)cycles / reps / OPS;
+    res.cache_misses = (double)misses / reps / OPS;
+
+    free(samples);
+    return res;
+}
+
+// looks `name` up in a baseline file of "<name> <p50 ns/op>" lines
+static bool _baseline_p50(FILE *baseline, const char *name, double *p50) {
+    char line[256], key[128];
+    double value;
+
+    rewind(baseline);
+    while (fgets(line, sizeof(line), baseline) != NULL) {
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%127s %lf", key, &value) == 2 && strcmp(key, name) == 0) {
+            *p50 = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void _usage(const char *prog) {
+    fprintf(
+        stderr,
+        "usage: %s [--reps N] [--warmup N] [--filter SUBSTR] [--perf]\n"
+        "       [--baseline FILE] [--tolerance PCT] [--save FILE]\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    int reps = 21, warmup = 3;
+    double tolerance = 10;
+    const char *filter = NULL, *baseline_path = NULL, *save_path = NULL;
+    bool use_perf = false;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--reps") == 0 && has_value) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && has_value) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && has_value) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && has_value) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--save") == 0 && has_value) {
+            save_path = argv[++i];
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            use_perf = true;
+        } else {
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+    if (reps <= 0 || warmup < 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    for (size_t k = 0; k < KEYS; ++k) {
+        snprintf(keys[k], sizeof(keys[k]), "ident%zu", k);
+    }
+
+    Perf perf;
+    if (use_perf && !_perf_init(&perf)) {
+        fprintf(stderr, "perf_event_open unavailable, counters disabled\n");
+        use_perf = false;
+    }
+
+    FILE *baseline = NULL;
+    if (baseline_path != NULL && (baseline = fopen(baseline_path, "r")) == NULL) {
+        perror(baseline_path);
+        return 1;
+    }
+    FILE *save = NULL;
+    if (save_path != NULL && (save = fopen(save_path, "w")) == NULL) {
+        perror(save_path);
+        return 1;
+    }
+    if (save != NULL) {
+        fprintf(save, "# <benchmark> <p50 ns/op>, %d reps of %d ops\n", reps, OPS);
+    }
+
+    printf(
+        "%-28s %9s %9s %9s %9s %9s %10s %10s %10s\n",
+        "benchmark (ns/op)",
+        "min",
+        "p50",
+        "p90",
+        "p99",
+        "max",
+        "cycles/op",
+        "misses/op",
+        "vs base");
+
+    int regressions = 0;
+    int missing = 0;
+    for (size_t i = 0; i < N_BENCHES; ++i) {
+        const Bench *b = &BENCHES[i];
+        if (filter != NULL && strstr(b->name, filter) == NULL) {
+            continue;
+        }
+
+        Result r = _measure(b, warmup, reps, use_perf ? &perf : NULL);
+        printf(
+            "%-28s %9.2f %9.2f %9.2f %9.2f %9.2f",
+            b->name,
+            r.min,
+            r.p50,
+            r.p90,
+            r.p99,
+            r.max);
+        if (r.has_perf) {
+            printf(" %10.1f %10.3f", r.cycles, r.cache_misses);
+        } else {
+            printf(" %10s %10s", "-", "-");
+        }
+
+        double base;
+        if (baseline != NULL && _baseline_p50(baseline, b->name, &base)) {
+            double delta = (r.p50 - base) / base * 100;
+            bool regressed = delta > tolerance;
+            regressions += regressed;
+            printf(" %+9.1f%%%s", delta, regressed ? " REGRESSION" : "");
+        } else if (baseline != NULL) {
+            // not recorded yet, flagged so that it doesn't pass unnoticed
+            ++missing;
+            printf(" %10s", "NEW");
+        } else {
+            printf(" %10s", "-");
+        }
+        printf("\n");
+
+        if (save != NULL) {
+            fprintf(save, "%s %.3f\n", b->name, r.p50);
+        }
+    }
+
+    if (baseline != NULL) {
+        fclose(baseline);
+    }
+    if (missing > 0) {
+        fflush(stdout);
+        fprintf(
+            stderr,
+            "%d benchmarks missing from %s, record them with --save\n",
+            missing,
+            baseline_path);
+    }
+    if (save != NULL) {
+        fclose(save);
+    }
+
+    return regressions > 0;
+}
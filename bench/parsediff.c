@@ -0,0 +1,289 @@
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+#include "parser.h"
+#include "pratt.h"
+#include "precc.h"
+#include "str_pool.h"
+#include "tokens.h"
+#include "util.h"
+
+//
+// Differential test of the pratt parser against bison: programs from
+// bench/gen, and copies of them with random tokens inserted, deleted and
+// swapped, are compiled by a session parsing with `Parser_BISON` and one
+// parsing with `Parser_PRATT`, comparing their status, diagnostics and AST.
+// Both sessions lex with `Lexer_SIMD`, so that bison reads the same token
+// array lexed up front as pratt does
+//
+
+// token kinds spelled by a fixed text, identifiers and numbers aside
+static const struct {
+    int kind;
+    const char *text;
+} TEXTS[] = {
+    { TOK_MAIN, "main" },    { TOK_RETURN, "return" }, { TOK_VOID, "void" },
+    { TOK_BOOL, "bool" },    { TOK_INT, "int" },       { TOK_TRUE, "true" },
+    { TOK_FALSE, "false" },  { TOK_PLUS, "+" },        { TOK_STAR, "*" },
+    { TOK_EQUAL, "=" },      { TOK_LPAREN, "(" },      { TOK_RPAREN, ")" },
+    { TOK_LCURLY, "{" },     { TOK_RCURLY, "}" },      { TOK_SEMICOLON, ";" },
+    { TOK_COMMA, "," },      { TOK_ILLEGAL_CHAR, "@" },
+};
+
+#define N_TEXTS (sizeof(TEXTS) / sizeof(TEXTS[0]))
+
+static uint64_t rng = 42;
+
+// splitmix64
+static uint64_t _next() {
+    uint64_t z = (rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// compiles `src` with both parsers, false if they differ
+static bool _check(
+    const char *name,
+    const char *src,
+    size_t len,
+    PreccSession bison,
+    PreccSession pratt,
+    Buffer *lhs,
+    Buffer *rhs,
+    size_t *errors) {
+    precc_session_compile(bison, src, len);
+    precc_session_compile(pratt, src, len);
+    _dump(bison, lhs);
+    _dump(pratt, rhs);
+    if (precc_session_status(bison) != Status_OK) {
+        ++*errors;
+    }
+
+    if (lhs->size != rhs->size || memcmp(lhs->data, rhs->data, lhs->size)) {
+        fprintf(
+            stderr, "%s: pratt differs from bison:\n%.*s---\n%.*s---\n%.*s",
+            name, (int)lhs->size, lhs->data, (int)rhs->size, rhs->data,
+            (int)len, src);
+        return false;
+    }
+    return true;
+}
+
+//
+// sources
+//
+
+// runs bench/gen with the given seed
+static char *_generate(const char *gen, size_t stmts, uint64_t seed, size_t *len) {
+    char cmd[1024];
+    snprintf(
+        cmd, sizeof(cmd), "%s -n %zu -s %" PRIu64, gen, stmts, seed);
+    FILE *pipe = popen(cmd, "r");
+    if (pipe == NULL) {
+        return NULL;
+    }
+
+    char *src = u_read_all(pipe, len);
+    if (pclose(pipe) != 0) {
+        free(src);
+        return NULL;
+    }
+    return src;
+}
+
+// any token but the end of the input, identifiers and numbers taken from
+// `tokens`
+static Token _random_token(const Tokens tokens) {
+    Token tok = tokens->data[_next() % (tokens->size - 1)];
+    switch (_next() % 4) {
+    case 0:
+        tok.kind = TOK_NUM;
+        tok.value.num = (int64_t)(_next() % 100);
+        break;
+    case 1:
+        if (tok.kind == TOK_IDENT) {
+            break;
+        }
+        // fall through
+    default:
+        tok.kind = TEXTS[_next() % N_TEXTS].kind;
+        break;
+    }
+    return tok;
+}
+
+// inserts, deletes or swaps a few random tokens of `tokens`, keeping the end
+// of the input last
+static bool _mutate(Tokens tokens) {
+    size_t mutations = 1 + _next() % 4;
+    for (size_t m = 0; m < mutations; ++m) {
+        size_t n = tokens->size - 1;
+        size_t i = n > 0 ? _next() % n : 0;
+
+        switch (_next() % 3) {
+        case 0: {
+            if (!tokens_reserve(tokens, tokens->size + 1)) {
+                return false;
+            }
+            Token tok = _random_token(tokens);
+            memmove(
+                &tokens->data[i + 1], &tokens->data[i],
+                (tokens->size - i) * sizeof(Token));
+            tokens->data[i] = tok;
+            ++tokens->size;
+            break;
+        }
+        case 1:
+            if (n == 0) {
+                break;
+            }
+            memmove(
+                &tokens->data[i], &tokens->data[i + 1],
+                (tokens->size - i - 1) * sizeof(Token));
+            --tokens->size;
+            break;
+        default: {
+            if (n == 0) {
+                break;
+            }
+            size_t j = _next() % n;
+            Token tmp = tokens->data[i];
+            tokens->data[i] = tokens->data[j];
+            tokens->data[j] = tmp;
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+// spells `tokens` back out, one statement per line, so that lexing the text
+// gives the same tokens
+static void _render(const Tokens tokens, StrPool strs, Buffer *out) {
+    out->size = 0;
+    for (size_t i = 0; i + 1 < tokens->size; ++i) {
+        const Token *tok = &tokens->data[i];
+        if (tok->kind == TOK_IDENT) {
+            _append(out, "%s", str_pool_get(strs, tok->value.ident));
+        } else if (tok->kind == TOK_NUM) {
+            _append(out, "%" PRIi64, tok->value.num);
+        } else {
+            for (size_t k = 0; k < N_TEXTS; ++k) {
+                if (TEXTS[k].kind == tok->kind) {
+                    _append(out, "%s", TEXTS[k].text);
+                    break;
+                }
+            }
+        }
+
+        bool eol = tok->kind == TOK_SEMICOLON || tok->kind == TOK_LCURLY ||
+                   tok->kind == TOK_RCURLY;
+        _append(out, eol ? "\n" : " ");
+    }
+    _append(out, "\n");
+}
+
+static void _usage(const char *prog) {
+    fprintf(
+        stderr,
+        "usage: %s [--gen PATH] [--programs N] [--stmts N] [--mutants N] "
+        "[--seed N]\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *gen = "./bench/gen";
+    size_t programs = 100;
+    size_t stmts = 500;
+    size_t mutants = 20;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--gen") == 0 && has_value) {
+            gen = argv[++i];
+        } else if (strcmp(argv[i], "--programs") == 0 && has_value) {
+            programs = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--stmts") == 0 && has_value) {
+            stmts = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--mutants") == 0 && has_value) {
+            mutants = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            rng = strtoull(argv[++i], NULL, 10);
+        } else {
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+
+    PreccSession bison = precc_session_create();
+    PreccSession pratt = precc_session_create();
+    Tokens tokens = tokens_initialize();
+    StrPool strs = str_pool_init();
+    if (bison == NULL || pratt == NULL || tokens == NULL || strs == NULL) {
+        return 1;
+    }
+    precc_session_set_lexer(bison, Lexer_SIMD);
+    precc_session_set_lexer(pratt, Lexer_SIMD);
+    precc_session_set_parser(bison, Parser_BISON);
+    precc_session_set_parser(pratt, Parser_PRATT);
+
+    Buffer text = { 0 }, lhs = { 0 }, rhs = { 0 };
+    bool ok = true;
+    size_t sources = 0;
+    size_t errors = 0;
+    for (size_t k = 0; k < programs && ok; ++k) {
+        char name[64];
+        size_t len;
+        uint64_t seed = _next();
+        char *src = _generate(gen, stmts, seed, &len);
+        if (src == NULL) {
+            fprintf(stderr, "%s failed for seed %" PRIu64 "\n", gen, seed);
+            ok = false;
+            break;
+        }
+        snprintf(name, sizeof(name), "gen seed %" PRIu64, seed);
+        ok = _check(name, src, len, bison, pratt, &lhs, &rhs, &errors);
+        ++sources;
+
+        for (size_t m = 0; m < mutants && ok; ++m) {
+            tokens_clear(tokens);
+            if (tokens_lex(tokens, src, len, strs, Lexer_FLEX, 1, stderr) !=
+                    Status_OK ||
+                !_mutate(tokens)) {
+                ok = false;
+                break;
+            }
+            _render(tokens, strs, &text);
+
+            snprintf(
+                name, sizeof(name), "mutant %zu of gen seed %" PRIu64, m, seed);
+            ok = _check(
+                name, text.data, text.size, bison, pratt, &lhs, &rhs, &errors);
+            ++sources;
+        }
+        free(src);
+    }
+
+    if (ok) {
+        printf(
+            "%zu sources, %zu with syntax errors: pratt agrees with bison\n",
+            sources, errors);
+    }
+
+    free(text.data);
+    free(lhs.data);
+    free(rhs.data);
+    str_pool_release(strs);
+    tokens_release(tokens);
+    precc_session_destroy(bison);
+    precc_session_destroy(pratt);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "precc.h"
+#include "str_pool.h"
+
+//
+// Compiles millions of distinct programs in one session, with its string pool
+// capped, and checks neither the RSS of the process nor the live bytes of the
+// pool grow once the first programs warmed it up
+//
+
+// RSS and pool samples taken over the whole run, the first one is the warm up
+#define SAMPLES 20
+
+static uint64_t rng = 42;
+
+// splitmix64
+static uint64_t _next() {
+    uint64_t z = (rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static double _now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// resident set size of the process in bytes, 0 if it can't be read
+static size_t _rss() {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    unsigned long size, resident;
+    int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    return n == 2 ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+// writes program `k`, whose identifiers no other program uses
+static int _program(char *buf, size_t len, size_t k) {
+    uint64_t salt = _next() % 1000;
+    return snprintf(
+        buf, len,
+        "int main(int a%zux%" PRIu64 ") {\n"
+        "    int s%zu;\n"
+        "    bool t%zu;\n"
+        "    s%zu = a%zux%" PRIu64 " * %" PRIu64 " + 7;\n"
+        "    t%zu = true;\n"
+        "    return s%zu + a%zux%" PRIu64 ";\n"
+        "}\n",
+        k, salt, k, k, k, k, salt, salt, k, k, k, salt);
+}
+
+static void _usage(const char *prog) {
+    fprintf(
+        stderr,
+        "usage: %s [--programs N] [--limit BYTES] [--slack KB] [--seed N]\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    size_t programs = 1000000;
+    size_t limit = 4096;
+    size_t slack = 1024;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--programs") == 0 && has_value) {
+            programs = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--limit") == 0 && has_value) {
+            limit = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--slack") == 0 && has_value) {
+            slack = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            rng = strtoull(argv[++i], NULL, 10);
+        } else {
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+    if (programs < SAMPLES || limit == 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    PreccSession session = precc_session_create();
+    if (session == NULL) {
+        return 1;
+    }
+    StrPool strs = precc_session_strs(session);
+    str_pool_set_limit(strs, limit);
+
+    printf(
+        "%12s %12s %14s %16s %12s\n", "programs", "rss KB", "pool live B",
+        "pool resident B", "programs/s");
+
+    size_t warm_rss = 0;
+    size_t warm_resident = 0;
+    bool ok = true;
+    double start = _now();
+    for (size_t k = 0; k < programs && ok; ++k) {
+        char src[512];
+        int len = _program(src, sizeof(src), k);
+        if (precc_session_compile(session, src, (size_t)len) != Status_OK) {
+            fprintf(stderr, "program %zu failed to compile:\n%s", k, src);
+            fputs(precc_session_diagnostics(session), stderr);
+            ok = false;
+            continue;
+        }
+
+        if ((k + 1) % (programs / SAMPLES) != 0) {
+            continue;
+        }
+
+        size_t rss = _rss();
+        size_t live = str_pool_bytes(strs);
+        size_t resident = str_pool_resident_bytes(strs);
+        printf(
+            "%12zu %12zu %14zu %16zu %12.0f\n", k + 1, rss / 1024, live,
+            resident, (k + 1) / ((_now() - start) / 1e9));
+
+        if (warm_rss == 0) {
+            warm_rss = rss;
+            warm_resident = resident;
+        }
+        if (live > limit) {
+            fprintf(stderr, "pool holds %zu live bytes over the limit\n", live);
+            ok = false;
+        }
+        if (resident > warm_resident) {
+            fprintf(
+                stderr, "pool grew from %zu to %zu resident bytes\n",
+                warm_resident, resident);
+            ok = false;
+        }
+        if (rss > warm_rss + slack * 1024) {
+            fprintf(
+                stderr, "rss grew from %zu to %zu KB\n", warm_rss / 1024,
+                rss / 1024);
+            ok = false;
+        }
+    }
+
+    precc_session_destroy(session);
+    return ok ? 0 : 1;
+}
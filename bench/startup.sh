@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+# Startup benchmark: time to the first instruction of generated programs of
+# increasing size, compiled from source versus mapped from a precompiled
+# image (`precc --compile` / `precc --run`).
+#
+# From source it's lexing, parsing, checking and lowering to bytecode, from
+# an image it's mapping and verifying it.
+#
+# Environment:
+#   PRECC        compiler under test (default ./precc)
+#   GEN          program generator (default bench/gen)
+#   BENCH_SIZES  statement counts to sweep (default 10^2 .. 10^6)
+#   GEN_FLAGS    extra knobs for the generator, see `bench/gen -h`
+
+PRECC=${PRECC:-./precc}
+GEN=${GEN:-bench/gen}
+BENCH_SIZES=${BENCH_SIZES:-"100 1000 10000 100000 1000000"}
+SOURCE_PHASES="lex yyparse sempass initpass bytecode"
+
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# phase_wall <json> <phase> -> wall_s
+phase_wall() {
+    sed -n "s/.*\"$2\":{\"wall_s\":\([^,]*\),.*/\1/p" "$1"
+}
+
+# sum_walls <json> <phase>... -> sum of their wall_s
+sum_walls() {
+    json=$1
+    shift
+    for phase in "$@"; do
+        phase_wall "$json" "$phase"
+    done | awk '{ s += $1 } END { printf "%.9f\n", s }'
+}
+
+printf "%10s %14s %14s %10s %14s\n" \
+    "stmts" "source (ms)" "image (ms)" "speedup" "image (kB)"
+
+for n in $BENCH_SIZES; do
+    src="$TMP/prog_$n.txt"
+    img="$TMP/prog_$n.pcb"
+    # shellcheck disable=SC2086
+    "$GEN" -n "$n" $GEN_FLAGS > "$src" || exit 1
+
+    if ! "$PRECC" --time-report=json --compile -o "$img" < "$src" \
+        > /dev/null 2> "$TMP/report"; then
+        printf "%10s FAILED (compile)\n" "$n"
+        continue
+    fi
+    tail -n 1 "$TMP/report" > "$TMP/json"
+    # shellcheck disable=SC2086
+    source_s=$(sum_walls "$TMP/json" $SOURCE_PHASES)
+
+    # generated programs take no arguments
+    if ! "$PRECC" --time-report=json --run "$img" \
+        > /dev/null 2> "$TMP/report"; then
+        printf "%10s FAILED (run)\n" "$n"
+        continue
+    fi
+    tail -n 1 "$TMP/report" > "$TMP/json"
+    image_s=$(phase_wall "$TMP/json" image_load)
+
+    bytes=$(wc -c < "$img")
+    awk -v n="$n" -v s="$source_s" -v i="$image_s" -v b="$bytes" 'BEGIN {
+        printf "%10s %14.3f %14.3f %9.1fx %14.1f\n",
+            n, s * 1e3, i * 1e3, (i > 0 ? s / i : 0), b / 1024
+    }'
+    rm -f "$src" "$img"
+done
@@ -15,28 +15,29 @@ extern "C" {
 
 typedef uint32_t NodeID;
 
-typedef struct {
-    uint32_t line;
-    uint32_t col;
-} Location;
+/* Byte offset in the source, see line_index.h for its line and column */
+typedef uint32_t Location;
+
+/* 4-byte aligned, so that nodes pack into 24 bytes */
+typedef int64_t AstInt __attribute__((aligned(4)));
 
 typedef enum {
     BinOp_ADD,
     BinOp_MUL,
 } BinOp;
 
-#define FOR_AST_NODES(DO)                                   \
-    /* expressions */                                       \
-    DO(BOOL_CONSTANT, bool)                                 \
-    DO(INT_CONSTANT, int64_t)                               \
-    DO(BINOP, struct { NodeID lhs; NodeID rhs; BinOp op; }) \
-    DO(VAR, StrID)                                          \
-    /* statements */                                        \
-    DO(DECL, struct { StrID var; Type type; })              \
-    DO(ASGN, struct { StrID var; NodeID expr; })            \
-    DO(RET, NodeID)                                         \
-    /* toplevel */                                          \
-    DO(MAIN, struct { NodeID body; Type ret_type; })        \
+#define FOR_AST_NODES(DO)                                           \
+    /* expressions */                                               \
+    DO(BOOL_CONSTANT, bool)                                         \
+    DO(INT_CONSTANT, AstInt)                                        \
+    DO(BINOP, struct { NodeID lhs; NodeID rhs; BinOp op; })         \
+    DO(VAR, StrID)                                                  \
+    /* statements */                                                \
+    DO(DECL, struct { StrID var; Type type; })                      \
+    DO(ASGN, struct { StrID var; NodeID expr; })                    \
+    DO(RET, NodeID)                                                 \
+    /* toplevel */                                                  \
+    DO(MAIN, struct { NodeID params; NodeID body; Type ret_type; }) \
 
 #define MK_KINDS(name, type) AstNodeKind_ ## name,
 typedef enum {
@@ -50,8 +51,9 @@ typedef union {
 } AstNodeData;
 #undef MK_DATA
 
+// the AST isn't written after parsing, types of expressions go to a
+// TypeTable
 typedef union {
-    Type expr_type;
     NodeID stmt_next;
 } AstNodeHeader;
 
@@ -84,6 +86,21 @@ Ast ast_initialize();
  */
 void ast_release(Ast self);
 
+/**
+ * @brief Remove every node from the AST, keeping its memory for reuse
+ *
+ * @note All IDs from the AST are considered invalid after calling this
+ */
+void ast_clear(Ast self);
+
+/**
+ * @brief Remove every node pushed after the first `size` ones, keeping their
+ * memory for reuse
+ *
+ * @note IDs of the removed nodes are considered invalid after calling this
+ */
+void ast_truncate(Ast self, size_t size);
+
 /**
  * @brief Push a 'return' Statement into the AST
  *
@@ -120,11 +137,18 @@ NodeID ast_mk_asgn(Ast self, Location loc, NodeID prev, StrID ident, NodeID expr
  * @brief Push a 'main' Statement into the AST
  *
  * @param[in] type - Return type
+ * @param[in] params - ID of the first of the chained 'declaration'
+ * Statements of the input parameters, or NO_ID if it takes none
  * @param[in] body - ID of a valid node from the AST
  *
  * @returns The ID of the new node if successful, NO_ID otherwise
  */
-NodeID ast_mk_main(Ast self, Location loc, Type type, NodeID body);
+NodeID ast_mk_main(
+    Ast self,
+    Location loc,
+    Type type,
+    NodeID params,
+    NodeID body);
 
 /**
  * @brief Push an 'integer constant' Expression into the AST
@@ -16,7 +16,8 @@ typedef struct Visitor_S *Visitor;
  * @param[in] ast              The Abstract Syntax Tree to traverse.
  * @param[in] strs             String pool for managing identifier strings.
  * @param[in] additional_args  User-provided arguments for customized traversal.
- * @param[in] visit_<node>     Callback function for visiting <node>
+ * @param[in] visit_<node>     Callback function for visiting <node>, NULL to
+ *                             just visit the children of <node>
  * @return A newly initialized Visitor, or NULL if initialization fails.
  */
 Visitor init_visitor(
@@ -116,16 +117,126 @@ Ast visitor_get_ast(Visitor self);
  */
 StrPool visitor_get_strs(Visitor self);
 
+//
+// FUSED PASSES:
+//
+
+/**
+ * @brief A pass that can be fused with others into a single walk of the AST
+ *
+ * Passes see one statement at a time, the statements of `main` are walked
+ * once and handed to every pass in order before moving to the next one, so
+ * each statement is still hot in cache for the passes after the first.
+ */
+typedef struct {
+    void *context;
+
+    /* Optional, called before the body of `main`, the pass handles its
+     * parameters here */
+    Status (*enter_main)(void *context, const Ast ast, NodeID main_id);
+    /* Called with each statement, which the pass walks however it needs */
+    Status (*visit_stmt)(void *context, const Ast ast, NodeID stmt_id);
+    /* Optional, called after the body of `main` */
+    Status (*leave_main)(void *context, const Ast ast, NodeID main_id);
+    /* Optional, frees `context` */
+    void (*release)(void *context);
+
+    /* Skip the pass once a pass before it failed, e.g. to not run code
+     * that didn't type check */
+    bool gated;
+    /* First error returned by the pass, set by `ast_visit_fused` */
+    Status status;
+} AstPass;
+
+/**
+ * @brief Walk the AST once, running every pass on each statement
+ *
+ * For every statement the passes run in the order given, so an ordering
+ * dependency between them (check, then execute, then print) is honoured
+ * statement by statement.
+ *
+ * @param[in] root - ID of `main` or of the first statement of a chain
+ * @param[in,out] passes - Passes to run, their `status` is updated
+ * @param[in] n - Number of passes
+ *
+ * @returns The first error of the first pass that failed, Status_OK if
+ * none did
+ */
+Status ast_visit_fused(const Ast ast, NodeID root, AstPass *passes, size_t n);
+
+/**
+ * @brief Steps of `ast_visit_fused`, to drive fused passes while the AST is
+ * still being built
+ *
+ * Call `ast_fused_stmt` with every statement of `main` between
+ * `ast_fused_enter_main` and `ast_fused_leave_main`. The `status` of the
+ * passes must be Status_OK before the first step.
+ */
+void ast_fused_enter_main(
+    const Ast ast, NodeID main_id, AstPass *passes, size_t n);
+void ast_fused_stmt(const Ast ast, NodeID stmt_id, AstPass *passes, size_t n);
+void ast_fused_leave_main(
+    const Ast ast, NodeID main_id, AstPass *passes, size_t n);
+
+/**
+ * @returns The first error of the first pass that failed, Status_OK if
+ * none did
+ */
+Status ast_fused_status(const AstPass *passes, size_t n);
+
+/**
+ * @brief Free the context of the pass
+ */
+void ast_pass_release(AstPass *pass);
+
 //
 // USE CASE EXAMPLE OF A VISITOR:
 //
 
+typedef enum {
+    /* C-like pseudo-source, the default */
+    Format_SOURCE,
+    /* One S-expression per statement, `(asgn x (+ x 1))`, the parameters of
+     * `main` as `(params (int x))` if it takes any */
+    Format_SEXPR,
+    /* One statement per line, in the `body` array of a JSON object for `main`
+     * whose `params` array holds its parameters */
+    Format_JSON,
+    /* "PRECCAST", a 4 byte version, then every node in pre-order: its
+     * AstNodeKind as a byte, its fields as bytes (types, operators, flags),
+     * 8 byte integers or identifiers as a 4 byte length and their bytes,
+     * then its children. The parameters of `main` follow its type, as a 4
+     * byte count then the type and identifier of each one. The statements of
+     * `main` end with a 0xff byte. Numbers are little endian */
+    Format_BIN,
+    /* Nothing, printing is disabled */
+    Format_NONE,
+} Format;
+
 /**
  * @brief Displays the subtree of the AST starting from the given root node.
  *
+ * Output is buffered and written to the stream in large chunks, the last of
+ * it before returning.
+ *
  * @param[in] node_id The ID of a valid statement or expression in the AST.
+ * @param[in] format The format the subtree is printed in.
  * @param[in] stream The output handle where the AST subtree will be printed.
  */
-void ast_display(const Ast ast, NodeID node_id, StrPool strs, FILE *stream);
+void ast_display(
+    const Ast ast, NodeID node_id, StrPool strs, Format format, FILE *stream);
+
+/**
+ * @brief Make a pass printing each statement it is handed, like `ast_display`
+ *
+ * @param[out] pass - Pass to initialize, release it with `ast_pass_release`
+ * @param[in] format - Format to print in, anything but Format_NONE
+ * @param[in] stream - The output handle where the statements will be printed,
+ * each one is written to it as soon as it's printed
+ *
+ * @returns Status_OK if successful, Status_InternalError if out of memory
+ */
+Status ast_display_pass(
+    AstPass *pass, StrPool strs, Format format, FILE *stream);
 
 #endif // AST_VISITOR_H
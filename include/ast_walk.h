@@ -0,0 +1,175 @@
+/*
+ * Switch dispatched AST traversal, generated from FOR_AST_NODES.
+ *
+ * This header is a template: define the parameters below and include it to
+ * get a walker whose dispatch is a plain `switch` over the node kind, with
+ * every handler called directly (and usually inlined) with the node itself.
+ * It may be included several times per file, all parameters are undefined at
+ * the end of it.
+ *
+ * Parameters:
+ *
+ *   WALK_NAME    Prefix of the generated functions
+ *   WALK_CTX     Type of the context handed to every handler
+ *   WALK_<KIND>  Optional handler for AstNodeKind_<KIND>, called as
+ *                `Status WALK_<KIND>(WALK_CTX *ctx, const Ast ast, AstNode *node)`.
+ *                Kinds without a handler just walk their children.
+ *   WALK_INTERRUPTED(ctx)  Optional, stops walking a statement sequence
+ *   WALK_ON_DISPATCH(ctx)  Optional, evaluated for every dispatched node
+ *
+ * Generated functions:
+ *
+ *   Status <WALK_NAME>_expr(WALK_CTX *ctx, const Ast ast, NodeID id);
+ *   Status <WALK_NAME>_stmt(WALK_CTX *ctx, const Ast ast, NodeID id);
+ *   Status <WALK_NAME>_seq(WALK_CTX *ctx, const Ast ast, NodeID first);
+ *
+ * `_seq` walks a statement and every statement chained after it, without
+ * recursion, and returns the first error found while still walking the
+ * whole chain (same as `visit_stmt`).
+ *
+ * Handlers are called before their definition, so they must be declared
+ * before including this header.
+ */
+
+#include "ast.h"
+#include "error.h"
+
+#if !defined(WALK_NAME) || !defined(WALK_CTX)
+#error "WALK_NAME and WALK_CTX must be defined before including ast_walk.h"
+#endif
+
+#define _WALK_CAT_(a, b) a##_##b
+#define _WALK_CAT(a, b) _WALK_CAT_(a, b)
+#define _WALK_FN(suffix) _WALK_CAT(WALK_NAME, suffix)
+
+#ifndef WALK_INTERRUPTED
+#define WALK_INTERRUPTED(ctx) false
+#endif
+
+#ifndef WALK_ON_DISPATCH
+#define WALK_ON_DISPATCH(ctx) ((void)0)
+#endif
+
+static Status _WALK_FN(expr)(WALK_CTX *ctx, const Ast ast, NodeID id);
+static Status _WALK_FN(seq)(WALK_CTX *ctx, const Ast ast, NodeID first);
+
+//
+// default handlers, walking the children of the node
+//
+
+static inline Status _WALK_FN(leaf)(WALK_CTX *ctx, const Ast ast, AstNode *node) {
+    (void)ctx, (void)ast, (void)node;
+    return Status_OK;
+}
+
+static inline Status _WALK_FN(children_binop)(
+    WALK_CTX *ctx, const Ast ast, AstNode *node) {
+    Status s = _WALK_FN(expr)(ctx, ast, node->data.BINOP.lhs);
+    Status next_s = _WALK_FN(expr)(ctx, ast, node->data.BINOP.rhs);
+    return s != Status_OK ? s : next_s;
+}
+
+static inline Status _WALK_FN(children_asgn)(
+    WALK_CTX *ctx, const Ast ast, AstNode *node) {
+    return _WALK_FN(expr)(ctx, ast, node->data.ASGN.expr);
+}
+
+static inline Status _WALK_FN(children_ret)(
+    WALK_CTX *ctx, const Ast ast, AstNode *node) {
+    if (node->data.RET == NO_ID) {
+        return Status_OK;
+    }
+    return _WALK_FN(expr)(ctx, ast, node->data.RET);
+}
+
+static inline Status _WALK_FN(children_main)(
+    WALK_CTX *ctx, const Ast ast, AstNode *node) {
+    Status s = _WALK_FN(seq)(ctx, ast, node->data.MAIN.params);
+    Status next_s = _WALK_FN(seq)(ctx, ast, node->data.MAIN.body);
+    return s != Status_OK ? s : next_s;
+}
+
+#ifndef WALK_BOOL_CONSTANT
+#define WALK_BOOL_CONSTANT _WALK_FN(leaf)
+#endif
+#ifndef WALK_INT_CONSTANT
+#define WALK_INT_CONSTANT _WALK_FN(leaf)
+#endif
+#ifndef WALK_BINOP
+#define WALK_BINOP _WALK_FN(children_binop)
+#endif
+#ifndef WALK_VAR
+#define WALK_VAR _WALK_FN(leaf)
+#endif
+#ifndef WALK_DECL
+#define WALK_DECL _WALK_FN(leaf)
+#endif
+#ifndef WALK_ASGN
+#define WALK_ASGN _WALK_FN(children_asgn)
+#endif
+#ifndef WALK_RET
+#define WALK_RET _WALK_FN(children_ret)
+#endif
+#ifndef WALK_MAIN
+#define WALK_MAIN _WALK_FN(children_main)
+#endif
+
+//
+// dispatch
+//
+
+static inline Status _WALK_FN(dispatch)(WALK_CTX *ctx, const Ast ast, AstNode *node) {
+    WALK_ON_DISPATCH(ctx);
+
+#define _WALK_CASE(name, type)                                              \
+    case AstNodeKind_##name:                                                \
+        return WALK_##name(ctx, ast, node);
+
+    switch (node->kind) {
+        FOR_AST_NODES(_WALK_CASE)
+    }
+#undef _WALK_CASE
+
+    return Status_InternalError;
+}
+
+static Status _WALK_FN(expr)(WALK_CTX *ctx, const Ast ast, NodeID id) {
+    assert(id < ast->size);
+    return _WALK_FN(dispatch)(ctx, ast, &ast->data[id]);
+}
+
+static inline Status _WALK_FN(stmt)(WALK_CTX *ctx, const Ast ast, NodeID id) {
+    assert(id < ast->size);
+    return _WALK_FN(dispatch)(ctx, ast, &ast->data[id]);
+}
+
+static Status _WALK_FN(seq)(WALK_CTX *ctx, const Ast ast, NodeID first) {
+    Status res = Status_OK;
+
+    for (NodeID id = first; id != NO_ID && !WALK_INTERRUPTED(ctx);
+         id = ast->data[id].header.stmt_next) {
+        Status s = _WALK_FN(stmt)(ctx, ast, id);
+        if (res == Status_OK) {
+            res = s;
+        }
+    }
+
+    return res;
+}
+
+#undef _WALK_CAT_
+#undef _WALK_CAT
+#undef _WALK_FN
+
+#undef WALK_NAME
+#undef WALK_CTX
+#undef WALK_INTERRUPTED
+#undef WALK_ON_DISPATCH
+#undef WALK_BOOL_CONSTANT
+#undef WALK_INT_CONSTANT
+#undef WALK_BINOP
+#undef WALK_VAR
+#undef WALK_DECL
+#undef WALK_ASGN
+#undef WALK_RET
+#undef WALK_MAIN
@@ -0,0 +1,72 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+#include "error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Columnar evaluation of `main` over many rows of arguments at once
+ *
+ * The program is compiled once into a flat list of steps over columns: every
+ * variable, and every temporary of an expression, is a column holding its
+ * value for a block of rows. A step runs over a whole column at a time, the
+ * additions and multiplications as loops over 64-bit lanes that the compiler
+ * turns into SIMD (AVX2 where the CPU has it), so the cost of walking the AST
+ * is paid once per program rather than once per row. Constant subexpressions
+ * are folded while compiling.
+ *
+ * Integers wrap around on overflow. Booleans are 0 or 1.
+ */
+typedef struct Batch_S *Batch;
+
+/**
+ * @brief Compile a checked program for batch evaluation
+ *
+ * @param[in] root - ID of `main`, the program must have passed `sempass` and
+ * `initpass`
+ *
+ * @returns A valid instance if successful, NULL if out of memory or `root`
+ * isn't `main`
+ */
+Batch batch_compile(const Ast ast, NodeID root);
+
+/**
+ * @brief Free the memory of the compiled program
+ */
+void batch_release(Batch self);
+
+/**
+ * @brief Number of parameters of `main`, and of input columns
+ */
+size_t batch_params(const Batch self);
+
+/**
+ * @brief Run `main` once per row, same as `interp` with its parameters bound
+ * to the values of that row
+ *
+ * @param[in] inputs - One column per parameter of `main`, in the order they
+ * are declared, each holding `rows` values
+ * @param[in] rows - Number of rows
+ * @param[out] results - Value returned by `main` for every row, 0 if it
+ * returns nothing
+ *
+ * @returns Status_OK if successful, Status_InternalError if out of memory
+ */
+Status batch_eval(
+    const Batch self,
+    const int64_t *const *inputs,
+    size_t rows,
+    int64_t *results);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _BATCH_H */
@@ -0,0 +1,165 @@
+#ifndef _BYTECODE_H
+#define _BYTECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+#include "defs.h"
+#include "str_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Opcodes of the stack machine run by `vm_run` (see vm.h)
+ *
+ * Operands are slots, the variables of `main` with its parameters first, and
+ * at most one index into the constant pool, which always comes after the
+ * slots. `pops` and `pushes` are the values taken from and left on the stack.
+ *
+ * The first group is enough for any program. The rest are superinstructions,
+ * each standing for a sequence of the former that is common in our programs
+ * (see `bytecode_compile`). Opcodes are stored in images (see image.h), so
+ * new ones go last and changing any of them needs a new IMAGE_VERSION.
+ */
+#define FOR_OPCODES(DO)                                                 \
+    /* name, slots, constant, pops, pushes */                           \
+    DO(CONST, 0, 1, 0, 1)        /* push K[a] */                        \
+    DO(LOAD, 1, 0, 0, 1)         /* push S[a] */                        \
+    DO(STORE, 1, 0, 1, 0)        /* S[a] = pop */                       \
+    DO(ADD, 0, 0, 2, 1)          /* push pop + pop */                   \
+    DO(MUL, 0, 0, 2, 1)          /* push pop * pop */                   \
+    DO(RET, 0, 0, 1, 0)          /* return pop */                       \
+    DO(RET_VOID, 0, 0, 0, 0)     /* return */                           \
+    /* superinstructions */                                             \
+    DO(SET_CONST, 1, 1, 0, 0)    /* S[a] = K[b] */                      \
+    DO(COPY, 2, 0, 0, 0)         /* S[a] = S[b] */                      \
+    DO(ADD_VV, 2, 0, 0, 1)       /* push S[a] + S[b] */                 \
+    DO(MUL_VV, 2, 0, 0, 1)       /* push S[a] * S[b] */                 \
+    DO(ADD_VC, 1, 1, 0, 1)       /* push S[a] + K[b] */                 \
+    DO(MUL_VC, 1, 1, 0, 1)       /* push S[a] * K[b] */                 \
+    DO(ADD_V, 1, 0, 1, 1)        /* top += S[a] */                      \
+    DO(MUL_V, 1, 0, 1, 1)        /* top *= S[a] */                      \
+    DO(ADD_C, 0, 1, 1, 1)        /* top += K[a] */                      \
+    DO(MUL_C, 0, 1, 1, 1)        /* top *= K[a] */                      \
+    DO(ADD_STORE, 1, 0, 2, 0)    /* S[a] = pop + pop */                 \
+    DO(MUL_STORE, 1, 0, 2, 0)    /* S[a] = pop * pop */                 \
+    DO(ADD_VV_STORE, 3, 0, 0, 0) /* S[a] = S[b] + S[c] */               \
+    DO(MUL_VV_STORE, 3, 0, 0, 0) /* S[a] = S[b] * S[c] */               \
+    DO(ADD_VC_STORE, 2, 1, 0, 0) /* S[a] = S[b] + K[c] */               \
+    DO(MUL_VC_STORE, 2, 1, 0, 0) /* S[a] = S[b] * K[c] */               \
+    DO(RET_VAR, 1, 0, 0, 0)      /* return S[a] */                      \
+    DO(RET_CONST, 0, 1, 0, 0)    /* return K[a] */                      \
+
+#define MK_OPCODES(name, slots, constant, pops, pushes) Opcode_ ## name,
+typedef enum {
+    FOR_OPCODES(MK_OPCODES)
+    Opcode_COUNT,
+} Opcode;
+#undef MK_OPCODES
+
+typedef struct {
+    uint32_t op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} Insn;
+
+/* Name and type of a slot, for diagnostics */
+typedef struct {
+    // offset of the NUL terminated name in the strings of the chunk
+    uint32_t name;
+    // a Type, fixed in size as it's stored in images
+    uint32_t type;
+} SlotInfo;
+
+/**
+ * A compiled program, the instructions of `main` up to its first `return`
+ *
+ * Holds no pointers into the AST or the string pool, and the instructions
+ * refer to slots and constants by index, so the arrays may live anywhere,
+ * such as in an image mapped from a file.
+ */
+typedef struct {
+    const Insn *code;
+    size_t size;
+
+    // 64-bit constants, integers wrap around and booleans are 0 or 1
+    const int64_t *consts;
+    size_t n_consts;
+
+    // the parameters of `main` are the first slots
+    uint32_t params;
+    uint32_t slots;
+
+    // deepest the stack gets
+    uint32_t stack;
+
+    // statements run by the code, to tell dispatches per statement apart
+    uint32_t stmts;
+
+    Type ret_type;
+
+    // one per slot
+    const SlotInfo *slot_info;
+    const char *strings;
+    size_t strings_size;
+} Chunk;
+
+typedef struct Bytecode_S *Bytecode;
+
+/**
+ * @brief Compile a checked program into instructions for `vm_run`
+ *
+ * Constant subexpressions are folded, additions of 0, multiplications by 1
+ * and assignments of a variable to itself are dropped by a peephole pass
+ * run as instructions are emitted. With `fuse`, the same pass also fuses the
+ * sequences of instructions that are common in our programs into
+ * superinstructions, so the VM dispatches fewer of them.
+ *
+ * @param[in] root - ID of `main`, the program must have passed `sempass` and
+ * `initpass`
+ * @param[in] strs - String pool the names of the variables are interned in
+ * @param[in] fuse - Whether to emit superinstructions, off to check them
+ * against the plain instructions
+ *
+ * @returns A valid instance if successful, NULL if out of memory or `root`
+ * isn't `main`
+ */
+Bytecode bytecode_compile(
+    const Ast ast, NodeID root, StrPool strs, bool fuse);
+
+/**
+ * @brief Free the memory of the compiled program
+ */
+void bytecode_release(Bytecode self);
+
+/**
+ * @brief The compiled program, valid until the bytecode is released
+ */
+const Chunk *bytecode_chunk(const Bytecode self);
+
+/**
+ * @brief Check that a chunk from outside the process is safe to run
+ *
+ * Every operand must be in range, the stack must neither underflow nor get
+ * deeper than `stack`, the code must end in a return and every name must be
+ * within the strings, so that `vm_run` never reads or writes out of bounds.
+ *
+ * @returns NULL if the chunk is valid, what's wrong with it otherwise
+ */
+const char *bytecode_verify(const Chunk *chunk);
+
+/**
+ * @brief Name of an opcode, as in FOR_OPCODES
+ */
+const char *bytecode_opcode_name(Opcode op);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _BYTECODE_H */
@@ -0,0 +1,135 @@
+#ifndef _DOCUMENT_H
+#define _DOCUMENT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+#include "str_pool.h"
+#include "tokens.h"
+#include "type_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * A program kept open for editing, checked again after every edit
+ *
+ * The body of `main` is held as a balanced tree of its statements, each with
+ * its own text, nodes and the variables it refers to. An edit relexes and
+ * reparses only the statements it touches, splices the new ones into the
+ * chain of the body and type checks again the new statements and those
+ * referring to a variable whose declaration changed. Which variables are
+ * read before they're assigned is kept by variable, the way `initpass`
+ * reports them.
+ *
+ * After every edit the AST, the types and the diagnostics are the same as
+ * those of compiling the whole source again with `pratt_parse`, `sempass`
+ * and `initpass`, except for the NodeIDs and the locations of the nodes (see
+ * `document_source`). Edits of the header of `main` or past its body, and
+ * of a source that couldn't be split into statements, recompile it whole.
+ */
+typedef struct Document_S *Document;
+
+/**
+ * @brief Create an empty document, building its programs in the given AST
+ *
+ * @param[in] ast - AST the nodes are pushed to, owned by the document until
+ * it's released or cleared
+ * @param[in] strs - String pool identifiers are interned in
+ * @param[in] types - Table the types of the expressions are left in
+ * @param[in] tokens - Token array to lex into, reused by every edit
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+Document document_initialize(
+    Ast ast,
+    StrPool strs,
+    TypeTable types,
+    Tokens tokens);
+
+/**
+ * @brief Free the memory of the document, its AST is left as it is
+ */
+void document_release(Document self);
+
+/**
+ * @brief Forget the program, leaving the document empty
+ */
+void document_clear(Document self);
+
+/**
+ * @brief Compile a whole program, replacing the previous one
+ *
+ * The AST and the types are cleared first.
+ *
+ * @param[in] src - Source of the program, copied by the document
+ * @param[in] len - Length of `src` in bytes
+ * @param[in] lexer - Scanner to lex the program and its edits with
+ * @param[in] threads - Threads to lex the whole program with, see
+ * `tokens_lex`
+ * @param[in] diag - Output handle where diagnostics are printed
+ *
+ * @returns Status_OK if the program is valid, Status_SyntaxError if it could
+ * not be parsed or the first semantic error found otherwise, same as
+ * `precc_session_compile`
+ */
+Status document_open(
+    Document self,
+    const char *src,
+    size_t len,
+    Lexer lexer,
+    unsigned threads,
+    FILE *diag);
+
+/**
+ * @brief Replace a range of the source and check the program again
+ *
+ * @param[in] offset - Location of the first byte replaced
+ * @param[in] removed - Number of bytes replaced
+ * @param[in] text - Text replacing them, it doesn't need to be NUL
+ * terminated and may be NULL if `len` is 0
+ * @param[in] len - Length of `text` in bytes
+ * @param[in] diag - Output handle where the diagnostics of the whole
+ * program are printed, the same as `document_open` on the edited source
+ *
+ * @returns Same as `document_open` on the edited source,
+ * Status_InternalError if the range is past the end of the source, in which
+ * case the document is left unchanged, or if out of memory, in which case it
+ * is left empty
+ */
+Status document_edit(
+    Document self,
+    size_t offset,
+    size_t removed,
+    const char *text,
+    size_t len,
+    FILE *diag);
+
+/**
+ * @brief Root of the AST of the program, without the statements that have
+ * syntax errors, NO_ID if the program has syntax errors outside of its body
+ */
+NodeID document_root(const Document self);
+
+/**
+ * @brief Source of the program with every edit applied
+ *
+ * Also brings the locations of the nodes of the edited program up to date,
+ * edits leave those of the statements past them as they were parsed. Takes
+ * time linear in the size of the source the first time after an edit.
+ *
+ * @param[out] len - Length of the source in bytes
+ *
+ * @returns The source, not NUL terminated, valid until the next edit. NULL
+ * if out of memory
+ */
+const char *document_source(Document self, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _DOCUMENT_H */
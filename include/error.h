@@ -22,6 +22,9 @@ typedef enum {
     // Main function should return Int or bool expression
     Status_MissingReturn,
 
+    // input could not be parsed
+    Status_SyntaxError,
+
 } Status;
 
 #endif /* _ERROR_H */
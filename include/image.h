@@ -0,0 +1,72 @@
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include <stdio.h>
+
+#include "bytecode.h"
+#include "error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Precompiled programs, written to a file once and mapped into memory to run
+ * them without lexing, parsing, checking or lowering them again
+ *
+ * An image is the chunk of a program (see bytecode.h) laid out after a
+ * header: the instructions, the constant pool, the name and type of every
+ * slot and the strings those names point into. The header refers to every
+ * section by its offset from the start of the file, so the image runs from
+ * wherever it's mapped without relocating anything. Values are in the byte
+ * order of the machine that wrote the image, which must match the one that
+ * runs it.
+ */
+typedef struct Image_S *Image;
+
+/* Images of other versions are rejected, bumped when the layout or the
+ * opcodes change */
+#define IMAGE_VERSION 1
+
+/**
+ * @brief Write the image of a chunk
+ *
+ * @param[in] out - Output handle the image is written to, opened in binary
+ * mode
+ *
+ * @returns Status_OK if successful, Status_InternalError if writing failed
+ */
+Status image_write(const Chunk *chunk, FILE *out);
+
+/**
+ * @brief Map an image read-only and check it's safe to run
+ *
+ * The file is mapped, not read, so only the pages the program touches are
+ * loaded. The header, the bounds of every section and every instruction are
+ * checked (see `bytecode_verify`) before handing the chunk out.
+ *
+ * @param[in] path - Path of the image
+ * @param[in] diag - Output handle where the reason the image can't be run
+ * is printed, if any
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+Image image_open(const char *path, FILE *diag);
+
+/**
+ * @brief Unmap the image
+ *
+ * @note The chunk of the image is invalid after calling this
+ */
+void image_close(Image self);
+
+/**
+ * @brief The chunk of the image, pointing into the mapped file
+ */
+const Chunk *image_chunk(const Image self);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _IMAGE_H */
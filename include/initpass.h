@@ -0,0 +1,52 @@
+#ifndef _INITPASS_H
+#define _INITPASS_H
+
+#include <stdio.h>
+
+#include "ast.h"
+#include "ast_visitor.h"
+#include "error.h"
+#include "line_index.h"
+#include "str_pool.h"
+
+/**
+ * @brief Check that every variable is assigned before it's read
+ *
+ * A forward dataflow pass over a program that type checks: every read of a
+ * variable must be preceded by an assignment to it on every path from its
+ * declaration. Each variable is reported, with the location of the read,
+ * only the first time it's read uninitialized. Runs in time linear in the
+ * size of the program, so the interpreter never has to track which
+ * variables hold a value.
+ *
+ * @param[in] lines - Line index of the source, to report locations
+ * @param[in] diag - Output handle where diagnostics are printed
+ *
+ * @returns Status_OK if every read is initialized, Status_UninitSymbol if
+ * some isn't, Status_InternalError if out of memory
+ */
+Status initpass(
+    const Ast ast,
+    NodeID node_id,
+    StrPool strs,
+    LineIndex lines,
+    FILE *diag);
+
+/**
+ * @brief Make a pass checking each statement it is handed, to be fused with
+ * others by `ast_visit_fused` right after the type checking one
+ *
+ * The pass is gated, it stops checking statements once a pass before it
+ * fails. Reports the same diagnostics as `initpass`.
+ *
+ * @param[out] pass - Pass to initialize, release it with `ast_pass_release`
+ *
+ * @returns Status_OK if successful, Status_InternalError if out of memory
+ */
+Status initpass_pass(
+    AstPass *pass,
+    StrPool strs,
+    LineIndex lines,
+    FILE *diag);
+
+#endif /* _INITPASS_H */
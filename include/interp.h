@@ -2,10 +2,65 @@
 #define _INTERP_H
 
 #include "ast.h"
+#include "ast_visitor.h"
 #include "defs.h"
+#include "profile.h"
 #include "str_pool.h"
 #include "sym_table.h"
+#include "trace.h"
 
-Sym interp(Ast ast, NodeID root, StrPool strs, SymTable syms);
+/**
+ * @brief Run a program, returning the value returned by `main`
+ *
+ * Variables don't track whether they hold a value, the program must have
+ * passed `initpass` so that none is read before it's assigned.
+ *
+ * @param[in] syms - Symbol table holding the values of the variables. The
+ * parameters of `main` added to it beforehand are its arguments, the others
+ * are 0 or false
+ * @param[in] tracer - Hooks called with every value computed (see trace.h),
+ * NULL to run without tracing
+ */
+Sym interp(
+    Ast ast, NodeID root, StrPool strs, SymTable syms, const Tracer *tracer);
+
+/**
+ * @brief Same as `interp`, also counting the runs of every statement and the
+ * ticks spent in it
+ *
+ * Only the statements are timed, so that profiling perturbs the run as little
+ * as it can. `interp` itself is left without a single check for it.
+ *
+ * @param[out] profile - Profile the runs are added to, sized for `ast`
+ */
+Sym interp_profile(
+    Ast ast,
+    NodeID root,
+    StrPool strs,
+    SymTable syms,
+    const Tracer *tracer,
+    Profile profile);
+
+/**
+ * @brief Make a pass running each statement it is handed, to be fused with
+ * others by `ast_visit_fused`
+ *
+ * The pass is gated, it stops running statements once a pass before it
+ * fails, and ignores every statement after a `return`.
+ *
+ * @param[out] pass - Pass to initialize, release it with `ast_pass_release`
+ * @param[in] syms - Symbol table holding the values of the variables
+ * @param[in] tracer - Hooks called with every value computed, flushed after
+ * every statement. NULL to run without tracing
+ * @param[out] result - Value returned by `main`, updated after each statement
+ *
+ * @returns Status_OK if successful, Status_InternalError if out of memory
+ */
+Status interp_pass(
+    AstPass *pass,
+    StrPool strs,
+    SymTable syms,
+    const Tracer *tracer,
+    Sym *result);
 
 #endif /* _INTERP_H */
@@ -0,0 +1,96 @@
+#ifndef _LINE_INDEX_H
+#define _LINE_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct {
+    uint32_t line;
+    uint32_t col;
+} LineCol;
+
+typedef struct LineIndex_S *LineIndex;
+
+/**
+ * @brief Create an empty line index
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+LineIndex line_index_initialize();
+
+/**
+ * @brief Free the memory of the line index
+ */
+void line_index_release(LineIndex self);
+
+/**
+ * @brief Forget every line and start indexing a new source
+ *
+ * @param[in] src - Source the index is built from on the first lookup, it
+ * must outlive the lookups. NULL if the source isn't kept in memory, in which
+ * case its newlines are recorded with `line_index_scan` as it's read
+ * @param[in] len - Length of `src` in bytes
+ */
+void line_index_reset(LineIndex self, const char *src, size_t len);
+
+/**
+ * @brief Same as `line_index_reset` for a piece of a larger source
+ *
+ * Locations looked up are offsets in the piece, resolved as if it were
+ * still in that source.
+ *
+ * @param[in] start - Line and column of the first byte of the piece in the
+ * source, 1:1 for the start of it
+ */
+void line_index_reset_at(
+    LineIndex self, const char *src, size_t len, LineCol start);
+
+/**
+ * @brief Record the newlines of a piece of the source
+ *
+ * @param[in] text - Piece of the source, it must not end in the middle of a
+ * run of newlines
+ * @param[in] len - Length of `text` in bytes
+ * @param[in] offset - Location of `text` in the source, past every piece
+ * recorded before
+ *
+ * @returns true if successful, false if out of memory
+ */
+bool line_index_scan(
+    LineIndex self, const char *text, size_t len, Location offset);
+
+/**
+ * @brief Forget every line but the last one recorded, keeping the index
+ * bounded while streaming
+ *
+ * @note Only locations past the start of the last line can be looked up
+ * after calling this
+ */
+void line_index_trim(LineIndex self);
+
+/**
+ * @brief Line and column of a location, counted the way the scanner always
+ * did: a run of newlines moves down one line per byte, so "\r\n" counts twice
+ *
+ * @note Builds the index on the first call after `line_index_reset`
+ */
+LineCol line_index_lookup(LineIndex self, Location loc);
+
+/**
+ * @brief Length of the run of newlines at the start of `p`, the longest
+ * sequence of "\r\n", "\n\r" and "\n", 0 if there isn't any
+ */
+size_t line_index_newlines(const char *p, const char *end);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _LINE_INDEX_H */
@@ -0,0 +1,93 @@
+#ifndef _PRATT_H
+#define _PRATT_H
+
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+#include "line_index.h"
+#include "tokens.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef enum {
+    /* The bison grammar from parser.y */
+    Parser_BISON,
+    /* The hand-written one from pratt.h */
+    Parser_PRATT,
+} Parser;
+
+/**
+ * @brief Hand-written alternative to the bison parser from parser.y, over a
+ * token array lexed up front
+ *
+ * Statements are parsed by recursive descent and expressions by precedence
+ * climbing over explicit stacks, so nesting is only bounded by memory. Pushes
+ * the same nodes in the same order as the bison parser, and reports the same
+ * syntax errors, recovering from them at the next `;` the same way.
+ *
+ * @param[in] tokens - Tokens to parse, ending with the end of the input
+ * @param[in] lines - Line index of the source the tokens come from
+ * @param[in] diag - Output handle where syntax errors are printed
+ * @param[out] root - ID of the 'main' node, also valid if the program has
+ * syntax errors in its body that were recovered from, like bison's, NO_ID
+ * otherwise
+ *
+ * @returns Status_OK if successful, Status_SyntaxError if the program has
+ * syntax errors, Status_InternalError if out of memory
+ */
+Status pratt_parse(
+    Ast ast,
+    const Tokens tokens,
+    LineIndex lines,
+    FILE *diag,
+    NodeID *root);
+
+/**
+ * @brief Parse the header of a program, up to the "{" opening the body of
+ * `main`, reporting the same syntax errors as `pratt_parse`
+ *
+ * @param[out] root - ID of a 'main' node without statements, only valid if
+ * successful
+ * @param[out] body - Index of the first token of the body, only valid if
+ * successful
+ *
+ * @returns Same as `pratt_parse`
+ */
+Status pratt_parse_main(
+    Ast ast,
+    const Tokens tokens,
+    LineIndex lines,
+    FILE *diag,
+    NodeID *root,
+    size_t *body);
+
+/**
+ * @brief Parse a single statement of the body of `main`, reporting the same
+ * syntax errors as `pratt_parse` does for it
+ *
+ * The statement isn't chained to any other.
+ *
+ * @param[in] tokens - Tokens of the statement, the last one being the first
+ * `;` after its start
+ * @param[in] n - Number of tokens, at least 1
+ * @param[out] stmt - ID of the statement, NO_ID if it has syntax errors
+ *
+ * @returns Status_OK if successful, Status_SyntaxError if the statement has
+ * syntax errors, Status_InternalError if out of memory
+ */
+Status pratt_parse_stmt(
+    Ast ast,
+    const Token *tokens,
+    size_t n,
+    LineIndex lines,
+    FILE *diag,
+    NodeID *stmt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _PRATT_H */
@@ -0,0 +1,341 @@
+#ifndef _PRECC_H
+#define _PRECC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "ast_visitor.h"
+#include "error.h"
+#include "line_index.h"
+#include "pratt.h"
+#include "profile.h"
+#include "str_pool.h"
+#include "sym_table.h"
+#include "tokens.h"
+#include "trace.h"
+#include "type_table.h"
+#include "vm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct PreccSession_S *PreccSession;
+
+/**
+ * @brief Create a compile session
+ *
+ * A session owns the AST, the string pool and the diagnostics of the last
+ * program compiled with it, and reuses their memory across compilations.
+ *
+ * @returns A valid session if successful, NULL otherwise
+ */
+PreccSession precc_session_create();
+
+/**
+ * @brief Free the memory of the session
+ *
+ * @note The AST and string pool handed out by the session are invalid after
+ * calling this
+ */
+void precc_session_destroy(PreccSession self);
+
+/**
+ * @brief Lex the sources given to the session up front, in parallel
+ *
+ * @param[in] threads - Number of threads to lex with, 0 for one per CPU, or
+ * 1 (the default) to scan while parsing
+ *
+ * @note Doesn't apply to `precc_session_stream`, which always scans
+ */
+void precc_session_set_lex_threads(PreccSession self, unsigned threads);
+
+/**
+ * @brief Choose the scanner sources are lexed with, flex by default
+ *
+ * @note Anything but flex lexes up front, even with a single thread
+ * @note Doesn't apply to `precc_session_stream`, which always uses flex
+ */
+void precc_session_set_lexer(PreccSession self, Lexer lexer);
+
+/**
+ * @brief Choose the parser sources are parsed with, bison by default
+ *
+ * @note Anything but bison lexes up front
+ * @note Doesn't apply to `precc_session_stream`, which always uses bison
+ */
+void precc_session_set_parser(PreccSession self, Parser parser);
+
+/**
+ * @brief Choose the format `precc_session_run` and `precc_session_stream`
+ * print programs in, Format_SOURCE by default
+ *
+ * @note Format_NONE doesn't print anything, same as a NULL `display`
+ */
+void precc_session_set_format(PreccSession self, Format format);
+
+/**
+ * @brief Choose how `precc_session_eval` runs programs, Evaluator_INTERP by
+ * default
+ *
+ * @note Doesn't apply to `precc_session_run` and `precc_session_stream`,
+ * which always interpret
+ */
+void precc_session_set_evaluator(PreccSession self, Evaluator evaluator);
+
+/**
+ * @brief Whether Evaluator_VM runs bytecode with superinstructions, on by
+ * default (see `bytecode_compile`)
+ */
+void precc_session_set_fusion(PreccSession self, bool fuse);
+
+/**
+ * @brief Hooks the interpreter calls with every value it computes (see
+ * trace.h), NULL by default, which runs without tracing
+ *
+ * @param[in] tracer - Must outlive every run of the session. Evaluator_VM
+ * and `precc_session_eval_batch` don't trace
+ */
+void precc_session_set_tracer(PreccSession self, const Tracer *tracer);
+
+/**
+ * @brief Parse and type check a program, replacing the previous one
+ *
+ * @param[in] src - Source of the program, it doesn't need to be NUL terminated
+ * @param[in] len - Length of `src` in bytes
+ *
+ * @returns Status_OK if the program is valid, Status_SyntaxError if it could
+ * not be parsed or the first semantic error found otherwise
+ */
+Status precc_session_compile(PreccSession self, const char *src, size_t len);
+
+/**
+ * @brief Same as `precc_session_compile` reading the program from `in`
+ *
+ * Reading, lexing and parsing run on three threads connected by bounded
+ * queues (see token_pipe.h), so the input is read and lexed while the AST is
+ * built and never held in memory all at once. Builds the same AST, interning
+ * the same identifiers, as `precc_session_compile` on the whole input.
+ *
+ * @param[in] in - Input handle the program is read from
+ *
+ * @returns Same as `precc_session_compile`
+ *
+ * @note Always parses with bison, with the lexer set for the session
+ */
+Status precc_session_compile_file(PreccSession self, FILE *in);
+
+/**
+ * @brief Same as `precc_session_compile`, keeping the program open for
+ * `precc_session_edit`
+ *
+ * @note Always parses with the pratt parser, with the lexer set for the
+ * session
+ */
+Status precc_session_open(PreccSession self, const char *src, size_t len);
+
+/**
+ * @brief Replace a range of the source of the program opened last and check
+ * it again
+ *
+ * Only the statements of the body the edit touches are lexed and parsed
+ * again, and only them and the statements referring to a variable whose
+ * declaration changed are type checked again (see document.h). Reports the
+ * same status and diagnostics as `precc_session_compile` on the edited
+ * source.
+ *
+ * @param[in] offset - Location of the first byte replaced
+ * @param[in] removed - Number of bytes replaced
+ * @param[in] text - Text replacing them, it doesn't need to be NUL terminated
+ * and may be NULL if `len` is 0
+ * @param[in] len - Length of `text` in bytes
+ *
+ * @returns Same as `precc_session_compile`, Status_InternalError if no
+ * program is open or the range is past the end of its source, which leaves
+ * the program unchanged
+ *
+ * @note The locations of the nodes and `precc_session_lines` are only up to
+ * date after `precc_session_source`
+ */
+Status precc_session_edit(
+    PreccSession self,
+    size_t offset,
+    size_t removed,
+    const char *text,
+    size_t len);
+
+/**
+ * @brief Source of the program opened last with every edit applied
+ *
+ * Brings the locations of the nodes and `precc_session_lines` up to date.
+ *
+ * @param[out] len - Length of the source in bytes
+ *
+ * @returns The source, not NUL terminated, valid until the next edit. NULL
+ * if out of memory
+ */
+const char *precc_session_source(PreccSession self, size_t *len);
+
+/**
+ * @brief Diagnostics reported by the last compilation
+ *
+ * @returns A NUL terminated string, empty if nothing was reported. It's valid
+ * until the next call to `precc_session_compile` or `precc_session_reset`
+ */
+const char *precc_session_diagnostics(PreccSession self);
+
+/**
+ * @brief Status of the last compilation
+ */
+Status precc_session_status(PreccSession self);
+
+/**
+ * @brief AST of the last compilation, it isn't written after parsing
+ */
+Ast precc_session_ast(PreccSession self);
+
+/**
+ * @brief Root of the AST of the last compilation, NO_ID if there is none
+ */
+NodeID precc_session_root(PreccSession self);
+
+/**
+ * @brief String pool identifiers of the AST are interned in
+ */
+StrPool precc_session_strs(PreccSession self);
+
+/**
+ * @brief Types of the expressions of the AST of the last compilation
+ *
+ * @note Only meaningful if the compilation succeeded, and always empty after
+ * `precc_session_stream`, which recycles the nodes
+ */
+TypeTable precc_session_types(PreccSession self);
+
+/**
+ * @brief Line index of the source of the last compilation
+ *
+ * @note Looking up locations reads the source handed to
+ * `precc_session_compile`, which must still be alive
+ */
+LineIndex precc_session_lines(PreccSession self);
+
+/**
+ * @brief Run the last compiled program, with the evaluator set for the
+ * session
+ *
+ * @param[out] result - Value returned by `main`
+ *
+ * @returns Status_OK if the program was run, the compilation status if it
+ * didn't compile, Status_InternalError if out of memory
+ */
+Status precc_session_eval(PreccSession self, Sym *result);
+
+/**
+ * @brief Run the last compiled program with `interp_profile` (see interp.h),
+ * whatever the evaluator set for the session
+ *
+ * @param[out] profile - Profile the runs of every statement are added to,
+ * sized for the AST of the session
+ * @param[out] result - Value returned by `main`
+ *
+ * @returns Status_OK if the program was run, the compilation status if it
+ * didn't compile, Status_InternalError if out of memory
+ */
+Status precc_session_profile(
+    PreccSession self, Profile profile, Sym *result);
+
+/**
+ * @brief Write the image of the last compiled program (see image.h), to run
+ * it later without compiling it again
+ *
+ * @param[in] out - Output handle the image is written to, opened in binary
+ * mode
+ *
+ * @returns Status_OK if successful, the compilation status if it didn't
+ * compile, Status_InternalError if out of memory or writing failed
+ *
+ * @note The image holds the bytecode of Evaluator_VM, fused unless disabled
+ * with `precc_session_set_fusion`
+ */
+Status precc_session_write_image(PreccSession self, FILE *out);
+
+/**
+ * @brief Run the last compiled program once per row of arguments, with
+ * `batch_eval` (see batch.h)
+ *
+ * @param[in] inputs - One column per parameter of `main`, in the order they
+ * are declared, each holding `rows` values
+ * @param[in] rows - Number of rows
+ * @param[out] results - Value returned by `main` for every row
+ *
+ * @returns Status_OK if the program was run, the compilation status if it
+ * didn't compile, Status_InternalError if out of memory
+ *
+ * @note Like `precc_session_eval`, the program is empty after
+ * `precc_session_stream`, which recycles the nodes
+ */
+Status precc_session_eval_batch(
+    PreccSession self,
+    const int64_t *const *inputs,
+    size_t rows,
+    int64_t *results);
+
+/**
+ * @brief Compile, run and display a program in a single walk of its AST
+ *
+ * Each statement is type checked, then run, then printed before moving to
+ * the next one. Statements run until the first one that doesn't type check,
+ * so unlike `precc_session_eval` a program with errors may run partially.
+ *
+ * @param[in] src - Source of the program, it doesn't need to be NUL terminated
+ * @param[in] len - Length of `src` in bytes
+ * @param[in] display - Output handle where the program is printed, NULL to
+ * not print it
+ * @param[out] result - Value returned by `main`, only meaningful if the
+ * program compiled
+ *
+ * @returns Same as `precc_session_compile`
+ */
+Status precc_session_run(
+    PreccSession self,
+    const char *src,
+    size_t len,
+    FILE *display,
+    Sym *result);
+
+/**
+ * @brief Same as `precc_session_run` but streaming the program from `in`
+ *
+ * Each statement is checked, run and printed as soon as it's parsed, and its
+ * nodes are recycled right after, so memory is bounded by the variables of
+ * the program rather than by its length. The AST is left with an empty
+ * `main`.
+ *
+ * Results match the batch pipeline for programs without syntax errors. On a
+ * syntax error, the statements after it are not run, but those before it
+ * have already been checked, run and printed, where batch mode only reports
+ * the error.
+ *
+ * @param[in] in - Input handle the program is read from
+ *
+ * @returns Same as `precc_session_compile`
+ */
+Status precc_session_stream(
+    PreccSession self,
+    FILE *in,
+    FILE *display,
+    Sym *result);
+
+/**
+ * @brief Drop the last program and every identifier interned for it
+ */
+void precc_session_reset(PreccSession self);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _PRECC_H */
@@ -0,0 +1,90 @@
+#ifndef _PRINTER_H
+#define _PRINTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define PRINTER_CAPACITY (64 * 1024)
+
+/**
+ * Output buffer written to a stream in large chunks
+ *
+ * Meant to live on the stack or inside another context: it doesn't allocate,
+ * and nothing reaches the stream until the buffer fills up or it's flushed.
+ * Anything else writing to the same stream must wait for a flush to keep the
+ * output in order.
+ */
+typedef struct {
+    FILE *stream;
+    size_t size;
+    char data[PRINTER_CAPACITY];
+} Printer;
+
+/**
+ * @brief Start an empty buffer in front of `stream`
+ */
+void printer_init(Printer *self, FILE *stream);
+
+/**
+ * @brief Write everything buffered to the stream
+ */
+void printer_flush(Printer *self);
+
+/**
+ * @brief Buffer `len` bytes of `bytes`, flushing as many times as needed
+ */
+void printer_write_slow(Printer *self, const void *bytes, size_t len);
+
+/**
+ * @brief Buffer `v` in decimal
+ */
+void printer_int(Printer *self, int64_t v);
+
+static inline void printer_write(Printer *self, const void *bytes, size_t len) {
+    if (len > PRINTER_CAPACITY - self->size) {
+        printer_write_slow(self, bytes, len);
+        return;
+    }
+
+    memcpy(self->data + self->size, bytes, len);
+    self->size += len;
+}
+
+static inline void printer_puts(Printer *self, const char *str) {
+    printer_write(self, str, strlen(str));
+}
+
+static inline void printer_putc(Printer *self, char c) {
+    if (self->size == PRINTER_CAPACITY) {
+        printer_flush(self);
+    }
+    self->data[self->size++] = c;
+}
+
+/**
+ * @brief Buffer `v` as 4 little endian bytes
+ */
+static inline void printer_u32(Printer *self, uint32_t v) {
+    unsigned char bytes[4] = { v, v >> 8, v >> 16, v >> 24 };
+    printer_write(self, bytes, sizeof(bytes));
+}
+
+/**
+ * @brief Buffer `v` as 8 little endian bytes
+ */
+static inline void printer_u64(Printer *self, uint64_t v) {
+    printer_u32(self, (uint32_t)v);
+    printer_u32(self, (uint32_t)(v >> 32));
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _PRINTER_H */
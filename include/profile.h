@@ -0,0 +1,94 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "line_index.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Execution profile of a program run by `interp_profile` (see interp.h)
+ *
+ * Counts how many times every statement ran and the ticks spent in it, by
+ * NodeID. `main` is the only statement holding others, its ticks include
+ * theirs.
+ */
+typedef struct Profile_S *Profile;
+
+typedef enum {
+    /* Hottest statements with their line and source text */
+    ProfileFormat_TEXT,
+    /* One `main;statement ticks` line per statement, for flame graphs */
+    ProfileFormat_FOLDED,
+} ProfileFormat;
+
+/**
+ * @brief Current tick, the time stamp counter where there is one and
+ * nanoseconds otherwise
+ */
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t profile_ticks(void) {
+    return __rdtsc();
+}
+#else
+uint64_t profile_ticks(void);
+#endif
+
+/**
+ * @brief Create an empty profile
+ *
+ * @param[in] nodes - Size of the AST of the program to profile
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+Profile profile_initialize(size_t nodes);
+
+/**
+ * @brief Free the memory of the profile
+ */
+void profile_release(Profile self);
+
+/**
+ * @brief Mark the start and the end of the run, which turn ticks into time
+ */
+void profile_start(Profile self);
+void profile_stop(Profile self);
+
+/**
+ * @brief Record one run of a statement
+ */
+void profile_add(Profile self, NodeID id, uint64_t ticks);
+
+/**
+ * @brief Print the profile, statements sorted by the ticks spent in them
+ *
+ * @param[in] lines - Line index of the source of the program
+ * @param[in] src - Source of the program, NULL if it wasn't kept, in which
+ * case only the lines are printed
+ * @param[in] len - Length of `src` in bytes
+ */
+void profile_report(
+    const Profile self,
+    const Ast ast,
+    LineIndex lines,
+    const char *src,
+    size_t len,
+    ProfileFormat format,
+    FILE *out);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _PROFILE_H */
@@ -0,0 +1,80 @@
+#ifndef _RING_H
+#define _RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Bounded queue between exactly one producer thread and one consumer thread
+ *
+ * Lock-free: each side only writes its own index and publishes items in
+ * batches, a producer finding the ring full or a consumer finding it empty
+ * waits for the other side, which is what keeps a fast stage from running
+ * ahead of a slow one.
+ */
+typedef struct Ring_S *Ring;
+
+/**
+ * @brief Create an empty ring
+ *
+ * @param[in] capacity - Number of items, rounded up to a power of 2
+ * @param[in] item_size - Size of each item in bytes
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+Ring ring_initialize(size_t capacity, size_t item_size);
+
+/**
+ * @brief Free the memory of the ring, neither side may be using it
+ */
+void ring_release(Ring self);
+
+/**
+ * @brief Producer side, wait for free slots and get the first of them
+ *
+ * @param[in,out] n - Most slots wanted, set to the slots available, which
+ * are contiguous and at least one
+ *
+ * @returns The first slot, NULL if the ring was closed
+ */
+void *ring_reserve(Ring self, size_t *n);
+
+/**
+ * @brief Producer side, hand the first `n` reserved slots to the consumer
+ */
+void ring_commit(Ring self, size_t n);
+
+/**
+ * @brief Consumer side, wait for items and get the first of them
+ *
+ * @param[in,out] n - Most items wanted, set to the items available, which
+ * are contiguous and at least one
+ *
+ * @returns The first item, NULL if the ring was closed and every item
+ * committed before has been consumed
+ */
+const void *ring_peek(Ring self, size_t *n);
+
+/**
+ * @brief Consumer side, give the first `n` peeked items back to the producer
+ */
+void ring_consume(Ring self, size_t n);
+
+/**
+ * @brief Close the ring, from either side
+ *
+ * The producer closes it once it's done, the consumer still gets every item
+ * committed before. The consumer closes it to stop the producer early, whose
+ * next reserve fails.
+ */
+void ring_close(Ring self);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _RING_H */
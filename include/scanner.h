@@ -0,0 +1,55 @@
+#ifndef _SCANNER_H
+#define _SCANNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "error.h"
+#include "str_pool.h"
+#include "tokens.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief Hand-written alternative to the flex scanner from lexer.l
+ *
+ * Produces exactly the same tokens and locations as flex, whitespace,
+ * identifiers and numbers are spanned 16 or 32 bytes at a time with
+ * SSE2/AVX2 when the CPU supports them, byte by byte otherwise.
+ *
+ * @param[out] out - Token array the tokens are appended to, the last one is
+ * always the end of the input
+ * @param[in] src - Source to scan, it doesn't need to be NUL terminated
+ * @param[in] len - Length of `src` in bytes
+ * @param[in] strs - String pool identifiers are interned in
+ *
+ * @returns Status_OK if successful, Status_InternalError if out of memory
+ */
+Status scanner_scan(Tokens out, const char *src, size_t len, StrPool strs);
+
+typedef enum {
+    /* The widest the CPU supports */
+    ScannerSpan_AUTO,
+    ScannerSpan_SCALAR,
+    ScannerSpan_SSE2,
+    ScannerSpan_AVX2,
+} ScannerSpan;
+
+/**
+ * @brief Pick how every later scan spans runs of whitespace, identifiers and
+ * numbers, to check them against each other
+ *
+ * Not thread safe, scans running while it's called may use either.
+ *
+ * @returns true if successful, false if the build or the CPU doesn't support
+ * `span`, which leaves the previous choice
+ */
+bool scanner_set_span(ScannerSpan span);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _SCANNER_H */
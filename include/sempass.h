@@ -4,6 +4,13 @@
 #include "../include/ast_visitor.h"
 #include "../include/sym_table.h"
 #include "../include/error.h"
+#include "../include/type_table.h"
+
+/**
+ * @brief Print the message of an error status followed by some detail, such
+ * as the symbol it's about
+ */
+void error_msg(FILE *stream, Status status, const char *detailed_msg);
 
 /**
  * @brief Perform semantic analysis on the given AST node.
@@ -22,4 +29,76 @@
  */
 Status sempass(const Ast ast, NodeID node_id, StrPool strs);
 
+/**
+ * @brief Same as `sempass` but reporting diagnostics to `diag` and keeping
+ * the types of the expressions
+ *
+ * The AST isn't written, so it may be checked by several threads at once as
+ * long as each has its own type table.
+ *
+ * @param[out] types - Table the types of the expressions are left in, by
+ * NodeID, NULL to drop them
+ * @param[in] diag - Output handle where diagnostics are printed
+ */
+Status sempass_report(
+    const Ast ast,
+    NodeID node_id,
+    StrPool strs,
+    TypeTable types,
+    FILE *diag);
+
+/**
+ * @brief Same as `sempass_report` but typing each expression with a forward
+ * scan over its nodes instead of walking it
+ *
+ * Relies on the nodes of every expression being pushed in post-order, as
+ * `ast_mk_*` does, and falls back to walking the expressions that aren't.
+ * Reports the same diagnostics and status as `sempass_report`.
+ */
+Status sempass_linear(
+    const Ast ast,
+    NodeID node_id,
+    StrPool strs,
+    TypeTable types,
+    FILE *diag);
+
+/**
+ * @brief Type check a single statement of the body of `main`, in the scope
+ * of the variables in `syms`
+ *
+ * Reports the same diagnostics as `sempass_report` does for the statement
+ * when `syms` holds the variables declared before it, and leaves the types
+ * of the other statements in `types` as they were.
+ *
+ * @param[in,out] syms - Variables in scope with their types, a declaration
+ * adds its variable
+ * @param[in] ret_type - Type `main` returns
+ * @param[out] types - Table the types of the expressions are left in, by
+ * NodeID, NULL to drop them
+ * @param[in] diag - Output handle where diagnostics are printed
+ */
+Status sempass_stmt(
+    const Ast ast,
+    NodeID stmt,
+    StrPool strs,
+    SymTable syms,
+    Type ret_type,
+    TypeTable types,
+    FILE *diag);
+
+/**
+ * @brief Make a pass type checking each statement it is handed, to be fused
+ * with others by `ast_visit_fused`
+ *
+ * Reports the same diagnostics and status as `sempass_report`.
+ *
+ * @param[out] pass - Pass to initialize, release it with `ast_pass_release`
+ * @param[out] types - Table the types of the expressions are left in, by
+ * NodeID, NULL to drop them
+ * @param[in] diag - Output handle where diagnostics are printed
+ *
+ * @returns Status_OK if successful, Status_InternalError if out of memory
+ */
+Status sempass_pass(AstPass *pass, StrPool strs, TypeTable types, FILE *diag);
+
 #endif // SEMPASS_H
@@ -0,0 +1,74 @@
+#ifndef _SHARED_STR_POOL_H
+#define _SHARED_STR_POOL_H
+
+#include <stddef.h>
+
+#include "str_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * String pool that can be shared by many threads interning at once
+ *
+ * Unlike `StrPool` it's append-only: strings are never collected nor moved,
+ * so `shared_str_pool_get` is wait-free and the pointers it returns are valid
+ * until the pool is released. Strings are spread over shards by hash, looking
+ * up a string already interned doesn't take any lock and only adding a new
+ * one locks its shard.
+ */
+typedef struct SharedStrPool_S *SharedStrPool;
+
+/**
+ * @brief Create an empty pool
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+SharedStrPool shared_str_pool_init();
+
+/**
+ * @brief Free the pool and every string in it, no other thread may be using
+ * it
+ */
+void shared_str_pool_release(SharedStrPool self);
+
+/**
+ * @brief Intern a string, safe to call from any number of threads at once
+ *
+ * @param[in] sym - NUL terminated string to intern
+ *
+ * @returns The ID of the string if successful, NO_ID if out of memory
+ *
+ * @note Every thread gets the same ID for the same string. IDs are dense but
+ * the order they're handed out in depends on how the threads interleave.
+ */
+StrID shared_str_pool_put(SharedStrPool self, const char *sym);
+
+/**
+ * @brief Same as `shared_str_pool_put` for the first `len` bytes of `sym`,
+ * which doesn't need to be NUL terminated but must not contain NUL
+ */
+StrID shared_str_pool_put_len(SharedStrPool self, const char *sym, size_t len);
+
+/**
+ * @brief Get the string with ID `id`, wait-free
+ *
+ * @returns The string, NULL if `id` wasn't handed out by the pool
+ *
+ * @note `id` must come from a put that happens before the call, either on the
+ * same thread or on one that synchronized with it
+ */
+const char *shared_str_pool_get(SharedStrPool self, StrID id);
+
+/**
+ * @brief Upper bound of the IDs handed out so far, to size arrays indexed by
+ * them
+ */
+size_t shared_str_pool_id_bound(SharedStrPool self);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _SHARED_STR_POOL_H */
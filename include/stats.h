@@ -0,0 +1,130 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "bytecode.h"
+#include "defs.h"
+#include "str_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define FOR_PHASES(DO)          \
+    DO(LEX, "lex")              \
+    DO(PARSE, "yyparse")        \
+    DO(DISPLAY, "ast_display")  \
+    DO(SEMPASS, "sempass")      \
+    DO(INITPASS, "initpass")    \
+    DO(LOWER, "bytecode")       \
+    DO(LOAD, "image_load")      \
+    DO(INTERP, "interp")        \
+    DO(FUSED, "fused")          \
+
+#define MK_PHASES(name, str) Phase_ ## name,
+typedef enum {
+    FOR_PHASES(MK_PHASES)
+    Phase_COUNT,
+} Phase;
+#undef MK_PHASES
+
+typedef struct {
+    double wall;
+    double cpu;
+    long peak_rss_kb;
+    size_t visitor_callbacks;
+
+    // start of the running measurement and the phase it interrupted
+    double wall_start;
+    double cpu_start;
+    Phase parent;
+} PhaseStats;
+
+typedef struct {
+    PhaseStats phases[Phase_COUNT];
+    Phase current;
+
+    size_t tokens;
+
+    size_t ast_nodes[AstNodeKind_MAIN + 1];
+    size_t ast_capacity;
+
+    size_t strings;
+    size_t string_bytes;
+    size_t str_pool_peak_bytes;
+
+    size_t symbols;
+    size_t sym_lookups;
+    // slots symbol tables grew to, they're indexed by StrID so this follows
+    // the highest identifier stored rather than the symbols
+    size_t sym_slots;
+
+    // instructions dispatched by `vm_run`, by opcode and by pair of
+    // consecutive opcodes, over the statements it ran
+    size_t vm_dispatches;
+    size_t vm_stmts;
+    size_t vm_ops[Opcode_COUNT];
+    size_t vm_pairs[Opcode_COUNT][Opcode_COUNT];
+} Stats;
+
+/**
+ * @brief Stats collected by the running thread, NULL while disabled
+ *
+ * Instrumented code only pays for a check of this pointer when disabled.
+ */
+extern _Thread_local Stats *stats_active;
+
+/**
+ * @brief Reset `stats` and start collecting into it from the calling thread
+ *
+ * @param[in] stats - Where to collect, NULL to disable collection
+ */
+void stats_enable(Stats *stats);
+
+/**
+ * @brief Start measuring a phase, nothing is done if stats are disabled
+ *
+ * Phases may nest, time spent in the inner phase is also accounted to the
+ * outer one. Phase_LEX runs once per token inside Phase_PARSE, so only its
+ * wall time is measured and its CPU time is apportioned from Phase_PARSE.
+ */
+void stats_phase_begin(Phase phase);
+
+/**
+ * @brief Stop measuring a phase, nothing is done if stats are disabled
+ */
+void stats_phase_end(Phase phase);
+
+/**
+ * @brief Account `n` visitor callbacks to the running phase
+ */
+void stats_count_callbacks(size_t n);
+
+/**
+ * @brief Record the node counts and capacity of the AST
+ */
+void stats_collect_ast(Stats *stats, const Ast ast);
+
+/**
+ * @brief Record the strings interned in the pool
+ */
+void stats_collect_strs(Stats *stats, StrPool strs);
+
+/**
+ * @brief Print the report as an aligned table
+ */
+void stats_report(const Stats *stats, FILE *stream);
+
+/**
+ * @brief Print the report as a single JSON object
+ */
+void stats_report_json(const Stats *stats, FILE *stream);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _STATS_H */
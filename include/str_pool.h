@@ -1,18 +1,99 @@
 #ifndef _STR_POOL
 #define _STR_POOL
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define NO_ID UINT32_MAX
 
 typedef uint32_t StrID;
+typedef uint32_t StrGen;
 
 typedef struct StrPool_S *StrPool;
 
 StrPool str_pool_init();
 void str_pool_release(StrPool self);
 
+/**
+ * @brief Intern a string, stamping it with the current generation
+ *
+ * @param[in] sym - NUL terminated string to intern
+ *
+ * @returns The ID of the string if successful, NO_ID if out of memory or if
+ * storing it would exceed the limit set with `str_pool_set_limit`
+ *
+ * @note IDs are stable for as long as the string is alive, even across
+ * compactions. Pointers returned by `str_pool_get` are not.
+ * @note IDs are dense, they're handed out from 0 up and those of collected
+ * strings are reused first, so they can index arrays directly
+ */
 StrID str_pool_put(StrPool self, const char *sym);
+
+/**
+ * @brief Same as `str_pool_put` for the first `len` bytes of `sym`, which
+ * doesn't need to be NUL terminated but must not contain NUL
+ */
+StrID str_pool_put_len(StrPool self, const char *sym, size_t len);
 const char *str_pool_get(StrPool self, StrID id);
 
+/**
+ * @brief Open a new generation
+ *
+ * Every string interned (or re-interned) from now on is stamped with the
+ * returned generation, keeping it alive until that generation is collected.
+ *
+ * @returns The new current generation
+ */
+StrGen str_pool_begin_generation(StrPool self);
+
+/**
+ * @brief Drop every string whose newest stamp is older than `oldest_live`
+ *
+ * Storage of the dropped strings is compacted once the dead bytes cross the
+ * fragmentation threshold.
+ *
+ * @param[in] oldest_live - Oldest generation still referenced by the caller
+ *
+ * @returns The number of strings dropped
+ *
+ * @note IDs of dropped strings are invalid after calling this and may be
+ * handed out again by later calls to `str_pool_put`
+ */
+size_t str_pool_collect(StrPool self, StrGen oldest_live);
+
+/**
+ * @brief Cap the bytes of string storage kept resident by the pool
+ *
+ * @param[in] max_bytes - Upper bound for the string storage, 0 for no limit
+ */
+void str_pool_set_limit(StrPool self, size_t max_bytes);
+
+/**
+ * @brief Bytes currently held by the pool, including its bookkeeping
+ */
+size_t str_pool_resident_bytes(StrPool self);
+
+/**
+ * @brief Highest value `str_pool_resident_bytes` ever reached
+ */
+size_t str_pool_peak_bytes(StrPool self);
+
+/**
+ * @brief Upper bound of the IDs of the live strings, to size arrays indexed
+ * by them
+ *
+ * @note Never more than the most strings ever alive at once
+ */
+size_t str_pool_id_bound(StrPool self);
+
+/**
+ * @brief Number of live strings
+ */
+size_t str_pool_count(StrPool self);
+
+/**
+ * @brief Bytes taken by live strings, including their terminators
+ */
+size_t str_pool_bytes(StrPool self);
+
 #endif
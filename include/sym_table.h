@@ -42,6 +42,10 @@ SymTable symtable_initialize();
  *
  * @returns A pointer to the symbol node containing information about the
  * symbol, or NULL if the symbol is not found.
+ *
+ * @note Symbols are indexed directly by their StrID, which the string pool
+ * keeps dense, so this is a single array access. The pointer is valid until
+ * the next call to `symtable_add_symbol`.
  */
 SymNode symtable_get_info(const SymTable self, StrID ident);
 
@@ -51,8 +55,18 @@ SymNode symtable_get_info(const SymTable self, StrID ident);
  * @param[in] self  A pointer to the symbol table.
  * @param[in] ident The identifier of the symbol to add.
  * @param[in] type  The type of the symbol to add.
+ *
+ * @returns true if successful, false if out of memory.
+ */
+bool symtable_add_symbol(SymTable self, const StrID ident, const Type type);
+
+/**
+ * @brief Removes a symbol from the symbol table, if it's there.
+ *
+ * @param[in] self  A pointer to the symbol table.
+ * @param[in] ident The identifier of the symbol to remove.
  */
-void symtable_add_symbol(SymTable self, const StrID ident, const Type type);
+void symtable_remove_symbol(SymTable self, const StrID ident);
 
 /**
  * @brief Releases the memory associated with a symbol table.
@@ -0,0 +1,78 @@
+#ifndef _TOKEN_PIPE_H
+#define _TOKEN_PIPE_H
+
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+#include "line_index.h"
+#include "str_pool.h"
+#include "tokens.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Front end pipelined over threads: a reader stage fills large blocks of the
+ * input, a lexer stage turns them into tokens, and the parser pulls the
+ * tokens on the calling thread. Stages are connected by rings (see ring.h),
+ * so reading and lexing overlap with building the AST and none of them runs
+ * far ahead of the next one.
+ *
+ * The lexer stage cuts the input right after a `;` and lexes every piece on
+ * its own, so the tokens and their locations are the same as when lexing the
+ * whole input in one go.
+ */
+typedef struct TokenPipe_S *TokenPipe;
+
+/**
+ * @brief Start reading and lexing `in`
+ *
+ * Until `token_pipe_finish` is called, `strs` and `lines` belong to the
+ * stages: identifiers are interned and newlines recorded as they're lexed.
+ *
+ * @param[in] in - Input handle the program is read from
+ * @param[in] strs - String pool identifiers are interned in
+ * @param[in] lines - Line index to record the newlines in, reset for a
+ * source that isn't kept in memory
+ * @param[in] lexer - Scanner to lex every piece with
+ *
+ * @returns A valid pipe if successful, NULL otherwise
+ */
+TokenPipe token_pipe_start(
+    FILE *in,
+    StrPool strs,
+    LineIndex lines,
+    Lexer lexer);
+
+/**
+ * @brief Wait for the next token
+ *
+ * @returns The token, valid until the next call. After the end of the input
+ * every call returns it again
+ */
+const Token *token_pipe_next(TokenPipe self);
+
+/**
+ * @brief Line and column of the location of a token already pulled
+ */
+LineCol token_pipe_lookup(TokenPipe self, Location loc);
+
+/**
+ * @brief Stop the stages, even if the input wasn't read to the end, and free
+ * the pipe
+ *
+ * @param[in] diag - Output handle where the reason the stages failed is
+ * printed, if any
+ *
+ * @returns Status_OK if every token pulled was read and lexed successfully,
+ * Status_InternalError otherwise
+ */
+Status token_pipe_finish(TokenPipe self, FILE *diag);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _TOKEN_PIPE_H */
@@ -0,0 +1,96 @@
+#ifndef _TOKENS_H
+#define _TOKENS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+#include "str_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct {
+    /* Token kind from parser.h, 0 for the end of the input */
+    int kind;
+    Location loc;
+    union {
+        StrID ident;
+        int64_t num;
+    } value;
+} Token;
+
+typedef enum {
+    /* The flex scanner from lexer.l */
+    Lexer_FLEX,
+    /* The hand-written one from scanner.h */
+    Lexer_SIMD,
+} Lexer;
+
+struct TokenArray_S {
+    Token *data;
+    size_t size;
+    size_t capacity;
+};
+
+typedef struct TokenArray_S *Tokens;
+
+/**
+ * @brief Create an empty token array
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+Tokens tokens_initialize();
+
+/**
+ * @brief Free the memory of the token array
+ */
+void tokens_release(Tokens self);
+
+/**
+ * @brief Remove every token, keeping their memory for reuse
+ */
+void tokens_clear(Tokens self);
+
+/**
+ * @brief Make room for at least `capacity` tokens
+ *
+ * @returns true if successful, false if out of memory
+ */
+bool tokens_reserve(Tokens self, size_t capacity);
+
+/**
+ * @brief Lex a whole source, replacing the tokens of the array
+ *
+ * The source is split right after `;` into one chunk per thread, chunks are
+ * lexed concurrently with their own string pool and merged back, remapping
+ * their identifiers into `strs` and their locations as if the source had been
+ * lexed in one go. The last token is always the end of the input.
+ *
+ * @param[in] src - Source to lex, it doesn't need to be NUL terminated
+ * @param[in] len - Length of `src` in bytes
+ * @param[in] strs - String pool identifiers are interned in
+ * @param[in] lexer - Scanner to lex every chunk with
+ * @param[in] threads - Number of threads to lex with, 0 for one per CPU
+ * @param[in] diag - Where to report a statement too long to lex, or NULL
+ *
+ * @returns Status_OK if successful, Status_InternalError otherwise
+ */
+Status tokens_lex(
+    Tokens self,
+    const char *src,
+    size_t len,
+    StrPool strs,
+    Lexer lexer,
+    unsigned threads,
+    FILE *diag);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _TOKENS_H */
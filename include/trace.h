@@ -0,0 +1,156 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+#include "str_pool.h"
+#include "sym_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Hooks called by `interp` as it runs a program (see interp.h)
+ *
+ * Every callback gets `context` first, then the node the event comes from.
+ * Values are handed as the symbol holding them, whose `ident` is the
+ * variable for reads and assignments and NO_ID otherwise. Running without a
+ * tracer costs a single, always predicted, branch per event.
+ */
+typedef struct {
+    void *context;
+
+    /* Optional, called with every constant loaded */
+    void (*on_const)(void *context, NodeID id, const Sym *value);
+    /* Optional, called with every variable read */
+    void (*on_var)(void *context, NodeID id, const Sym *value);
+    /* Optional, called with the result of every binary operation */
+    void (*on_binop)(void *context, NodeID id, BinOp op, const Sym *value);
+    /* Optional, called with every variable after it's assigned */
+    void (*on_asgn)(void *context, NodeID id, const Sym *value);
+    /* Optional, called with the value returned by `main`, Type_VOID for
+     * `return;` */
+    void (*on_ret)(void *context, NodeID id, const Sym *value);
+    /* Optional, called after every statement run by `interp_pass` and at the
+     * end of `interp`, so that buffered output stays in order with that of
+     * other passes */
+    void (*flush)(void *context);
+} Tracer;
+
+//
+// text tracer
+//
+
+/**
+ * Prints every event as a line, such as `VAR x: 3` or `ADD: 7`, buffering
+ * them in 64 KiB chunks (see printer.h) until flushed. Booleans are printed
+ * as 0 or 1.
+ */
+typedef struct TraceText_S *TraceText;
+
+/**
+ * @brief Create a text tracer
+ *
+ * @param[in] strs - String pool the variables are interned in
+ * @param[in] stream - Output handle the events are written to
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+TraceText trace_text_initialize(StrPool strs, FILE *stream);
+
+/**
+ * @brief Write what's left in the buffer and free the memory of the tracer
+ */
+void trace_text_release(TraceText self);
+
+/**
+ * @brief Hooks that print to the tracer, valid until it's released
+ */
+Tracer trace_text_tracer(TraceText self);
+
+//
+// ring tracer
+//
+
+typedef enum {
+    TraceEvent_CONST,
+    TraceEvent_VAR,
+    TraceEvent_BINOP,
+    TraceEvent_ASGN,
+    TraceEvent_RET,
+} TraceEvent;
+
+/* An event as recorded by the ring tracer, dumped as is */
+typedef struct {
+    // integers wrap around, booleans are 0 or 1
+    int64_t value;
+    NodeID node;
+    // variable of VAR and ASGN, BinOp of BINOP, NO_ID otherwise
+    uint32_t arg;
+    // a TraceEvent and a Type
+    uint8_t event;
+    uint8_t type;
+    uint8_t reserved[6];
+} TraceRecord;
+
+/**
+ * Keeps the last events of a run as binary records in a fixed ring, the
+ * oldest overwritten once it's full, so tracing never allocates nor writes
+ * anything while the program runs.
+ */
+typedef struct TraceRing_S *TraceRing;
+
+/**
+ * @brief Create an empty ring tracer
+ *
+ * @param[in] capacity - Number of records kept, rounded up to a power of 2
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+TraceRing trace_ring_initialize(size_t capacity);
+
+/**
+ * @brief Free the memory of the tracer
+ */
+void trace_ring_release(TraceRing self);
+
+/**
+ * @brief Hooks that record to the tracer, valid until it's released
+ */
+Tracer trace_ring_tracer(TraceRing self);
+
+/**
+ * @brief Number of records kept, at most the capacity
+ */
+size_t trace_ring_size(const TraceRing self);
+
+/**
+ * @brief Number of events recorded since the tracer was created, the ones
+ * before the last `trace_ring_size` were overwritten
+ */
+uint64_t trace_ring_total(const TraceRing self);
+
+/**
+ * @brief Record kept, from the oldest at 0 to the newest at
+ * `trace_ring_size - 1`
+ */
+const TraceRecord *trace_ring_get(const TraceRing self, size_t i);
+
+/**
+ * @brief Write every record kept, oldest first, as raw TraceRecords in the
+ * byte order of the machine
+ *
+ * @returns Status_OK if successful, Status_InternalError if writing failed
+ */
+Status trace_ring_dump(const TraceRing self, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _TRACE_H */
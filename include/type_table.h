@@ -0,0 +1,57 @@
+#ifndef _TYPE_TABLE_H
+#define _TYPE_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ast.h"
+#include "defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Types of the expressions of an AST, by NodeID
+ *
+ * Filled by the type checker instead of annotating the nodes, so the AST is
+ * never written after parsing and may be shared by several readers.
+ */
+typedef struct TypeTable_S *TypeTable;
+
+/**
+ * @brief Create an empty type table
+ *
+ * @returns A valid instance if successful, NULL otherwise
+ */
+TypeTable type_table_initialize();
+
+/**
+ * @brief Free the memory of the type table
+ */
+void type_table_release(TypeTable self);
+
+/**
+ * @brief Make room for the types of nodes [0, nodes)
+ *
+ * @returns The types by NodeID, valid until the next call, NULL if out of
+ * memory. Entries past the previous size are Type_VOID
+ */
+Type *type_table_reserve(TypeTable self, size_t nodes);
+
+/**
+ * @returns The type of the expression `id` found by the last check,
+ * Type_VOID if it isn't an expression or it didn't type check
+ */
+Type type_table_get(const TypeTable self, NodeID id);
+
+/**
+ * @brief Forget every type, keeping the memory
+ */
+void type_table_clear(TypeTable self);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _TYPE_TABLE_H */
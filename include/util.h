@@ -1,6 +1,18 @@
 #ifndef _UTIL_H
 #define _UTIL_H
 
+#include <stddef.h>
+#include <stdio.h>
+
 char *u_strdup(const char *src);
 
+/**
+ * @brief Read `stream` until EOF into a NUL terminated buffer
+ *
+ * @param[out] len - Number of bytes read, not counting the terminator
+ *
+ * @returns A buffer to be released with `free`, NULL on failure
+ */
+char *u_read_all(FILE *stream, size_t *len);
+
 #endif /* _UTIL_H */
@@ -0,0 +1,44 @@
+#ifndef _VM_H
+#define _VM_H
+
+#include <stdint.h>
+
+#include "bytecode.h"
+#include "error.h"
+#include "sym_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * How programs are run
+ */
+typedef enum {
+    /* Walks the AST, printing every value it computes (see interp.h) */
+    Evaluator_INTERP,
+    /* Compiles to bytecode and runs it with `vm_run`, printing nothing */
+    Evaluator_VM,
+} Evaluator;
+
+/**
+ * @brief Run a compiled program, same as `interp` but for the printing
+ *
+ * Dispatches one instruction at a time from a switch, integers wrap around
+ * on overflow. While stats are being collected, every dispatch and every
+ * pair of consecutive opcodes is counted, which is what the superinstructions
+ * of bytecode.h were chosen from.
+ *
+ * @param[in] args - Arguments of `main`, one per parameter. NULL to run it
+ * with every parameter 0 or false
+ * @param[out] result - Value returned by `main`
+ *
+ * @returns Status_OK if successful, Status_InternalError if out of memory
+ */
+Status vm_run(const Chunk *chunk, const int64_t *args, Sym *result);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _VM_H */
@@ -23,6 +23,16 @@ void ast_release(Ast self) {
     free(self);
 }
 
+void ast_clear(Ast self) {
+    self->size = 0;
+}
+
+void ast_truncate(Ast self, size_t size) {
+    if (size < self->size) {
+        self->size = size;
+    }
+}
+
 //
 // tree construction
 //
@@ -128,13 +138,19 @@ NodeID ast_mk_asgn(Ast self, Location loc, NodeID prev, StrID ident, NodeID expr
     return node_id;
 }
 
-NodeID ast_mk_main(Ast self, Location loc, Type type, NodeID body) {
+NodeID ast_mk_main(
+    Ast self,
+    Location loc,
+    Type type,
+    NodeID params,
+    NodeID body) {
     AstNode entry = (AstNode){
         .kind = AstNodeKind_MAIN,
         .loc = loc,
         .header = { .stmt_next = NO_ID },
         .data = { .MAIN = {
             .ret_type = type,
+            .params = params,
             .body = body,
         } },
     };
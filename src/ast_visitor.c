@@ -1,11 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../include/ast.h"
 #include "../include/str_pool.h"
 #include "../include/ast_visitor.h"
 #include "../include/error.h"
-
-#include <inttypes.h>
+#include "../include/printer.h"
+#include "../include/stats.h"
 
 // VISITOR
 struct Visitor_S {
@@ -13,6 +14,7 @@ struct Visitor_S {
     StrPool strs;
     void *context;
     bool interrupt;
+    size_t callbacks;
 
     /* Expression visitors */
     Status (*visit_int_constant)(Visitor visitor, NodeID expr_id);
@@ -27,6 +29,36 @@ struct Visitor_S {
     Status (*visit_main)(Visitor visitor, NodeID stmt_id);
 };
 
+// generic visits, walking the children of the node
+static Status _visit_leaf(Visitor visitor, NodeID id) {
+    (void)visitor, (void)id;
+    return Status_OK;
+}
+
+static Status _visit_binary_expr(Visitor visitor, NodeID expr_id) {
+    AstNode *expr = ast_get_expr(visitor->ast, expr_id);
+    Status s = visit_expr(visitor, expr->data.BINOP.lhs);
+    Status next_s = visit_expr(visitor, expr->data.BINOP.rhs);
+    return s != Status_OK ? s : next_s;
+}
+
+static Status _visit_assignment(Visitor visitor, NodeID stmt_id) {
+    AstNode *stmt = ast_get_stmt(visitor->ast, stmt_id);
+    return visit_expr(visitor, stmt->data.ASGN.expr);
+}
+
+static Status _visit_return(Visitor visitor, NodeID stmt_id) {
+    AstNode *stmt = ast_get_stmt(visitor->ast, stmt_id);
+    return visit_expr(visitor, stmt->data.RET);
+}
+
+static Status _visit_main(Visitor visitor, NodeID stmt_id) {
+    AstNode *stmt = ast_get_stmt(visitor->ast, stmt_id);
+    Status s = visit_stmt(visitor, stmt->data.MAIN.params);
+    Status next_s = visit_stmt(visitor, stmt->data.MAIN.body);
+    return s != Status_OK ? s : next_s;
+}
+
 Visitor init_visitor(
     Ast ast,
     StrPool strs,
@@ -39,22 +71,24 @@ Visitor init_visitor(
     Status (*visit_assignment)(Visitor visitor, NodeID stmt_id),
     Status (*visit_return)(Visitor visitor, NodeID stmt_id),
     Status (*visit_main)(Visitor visitor, NodeID stmt_id)) {
-    // TODO: We could define some generic visits if some of the
-    // pointers are NULL
-
     Visitor self = malloc(sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
     self->interrupt = false;
+    self->callbacks = 0;
     self->ast = ast;
     self->strs = strs;
     self->context = context;
-    self->visit_int_constant = visit_int_constant;
-    self->visit_bool_constant = visit_bool_constant;
-    self->visit_var = visit_var;
-    self->visit_binary_expr = visit_binary_expr;
-    self->visit_declaration = visit_declaration;
-    self->visit_assignment = visit_assignment;
-    self->visit_return = visit_return;
-    self->visit_main = visit_main;
+    self->visit_int_constant = visit_int_constant ? visit_int_constant : _visit_leaf;
+    self->visit_bool_constant = visit_bool_constant ? visit_bool_constant : _visit_leaf;
+    self->visit_var = visit_var ? visit_var : _visit_leaf;
+    self->visit_binary_expr = visit_binary_expr ? visit_binary_expr : _visit_binary_expr;
+    self->visit_declaration = visit_declaration ? visit_declaration : _visit_leaf;
+    self->visit_assignment = visit_assignment ? visit_assignment : _visit_assignment;
+    self->visit_return = visit_return ? visit_return : _visit_return;
+    self->visit_main = visit_main ? visit_main : _visit_main;
 
     return self;
 }
@@ -69,7 +103,8 @@ Status visit_expr(Visitor self, NodeID expr_id) {
         return Status_OK;
     }
 
-    Status s;
+    ++self->callbacks;
+    Status s = Status_InternalError;
     switch (expr->kind) {
     case AstNodeKind_INT_CONSTANT:
         s = self->visit_int_constant(self, expr_id);
@@ -98,46 +133,48 @@ Status visit_expr(Visitor self, NodeID expr_id) {
 }
 
 Status visit_stmt(Visitor self, NodeID stmt_id) {
-    if (self->interrupt) {
-        return Status_OK;
-    }
-
-    AstNode *stmt = ast_get_stmt(self->ast, stmt_id);
-    if (stmt == NULL) {
-        return Status_OK;
-    }
-
-    Status s;
-    switch (stmt->kind) {
-    case AstNodeKind_DECL:
-        s = self->visit_declaration(self, stmt_id);
-        break;
-
-    case AstNodeKind_ASGN:
-        s = self->visit_assignment(self, stmt_id);
-        break;
-
-    case AstNodeKind_RET:
-        s = self->visit_return(self, stmt_id);
-        break;
-
-    case AstNodeKind_MAIN:
-        s = self->visit_main(self, stmt_id);
-        break;
-
-    case AstNodeKind_BINOP:
-    case AstNodeKind_VAR:
-    case AstNodeKind_INT_CONSTANT:
-    case AstNodeKind_BOOL_CONSTANT:
-        return Status_InternalError;
-    }
-
-    Status next_s = Status_OK;
-    if (stmt->header.stmt_next != NO_ID) {
-        next_s = visit_stmt(self, stmt->header.stmt_next);
+    Status res = Status_OK;
+
+    // statements are chained, iterate rather than recurse on the next one
+    for (NodeID id = stmt_id; !self->interrupt && id != NO_ID;) {
+        AstNode *stmt = ast_get_stmt(self->ast, id);
+        if (stmt == NULL) {
+            break;
+        }
+
+        ++self->callbacks;
+        Status s = Status_InternalError;
+        switch (stmt->kind) {
+        case AstNodeKind_DECL:
+            s = self->visit_declaration(self, id);
+            break;
+
+        case AstNodeKind_ASGN:
+            s = self->visit_assignment(self, id);
+            break;
+
+        case AstNodeKind_RET:
+            s = self->visit_return(self, id);
+            break;
+
+        case AstNodeKind_MAIN:
+            s = self->visit_main(self, id);
+            break;
+
+        case AstNodeKind_BINOP:
+        case AstNodeKind_VAR:
+        case AstNodeKind_INT_CONSTANT:
+        case AstNodeKind_BOOL_CONSTANT:
+            return Status_InternalError;
+        }
+
+        if (res == Status_OK) {
+            res = s;
+        }
+        id = stmt->header.stmt_next;
     }
 
-    return s != Status_OK ? s : next_s;
+    return res;
 }
 
 Status ast_visit(Visitor self, NodeID node_id) {
@@ -155,6 +192,7 @@ void visitor_interrupt(Visitor self) {
 }
 
 void visitor_release(Visitor self) {
+    stats_count_callbacks(self->callbacks);
     free(self);
 }
 
@@ -171,12 +209,107 @@ StrPool visitor_get_strs(Visitor self) {
     return self->strs;
 }
 
+//
+// FUSED PASSES
+//
+
+static void _fused_run(AstPass *pass, Status s) {
+    if (pass->status == Status_OK) {
+        pass->status = s;
+    }
+}
+
+void ast_fused_enter_main(
+    const Ast ast, NodeID main_id, AstPass *passes, size_t n) {
+    // a pass may declare the parameters, later ones are gated on it too
+    bool failed = false;
+    for (size_t i = 0; i < n; ++i) {
+        AstPass *pass = &passes[i];
+        if (pass->enter_main != NULL && !(pass->gated && failed)) {
+            _fused_run(pass, pass->enter_main(pass->context, ast, main_id));
+        }
+        failed = failed || pass->status != Status_OK;
+    }
+}
+
+void ast_fused_stmt(const Ast ast, NodeID stmt_id, AstPass *passes, size_t n) {
+    bool failed = false;
+    for (size_t i = 0; i < n; ++i) {
+        AstPass *pass = &passes[i];
+        if (!(pass->gated && failed)) {
+            _fused_run(pass, pass->visit_stmt(pass->context, ast, stmt_id));
+        }
+        failed = failed || pass->status != Status_OK;
+    }
+}
+
+void ast_fused_leave_main(
+    const Ast ast, NodeID main_id, AstPass *passes, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (passes[i].leave_main != NULL) {
+            _fused_run(
+                &passes[i],
+                passes[i].leave_main(passes[i].context, ast, main_id));
+        }
+    }
+}
+
+Status ast_fused_status(const AstPass *passes, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (passes[i].status != Status_OK) {
+            return passes[i].status;
+        }
+    }
+    return Status_OK;
+}
+
+Status ast_visit_fused(const Ast ast, NodeID root, AstPass *passes, size_t n) {
+    if (ast->size <= root) {
+        return Status_InternalError;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        passes[i].status = Status_OK;
+    }
+
+    AstNode *main = &ast->data[root];
+    bool is_main = main->kind == AstNodeKind_MAIN;
+
+    if (is_main) {
+        ast_fused_enter_main(ast, root, passes, n);
+    }
+
+    NodeID first = is_main ? main->data.MAIN.body : root;
+    for (NodeID id = first; id != NO_ID; id = ast->data[id].header.stmt_next) {
+        ast_fused_stmt(ast, id, passes, n);
+    }
+
+    if (is_main) {
+        ast_fused_leave_main(ast, root, passes, n);
+    }
+
+    return ast_fused_status(passes, n);
+}
+
+void ast_pass_release(AstPass *pass) {
+    if (pass->release != NULL) {
+        pass->release(pass->context);
+    }
+    pass->context = NULL;
+}
+
 //
 // INSTANCES OF VISITORS
 //
 
+
 // DISPLAY AST
 
+// binary dump header, followed by the nodes in pre-order
+#define BIN_MAGIC "PRECCAST"
+#define BIN_VERSION 2
+#define BIN_END 0xff
+
 static const char *_str_bin_op(BinOp op) {
     switch (op) {
     case BinOp_ADD:
@@ -209,108 +342,504 @@ static const char *_str_bool(bool val) {
     }
 }
 
-Status display_int_constant(Visitor visitor, NodeID expr_id) {
-    FILE *stream = (FILE *)visitor->context;
-    AstNode *expr = ast_get_expr(visitor->ast, expr_id);
+typedef struct {
+    Printer out;
+    StrPool strs;
+    Format format;
+    // statements printed since entering `main`, JSON separates them with a
+    // leading comma so each one ends its own line
+    size_t stmts;
+    size_t dispatches;
+} Display;
+
+static Status _display_int_constant(Display *d, const Ast ast, AstNode *expr);
+static Status _display_bool_constant(Display *d, const Ast ast, AstNode *expr);
+static Status _display_var(Display *d, const Ast ast, AstNode *expr);
+static Status _display_binary_expr(Display *d, const Ast ast, AstNode *expr);
+static Status _display_declaration(Display *d, const Ast ast, AstNode *stmt);
+static Status _display_assignment(Display *d, const Ast ast, AstNode *stmt);
+static Status _display_return(Display *d, const Ast ast, AstNode *stmt);
+static Status _display_main(Display *d, const Ast ast, AstNode *stmt);
+
+#define WALK_NAME _display
+#define WALK_CTX Display
+#define WALK_ON_DISPATCH(d) (++(d)->dispatches)
+#define WALK_INT_CONSTANT _display_int_constant
+#define WALK_BOOL_CONSTANT _display_bool_constant
+#define WALK_VAR _display_var
+#define WALK_BINOP _display_binary_expr
+#define WALK_DECL _display_declaration
+#define WALK_ASGN _display_assignment
+#define WALK_RET _display_return
+#define WALK_MAIN _display_main
+#include "../include/ast_walk.h"
+
+// identifiers are [a-zA-Z][a-zA-Z0-9]*, they never need escaping in JSON
+static void _display_ident(Display *d, StrID id) {
+    const char *name = str_pool_get(d->strs, id);
+    size_t len = strlen(name);
+
+    switch (d->format) {
+    case Format_JSON:
+        printer_putc(&d->out, '"');
+        printer_write(&d->out, name, len);
+        printer_putc(&d->out, '"');
+        break;
+    case Format_BIN:
+        printer_u32(&d->out, (uint32_t)len);
+        printer_write(&d->out, name, len);
+        break;
+    default:
+        printer_write(&d->out, name, len);
+        break;
+    }
+}
 
-    fprintf(stream, "%" PRIi64 "", expr->data.INT_CONSTANT);
-    return 0;
+static void _display_stmt_begin(Display *d, AstNode *stmt) {
+    switch (d->format) {
+    case Format_SEXPR:
+        printer_puts(&d->out, "  (");
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, d->stmts > 0 ? ",{" : "{");
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, (char)stmt->kind);
+        break;
+    default:
+        break;
+    }
+    ++d->stmts;
 }
 
-Status display_bool_constant(Visitor visitor, NodeID expr_id) {
-    FILE *stream = (FILE *)visitor->context;
-    AstNode *expr = ast_get_expr(visitor->ast, expr_id);
-    fprintf(stream, "%s", _str_bool(expr->data.BOOL_CONSTANT));
+static void _display_stmt_end(Display *d) {
+    switch (d->format) {
+    case Format_SOURCE:
+        printer_puts(&d->out, ";\n");
+        break;
+    case Format_SEXPR:
+        printer_puts(&d->out, ")\n");
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, "}\n");
+        break;
+    default:
+        break;
+    }
+}
+
+// the parameters of `main`, inside its header
+static void _display_params(Display *d, const Ast ast, const AstNode *main) {
+    size_t n = 0;
+    for (NodeID id = main->data.MAIN.params; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        ++n;
+    }
+
+    switch (d->format) {
+    case Format_SEXPR:
+        if (n > 0) {
+            printer_puts(&d->out, " (params");
+        }
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, ",\"params\":[");
+        break;
+    case Format_BIN:
+        printer_u32(&d->out, (uint32_t)n);
+        break;
+    default:
+        break;
+    }
+
+    size_t i = 0;
+    for (NodeID id = main->data.MAIN.params; id != NO_ID;
+         id = ast->data[id].header.stmt_next, ++i) {
+        const AstNode *param = &ast->data[id];
+        const char *type = _str_type(param->data.DECL.type);
+
+        switch (d->format) {
+        case Format_SOURCE:
+            printer_puts(&d->out, i > 0 ? ", " : "");
+            printer_puts(&d->out, type);
+            printer_putc(&d->out, ' ');
+            break;
+        case Format_SEXPR:
+            printer_puts(&d->out, " (");
+            printer_puts(&d->out, type);
+            printer_putc(&d->out, ' ');
+            break;
+        case Format_JSON:
+            printer_puts(&d->out, i > 0 ? ",{\"type\":\"" : "{\"type\":\"");
+            printer_puts(&d->out, type);
+            printer_puts(&d->out, "\",\"var\":");
+            break;
+        case Format_BIN:
+            printer_putc(&d->out, (char)param->data.DECL.type);
+            break;
+        default:
+            break;
+        }
+        _display_ident(d, param->data.DECL.var);
+
+        switch (d->format) {
+        case Format_SEXPR:
+            printer_putc(&d->out, ')');
+            break;
+        case Format_JSON:
+            printer_putc(&d->out, '}');
+            break;
+        default:
+            break;
+        }
+    }
 
-    return 0;
+    switch (d->format) {
+    case Format_SEXPR:
+        if (n > 0) {
+            printer_putc(&d->out, ')');
+        }
+        break;
+    case Format_JSON:
+        printer_putc(&d->out, ']');
+        break;
+    default:
+        break;
+    }
 }
 
-Status display_var(Visitor visitor, NodeID expr_id) {
-    FILE *stream = (FILE *)visitor->context;
-    AstNode *expr = ast_get_expr(visitor->ast, expr_id);
+static void _display_enter_main(
+    Display *d, const Ast ast, const AstNode *main) {
+    Type ret_type = main->data.MAIN.ret_type;
+    d->stmts = 0;
+
+    switch (d->format) {
+    case Format_SOURCE:
+        printer_puts(&d->out, _str_type(ret_type));
+        printer_puts(&d->out, " main(");
+        _display_params(d, ast, main);
+        printer_puts(&d->out, ") {\n");
+        break;
+    case Format_SEXPR:
+        printer_puts(&d->out, "(main ");
+        printer_puts(&d->out, _str_type(ret_type));
+        _display_params(d, ast, main);
+        printer_putc(&d->out, '\n');
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, "{\"kind\":\"main\",\"type\":\"");
+        printer_puts(&d->out, _str_type(ret_type));
+        printer_putc(&d->out, '"');
+        _display_params(d, ast, main);
+        printer_puts(&d->out, ",\"body\":[\n");
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, AstNodeKind_MAIN);
+        printer_putc(&d->out, (char)ret_type);
+        _display_params(d, ast, main);
+        break;
+    default:
+        break;
+    }
+}
 
-    fprintf(stream, "%s", str_pool_get(visitor->strs, expr->data.VAR));
-    return 0;
+static void _display_leave_main(Display *d) {
+    switch (d->format) {
+    case Format_SOURCE:
+        printer_puts(&d->out, "}\n");
+        break;
+    case Format_SEXPR:
+        printer_puts(&d->out, ")\n");
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, "]}\n");
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, (char)BIN_END);
+        break;
+    default:
+        break;
+    }
 }
 
-Status display_binary_expr(Visitor visitor, NodeID expr_id) {
-    FILE *stream = (FILE *)visitor->context;
-    AstNode *expr = ast_get_expr(visitor->ast, expr_id);
+static Status _display_int_constant(Display *d, const Ast ast, AstNode *expr) {
+    (void)ast;
+    switch (d->format) {
+    case Format_JSON:
+        printer_puts(&d->out, "{\"kind\":\"int\",\"value\":");
+        printer_int(&d->out, expr->data.INT_CONSTANT);
+        printer_putc(&d->out, '}');
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, AstNodeKind_INT_CONSTANT);
+        printer_u64(&d->out, (uint64_t)expr->data.INT_CONSTANT);
+        break;
+    default:
+        printer_int(&d->out, expr->data.INT_CONSTANT);
+        break;
+    }
+    return Status_OK;
+}
 
-    fprintf(stream, "(");
-    visit_expr(visitor, expr->data.BINOP.lhs);
-    fprintf(stream, " %s ", _str_bin_op(expr->data.BINOP.op));
-    visit_expr(visitor, expr->data.BINOP.rhs);
-    fprintf(stream, ")");
-    return 0;
+static Status _display_bool_constant(Display *d, const Ast ast, AstNode *expr) {
+    (void)ast;
+    switch (d->format) {
+    case Format_JSON:
+        printer_puts(&d->out, "{\"kind\":\"bool\",\"value\":");
+        printer_puts(&d->out, _str_bool(expr->data.BOOL_CONSTANT));
+        printer_putc(&d->out, '}');
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, AstNodeKind_BOOL_CONSTANT);
+        printer_putc(&d->out, expr->data.BOOL_CONSTANT);
+        break;
+    default:
+        printer_puts(&d->out, _str_bool(expr->data.BOOL_CONSTANT));
+        break;
+    }
+    return Status_OK;
 }
 
-Status display_declaration(Visitor visitor, NodeID stmt_id) {
-    FILE *stream = (FILE *)visitor->context;
-    AstNode *stmt = ast_get_stmt(visitor->ast, stmt_id);
+static Status _display_var(Display *d, const Ast ast, AstNode *expr) {
+    (void)ast;
+    switch (d->format) {
+    case Format_JSON:
+        printer_puts(&d->out, "{\"kind\":\"var\",\"var\":");
+        _display_ident(d, expr->data.VAR);
+        printer_putc(&d->out, '}');
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, AstNodeKind_VAR);
+        _display_ident(d, expr->data.VAR);
+        break;
+    default:
+        _display_ident(d, expr->data.VAR);
+        break;
+    }
+    return Status_OK;
+}
 
-    fprintf(
-        stream,
-        "%s %s",
-        _str_type(stmt->data.DECL.type),
-        str_pool_get(visitor->strs, stmt->data.DECL.var));
-    fprintf(stream, ";\n");
-    return 0;
+static Status _display_binary_expr(Display *d, const Ast ast, AstNode *expr) {
+    const char *op = _str_bin_op(expr->data.BINOP.op);
+
+    switch (d->format) {
+    case Format_SOURCE:
+        printer_putc(&d->out, '(');
+        _display_expr(d, ast, expr->data.BINOP.lhs);
+        printer_putc(&d->out, ' ');
+        printer_puts(&d->out, op);
+        printer_putc(&d->out, ' ');
+        _display_expr(d, ast, expr->data.BINOP.rhs);
+        printer_putc(&d->out, ')');
+        break;
+    case Format_SEXPR:
+        printer_putc(&d->out, '(');
+        printer_puts(&d->out, op);
+        printer_putc(&d->out, ' ');
+        _display_expr(d, ast, expr->data.BINOP.lhs);
+        printer_putc(&d->out, ' ');
+        _display_expr(d, ast, expr->data.BINOP.rhs);
+        printer_putc(&d->out, ')');
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, "{\"kind\":\"binop\",\"op\":\"");
+        printer_puts(&d->out, op);
+        printer_puts(&d->out, "\",\"lhs\":");
+        _display_expr(d, ast, expr->data.BINOP.lhs);
+        printer_puts(&d->out, ",\"rhs\":");
+        _display_expr(d, ast, expr->data.BINOP.rhs);
+        printer_putc(&d->out, '}');
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, AstNodeKind_BINOP);
+        printer_putc(&d->out, (char)expr->data.BINOP.op);
+        _display_expr(d, ast, expr->data.BINOP.lhs);
+        _display_expr(d, ast, expr->data.BINOP.rhs);
+        break;
+    default:
+        break;
+    }
+    return Status_OK;
 }
 
-Status display_assignment(Visitor visitor, NodeID stmt_id) {
-    FILE *stream = (FILE *)visitor->context;
-    AstNode *stmt = ast_get_stmt(visitor->ast, stmt_id);
+static Status _display_declaration(Display *d, const Ast ast, AstNode *stmt) {
+    (void)ast;
+    const char *type = _str_type(stmt->data.DECL.type);
+
+    _display_stmt_begin(d, stmt);
+    switch (d->format) {
+    case Format_SOURCE:
+        printer_puts(&d->out, type);
+        printer_putc(&d->out, ' ');
+        break;
+    case Format_SEXPR:
+        printer_puts(&d->out, "decl ");
+        printer_puts(&d->out, type);
+        printer_putc(&d->out, ' ');
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, "\"kind\":\"decl\",\"type\":\"");
+        printer_puts(&d->out, type);
+        printer_puts(&d->out, "\",\"var\":");
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, (char)stmt->data.DECL.type);
+        break;
+    default:
+        break;
+    }
+    _display_ident(d, stmt->data.DECL.var);
+    _display_stmt_end(d);
+    return Status_OK;
+}
 
-    fprintf(stream, "%s = ", str_pool_get(visitor->strs, stmt->data.ASGN.var));
-    visit_expr(visitor, stmt->data.ASGN.expr);
-    fprintf(stream, ";\n");
-    return 0;
+static Status _display_assignment(Display *d, const Ast ast, AstNode *stmt) {
+    _display_stmt_begin(d, stmt);
+    switch (d->format) {
+    case Format_SOURCE:
+        _display_ident(d, stmt->data.ASGN.var);
+        printer_puts(&d->out, " = ");
+        break;
+    case Format_SEXPR:
+        printer_puts(&d->out, "asgn ");
+        _display_ident(d, stmt->data.ASGN.var);
+        printer_putc(&d->out, ' ');
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, "\"kind\":\"asgn\",\"var\":");
+        _display_ident(d, stmt->data.ASGN.var);
+        printer_puts(&d->out, ",\"expr\":");
+        break;
+    default:
+        _display_ident(d, stmt->data.ASGN.var);
+        break;
+    }
+    _display_expr(d, ast, stmt->data.ASGN.expr);
+    _display_stmt_end(d);
+    return Status_OK;
 }
 
-Status display_return(Visitor visitor, NodeID stmt_id) {
-    FILE *stream = (FILE *)visitor->context;
-    AstNode *stmt = ast_get_stmt(visitor->ast, stmt_id);
+static Status _display_return(Display *d, const Ast ast, AstNode *stmt) {
+    bool has_expr = stmt->data.RET != NO_ID;
+
+    _display_stmt_begin(d, stmt);
+    switch (d->format) {
+    case Format_SOURCE:
+        printer_puts(&d->out, has_expr ? "return " : "return");
+        break;
+    case Format_SEXPR:
+        printer_puts(&d->out, has_expr ? "ret " : "ret");
+        break;
+    case Format_JSON:
+        printer_puts(&d->out, "\"kind\":\"ret\",\"expr\":");
+        if (!has_expr) {
+            printer_puts(&d->out, "null");
+        }
+        break;
+    case Format_BIN:
+        printer_putc(&d->out, has_expr);
+        break;
+    default:
+        break;
+    }
+    if (has_expr) {
+        _display_expr(d, ast, stmt->data.RET);
+    }
+    _display_stmt_end(d);
+    return Status_OK;
+}
+
+static Status _display_main(Display *d, const Ast ast, AstNode *stmt) {
+    _display_enter_main(d, ast, stmt);
+    _display_seq(d, ast, stmt->data.MAIN.body);
+    _display_leave_main(d);
+    return Status_OK;
+}
 
-    fprintf(stream, "return");
-    if (stmt->data.RET != NO_ID) {
-        fprintf(stream, " ");
-        visit_expr(visitor, stmt->data.RET);
+static void _display_init(
+    Display *d, StrPool strs, Format format, FILE *stream) {
+    printer_init(&d->out, stream);
+    d->strs = strs;
+    d->format = format;
+    d->stmts = 0;
+    d->dispatches = 0;
+
+    if (format == Format_BIN) {
+        printer_write(&d->out, BIN_MAGIC, strlen(BIN_MAGIC));
+        printer_u32(&d->out, BIN_VERSION);
     }
-    fprintf(stream, ";\n");
-    return 0;
 }
 
-Status display_main(Visitor visitor, NodeID stmt_id) {
-    FILE *stream = (FILE *)visitor->context;
-    AstNode *stmt = ast_get_stmt(visitor->ast, stmt_id);
+void ast_display(
+    const Ast ast, NodeID node_id, StrPool strs, Format format, FILE *stream) {
+    if (format == Format_NONE) {
+        return;
+    }
 
-    fprintf(stream, "%s main() {\n", _str_type(stmt->data.MAIN.ret_type));
-    NodeID body = stmt->data.MAIN.body;
-    if (body != NO_ID) {
-        visit_stmt(visitor, stmt->data.MAIN.body);
+    Display d;
+    _display_init(&d, strs, format, stream);
+
+    bool is_main = node_id < ast->size &&
+        ast->data[node_id].kind == AstNodeKind_MAIN;
+    if (node_id < ast->size) {
+        _display_stmt(&d, ast, node_id);
+    }
+    if (!is_main && format != Format_BIN) {
+        printer_putc(&d.out, '\n');
     }
-    fprintf(stream, "}");
-    return 0;
+    printer_flush(&d.out);
+
+    stats_count_callbacks(d.dispatches);
 }
 
-void ast_display(const Ast ast, NodeID node_id, StrPool strs, FILE *stream) {
+// the stream is flushed after every callback, so the output stays in order
+// with that of the passes around this one
 
-    Visitor visitor = init_visitor(
-        ast,
-        strs,
-        (void *)stream,
-        display_int_constant,
-        display_bool_constant,
-        display_var,
-        display_binary_expr,
-        display_declaration,
-        display_assignment,
-        display_return,
-        display_main);
+static Status _display_pass_enter_main(void *context, const Ast ast, NodeID id) {
+    Display *d = context;
+    _display_enter_main(d, ast, &ast->data[id]);
+    printer_flush(&d->out);
+    return Status_OK;
+}
+
+static Status _display_pass_stmt(void *context, const Ast ast, NodeID id) {
+    Display *d = context;
+    Status s = _display_stmt(d, ast, id);
+    printer_flush(&d->out);
+    return s;
+}
 
-    ast_visit(visitor, node_id);
-    fprintf(stream, "\n");
+static Status _display_pass_leave_main(void *context, const Ast ast, NodeID id) {
+    (void)ast, (void)id;
+    Display *d = context;
+    _display_leave_main(d);
+    printer_flush(&d->out);
+    return Status_OK;
+}
+
+static void _display_pass_release(void *context) {
+    Display *d = context;
+    stats_count_callbacks(d->dispatches);
+    free(d);
+}
+
+Status ast_display_pass(
+    AstPass *pass, StrPool strs, Format format, FILE *stream) {
+    Display *d = malloc(sizeof(*d));
+    if (d == NULL) {
+        return Status_InternalError;
+    }
 
-    visitor_release(visitor);
+    _display_init(d, strs, format, stream);
+
+    *pass = (AstPass){
+        .context = d,
+        .enter_main = _display_pass_enter_main,
+        .visit_stmt = _display_pass_stmt,
+        .leave_main = _display_pass_leave_main,
+        .release = _display_pass_release,
+        .gated = false,
+        .status = Status_OK,
+    };
+    return Status_OK;
 }
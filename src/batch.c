@@ -0,0 +1,394 @@
+#include "batch.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "error.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_AVX2 1
+#endif
+
+#define DEFAULT_CAPACITY 64
+
+// rows run through the steps at once, a column of a block fits in L1 along
+// with the few others a step reads
+#define BLOCK 256
+
+// a column is a block of 64-bit lanes, in vectors of 4 that the compiler
+// maps to a single AVX2 register or to a pair of SSE2 ones. Aligned for AVX2
+// even where the file is built without it, which would align them to 16
+typedef uint64_t Lanes __attribute__((vector_size(32), aligned(32)));
+#define LANES (BLOCK / 4)
+
+#define NO_SLOT UINT32_MAX
+
+typedef enum {
+    // dst = imm
+    Op_FILL,
+    // dst = src
+    Op_COPY,
+    // dst = src op arg
+    Op_ADD,
+    Op_MUL,
+    // dst = src op imm
+    Op_ADD_IMM,
+    Op_MUL_IMM,
+} Op;
+
+typedef struct {
+    Op op;
+    uint32_t dst;
+    uint32_t src;
+    uint32_t arg;
+    uint64_t imm;
+} Step;
+
+// a column, or the same value for every row
+typedef struct {
+    uint32_t slot;
+    uint64_t imm;
+} Operand;
+
+struct Batch_S {
+    Step *steps;
+    size_t size;
+    size_t capacity;
+
+    // the parameters are the first columns, then the other variables, then
+    // the temporaries
+    size_t params;
+    size_t slots;
+
+    // value returned by `main`
+    Operand ret;
+};
+
+typedef struct {
+    Batch batch;
+    Ast ast;
+
+    // StrID -> column of the variable
+    uint32_t *slot_of;
+    size_t idents;
+
+    size_t vars;
+    bool out_of_memory;
+} Compiler;
+
+//
+// helpers
+//
+
+static inline Operand _slot(uint32_t slot) {
+    return (Operand){ .slot = slot, .imm = 0 };
+}
+
+static inline Operand _imm(uint64_t imm) {
+    return (Operand){ .slot = NO_SLOT, .imm = imm };
+}
+
+static inline bool _is_leaf(const Ast ast, NodeID id) {
+    return ast->data[id].kind != AstNodeKind_BINOP;
+}
+
+static void _emit(Compiler *c, Step step) {
+    Batch b = c->batch;
+    if (b->size == b->capacity) {
+        size_t capacity =
+            b->capacity == 0 ? DEFAULT_CAPACITY : 2 * b->capacity;
+        Step *dummy = (Step *)realloc(b->steps, capacity * sizeof(*dummy));
+        if (dummy == NULL) {
+            c->out_of_memory = true;
+            return;
+        }
+        b->steps = dummy;
+        b->capacity = capacity;
+    }
+    b->steps[b->size++] = step;
+}
+
+// expressions use a temporary per level of nesting at most
+static uint32_t _temp(Compiler *c, size_t depth) {
+    size_t slot = c->vars + depth;
+    if (c->batch->slots <= slot) {
+        c->batch->slots = slot + 1;
+    }
+    return (uint32_t)slot;
+}
+
+// gives the variable declared by `decl` the next column
+static void _declare(Compiler *c, const AstNode *decl) {
+    StrID var = decl->data.DECL.var;
+    if (c->idents <= var) {
+        size_t idents = c->idents == 0 ? DEFAULT_CAPACITY : 2 * c->idents;
+        while (idents <= var) {
+            idents *= 2;
+        }
+
+        uint32_t *dummy =
+            (uint32_t *)realloc(c->slot_of, idents * sizeof(*dummy));
+        if (dummy == NULL) {
+            c->out_of_memory = true;
+            return;
+        }
+        c->slot_of = dummy;
+        c->idents = idents;
+    }
+    c->slot_of[var] = (uint32_t)c->vars++;
+}
+
+//
+// compiling
+//
+
+// a BINOP leaves its value in `dst`, its operands use the temporaries from
+// `depth` on
+static Operand _compile_expr(
+    Compiler *c, NodeID id, uint32_t dst, size_t depth) {
+    const AstNode *e = &c->ast->data[id];
+    switch (e->kind) {
+    case AstNodeKind_INT_CONSTANT:
+        return _imm((uint64_t)e->data.INT_CONSTANT);
+    case AstNodeKind_BOOL_CONSTANT:
+        return _imm(e->data.BOOL_CONSTANT);
+    case AstNodeKind_VAR:
+        return _slot(c->slot_of[e->data.VAR]);
+    default:
+        break;
+    }
+
+    // both operations commute, the operand that needs temporaries goes
+    // first so that the other one doesn't hold one meanwhile
+    NodeID lhs = e->data.BINOP.lhs;
+    NodeID rhs = e->data.BINOP.rhs;
+    if (_is_leaf(c->ast, lhs) && !_is_leaf(c->ast, rhs)) {
+        lhs = e->data.BINOP.rhs;
+        rhs = e->data.BINOP.lhs;
+    }
+
+    // `dst` may be a variable read by `rhs`, so `lhs` can't be written to it
+    Operand a = _compile_expr(c, lhs, _temp(c, depth), depth);
+    Operand b = _compile_expr(c, rhs, _temp(c, depth + 1), depth + 1);
+    bool add = e->data.BINOP.op == BinOp_ADD;
+
+    if (a.slot == NO_SLOT && b.slot == NO_SLOT) {
+        return _imm(add ? a.imm + b.imm : a.imm * b.imm);
+    }
+    if (a.slot == NO_SLOT) {
+        Operand tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    Step step = { .dst = dst, .src = a.slot, .arg = b.slot, .imm = b.imm };
+    if (b.slot == NO_SLOT) {
+        step.op = add ? Op_ADD_IMM : Op_MUL_IMM;
+    } else {
+        step.op = add ? Op_ADD : Op_MUL;
+    }
+    _emit(c, step);
+    return _slot(dst);
+}
+
+static void _compile_asgn(Compiler *c, const AstNode *stmt) {
+    uint32_t var = c->slot_of[stmt->data.ASGN.var];
+    Operand value = _compile_expr(c, stmt->data.ASGN.expr, var, 0);
+
+    if (value.slot == NO_SLOT) {
+        _emit(c, (Step){ .op = Op_FILL, .dst = var, .imm = value.imm });
+    } else if (value.slot != var) {
+        _emit(c, (Step){ .op = Op_COPY, .dst = var, .src = value.slot });
+    }
+}
+
+static void _compile_main(Compiler *c, const AstNode *main) {
+    const Ast ast = c->ast;
+
+    for (NodeID id = main->data.MAIN.params; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        _declare(c, &ast->data[id]);
+        ++c->batch->params;
+    }
+    for (NodeID id = main->data.MAIN.body; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        if (ast->data[id].kind == AstNodeKind_DECL) {
+            _declare(c, &ast->data[id]);
+        }
+    }
+    c->batch->slots = c->vars;
+
+    // every row runs the same statements, up to the first `return`
+    c->batch->ret = _imm(0);
+    for (NodeID id = main->data.MAIN.body; id != NO_ID && !c->out_of_memory;
+         id = ast->data[id].header.stmt_next) {
+        const AstNode *stmt = &ast->data[id];
+        if (stmt->kind == AstNodeKind_ASGN) {
+            _compile_asgn(c, stmt);
+        } else if (stmt->kind == AstNodeKind_RET) {
+            if (stmt->data.RET != NO_ID) {
+                c->batch->ret =
+                    _compile_expr(c, stmt->data.RET, _temp(c, 0), 0);
+            }
+            break;
+        }
+    }
+}
+
+//
+// constructor & destructor
+//
+
+Batch batch_compile(const Ast ast, NodeID root) {
+    if (ast->size <= root || ast->data[root].kind != AstNodeKind_MAIN) {
+        return NULL;
+    }
+
+    Batch self = (Batch)calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    Compiler c = {
+        .batch = self,
+        .ast = ast,
+        .slot_of = NULL,
+        .idents = 0,
+        .vars = 0,
+        .out_of_memory = false,
+    };
+    _compile_main(&c, &ast->data[root]);
+    free(c.slot_of);
+
+    if (c.out_of_memory) {
+        batch_release(self);
+        return NULL;
+    }
+    return self;
+}
+
+void batch_release(Batch self) {
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->steps);
+    free(self);
+}
+
+size_t batch_params(const Batch self) {
+    return self->params;
+}
+
+//
+// running
+//
+
+typedef void (*RunFn)(const Step *steps, size_t n, Lanes *cols);
+
+static inline __attribute__((always_inline)) void _run_steps(
+    const Step *steps, size_t n, Lanes *cols) {
+    for (const Step *s = steps; s < steps + n; ++s) {
+        Lanes *dst = &cols[(size_t)s->dst * LANES];
+        const Lanes *src = &cols[(size_t)s->src * LANES];
+        const Lanes *arg = &cols[(size_t)s->arg * LANES];
+        uint64_t imm = s->imm;
+
+        switch (s->op) {
+        case Op_FILL:
+            for (size_t i = 0; i < LANES; ++i) {
+                dst[i] = (Lanes){ 0 } + imm;
+            }
+            break;
+        case Op_COPY:
+            for (size_t i = 0; i < LANES; ++i) {
+                dst[i] = src[i];
+            }
+            break;
+        case Op_ADD:
+            for (size_t i = 0; i < LANES; ++i) {
+                dst[i] = src[i] + arg[i];
+            }
+            break;
+        case Op_MUL:
+            for (size_t i = 0; i < LANES; ++i) {
+                dst[i] = src[i] * arg[i];
+            }
+            break;
+        case Op_ADD_IMM:
+            for (size_t i = 0; i < LANES; ++i) {
+                dst[i] = src[i] + imm;
+            }
+            break;
+        case Op_MUL_IMM:
+            for (size_t i = 0; i < LANES; ++i) {
+                dst[i] = src[i] * imm;
+            }
+            break;
+        }
+    }
+}
+
+static void _run_generic(const Step *steps, size_t n, Lanes *cols) {
+    _run_steps(steps, n, cols);
+}
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2"))) static void _run_avx2(
+    const Step *steps, size_t n, Lanes *cols) {
+    _run_steps(steps, n, cols);
+}
+#endif
+
+static RunFn _select_run() {
+#ifdef HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return _run_avx2;
+    }
+#endif
+    return _run_generic;
+}
+
+Status batch_eval(
+    const Batch self,
+    const int64_t *const *inputs,
+    size_t rows,
+    int64_t *results) {
+    size_t slots = self->slots > 0 ? self->slots : 1;
+    Lanes *cols = (Lanes *)aligned_alloc(
+        alignof(Lanes), slots * LANES * sizeof(Lanes));
+    if (cols == NULL) {
+        return Status_InternalError;
+    }
+    memset(cols, 0, slots * LANES * sizeof(Lanes));
+
+    RunFn run = _select_run();
+    for (size_t row = 0; row < rows; row += BLOCK) {
+        size_t n = rows - row < BLOCK ? rows - row : BLOCK;
+
+        for (size_t p = 0; p < self->params; ++p) {
+            uint64_t *col = (uint64_t *)&cols[p * LANES];
+            memcpy(col, inputs[p] + row, n * sizeof(*col));
+        }
+
+        run(self->steps, self->size, cols);
+
+        if (self->ret.slot == NO_SLOT) {
+            for (size_t i = 0; i < n; ++i) {
+                results[row + i] = (int64_t)self->ret.imm;
+            }
+        } else {
+            memcpy(
+                results + row,
+                &cols[(size_t)self->ret.slot * LANES],
+                n * sizeof(*results));
+        }
+    }
+
+    free(cols);
+    return Status_OK;
+}
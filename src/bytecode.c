@@ -0,0 +1,585 @@
+#include "bytecode.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "ast.h"
+#include "defs.h"
+#include "str_pool.h"
+
+#define DEFAULT_CAPACITY 64
+
+typedef struct {
+    const char *name;
+    uint8_t slots;
+    bool constant;
+    uint8_t pops;
+    uint8_t pushes;
+} OpcodeInfo;
+
+#define MK_INFO(name, slots, constant, pops, pushes) \
+    { #name, slots, constant, pops, pushes },
+static const OpcodeInfo OPCODES[] = { FOR_OPCODES(MK_INFO) };
+#undef MK_INFO
+
+struct Bytecode_S {
+    Chunk chunk;
+    Insn *code;
+    int64_t *consts;
+    SlotInfo *slot_info;
+    char *strings;
+};
+
+// an instruction while compiling, with its constant inline rather than in
+// the pool, so that folding them leaves nothing behind
+typedef struct {
+    Opcode op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint64_t k;
+} Ir;
+
+typedef struct {
+    Ast ast;
+    StrPool strs;
+    bool fuse;
+
+    Ir *code;
+    size_t size;
+    size_t capacity;
+
+    // StrID -> slot of the variable
+    uint32_t *slot_of;
+    size_t idents;
+
+    uint32_t slots;
+    uint32_t stmts;
+    bool out_of_memory;
+
+    // names and types of the slots
+    SlotInfo *slot_info;
+    size_t slot_capacity;
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+} Compiler;
+
+//
+// peephole
+//
+
+static inline bool _is_arith(Opcode op) {
+    return op == Opcode_ADD || op == Opcode_MUL;
+}
+
+// pushes a value without popping any
+static inline bool _is_operand(Opcode op) {
+    switch (op) {
+    case Opcode_LOAD:
+    case Opcode_ADD_VV:
+    case Opcode_MUL_VV:
+    case Opcode_ADD_VC:
+    case Opcode_MUL_VC:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// the form of a superinstruction for the operation `op`
+static inline Opcode _pick(Opcode op, Opcode add, Opcode mul) {
+    return op == Opcode_ADD ? add : mul;
+}
+
+// replaces the last `n` instructions with `insn`
+static inline bool _replace(Compiler *c, size_t n, Ir insn) {
+    c->size -= n - 1;
+    c->code[c->size - 1] = insn;
+    return true;
+}
+
+static inline bool _drop(Compiler *c, size_t n) {
+    c->size -= n;
+    return true;
+}
+
+// rewrites the instructions at the end of the code, true if it did. Every
+// rule replaces a sequence with one that leaves the same slots and stack
+// whatever comes before it
+static bool _rewrite(Compiler *c) {
+    size_t n = c->size;
+    Ir *x = n >= 3 ? &c->code[n - 3] : NULL;
+    Ir *y = n >= 2 ? &c->code[n - 2] : NULL;
+    Ir *z = &c->code[n - 1];
+
+    if (x != NULL && _is_arith(z->op)) {
+        // a op b
+        if (x->op == Opcode_CONST && y->op == Opcode_CONST) {
+            uint64_t k = z->op == Opcode_ADD ? x->k + y->k : x->k * y->k;
+            return _replace(c, 3, (Ir){ .op = Opcode_CONST, .k = k });
+        }
+        // constants go last, both operations commute
+        if (x->op == Opcode_CONST && _is_operand(y->op)) {
+            Ir tmp = *x;
+            *x = *y;
+            *y = tmp;
+            return true;
+        }
+    }
+    if (y != NULL) {
+        // e + 0, e * 1
+        if (y->op == Opcode_CONST &&
+            ((z->op == Opcode_ADD && y->k == 0) ||
+             (z->op == Opcode_MUL && y->k == 1))) {
+            return _drop(c, 2);
+        }
+        // x = x
+        if (y->op == Opcode_LOAD && z->op == Opcode_STORE && y->a == z->a) {
+            return _drop(c, 2);
+        }
+    }
+
+    if (!c->fuse || y == NULL) {
+        return false;
+    }
+
+    if (x != NULL && x->op == Opcode_LOAD && _is_arith(z->op)) {
+        Opcode op = z->op;
+        if (y->op == Opcode_LOAD) {
+            Opcode vv = _pick(op, Opcode_ADD_VV, Opcode_MUL_VV);
+            return _replace(c, 3, (Ir){ .op = vv, .a = x->a, .b = y->a });
+        }
+        if (y->op == Opcode_CONST) {
+            Opcode vc = _pick(op, Opcode_ADD_VC, Opcode_MUL_VC);
+            return _replace(c, 3, (Ir){ .op = vc, .a = x->a, .k = y->k });
+        }
+    }
+
+    Ir insn = { .op = Opcode_COUNT, .a = z->a };
+    switch (z->op) {
+    case Opcode_STORE:
+        switch (y->op) {
+        case Opcode_CONST:
+            insn = (Ir){ .op = Opcode_SET_CONST, .a = z->a, .k = y->k };
+            break;
+        case Opcode_LOAD:
+            insn = (Ir){ .op = Opcode_COPY, .a = z->a, .b = y->a };
+            break;
+        case Opcode_ADD:
+            insn.op = Opcode_ADD_STORE;
+            break;
+        case Opcode_MUL:
+            insn.op = Opcode_MUL_STORE;
+            break;
+        case Opcode_ADD_VV:
+        case Opcode_MUL_VV:
+            insn.op = y->op == Opcode_ADD_VV
+                ? Opcode_ADD_VV_STORE
+                : Opcode_MUL_VV_STORE;
+            insn.b = y->a;
+            insn.c = y->b;
+            break;
+        case Opcode_ADD_VC:
+        case Opcode_MUL_VC:
+            insn.op = y->op == Opcode_ADD_VC
+                ? Opcode_ADD_VC_STORE
+                : Opcode_MUL_VC_STORE;
+            insn.b = y->a;
+            insn.k = y->k;
+            break;
+        default:
+            break;
+        }
+        break;
+    case Opcode_ADD:
+    case Opcode_MUL:
+        if (y->op == Opcode_LOAD) {
+            insn = (Ir){
+                .op = _pick(z->op, Opcode_ADD_V, Opcode_MUL_V),
+                .a = y->a,
+            };
+        } else if (y->op == Opcode_CONST) {
+            insn = (Ir){
+                .op = _pick(z->op, Opcode_ADD_C, Opcode_MUL_C),
+                .k = y->k,
+            };
+        }
+        break;
+    case Opcode_RET:
+        if (y->op == Opcode_LOAD) {
+            insn = (Ir){ .op = Opcode_RET_VAR, .a = y->a };
+        } else if (y->op == Opcode_CONST) {
+            insn = (Ir){ .op = Opcode_RET_CONST, .k = y->k };
+        }
+        break;
+    default:
+        break;
+    }
+
+    return insn.op != Opcode_COUNT && _replace(c, 2, insn);
+}
+
+//
+// helpers
+//
+
+static void _emit(Compiler *c, Ir insn) {
+    if (c->size == c->capacity) {
+        size_t capacity =
+            c->capacity == 0 ? DEFAULT_CAPACITY : 2 * c->capacity;
+        Ir *dummy = (Ir *)realloc(c->code, capacity * sizeof(*dummy));
+        if (dummy == NULL) {
+            c->out_of_memory = true;
+            return;
+        }
+        c->code = dummy;
+        c->capacity = capacity;
+    }
+    c->code[c->size++] = insn;
+
+    while (_rewrite(c)) {
+    }
+}
+
+// gives the variable declared by `decl` the next slot
+static void _declare(Compiler *c, const AstNode *decl) {
+    StrID var = decl->data.DECL.var;
+    if (c->idents <= var) {
+        size_t idents = c->idents == 0 ? DEFAULT_CAPACITY : 2 * c->idents;
+        while (idents <= var) {
+            idents *= 2;
+        }
+
+        uint32_t *dummy =
+            (uint32_t *)realloc(c->slot_of, idents * sizeof(*dummy));
+        if (dummy == NULL) {
+            c->out_of_memory = true;
+            return;
+        }
+        c->slot_of = dummy;
+        c->idents = idents;
+    }
+
+    if (c->slots == c->slot_capacity) {
+        size_t capacity =
+            c->slot_capacity == 0 ? DEFAULT_CAPACITY : 2 * c->slot_capacity;
+        SlotInfo *dummy =
+            (SlotInfo *)realloc(c->slot_info, capacity * sizeof(*dummy));
+        if (dummy == NULL) {
+            c->out_of_memory = true;
+            return;
+        }
+        c->slot_info = dummy;
+        c->slot_capacity = capacity;
+    }
+
+    const char *name = str_pool_get(c->strs, var);
+    size_t len = strlen(name) + 1;
+    if (c->strings_size + len > c->strings_capacity) {
+        size_t capacity = c->strings_capacity == 0
+            ? DEFAULT_CAPACITY
+            : 2 * c->strings_capacity;
+        while (capacity < c->strings_size + len) {
+            capacity *= 2;
+        }
+
+        char *dummy = (char *)realloc(c->strings, capacity);
+        if (dummy == NULL) {
+            c->out_of_memory = true;
+            return;
+        }
+        c->strings = dummy;
+        c->strings_capacity = capacity;
+    }
+
+    c->slot_info[c->slots] = (SlotInfo){
+        .name = (uint32_t)c->strings_size,
+        .type = decl->data.DECL.type,
+    };
+    memcpy(c->strings + c->strings_size, name, len);
+    c->strings_size += len;
+    c->slot_of[var] = c->slots++;
+}
+
+//
+// compiling
+//
+
+static void _compile_expr(Compiler *c, NodeID id) {
+    const AstNode *e = &c->ast->data[id];
+    switch (e->kind) {
+    case AstNodeKind_INT_CONSTANT:
+        _emit(c, (Ir){ .op = Opcode_CONST, .k = e->data.INT_CONSTANT });
+        break;
+    case AstNodeKind_BOOL_CONSTANT:
+        _emit(c, (Ir){ .op = Opcode_CONST, .k = e->data.BOOL_CONSTANT });
+        break;
+    case AstNodeKind_VAR:
+        _emit(c, (Ir){ .op = Opcode_LOAD, .a = c->slot_of[e->data.VAR] });
+        break;
+    case AstNodeKind_BINOP:
+        _compile_expr(c, e->data.BINOP.lhs);
+        _compile_expr(c, e->data.BINOP.rhs);
+        _emit(
+            c,
+            (Ir){
+                .op = e->data.BINOP.op == BinOp_ADD ? Opcode_ADD : Opcode_MUL,
+            });
+        break;
+    default:
+        break;
+    }
+}
+
+static void _compile_main(Compiler *c, const AstNode *main) {
+    const Ast ast = c->ast;
+
+    for (NodeID id = main->data.MAIN.params; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        _declare(c, &ast->data[id]);
+    }
+    for (NodeID id = main->data.MAIN.body; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        if (ast->data[id].kind == AstNodeKind_DECL) {
+            _declare(c, &ast->data[id]);
+        }
+    }
+
+    // statements after the first `return` never run
+    for (NodeID id = main->data.MAIN.body; id != NO_ID && !c->out_of_memory;
+         id = ast->data[id].header.stmt_next) {
+        const AstNode *stmt = &ast->data[id];
+        ++c->stmts;
+
+        if (stmt->kind == AstNodeKind_ASGN) {
+            _compile_expr(c, stmt->data.ASGN.expr);
+            _emit(
+                c,
+                (Ir){
+                    .op = Opcode_STORE,
+                    .a = c->slot_of[stmt->data.ASGN.var],
+                });
+        } else if (stmt->kind == AstNodeKind_RET) {
+            if (stmt->data.RET == NO_ID) {
+                _emit(c, (Ir){ .op = Opcode_RET_VOID });
+            } else {
+                _compile_expr(c, stmt->data.RET);
+                _emit(c, (Ir){ .op = Opcode_RET });
+            }
+            return;
+        }
+    }
+
+    // falls off the end of a `void main`
+    _emit(c, (Ir){ .op = Opcode_RET_VOID });
+}
+
+// lays the instructions out with their constants in the pool
+static bool _assemble(Bytecode self, const Compiler *c) {
+    size_t n_consts = 0;
+    for (size_t i = 0; i < c->size; ++i) {
+        n_consts += OPCODES[c->code[i].op].constant;
+    }
+
+    self->code = (Insn *)malloc(c->size * sizeof(*self->code));
+    self->consts = (int64_t *)malloc(
+        (n_consts > 0 ? n_consts : 1) * sizeof(*self->consts));
+    if (self->code == NULL || self->consts == NULL) {
+        return false;
+    }
+
+    uint32_t depth = 0, stack = 0;
+    size_t k = 0;
+    for (size_t i = 0; i < c->size; ++i) {
+        const Ir *ir = &c->code[i];
+        const OpcodeInfo *info = &OPCODES[ir->op];
+
+        uint32_t operands[3] = { ir->a, ir->b, ir->c };
+        if (info->constant) {
+            operands[info->slots] = (uint32_t)k;
+            self->consts[k++] = (int64_t)ir->k;
+        }
+        self->code[i] = (Insn){
+            .op = ir->op,
+            .a = operands[0],
+            .b = operands[1],
+            .c = operands[2],
+        };
+
+        depth = depth - info->pops + info->pushes;
+        stack = depth > stack ? depth : stack;
+    }
+
+    self->chunk = (Chunk){
+        .code = self->code,
+        .size = c->size,
+        .consts = self->consts,
+        .n_consts = n_consts,
+        .slots = c->slots,
+        .stack = stack,
+        .stmts = c->stmts,
+        .slot_info = c->slot_info,
+        .strings = c->strings,
+        .strings_size = c->strings_size,
+    };
+    return true;
+}
+
+//
+// constructor & destructor
+//
+
+Bytecode bytecode_compile(
+    const Ast ast, NodeID root, StrPool strs, bool fuse) {
+    if (ast->size <= root || ast->data[root].kind != AstNodeKind_MAIN) {
+        return NULL;
+    }
+
+    Bytecode self = (Bytecode)calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    Compiler c = {
+        .ast = ast,
+        .strs = strs,
+        .fuse = fuse,
+        .code = NULL,
+        .size = 0,
+        .capacity = 0,
+        .slot_of = NULL,
+        .idents = 0,
+        .slots = 0,
+        .stmts = 0,
+        .out_of_memory = false,
+        .slot_info = NULL,
+        .slot_capacity = 0,
+        .strings = NULL,
+        .strings_size = 0,
+        .strings_capacity = 0,
+    };
+    const AstNode *main = &ast->data[root];
+    _compile_main(&c, main);
+
+    // the names are handed over even if assembling fails
+    self->slot_info = c.slot_info;
+    self->strings = c.strings;
+    bool ok = !c.out_of_memory && _assemble(self, &c);
+    free(c.code);
+    free(c.slot_of);
+
+    if (!ok) {
+        bytecode_release(self);
+        return NULL;
+    }
+
+    for (NodeID id = main->data.MAIN.params; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        ++self->chunk.params;
+    }
+    self->chunk.ret_type = main->data.MAIN.ret_type;
+    return self;
+}
+
+void bytecode_release(Bytecode self) {
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->code);
+    free(self->consts);
+    free(self->slot_info);
+    free(self->strings);
+    free(self);
+}
+
+//
+// verification
+//
+
+static inline bool _is_return(Opcode op) {
+    switch (op) {
+    case Opcode_RET:
+    case Opcode_RET_VOID:
+    case Opcode_RET_VAR:
+    case Opcode_RET_CONST:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char *bytecode_verify(const Chunk *chunk) {
+    if (chunk->params > chunk->slots) {
+        return "more parameters than slots";
+    }
+    if (chunk->ret_type > Type_BOOL) {
+        return "invalid return type";
+    }
+    if (chunk->strings_size > 0 &&
+        chunk->strings[chunk->strings_size - 1] != '\0') {
+        return "unterminated string table";
+    }
+    for (uint32_t i = 0; i < chunk->slots; ++i) {
+        if (chunk->slot_info[i].name >= chunk->strings_size) {
+            return "slot name out of the string table";
+        }
+        if (chunk->slot_info[i].type > Type_BOOL) {
+            return "invalid slot type";
+        }
+    }
+
+    if (chunk->size == 0 || !_is_return(chunk->code[chunk->size - 1].op)) {
+        return "code doesn't end in a return";
+    }
+    // every instruction pushes at most one value, this bounds what `vm_run`
+    // allocates
+    if (chunk->stack > chunk->size) {
+        return "stack deeper than the code gets";
+    }
+
+    uint32_t depth = 0;
+    for (size_t i = 0; i < chunk->size; ++i) {
+        const Insn *insn = &chunk->code[i];
+        if (insn->op >= Opcode_COUNT) {
+            return "invalid opcode";
+        }
+
+        const OpcodeInfo *info = &OPCODES[insn->op];
+        uint32_t operands[3] = { insn->a, insn->b, insn->c };
+        for (size_t j = 0; j < info->slots; ++j) {
+            if (operands[j] >= chunk->slots) {
+                return "slot out of range";
+            }
+        }
+        if (info->constant && operands[info->slots] >= chunk->n_consts) {
+            return "constant out of range";
+        }
+
+        if (depth < info->pops) {
+            return "stack underflow";
+        }
+        depth = depth - info->pops + info->pushes;
+        if (depth > chunk->stack) {
+            return "stack deeper than declared";
+        }
+    }
+
+    return NULL;
+}
+
+//
+// getters
+//
+
+const Chunk *bytecode_chunk(const Bytecode self) {
+    return &self->chunk;
+}
+
+const char *bytecode_opcode_name(Opcode op) {
+    return op < Opcode_COUNT ? OPCODES[op].name : "?";
+}
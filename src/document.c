@@ -0,0 +1,1838 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "document.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "error.h"
+#include "line_index.h"
+#include "parser.h"
+#include "pratt.h"
+#include "sempass.h"
+#include "str_pool.h"
+#include "sym_table.h"
+#include "tokens.h"
+#include "type_table.h"
+
+#define DEFAULT_CAPACITY 64
+
+// the AST is rebuilt once it holds more nodes left behind by edits than
+// this and than nodes of the program
+#define MIN_GARBAGE (1 << 16)
+
+// index of a span or a variable in none of the sets
+#define NO_SLOT UINT32_MAX
+
+// ways a statement refers to a variable
+#define REF_DECL 1u
+#define REF_READ 2u
+#define REF_WRITE 4u
+
+typedef struct Span_S Span;
+
+/* A variable a statement refers to */
+typedef struct {
+    StrID var;
+    /* REF_* bits */
+    uint32_t how;
+    /* First node reading the variable, NO_ID if it isn't read */
+    NodeID read;
+    /* Index of the statement in the uses of the variable */
+    uint32_t slot;
+} Ref;
+
+/* A statement of the body of `main` and its text, which runs up to the first
+ * byte of the next statement or of the closing "}" */
+struct Span_S {
+    // treap by position in the body, a heap by `priority`
+    Span *left;
+    Span *right;
+    Span *parent;
+    uint32_t priority;
+
+    // spans and bytes of the subtree, and the line and column its text ends
+    // at when it starts at 1:1
+    uint32_t count;
+    uint32_t bytes;
+    LineCol extent;
+
+    // text of the span alone, owned if an edit parsed it, in `base`
+    // otherwise
+    const char *text;
+    uint32_t len;
+    bool owned;
+    LineCol text_extent;
+
+    // the statement and the first of its nodes, NO_ID if it has syntax
+    // errors. Their locations are those of a source where the text started
+    // at `parsed_at`
+    NodeID stmt;
+    NodeID first;
+    Location parsed_at;
+
+    Status status;
+
+    Ref *refs;
+    uint32_t n_refs;
+    uint32_t refs_capacity;
+
+    // index in `broken` or `errors`, NO_SLOT if in neither
+    uint32_t slot;
+    // edit the span was parsed by, and the last one that checked it
+    uint32_t born;
+    uint32_t checked;
+};
+
+/* What the statements know about a variable */
+typedef struct {
+    // spans referring to it, in no particular order
+    Span **uses;
+    uint32_t n_uses;
+    uint32_t capacity;
+
+    // first span declaring it, and first one reading or writing it
+    Span *decl;
+    Span *touch;
+
+    // parameters are declared and assigned before every statement
+    bool param;
+    Type param_type;
+
+    // index in `uninit` if the first touch reads it, NO_SLOT otherwise
+    uint32_t uninit_slot;
+
+    // last edit that changed its uses, and its declaration before that edit,
+    // which `lost_decl` tells was removed by it
+    uint32_t edit;
+    Span *was_decl;
+    Type was_type;
+    bool lost_decl;
+    bool lost_touch;
+
+    // span collecting its refs, and the index of the ref in it
+    const Span *collecting;
+    uint32_t ref;
+} Name;
+
+typedef struct {
+    Span **data;
+    uint32_t size;
+    uint32_t capacity;
+} SpanSet;
+
+struct Document_S {
+    Ast ast;
+    StrPool strs;
+    TypeTable types;
+    Tokens tokens;
+    Lexer lexer;
+    unsigned threads;
+
+    // scratch: pieces of the source, the scope of a statement and the
+    // diagnostics nobody reads
+    LineIndex piece;
+    SymTable scope;
+    FILE *quiet;
+    char *quiet_buf;
+    size_t quiet_size;
+
+    // source the document was opened with, or last written by
+    // `document_source`, which spans that don't own their text point into
+    char *base;
+    size_t base_len;
+    // whether `base` is the source, there was no edit since
+    bool current;
+    // the source couldn't be split into statements, edits recompile it
+    bool unsplit;
+
+    // text before the first statement, and from the closing "}" on
+    const char *header;
+    uint32_t header_len;
+    LineCol header_extent;
+    const char *footer;
+    uint32_t footer_len;
+
+    Span *spans;
+    NodeID main;
+    Type ret_type;
+    Status params_status;
+
+    // by StrID
+    Name *names;
+    size_t n_names;
+
+    // spans with syntax errors, and spans that don't type check
+    SpanSet broken;
+    SpanSet errors;
+    // variables read before they're assigned
+    StrID *uninit;
+    uint32_t n_uninit;
+    uint32_t uninit_capacity;
+
+    // variables whose uses the current edit changed, and spans it checks
+    StrID *affected;
+    uint32_t n_affected;
+    uint32_t affected_capacity;
+    SpanSet queue;
+
+    // spans holding a `return`, and nodes reachable from `main`
+    size_t rets;
+    size_t live;
+
+    uint32_t edits;
+    uint32_t seed;
+};
+
+//
+// helpers
+//
+
+static bool _reserve(
+    void **data, uint32_t *capacity, size_t size, size_t elem) {
+    if (size < *capacity) {
+        return true;
+    }
+
+    size_t new_capacity = *capacity == 0 ? DEFAULT_CAPACITY : 2 * *capacity;
+    void *dummy = realloc(*data, new_capacity * elem);
+    if (dummy == NULL) {
+        return false;
+    }
+
+    *data = dummy;
+    *capacity = (uint32_t)new_capacity;
+    return true;
+}
+
+static bool _set_add(SpanSet *set, Span *span) {
+    if (!_reserve(
+            (void **)&set->data, &set->capacity, set->size,
+            sizeof(*set->data))) {
+        return false;
+    }
+
+    span->slot = set->size;
+    set->data[set->size++] = span;
+    return true;
+}
+
+// adds `span` to a set that doesn't keep its index, such as the queue
+static bool _push(SpanSet *set, Span *span) {
+    if (!_reserve(
+            (void **)&set->data, &set->capacity, set->size,
+            sizeof(*set->data))) {
+        return false;
+    }
+
+    set->data[set->size++] = span;
+    return true;
+}
+
+static void _set_remove(SpanSet *set, Span *span) {
+    Span *last = set->data[--set->size];
+    set->data[span->slot] = last;
+    last->slot = span->slot;
+    span->slot = NO_SLOT;
+}
+
+// a run of newlines split in two pieces isn't lexed as one
+static inline bool _splits_newline(char before, char after) {
+    return (before == '\n' && after == '\r') ||
+        (before == '\r' && after == '\n');
+}
+
+// where `text` ends if it starts at 1:1
+static LineCol _extent(Document self, const char *text, size_t len) {
+    line_index_reset(self->piece, text, len);
+    return line_index_lookup(self->piece, (Location)len);
+}
+
+// where text ending at `b` when it starts at 1:1 ends if it starts at `a`
+static inline LineCol _compose(LineCol a, LineCol b) {
+    if (b.line == 1) {
+        return (LineCol){ a.line, a.col + b.col - 1 };
+    }
+    return (LineCol){ a.line + b.line - 1, b.col };
+}
+
+// rewound, what was written to it is never read
+static FILE *_quiet(Document self) {
+    rewind(self->quiet);
+    return self->quiet;
+}
+
+static uint32_t _random(Document self) {
+    // xorshift32
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    return self->seed;
+}
+
+//
+// spans
+//
+
+static inline uint32_t _count(const Span *span) {
+    return span == NULL ? 0 : span->count;
+}
+
+static inline uint32_t _bytes(const Span *span) {
+    return span == NULL ? 0 : span->bytes;
+}
+
+static void _pull(Span *span) {
+    span->count = 1;
+    span->bytes = span->len;
+    span->extent = span->text_extent;
+
+    if (span->left != NULL) {
+        span->count += span->left->count;
+        span->bytes += span->left->bytes;
+        span->extent = _compose(span->left->extent, span->extent);
+        span->left->parent = span;
+    }
+    if (span->right != NULL) {
+        span->count += span->right->count;
+        span->bytes += span->right->bytes;
+        span->extent = _compose(span->extent, span->right->extent);
+        span->right->parent = span;
+    }
+}
+
+static Span *_merge(Span *a, Span *b) {
+    if (a == NULL) {
+        return b;
+    }
+    if (b == NULL) {
+        return a;
+    }
+
+    if (a->priority > b->priority) {
+        a->right = _merge(a->right, b);
+        _pull(a);
+        return a;
+    }
+    b->left = _merge(a, b->left);
+    _pull(b);
+    return b;
+}
+
+// the first `k` spans of `span` to `a`, the others to `b`
+static void _split(Span *span, uint32_t k, Span **a, Span **b) {
+    if (span == NULL) {
+        *a = *b = NULL;
+        return;
+    }
+
+    uint32_t left = _count(span->left);
+    if (k <= left) {
+        _split(span->left, k, a, &span->left);
+        _pull(span);
+        *b = span;
+    } else {
+        _split(span->right, k - left - 1, &span->right, b);
+        _pull(span);
+        *a = span;
+    }
+}
+
+static void _pull_all(Span *span) {
+    if (span != NULL) {
+        _pull_all(span->left);
+        _pull_all(span->right);
+        _pull(span);
+    }
+}
+
+// treap of spans in order, by pushing them on its right spine. `stack`
+// holds `n` spans
+static Span *_build(Span **spans, size_t n, Span **stack) {
+    size_t top = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Span *span = spans[i];
+        Span *below = NULL;
+        while (top > 0 && stack[top - 1]->priority < span->priority) {
+            below = stack[--top];
+        }
+
+        span->left = below;
+        span->right = NULL;
+        if (top > 0) {
+            stack[top - 1]->right = span;
+        }
+        stack[top++] = span;
+    }
+
+    if (top == 0) {
+        return NULL;
+    }
+    _pull_all(stack[0]);
+    stack[0]->parent = NULL;
+    return stack[0];
+}
+
+// index of `span` in the body
+static uint32_t _rank(const Span *span) {
+    uint32_t rank = _count(span->left);
+    for (; span->parent != NULL; span = span->parent) {
+        if (span == span->parent->right) {
+            rank += _count(span->parent->left) + 1;
+        }
+    }
+    return rank;
+}
+
+static Span *_leftmost(Span *span) {
+    while (span != NULL && span->left != NULL) {
+        span = span->left;
+    }
+    return span;
+}
+
+static Span *_rightmost(Span *span) {
+    while (span != NULL && span->right != NULL) {
+        span = span->right;
+    }
+    return span;
+}
+
+static Span *_next(Span *span) {
+    if (span->right != NULL) {
+        return _leftmost(span->right);
+    }
+    while (span->parent != NULL && span == span->parent->right) {
+        span = span->parent;
+    }
+    return span->parent;
+}
+
+static Span *_prev(Span *span) {
+    if (span->left != NULL) {
+        return _rightmost(span->left);
+    }
+    while (span->parent != NULL && span == span->parent->left) {
+        span = span->parent;
+    }
+    return span->parent;
+}
+
+// span holding the byte `offset` of the body, its index and the offset of
+// the byte in it. NULL past the last span
+static Span *_find(Span *span, uint32_t offset, uint32_t *rank, uint32_t *in) {
+    *rank = 0;
+    while (span != NULL) {
+        uint32_t left = _bytes(span->left);
+        if (offset < left) {
+            span = span->left;
+            continue;
+        }
+
+        offset -= left;
+        *rank += _count(span->left);
+        if (offset < span->len) {
+            *in = offset;
+            return span;
+        }
+
+        offset -= span->len;
+        *rank += 1;
+        span = span->right;
+    }
+    return NULL;
+}
+
+// location of the first byte of `span` in the source, and its line and
+// column
+static LineCol _locate(const Document self, const Span *span, Location *loc) {
+    uint32_t bytes = _bytes(span->left);
+    LineCol before =
+        span->left != NULL ? span->left->extent : (LineCol){ 1, 1 };
+
+    for (; span->parent != NULL; span = span->parent) {
+        const Span *parent = span->parent;
+        if (span == parent->right) {
+            bytes += _bytes(parent->left) + parent->len;
+            LineCol prefix = parent->left != NULL
+                ? _compose(parent->left->extent, parent->text_extent)
+                : parent->text_extent;
+            before = _compose(prefix, before);
+        }
+    }
+
+    *loc = self->header_len + bytes;
+    return _compose(self->header_extent, before);
+}
+
+// a span for `len` bytes of `text`, copied if `owned`
+static Span *_span_create(
+    Document self, const char *text, uint32_t len, bool owned) {
+    Span *span = (Span *)calloc(1, sizeof(*span));
+    if (span == NULL) {
+        return NULL;
+    }
+
+    if (owned) {
+        char *copy = (char *)malloc(len > 0 ? len : 1);
+        if (copy == NULL) {
+            free(span);
+            return NULL;
+        }
+        memcpy(copy, text, len);
+        text = copy;
+    }
+
+    span->priority = _random(self);
+    span->text = text;
+    span->len = len;
+    span->owned = owned;
+    span->text_extent = _extent(self, text, len);
+    span->stmt = NO_ID;
+    span->first = NO_ID;
+    span->status = Status_OK;
+    span->slot = NO_SLOT;
+    span->born = self->edits;
+    _pull(span);
+    return span;
+}
+
+static void _span_free(Span *span) {
+    if (span->owned) {
+        free((char *)span->text);
+    }
+    free(span->refs);
+    free(span);
+}
+
+static void _free_all(Span *span) {
+    if (span != NULL) {
+        _free_all(span->left);
+        _free_all(span->right);
+        _span_free(span);
+    }
+}
+
+//
+// variables
+//
+
+static Name *_name(Document self, StrID var) {
+    if (var >= self->n_names) {
+        size_t n = self->n_names == 0 ? DEFAULT_CAPACITY : 2 * self->n_names;
+        while (n <= var) {
+            n *= 2;
+        }
+
+        Name *dummy = (Name *)realloc(self->names, n * sizeof(*dummy));
+        if (dummy == NULL) {
+            return NULL;
+        }
+
+        memset(&dummy[self->n_names], 0, (n - self->n_names) * sizeof(*dummy));
+        for (size_t i = self->n_names; i < n; ++i) {
+            dummy[i].uninit_slot = NO_SLOT;
+        }
+        self->names = dummy;
+        self->n_names = n;
+    }
+    return &self->names[var];
+}
+
+static Ref *_ref(const Span *span, StrID var) {
+    for (uint32_t i = 0; i < span->n_refs; ++i) {
+        if (span->refs[i].var == var) {
+            return &span->refs[i];
+        }
+    }
+    return NULL;
+}
+
+static inline Type _decl_type(const Document self, const Span *span) {
+    return self->ast->data[span->stmt].data.DECL.type;
+}
+
+// remembers the declaration the statements saw before the current edit
+static bool _affect(Document self, StrID var) {
+    Name *name = &self->names[var];
+    if (name->edit == self->edits) {
+        return true;
+    }
+
+    if (!_reserve(
+            (void **)&self->affected, &self->affected_capacity,
+            self->n_affected, sizeof(*self->affected))) {
+        return false;
+    }
+
+    self->affected[self->n_affected++] = var;
+    name->edit = self->edits;
+    name->was_decl = name->decl;
+    name->was_type = name->decl != NULL ? _decl_type(self, name->decl) : 0;
+    name->lost_decl = false;
+    name->lost_touch = false;
+    return true;
+}
+
+// first use of the variable that refers to it in one of the `how` ways
+static Span *_first_use(const Name *name, StrID var, uint32_t how) {
+    Span *first = NULL;
+    uint32_t first_rank = 0;
+    for (uint32_t i = 0; i < name->n_uses; ++i) {
+        Span *span = name->uses[i];
+        if ((_ref(span, var)->how & how) == 0) {
+            continue;
+        }
+
+        uint32_t rank = _rank(span);
+        if (first == NULL || rank < first_rank) {
+            first = span;
+            first_rank = rank;
+        }
+    }
+    return first;
+}
+
+// whether `initpass` reports the first touch of the variable
+static bool _update_uninit(Document self, StrID var) {
+    Name *name = &self->names[var];
+    bool uninit = !name->param && name->touch != NULL &&
+        (_ref(name->touch, var)->how & REF_READ) != 0;
+
+    if (uninit && name->uninit_slot == NO_SLOT) {
+        if (!_reserve(
+                (void **)&self->uninit, &self->uninit_capacity,
+                self->n_uninit, sizeof(*self->uninit))) {
+            return false;
+        }
+        name->uninit_slot = self->n_uninit;
+        self->uninit[self->n_uninit++] = var;
+    } else if (!uninit && name->uninit_slot != NO_SLOT) {
+        StrID last = self->uninit[--self->n_uninit];
+        self->uninit[name->uninit_slot] = last;
+        self->names[last].uninit_slot = name->uninit_slot;
+        name->uninit_slot = NO_SLOT;
+    }
+    return true;
+}
+
+//
+// refs
+//
+
+typedef struct {
+    Document doc;
+    Span *span;
+} Collect;
+
+static Status _refs_var(Collect *c, const Ast ast, AstNode *e);
+static Status _refs_declaration(Collect *c, const Ast ast, AstNode *stmt);
+static Status _refs_assignment(Collect *c, const Ast ast, AstNode *stmt);
+
+#define WALK_NAME _refs
+#define WALK_CTX Collect
+#define WALK_VAR _refs_var
+#define WALK_DECL _refs_declaration
+#define WALK_ASGN _refs_assignment
+#include "ast_walk.h"
+
+static Status _add_ref(Collect *c, StrID var, uint32_t how, NodeID read) {
+    Span *span = c->span;
+    Name *name = _name(c->doc, var);
+    if (name == NULL) {
+        return Status_InternalError;
+    }
+
+    if (name->collecting == span) {
+        Ref *ref = &span->refs[name->ref];
+        if (ref->read == NO_ID) {
+            ref->read = read;
+        }
+        ref->how |= how;
+        return Status_OK;
+    }
+
+    if (span->n_refs == span->refs_capacity) {
+        uint32_t capacity =
+            span->refs_capacity == 0 ? 4 : 2 * span->refs_capacity;
+        Ref *dummy = (Ref *)realloc(span->refs, capacity * sizeof(*dummy));
+        if (dummy == NULL) {
+            return Status_InternalError;
+        }
+        span->refs = dummy;
+        span->refs_capacity = capacity;
+    }
+
+    name->collecting = span;
+    name->ref = span->n_refs;
+    span->refs[span->n_refs++] = (Ref){
+        .var = var,
+        .how = how,
+        .read = read,
+        .slot = NO_SLOT,
+    };
+    return Status_OK;
+}
+
+static Status _refs_var(Collect *c, const Ast ast, AstNode *e) {
+    return _add_ref(c, e->data.VAR, REF_READ, (NodeID)(e - ast->data));
+}
+
+static Status _refs_declaration(Collect *c, const Ast ast, AstNode *stmt) {
+    (void)ast;
+    return _add_ref(c, stmt->data.DECL.var, REF_DECL, NO_ID);
+}
+
+static Status _refs_assignment(Collect *c, const Ast ast, AstNode *stmt) {
+    // in the order `initpass` sees them, the value is read first
+    Status s = _refs_expr(c, ast, stmt->data.ASGN.expr);
+    if (s != Status_OK) {
+        return s;
+    }
+    return _add_ref(c, stmt->data.ASGN.var, REF_WRITE, NO_ID);
+}
+
+// the variables the statement of `span` refers to, in the order it reads
+// them
+static Status _collect(Document self, Span *span) {
+    Collect c = { .doc = self, .span = span };
+    Status s = _refs_stmt(&c, self->ast, span->stmt);
+
+    for (uint32_t i = 0; i < span->n_refs; ++i) {
+        self->names[span->refs[i].var].collecting = NULL;
+    }
+    return s;
+}
+
+// adds `span` to the uses of its variables, spans being registered in order
+// within an edit
+static bool _register(Document self, Span *span, bool edit) {
+    for (uint32_t i = 0; i < span->n_refs; ++i) {
+        Ref *ref = &span->refs[i];
+        if (edit && !_affect(self, ref->var)) {
+            return false;
+        }
+
+        Name *name = &self->names[ref->var];
+        if (!_reserve(
+                (void **)&name->uses, &name->capacity, name->n_uses,
+                sizeof(*name->uses))) {
+            return false;
+        }
+        ref->slot = name->n_uses;
+        name->uses[name->n_uses++] = span;
+
+        // spans are registered in order, and the first one removed by an
+        // edit was in their place, before the others
+        if ((ref->how & REF_DECL) != 0 &&
+            (name->decl == NULL ||
+             (edit && !name->lost_decl &&
+              _rank(span) < _rank(name->decl)))) {
+            name->decl = span;
+        }
+        if ((ref->how & (REF_READ | REF_WRITE)) != 0 &&
+            (name->touch == NULL ||
+             (edit && !name->lost_touch &&
+              _rank(span) < _rank(name->touch)))) {
+            name->touch = span;
+        }
+    }
+
+    if (span->stmt != NO_ID) {
+        self->rets += self->ast->data[span->stmt].kind == AstNodeKind_RET;
+        self->live += span->stmt - span->first + 1;
+    }
+    return true;
+}
+
+static bool _unregister(Document self, Span *span) {
+    for (uint32_t i = 0; i < span->n_refs; ++i) {
+        const Ref *ref = &span->refs[i];
+        if (!_affect(self, ref->var)) {
+            return false;
+        }
+
+        Name *name = &self->names[ref->var];
+        Span *last = name->uses[--name->n_uses];
+        name->uses[ref->slot] = last;
+        _ref(last, ref->var)->slot = ref->slot;
+
+        if (name->decl == span) {
+            name->decl = NULL;
+            name->lost_decl = true;
+        }
+        if (name->touch == span) {
+            name->touch = NULL;
+            name->lost_touch = true;
+        }
+    }
+
+    if (span->slot != NO_SLOT) {
+        _set_remove(span->stmt == NO_ID ? &self->broken : &self->errors, span);
+    }
+    if (span->stmt != NO_ID) {
+        self->rets -= self->ast->data[span->stmt].kind == AstNodeKind_RET;
+        self->live -= span->stmt - span->first + 1;
+    }
+    return true;
+}
+
+//
+// checks
+//
+
+// type checks `span` in the scope of the declarations before it
+static Status _check(Document self, Span *span, FILE *diag) {
+    uint32_t rank = _rank(span);
+    for (uint32_t i = 0; i < span->n_refs; ++i) {
+        StrID var = span->refs[i].var;
+        const Name *name = &self->names[var];
+
+        bool ok = true;
+        if (name->param) {
+            ok = symtable_add_symbol(self->scope, var, name->param_type);
+        } else if (name->decl != NULL && _rank(name->decl) < rank) {
+            ok = symtable_add_symbol(
+                self->scope, var, _decl_type(self, name->decl));
+        } else {
+            symtable_remove_symbol(self->scope, var);
+        }
+        if (!ok) {
+            return Status_InternalError;
+        }
+    }
+
+    return sempass_stmt(
+        self->ast, span->stmt, self->strs, self->scope, self->ret_type,
+        self->types, diag);
+}
+
+// keeps the result of checking `span`, and the set of spans with errors
+static bool _set_status(Document self, Span *span, Status status) {
+    span->status = status;
+    span->checked = self->edits;
+
+    if (status != Status_OK && span->slot == NO_SLOT) {
+        return _set_add(&self->errors, span);
+    }
+    if (status == Status_OK && span->slot != NO_SLOT) {
+        _set_remove(&self->errors, span);
+    }
+    return true;
+}
+
+// checks the parameters in order, as `sempass` does before the body
+static Status _check_params(Document self, FILE *diag) {
+    Ast ast = self->ast;
+    NodeID params = ast->data[self->main].data.MAIN.params;
+
+    for (NodeID id = params; id != NO_ID; id = ast->data[id].header.stmt_next) {
+        symtable_remove_symbol(self->scope, ast->data[id].data.DECL.var);
+    }
+
+    Status status = Status_OK;
+    for (NodeID id = params; id != NO_ID; id = ast->data[id].header.stmt_next) {
+        Status s = sempass_stmt(
+            ast, id, self->strs, self->scope, self->ret_type, self->types,
+            diag);
+        if (status == Status_OK) {
+            status = s;
+        }
+    }
+    return status;
+}
+
+typedef struct {
+    uint32_t rank;
+    Span *span;
+} Ranked;
+
+static int _by_rank(const void *lhs, const void *rhs) {
+    const Ranked *a = lhs;
+    const Ranked *b = rhs;
+    return a->rank < b->rank ? -1 : a->rank > b->rank;
+}
+
+// the spans in order, NULL if out of memory
+static Ranked *_sorted(Span *const *spans, uint32_t n) {
+    Ranked *sorted = (Ranked *)malloc((n + 1) * sizeof(*sorted));
+    if (sorted == NULL) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < n; ++i) {
+        sorted[i] = (Ranked){ _rank(spans[i]), spans[i] };
+    }
+    qsort(sorted, n, sizeof(*sorted), _by_rank);
+    return sorted;
+}
+
+// parses the text of a span with syntax errors again, to report them where
+// the span is now
+static Status _report_syntax(Document self, const Span *span, FILE *diag) {
+    Location loc;
+    LineCol start = _locate(self, span, &loc);
+
+    Status s = tokens_lex(
+        self->tokens, span->text, span->len, self->strs, self->lexer, 1,
+        diag);
+    if (s != Status_OK) {
+        return s;
+    }
+
+    size_t size = self->ast->size;
+    NodeID stmt;
+    line_index_reset_at(self->piece, span->text, span->len, start);
+    s = pratt_parse_stmt(
+        self->ast, self->tokens->data, self->tokens->size - 1, self->piece,
+        diag, &stmt);
+    ast_truncate(self->ast, size);
+    return s == Status_SyntaxError ? Status_OK : s;
+}
+
+// same as `initpass`, every variable whose first touch reads it is reported
+// there
+static Status _report_uninit(Document self, FILE *diag) {
+    Span **touches = (Span **)malloc((self->n_uninit + 1) * sizeof(*touches));
+    if (touches == NULL) {
+        return Status_InternalError;
+    }
+    for (uint32_t i = 0; i < self->n_uninit; ++i) {
+        touches[i] = self->names[self->uninit[i]].touch;
+    }
+
+    Ranked *sorted = _sorted(touches, self->n_uninit);
+    free(touches);
+    if (sorted == NULL) {
+        return Status_InternalError;
+    }
+
+    for (uint32_t i = 0; i < self->n_uninit; ++i) {
+        const Span *span = sorted[i].span;
+        if (i > 0 && sorted[i - 1].span == span) {
+            continue;
+        }
+
+        Location loc;
+        LineCol start = _locate(self, span, &loc);
+        line_index_reset_at(self->piece, span->text, span->len, start);
+
+        for (uint32_t r = 0; r < span->n_refs; ++r) {
+            const Ref *ref = &span->refs[r];
+            const Name *name = &self->names[ref->var];
+            if ((ref->how & REF_READ) == 0 || name->param ||
+                name->touch != span) {
+                continue;
+            }
+
+            Location at = self->ast->data[ref->read].loc - span->parsed_at;
+            LineCol pos = line_index_lookup(self->piece, at);
+            fprintf(diag, "%u:%u: ", pos.line, pos.col);
+            error_msg(
+                diag, Status_UninitSymbol, str_pool_get(self->strs, ref->var));
+        }
+    }
+
+    free(sorted);
+    return Status_UninitSymbol;
+}
+
+// prints the diagnostics of the whole program, in the order compiling it
+// would
+static Status _report(Document self, FILE *diag) {
+    if (self->broken.size > 0) {
+        Ranked *sorted = _sorted(self->broken.data, self->broken.size);
+        if (sorted == NULL) {
+            return Status_InternalError;
+        }
+
+        Status s = Status_OK;
+        for (uint32_t i = 0; i < self->broken.size && s == Status_OK; ++i) {
+            s = _report_syntax(self, sorted[i].span, diag);
+        }
+        free(sorted);
+        return s == Status_OK ? Status_SyntaxError : s;
+    }
+
+    if (self->params_status != Status_OK) {
+        return _check_params(self, diag);
+    }
+
+    if (self->errors.size > 0) {
+        Ranked *sorted = _sorted(self->errors.data, self->errors.size);
+        if (sorted == NULL) {
+            return Status_InternalError;
+        }
+
+        for (uint32_t i = 0; i < self->errors.size; ++i) {
+            _check(self, sorted[i].span, diag);
+        }
+        Status s = sorted[0].span->status;
+        free(sorted);
+        return s;
+    }
+
+    if (self->ret_type != Type_VOID && self->rets == 0) {
+        error_msg(diag, Status_MissingReturn, "");
+        return Status_MissingReturn;
+    }
+
+    if (self->n_uninit > 0) {
+        return _report_uninit(self, diag);
+    }
+    return Status_OK;
+}
+
+//
+// constructor & destructor
+//
+
+Document document_initialize(
+    Ast ast,
+    StrPool strs,
+    TypeTable types,
+    Tokens tokens) {
+    Document self = (Document)calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->ast = ast;
+    self->strs = strs;
+    self->types = types;
+    self->tokens = tokens;
+    self->lexer = Lexer_FLEX;
+    self->threads = 1;
+    self->main = NO_ID;
+    self->seed = 0x9e3779b9;
+    self->piece = line_index_initialize();
+    self->scope = symtable_initialize();
+    self->quiet = open_memstream(&self->quiet_buf, &self->quiet_size);
+
+    if (self->piece == NULL || self->scope == NULL || self->quiet == NULL) {
+        document_release(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void document_release(Document self) {
+    if (self == NULL) {
+        return;
+    }
+
+    document_clear(self);
+    free(self->names);
+    free(self->broken.data);
+    free(self->errors.data);
+    free(self->uninit);
+    free(self->affected);
+    free(self->queue.data);
+    line_index_release(self->piece);
+    if (self->scope != NULL) {
+        symtable_release(self->scope);
+    }
+    if (self->quiet != NULL) {
+        fclose(self->quiet);
+    }
+    free(self->quiet_buf);
+    free(self);
+}
+
+void document_clear(Document self) {
+    _free_all(self->spans);
+    self->spans = NULL;
+
+    for (size_t i = 0; i < self->n_names; ++i) {
+        free(self->names[i].uses);
+    }
+    free(self->names);
+    self->names = NULL;
+    self->n_names = 0;
+
+    free(self->base);
+    self->base = NULL;
+    self->base_len = 0;
+    self->current = true;
+    self->unsplit = false;
+    self->header = self->footer = NULL;
+    self->header_len = self->footer_len = 0;
+    self->main = NO_ID;
+    self->params_status = Status_OK;
+    self->broken.size = 0;
+    self->errors.size = 0;
+    self->n_uninit = 0;
+    self->n_affected = 0;
+    self->queue.size = 0;
+    self->rets = 0;
+    self->live = 0;
+}
+
+//
+// compiling
+//
+
+// parses the statement of `span` from `n` tokens, its nodes located as if
+// its text started at `parsed_at`
+static Status _parse_span(
+    Document self, Span *span, const Token *tokens, size_t n,
+    Location parsed_at) {
+    span->first = (NodeID)self->ast->size;
+    span->parsed_at = parsed_at;
+
+    Status s = pratt_parse_stmt(
+        self->ast, tokens, n, self->piece, _quiet(self), &span->stmt);
+    if (s == Status_SyntaxError) {
+        // partial expressions aren't left behind
+        ast_truncate(self->ast, span->first);
+        span->first = NO_ID;
+        return _set_add(&self->broken, span) ? Status_OK
+                                              : Status_InternalError;
+    }
+    if (s != Status_OK) {
+        return s;
+    }
+    return _collect(self, span);
+}
+
+// chains the statements of `spans` to those around them, `before` and
+// `after` being the spans around the edit, NULL at the ends of the body
+static void _link(
+    Document self, Span *before, Span **spans, size_t n, Span *after) {
+    Ast ast = self->ast;
+    while (before != NULL && before->stmt == NO_ID) {
+        before = _prev(before);
+    }
+    while (after != NULL && after->stmt == NO_ID) {
+        after = _next(after);
+    }
+
+    NodeID *link = before != NULL ? &ast->data[before->stmt].header.stmt_next
+                                  : &ast->data[self->main].data.MAIN.body;
+    for (size_t i = 0; i < n; ++i) {
+        if (spans[i]->stmt != NO_ID) {
+            *link = spans[i]->stmt;
+            link = &ast->data[spans[i]->stmt].header.stmt_next;
+        }
+    }
+    *link = after != NULL ? after->stmt : NO_ID;
+}
+
+// parses and checks the whole source from `base`
+static Status _open(Document self, FILE *diag) {
+    const char *src = self->base;
+    size_t len = self->base_len;
+
+    Status s = tokens_lex(
+        self->tokens, src, len, self->strs, self->lexer, self->threads,
+        diag);
+    if (s != Status_OK) {
+        return s;
+    }
+
+    line_index_reset(self->piece, src, len);
+    size_t body;
+    s = pratt_parse_main(
+        self->ast, self->tokens, self->piece, diag, &self->main, &body);
+    if (s != Status_OK) {
+        self->unsplit = true;
+        return s;
+    }
+    self->ret_type = self->ast->data[self->main].data.MAIN.ret_type;
+
+    // statements until the closing "}", each through its first ";", even
+    // past a "}" within it
+    const Token *tok = &self->tokens->data[body];
+    size_t n = 0;
+    for (const Token *t = tok; t->kind != YYEOF; ++t) {
+        n += t->kind == TOK_SEMICOLON;
+    }
+    Span **spans = (Span **)malloc((n + 1) * sizeof(*spans));
+    if (spans == NULL) {
+        return Status_InternalError;
+    }
+
+    size_t live = self->ast->size;
+    n = 0;
+    while (s == Status_OK && tok->kind != TOK_RCURLY) {
+        const Token *semi = tok;
+        while (semi->kind != TOK_SEMICOLON && semi->kind != YYEOF) {
+            ++semi;
+        }
+        if (tok->kind == YYEOF || semi->kind == YYEOF) {
+            break;
+        }
+
+        Span *span = _span_create(
+            self, src + tok->loc, semi[1].loc - tok->loc, false);
+        if (span == NULL) {
+            s = Status_InternalError;
+            break;
+        }
+        spans[n++] = span;
+        s = _parse_span(self, span, tok, semi - tok + 1, tok->loc);
+        tok = semi + 1;
+    }
+
+    if (s != Status_OK || tok->kind != TOK_RCURLY) {
+        for (size_t i = 0; i < n; ++i) {
+            _span_free(spans[i]);
+        }
+        free(spans);
+        self->broken.size = 0;
+        if (s != Status_OK) {
+            return s;
+        }
+
+        // the body never ends, the whole program reports it
+        self->unsplit = true;
+        ast_clear(self->ast);
+        line_index_reset(self->piece, src, len);
+        NodeID root;
+        return pratt_parse(self->ast, self->tokens, self->piece, diag, &root);
+    }
+
+    Location body_at = n > 0 ? (Location)(spans[0]->text - src) : tok->loc;
+    self->header = src;
+    self->header_len = body_at;
+    self->header_extent = _extent(self, src, body_at);
+    self->footer = src + tok->loc;
+    self->footer_len = (uint32_t)(len - tok->loc);
+
+    Span **stack = (Span **)malloc((n + 1) * sizeof(*stack));
+    if (stack == NULL) {
+        for (size_t i = 0; i < n; ++i) {
+            _span_free(spans[i]);
+        }
+        free(spans);
+        return Status_InternalError;
+    }
+    self->spans = _build(spans, n, stack);
+    free(stack);
+    _link(self, NULL, spans, n, NULL);
+
+    // parameters are declared and written before the body
+    Ast ast = self->ast;
+    for (NodeID id = ast->data[self->main].data.MAIN.params; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        Name *name = _name(self, ast->data[id].data.DECL.var);
+        if (name == NULL) {
+            s = Status_InternalError;
+            break;
+        }
+        if (!name->param) {
+            name->param = true;
+            name->param_type = ast->data[id].data.DECL.type;
+        }
+    }
+
+    self->live = live;
+    for (size_t i = 0; i < n && s == Status_OK; ++i) {
+        if (!_register(self, spans[i], false)) {
+            s = Status_InternalError;
+        }
+    }
+    for (size_t var = 0; var < self->n_names && s == Status_OK; ++var) {
+        if (!_update_uninit(self, (StrID)var)) {
+            s = Status_InternalError;
+        }
+    }
+
+    // the body is checked in order with a scope of its own, as `sempass`
+    // does
+    SymTable scope = symtable_initialize();
+    if (s == Status_OK && scope == NULL) {
+        s = Status_InternalError;
+    }
+    if (s == Status_OK) {
+        SymTable shared = self->scope;
+        self->scope = scope;
+        self->params_status = _check_params(self, _quiet(self));
+        self->scope = shared;
+    }
+    for (size_t i = 0; i < n && s == Status_OK; ++i) {
+        if (spans[i]->stmt == NO_ID) {
+            continue;
+        }
+
+        Status checked = sempass_stmt(
+            ast, spans[i]->stmt, self->strs, scope, self->ret_type,
+            self->types, _quiet(self));
+        if (checked == Status_InternalError ||
+            !_set_status(self, spans[i], checked)) {
+            s = Status_InternalError;
+        }
+    }
+    if (scope != NULL) {
+        symtable_release(scope);
+    }
+
+    free(spans);
+    return s != Status_OK ? s : _report(self, diag);
+}
+
+Status document_open(
+    Document self,
+    const char *src,
+    size_t len,
+    Lexer lexer,
+    unsigned threads,
+    FILE *diag) {
+    document_clear(self);
+    ast_clear(self->ast);
+    type_table_clear(self->types);
+    self->lexer = lexer;
+    self->threads = threads;
+
+    // locations are 32-bit offsets
+    if (len > UINT32_MAX) {
+        fputs("source too large, it must be under 4 GiB\n", diag);
+        return Status_InternalError;
+    }
+
+    self->base = (char *)malloc(len > 0 ? len : 1);
+    if (self->base == NULL) {
+        return Status_InternalError;
+    }
+    memcpy(self->base, src, len);
+    self->base_len = len;
+
+    Status s = _open(self, diag);
+    if (s == Status_InternalError) {
+        document_clear(self);
+    }
+    return s;
+}
+
+//
+// editing
+//
+
+// size of the source with every edit applied
+static size_t _size(const Document self) {
+    if (self->unsplit) {
+        return self->base_len;
+    }
+    return self->header_len + _bytes(self->spans) + self->footer_len;
+}
+
+// writes the source to `out`, which holds `_size` bytes, pointing the spans
+// to it if `rebase`
+static void _write(Document self, char *out, bool rebase) {
+    if (self->unsplit) {
+        memcpy(out, self->base, self->base_len);
+        return;
+    }
+
+    memcpy(out, self->header, self->header_len);
+    size_t at = self->header_len;
+    for (Span *span = _leftmost(self->spans); span != NULL;
+         span = _next(span)) {
+        memcpy(out + at, span->text, span->len);
+        if (rebase) {
+            if (span->owned) {
+                free((char *)span->text);
+                span->owned = false;
+            }
+            span->text = out + at;
+        }
+        at += span->len;
+    }
+    memcpy(out + at, self->footer, self->footer_len);
+
+    if (rebase) {
+        self->header = out;
+        self->footer = out + at;
+    }
+}
+
+// the region of the body from the span `first` through `last`, with the
+// edit applied, parsed into new spans
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+    char *text;
+    size_t len;
+    Span **spans;
+    size_t n;
+} Region;
+
+// the text of the spans `first` through `last`
+static bool _region_text(Region *region, Span *first) {
+    size_t len = 0;
+    Span *span = first;
+    for (uint32_t i = region->first; i <= region->last; ++i) {
+        len += span->len;
+        span = _next(span);
+    }
+
+    char *text = (char *)malloc(len > 0 ? len : 1);
+    if (text == NULL) {
+        return false;
+    }
+
+    len = 0;
+    span = first;
+    for (uint32_t i = region->first; i <= region->last; ++i) {
+        memcpy(text + len, span->text, span->len);
+        len += span->len;
+        span = _next(span);
+    }
+
+    free(region->text);
+    region->text = text;
+    region->len = len;
+    return true;
+}
+
+typedef enum {
+    /* The region holds whole statements */
+    Cut_OK,
+    /* Its last statement runs past it, or it splits a newline at its end */
+    Cut_NEXT,
+    /* It splits a newline at its start, or holds text but no statement */
+    Cut_PREV,
+    /* It holds the end of the body, or splits a newline with the header */
+    Cut_WHOLE,
+} Cut;
+
+// checks that the tokens of the region make whole statements
+static Cut _cut(const Document self, const Region *region, Span *first) {
+    Span *prev = _prev(first);
+    char before = prev != NULL ? prev->text[prev->len - 1]
+                               : self->header[self->header_len - 1];
+    if (region->len > 0 && _splits_newline(before, region->text[0])) {
+        return prev != NULL ? Cut_PREV : Cut_WHOLE;
+    }
+
+    const Token *tok = self->tokens->data;
+    bool statements = false;
+    while (tok->kind != YYEOF) {
+        if (tok->kind == TOK_RCURLY) {
+            return Cut_WHOLE;
+        }
+        while (tok->kind != TOK_SEMICOLON && tok->kind != YYEOF) {
+            ++tok;
+        }
+        if (tok->kind == YYEOF) {
+            return Cut_NEXT;
+        }
+        statements = true;
+        ++tok;
+    }
+
+    if (region->len > 0 && !statements) {
+        return Cut_PREV;
+    }
+    return Cut_OK;
+}
+
+// lexes and parses the region, growing it until it holds whole statements.
+// false if the edit must recompile the whole source
+static bool _reparse(
+    Document self, Region *region, Span **first, Status *s) {
+    for (;;) {
+        *s = tokens_lex(
+            self->tokens, region->text, region->len, self->strs, self->lexer,
+            1, NULL);
+        if (*s != Status_OK) {
+            return false;
+        }
+
+        Cut cut = _cut(self, region, *first);
+        Span *last = NULL;
+        if (cut == Cut_OK && region->last + 1 < self->spans->count) {
+            // the text after the region is left as it was
+            last = *first;
+            for (uint32_t i = region->first; i < region->last; ++i) {
+                last = _next(last);
+            }
+            Span *next = _next(last);
+            if (region->len > 0 &&
+                _splits_newline(region->text[region->len - 1], next->text[0])) {
+                cut = Cut_NEXT;
+            }
+        }
+
+        if (cut == Cut_WHOLE) {
+            return false;
+        }
+        if (cut == Cut_PREV && region->first == 0) {
+            cut = Cut_NEXT;
+        }
+        if (cut == Cut_NEXT && region->last + 1 >= self->spans->count) {
+            return false;
+        }
+
+        if (cut == Cut_OK) {
+            break;
+        }
+
+        // grows the region by a span, keeping the edit
+        Span *span = cut == Cut_PREV ? _prev(*first) : NULL;
+        if (cut == Cut_NEXT) {
+            span = *first;
+            for (uint32_t i = region->first; i <= region->last; ++i) {
+                span = _next(span);
+            }
+        }
+
+        char *text = (char *)malloc(region->len + span->len);
+        if (text == NULL) {
+            *s = Status_InternalError;
+            return false;
+        }
+        if (cut == Cut_PREV) {
+            memcpy(text, span->text, span->len);
+            memcpy(text + span->len, region->text, region->len);
+            *first = span;
+            --region->first;
+        } else {
+            memcpy(text, region->text, region->len);
+            memcpy(text + region->len, span->text, span->len);
+            ++region->last;
+        }
+        free(region->text);
+        region->text = text;
+        region->len += span->len;
+    }
+
+    // one span per statement, the first one from the start of the region
+    const Token *tok = self->tokens->data;
+    size_t n = 0;
+    for (const Token *t = tok; t->kind != YYEOF; ++t) {
+        n += t->kind == TOK_SEMICOLON;
+    }
+    region->spans = (Span **)malloc((n + 1) * sizeof(*region->spans));
+    if (region->spans == NULL) {
+        *s = Status_InternalError;
+        return false;
+    }
+
+    while (tok->kind != YYEOF) {
+        const Token *semi = tok;
+        while (semi->kind != TOK_SEMICOLON) {
+            ++semi;
+        }
+
+        Location start = region->n == 0 ? 0 : tok->loc;
+        Location end = semi[1].kind == YYEOF ? (Location)region->len
+                                             : semi[1].loc;
+        Span *span =
+            _span_create(self, region->text + start, end - start, true);
+        if (span == NULL) {
+            *s = Status_InternalError;
+            return false;
+        }
+        region->spans[region->n++] = span;
+
+        *s = _parse_span(self, span, tok, semi - tok + 1, start);
+        if (*s != Status_OK) {
+            return false;
+        }
+        tok = semi + 1;
+    }
+    return true;
+}
+
+// rechecks the new spans and the uses of the variables whose declaration
+// changed
+static Status _recheck(Document self, Region *region) {
+    SpanSet *queue = &self->queue;
+    queue->size = 0;
+
+    for (size_t i = 0; i < region->n; ++i) {
+        Span *span = region->spans[i];
+        if (span->stmt != NO_ID && !_push(queue, span)) {
+            return Status_InternalError;
+        }
+    }
+
+    for (uint32_t i = 0; i < self->n_affected; ++i) {
+        StrID var = self->affected[i];
+        Name *name = &self->names[var];
+
+        if (name->lost_decl && name->decl == NULL) {
+            name->decl = _first_use(name, var, REF_DECL);
+        }
+        if (name->lost_touch && name->touch == NULL) {
+            name->touch = _first_use(name, var, REF_READ | REF_WRITE);
+        }
+        if (!_update_uninit(self, var)) {
+            return Status_InternalError;
+        }
+
+        // a declaration replaced by an edit of its own statement changes
+        // nothing for the statements around it
+        bool changed = name->lost_decl
+            ? name->decl == NULL || name->decl->born != self->edits ||
+                _decl_type(self, name->decl) != name->was_type
+            : name->decl != name->was_decl;
+        if (!changed) {
+            continue;
+        }
+
+        for (uint32_t u = 0; u < name->n_uses; ++u) {
+            Span *span = name->uses[u];
+            if (span->born != self->edits && span->checked != self->edits) {
+                span->checked = self->edits;
+                if (!_push(queue, span)) {
+                    return Status_InternalError;
+                }
+            }
+        }
+    }
+
+    return Status_OK;
+}
+
+static Status _edit(
+    Document self,
+    size_t offset,
+    size_t removed,
+    const char *text,
+    size_t len,
+    bool *whole) {
+    *whole = true;
+    uint32_t body_len = _bytes(self->spans);
+    if (self->unsplit || self->spans == NULL || offset < self->header_len ||
+        offset + removed > self->header_len + body_len) {
+        return Status_OK;
+    }
+
+    // every span the edit touches, those it starts or ends next to included
+    uint32_t from = (uint32_t)(offset - self->header_len);
+    uint32_t to = (uint32_t)(from + removed);
+    uint32_t last_rank = self->spans->count - 1;
+
+    Region region = { 0 };
+    uint32_t in_first, in_last;
+    Span *first = _find(self->spans, from, &region.first, &in_first);
+    if (first == NULL) {
+        first = _rightmost(self->spans);
+        region.first = last_rank;
+        in_first = first->len;
+    } else if (in_first == 0 && region.first > 0) {
+        first = _prev(first);
+        --region.first;
+        in_first = first->len;
+    }
+    if (_find(self->spans, to, &region.last, &in_last) == NULL) {
+        region.last = last_rank;
+    }
+
+    Status s = Status_InternalError;
+    if (!_region_text(&region, first)) {
+        return s;
+    }
+
+    // the edit, in the text of the region
+    size_t head = in_first;
+    size_t tail = region.len - (to - (from - in_first));
+    char *edited = (char *)malloc(head + len + tail + 1);
+    if (edited == NULL) {
+        free(region.text);
+        return s;
+    }
+    memcpy(edited, region.text, head);
+    memcpy(edited + head, text, len);
+    memcpy(edited + head + len, region.text + region.len - tail, tail);
+    free(region.text);
+    region.text = edited;
+    region.len = head + len + tail;
+
+    size_t size = self->ast->size;
+    Span **stack = NULL;
+    if (_reparse(self, &region, &first, &s)) {
+        stack = (Span **)malloc((region.n + 1) * sizeof(*stack));
+        if (stack == NULL) {
+            s = Status_InternalError;
+        }
+    }
+    if (stack == NULL) {
+        // the document is left as it was
+        for (size_t i = 0; i < region.n; ++i) {
+            Span *span = region.spans[i];
+            if (span->slot != NO_SLOT) {
+                _set_remove(&self->broken, span);
+            }
+            _span_free(span);
+        }
+        free(region.spans);
+        free(region.text);
+        ast_truncate(self->ast, size);
+        return s;
+    }
+    *whole = false;
+
+    // the old spans leave, the new ones take their place
+    Span *span = first;
+    for (uint32_t i = region.first; i <= region.last && s == Status_OK; ++i) {
+        if (!_unregister(self, span)) {
+            s = Status_InternalError;
+        }
+        span = _next(span);
+    }
+
+    Span *before, *old, *after;
+    _split(self->spans, region.first, &before, &after);
+    if (after != NULL) {
+        after->parent = NULL;
+    }
+    _split(after, region.last - region.first + 1, &old, &after);
+    if (before != NULL) {
+        before->parent = NULL;
+    }
+    if (after != NULL) {
+        after->parent = NULL;
+    }
+
+    Span *spans = _build(region.spans, region.n, stack);
+    free(stack);
+
+    _link(self, _rightmost(before), region.spans, region.n, _leftmost(after));
+    self->spans = _merge(_merge(before, spans), after);
+    if (self->spans != NULL) {
+        self->spans->parent = NULL;
+    }
+    _free_all(old);
+
+    for (size_t i = 0; i < region.n && s == Status_OK; ++i) {
+        if (!_register(self, region.spans[i], true)) {
+            s = Status_InternalError;
+        }
+    }
+    if (s == Status_OK) {
+        s = _recheck(self, &region);
+    }
+
+    SpanSet *queue = &self->queue;
+    for (uint32_t i = 0; i < queue->size && s == Status_OK; ++i) {
+        Span *checked = queue->data[i];
+        Status status = _check(self, checked, _quiet(self));
+        if (status == Status_InternalError ||
+            !_set_status(self, checked, status)) {
+            s = Status_InternalError;
+        }
+    }
+
+    free(region.spans);
+    free(region.text);
+    return s;
+}
+
+Status document_edit(
+    Document self,
+    size_t offset,
+    size_t removed,
+    const char *text,
+    size_t len,
+    FILE *diag) {
+    size_t size = _size(self);
+    if (offset > size || removed > size - offset ||
+        size - removed + len > UINT32_MAX) {
+        return Status_InternalError;
+    }
+    // `memcpy` takes no NULL pointers, not even for 0 bytes
+    if (len == 0) {
+        text = "";
+    }
+
+    ++self->edits;
+    self->n_affected = 0;
+    self->current = false;
+
+    bool whole;
+    Status s = _edit(self, offset, removed, text, len, &whole);
+    if (s == Status_OK && !whole &&
+        self->ast->size > MIN_GARBAGE && self->ast->size > 2 * self->live) {
+        // nodes of replaced statements pile up, they go away with the rest
+        whole = true;
+        size = _size(self);
+        offset = removed = len = 0;
+    }
+
+    if (s == Status_OK && whole) {
+        char *src = (char *)malloc(size - removed + len + 1);
+        if (src == NULL) {
+            document_clear(self);
+            return Status_InternalError;
+        }
+
+        char *current = (char *)malloc(size + 1);
+        if (current == NULL) {
+            free(src);
+            document_clear(self);
+            return Status_InternalError;
+        }
+        _write(self, current, false);
+        memcpy(src, current, offset);
+        memcpy(src + offset, text, len);
+        memcpy(src + offset + len, current + offset + removed,
+               size - offset - removed);
+        free(current);
+
+        Lexer lexer = self->lexer;
+        unsigned threads = self->threads;
+        document_clear(self);
+        ast_clear(self->ast);
+        type_table_clear(self->types);
+        self->lexer = lexer;
+        self->threads = threads;
+        self->base = src;
+        self->base_len = size - removed + len;
+        s = _open(self, diag);
+        if (s == Status_InternalError) {
+            document_clear(self);
+        }
+        return s;
+    }
+
+    if (s != Status_OK) {
+        document_clear(self);
+        return s;
+    }
+    return _report(self, diag);
+}
+
+NodeID document_root(const Document self) {
+    // statements with syntax errors are left out of the body, as by the parsers
+    return self->unsplit ? NO_ID : self->main;
+}
+
+const char *document_source(Document self, size_t *len) {
+    *len = _size(self);
+    if (self->current) {
+        return self->base != NULL ? self->base : "";
+    }
+
+    char *src = (char *)malloc(*len + 1);
+    if (src == NULL) {
+        return NULL;
+    }
+    _write(self, src, true);
+
+    // the nodes of every statement are moved to where it is now
+    Location at = self->header_len;
+    for (Span *span = _leftmost(self->spans); span != NULL;
+         span = _next(span)) {
+        if (span->stmt != NO_ID && span->parsed_at != at) {
+            for (NodeID id = span->first; id <= span->stmt; ++id) {
+                self->ast->data[id].loc += at - span->parsed_at;
+            }
+        }
+        span->parsed_at = at;
+        at += span->len;
+    }
+
+    free(self->base);
+    self->base = src;
+    self->base_len = *len;
+    self->current = true;
+    return src;
+}
@@ -0,0 +1,246 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "image.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bytecode.h"
+#include "error.h"
+
+// sections start at multiples of it
+#define ALIGNMENT 16
+
+static const char MAGIC[4] = { '\x7f', 'P', 'C', 'B' };
+
+// read back as another value on a machine of the other byte order
+#define BYTE_ORDER_MARK 0x01020304u
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t ret_type;
+
+    uint32_t params;
+    uint32_t slots;
+    uint32_t stack;
+    uint32_t stmts;
+
+    // offsets from the start of the file, and number of elements
+    uint64_t code_offset;
+    uint64_t code_size;
+    uint64_t consts_offset;
+    uint64_t n_consts;
+    // `slots` elements
+    uint64_t slot_info_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+} ImageHeader;
+
+struct Image_S {
+    void *base;
+    size_t size;
+    Chunk chunk;
+};
+
+//
+// writing
+//
+
+static inline uint64_t _align(uint64_t offset) {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// pads from `*pos` up to `offset`, then writes the section
+static bool _write_section(
+    FILE *out, uint64_t *pos, uint64_t offset, const void *data, size_t size) {
+    static const char ZEROS[ALIGNMENT] = { 0 };
+
+    size_t padding = (size_t)(offset - *pos);
+    if (fwrite(ZEROS, 1, padding, out) != padding) {
+        return false;
+    }
+    if (size > 0 && fwrite(data, 1, size, out) != size) {
+        return false;
+    }
+
+    *pos = offset + size;
+    return true;
+}
+
+Status image_write(const Chunk *chunk, FILE *out) {
+    ImageHeader h = {
+        .version = IMAGE_VERSION,
+        .byte_order = BYTE_ORDER_MARK,
+        .ret_type = chunk->ret_type,
+        .params = chunk->params,
+        .slots = chunk->slots,
+        .stack = chunk->stack,
+        .stmts = chunk->stmts,
+        .code_size = chunk->size,
+        .n_consts = chunk->n_consts,
+        .strings_size = chunk->strings_size,
+    };
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+
+    size_t code_bytes = chunk->size * sizeof(*chunk->code);
+    size_t consts_bytes = chunk->n_consts * sizeof(*chunk->consts);
+    size_t slot_info_bytes = chunk->slots * sizeof(*chunk->slot_info);
+
+    h.code_offset = _align(sizeof(h));
+    h.consts_offset = _align(h.code_offset + code_bytes);
+    h.slot_info_offset = _align(h.consts_offset + consts_bytes);
+    h.strings_offset = _align(h.slot_info_offset + slot_info_bytes);
+
+    uint64_t pos = 0;
+    bool ok = _write_section(out, &pos, 0, &h, sizeof(h)) &&
+        _write_section(out, &pos, h.code_offset, chunk->code, code_bytes) &&
+        _write_section(
+            out, &pos, h.consts_offset, chunk->consts, consts_bytes) &&
+        _write_section(
+            out, &pos, h.slot_info_offset, chunk->slot_info, slot_info_bytes) &&
+        _write_section(
+            out, &pos, h.strings_offset, chunk->strings, chunk->strings_size);
+
+    if (!ok || fflush(out) != 0) {
+        return Status_InternalError;
+    }
+    return Status_OK;
+}
+
+//
+// loading
+//
+
+// points `*section` at `count` elements of `size` bytes at `offset`, false if
+// they aren't aligned or don't fit in the file
+static bool _section(
+    const Image self,
+    uint64_t offset,
+    uint64_t count,
+    size_t size,
+    const void **section) {
+    if (offset % ALIGNMENT != 0 || offset > self->size ||
+        count > (self->size - offset) / size) {
+        return false;
+    }
+
+    *section = (const char *)self->base + offset;
+    return true;
+}
+
+// fills the chunk from the header, NULL if the image is valid, what's wrong
+// with it otherwise
+static const char *_load(Image self) {
+    const ImageHeader *h = self->base;
+    if (self->size < sizeof(*h) ||
+        memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        return "not a precc image";
+    }
+    if (h->byte_order != BYTE_ORDER_MARK) {
+        return "image written on a machine of another byte order";
+    }
+    if (h->version != IMAGE_VERSION) {
+        return "image of another version of precc, compile it again";
+    }
+
+    Chunk *chunk = &self->chunk;
+    const void *code, *consts, *slot_info, *strings;
+    if (!_section(self, h->code_offset, h->code_size, sizeof(Insn), &code) ||
+        !_section(
+            self, h->consts_offset, h->n_consts, sizeof(int64_t), &consts) ||
+        !_section(
+            self,
+            h->slot_info_offset,
+            h->slots,
+            sizeof(SlotInfo),
+            &slot_info) ||
+        !_section(self, h->strings_offset, h->strings_size, 1, &strings)) {
+        return "truncated image";
+    }
+
+    *chunk = (Chunk){
+        .code = code,
+        .size = h->code_size,
+        .consts = consts,
+        .n_consts = h->n_consts,
+        .params = h->params,
+        .slots = h->slots,
+        .stack = h->stack,
+        .stmts = h->stmts,
+        .ret_type = (Type)h->ret_type,
+        .slot_info = slot_info,
+        .strings = strings,
+        .strings_size = h->strings_size,
+    };
+    return bytecode_verify(chunk);
+}
+
+Image image_open(const char *path, FILE *diag) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(diag, "%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(diag, "%s: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(ImageHeader)) {
+        fprintf(diag, "%s: not a precc image\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(diag, "%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    Image self = (Image)calloc(1, sizeof(*self));
+    if (self == NULL) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+    self->base = base;
+    self->size = st.st_size;
+
+    const char *error = _load(self);
+    if (error != NULL) {
+        fprintf(diag, "%s: %s\n", path, error);
+        image_close(self);
+        return NULL;
+    }
+    return self;
+}
+
+void image_close(Image self) {
+    if (self == NULL) {
+        return;
+    }
+
+    munmap(self->base, self->size);
+    free(self);
+}
+
+//
+// getters
+//
+
+const Chunk *image_chunk(const Image self) {
+    return &self->chunk;
+}
@@ -0,0 +1,217 @@
+#include "initpass.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "error.h"
+#include "line_index.h"
+#include "sempass.h"
+#include "stats.h"
+#include "str_pool.h"
+
+#define DEFAULT_CAPACITY 64
+
+typedef struct {
+    StrPool strs;
+    LineIndex lines;
+    FILE *diag;
+    size_t dispatches;
+
+    // bit `id` is set once the variable with StrID `id` holds a value, StrIDs
+    // are dense so it takes a bit per identifier
+    uint64_t *assigned;
+    size_t capacity;
+} Context;
+
+static Status _init_var(Context *ctx, const Ast ast, AstNode *e);
+static Status _init_declaration(Context *ctx, const Ast ast, AstNode *stmt);
+static Status _init_assignment(Context *ctx, const Ast ast, AstNode *stmt);
+static Status _init_main(Context *ctx, const Ast ast, AstNode *stmt);
+
+#define WALK_NAME _init
+#define WALK_CTX Context
+#define WALK_ON_DISPATCH(ctx) (++(ctx)->dispatches)
+#define WALK_VAR _init_var
+#define WALK_DECL _init_declaration
+#define WALK_ASGN _init_assignment
+#define WALK_MAIN _init_main
+#include "ast_walk.h"
+
+//
+// helpers
+//
+
+static bool _is_assigned(const Context *ctx, StrID id) {
+    size_t word = id / 64;
+    return word < ctx->capacity &&
+        (ctx->assigned[word] & ((uint64_t)1 << (id % 64))) != 0;
+}
+
+static Status _set_assigned(Context *ctx, StrID id, bool assigned) {
+    size_t word = id / 64;
+    if (word >= ctx->capacity) {
+        if (!assigned) {
+            return Status_OK;
+        }
+
+        size_t capacity =
+            ctx->capacity == 0 ? DEFAULT_CAPACITY : 2 * ctx->capacity;
+        while (capacity <= word) {
+            capacity *= 2;
+        }
+
+        uint64_t *dummy =
+            (uint64_t *)realloc(ctx->assigned, capacity * sizeof(*dummy));
+        if (dummy == NULL) {
+            return Status_InternalError;
+        }
+
+        for (size_t i = ctx->capacity; i < capacity; ++i) {
+            dummy[i] = 0;
+        }
+        ctx->assigned = dummy;
+        ctx->capacity = capacity;
+    }
+
+    uint64_t bit = (uint64_t)1 << (id % 64);
+    if (assigned) {
+        ctx->assigned[word] |= bit;
+    } else {
+        ctx->assigned[word] &= ~bit;
+    }
+    return Status_OK;
+}
+
+//
+// checks
+//
+
+static Status _init_var(Context *ctx, const Ast ast, AstNode *e) {
+    (void)ast;
+    if (_is_assigned(ctx, e->data.VAR)) {
+        return Status_OK;
+    }
+
+    LineCol pos = line_index_lookup(ctx->lines, e->loc);
+    fprintf(ctx->diag, "%u:%u: ", pos.line, pos.col);
+    error_msg(
+        ctx->diag, Status_UninitSymbol, str_pool_get(ctx->strs, e->data.VAR));
+
+    // reported once, the reads after this one would only repeat it
+    Status s = _set_assigned(ctx, e->data.VAR, true);
+    return s != Status_OK ? s : Status_UninitSymbol;
+}
+
+static Status _init_declaration(Context *ctx, const Ast ast, AstNode *stmt) {
+    (void)ast;
+    return _set_assigned(ctx, stmt->data.DECL.var, false);
+}
+
+static Status _init_assignment(Context *ctx, const Ast ast, AstNode *stmt) {
+    // the value is read before the variable is assigned, `x = x;` is a read
+    // of an uninitialized `x`
+    Status s = _init_expr(ctx, ast, stmt->data.ASGN.expr);
+    Status set_s = _set_assigned(ctx, stmt->data.ASGN.var, true);
+    return set_s != Status_OK ? set_s : s;
+}
+
+// parameters hold the values `main` is called with
+static Status _init_params(Context *ctx, const Ast ast, const AstNode *main) {
+    for (NodeID id = main->data.MAIN.params; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        Status s = _set_assigned(ctx, ast->data[id].data.DECL.var, true);
+        if (s != Status_OK) {
+            return s;
+        }
+    }
+    return Status_OK;
+}
+
+static Status _init_main(Context *ctx, const Ast ast, AstNode *stmt) {
+    Status s = _init_params(ctx, ast, stmt);
+    if (s != Status_OK) {
+        return s;
+    }
+    return _init_seq(ctx, ast, stmt->data.MAIN.body);
+}
+
+static void _init_release(Context *ctx) {
+    stats_count_callbacks(ctx->dispatches);
+    free(ctx->assigned);
+}
+
+Status initpass(
+    const Ast ast,
+    NodeID node_id,
+    StrPool strs,
+    LineIndex lines,
+    FILE *diag) {
+    if (ast->size <= node_id) {
+        return Status_InternalError;
+    }
+
+    Context ctx = {
+        .strs = strs,
+        .lines = lines,
+        .diag = diag,
+        .dispatches = 0,
+        .assigned = NULL,
+        .capacity = 0,
+    };
+
+    Status status = _init_stmt(&ctx, ast, node_id);
+
+    _init_release(&ctx);
+    return status;
+}
+
+//
+// fused pass
+//
+
+static Status _init_pass_enter_main(void *context, const Ast ast, NodeID id) {
+    return _init_params(context, ast, &ast->data[id]);
+}
+
+static Status _init_pass_stmt(void *context, const Ast ast, NodeID id) {
+    return _init_stmt(context, ast, id);
+}
+
+static void _init_pass_release(void *context) {
+    _init_release(context);
+    free(context);
+}
+
+Status initpass_pass(
+    AstPass *pass,
+    StrPool strs,
+    LineIndex lines,
+    FILE *diag) {
+    Context *ctx = malloc(sizeof(*ctx));
+    if (ctx == NULL) {
+        return Status_InternalError;
+    }
+
+    *ctx = (Context){
+        .strs = strs,
+        .lines = lines,
+        .diag = diag,
+        .dispatches = 0,
+        .assigned = NULL,
+        .capacity = 0,
+    };
+
+    *pass = (AstPass){
+        .context = ctx,
+        .enter_main = _init_pass_enter_main,
+        .visit_stmt = _init_pass_stmt,
+        .leave_main = NULL,
+        .release = _init_pass_release,
+        .gated = true,
+        .status = Status_OK,
+    };
+    return Status_OK;
+}
@@ -1,15 +1,17 @@
 #include "interp.h"
 
-#include <inttypes.h>
-#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "ast.h"
 #include "ast_visitor.h"
 #include "defs.h"
 #include "error.h"
+#include "profile.h"
+#include "stats.h"
 #include "str_pool.h"
 #include "sym_table.h"
+#include "trace.h"
 
 const Sym VOID_SYM = { .ident = NO_ID, .type = Type_VOID };
 
@@ -17,73 +19,96 @@ typedef struct {
     StrPool strs;
     SymTable syms;
     Sym last_symbol;
+    bool returned;
+    size_t dispatches;
+
+    // NULL if not tracing
+    const Tracer *tracer;
+
+    // where the fused pass leaves the value returned by main
+    Sym *result;
 } Context;
 
-static Status _interp_int_constant(Visitor visitor, NodeID id) {
-    Context *ctx = visitor_get_context(visitor);
-    Ast ast = visitor_get_ast(visitor);
+static Status _interp_int_constant(Context *ctx, const Ast ast, AstNode *node);
+static Status _interp_bool_constant(Context *ctx, const Ast ast, AstNode *node);
+static Status _interp_var(Context *ctx, const Ast ast, AstNode *node);
+static Status _interp_binary(Context *ctx, const Ast ast, AstNode *node);
+static Status _interp_declaration(Context *ctx, const Ast ast, AstNode *node);
+static Status _interp_assignment(Context *ctx, const Ast ast, AstNode *node);
+static Status _interp_return(Context *ctx, const Ast ast, AstNode *node);
+static Status _interp_main(Context *ctx, const Ast ast, AstNode *node);
+
+// a single branch per event while not tracing
+#define TRACE(ctx, event, ...)                                              \
+    do {                                                                    \
+        const Tracer *_tracer = (ctx)->tracer;                              \
+        if (__builtin_expect(_tracer != NULL, 0) && _tracer->event != NULL) { \
+            _tracer->event(_tracer->context, __VA_ARGS__);                  \
+        }                                                                   \
+    } while (0)
+
+static void _trace_flush(const Context *ctx) {
+    if (ctx->tracer != NULL && ctx->tracer->flush != NULL) {
+        ctx->tracer->flush(ctx->tracer->context);
+    }
+}
 
-    const AstNode *node = ast_get_expr(ast, id);
-    assert(node != NULL);
+static inline NodeID _id(const Ast ast, const AstNode *node) {
+    return (NodeID)(node - ast->data);
+}
 
+#define WALK_NAME _interp
+#define WALK_CTX Context
+#define WALK_INTERRUPTED(ctx) ((ctx)->returned)
+#define WALK_ON_DISPATCH(ctx) (++(ctx)->dispatches)
+#define WALK_INT_CONSTANT _interp_int_constant
+#define WALK_BOOL_CONSTANT _interp_bool_constant
+#define WALK_VAR _interp_var
+#define WALK_BINOP _interp_binary
+#define WALK_DECL _interp_declaration
+#define WALK_ASGN _interp_assignment
+#define WALK_RET _interp_return
+#define WALK_MAIN _interp_main
+#include "ast_walk.h"
+
+static Status _interp_int_constant(Context *ctx, const Ast ast, AstNode *node) {
     ctx->last_symbol.ident = NO_ID;
     ctx->last_symbol.type = Type_INT;
     ctx->last_symbol.value.v_int = node->data.INT_CONSTANT;
 
-    printf("INT: %" PRIi64 "\n", ctx->last_symbol.value.v_int);
+    TRACE(ctx, on_const, _id(ast, node), &ctx->last_symbol);
 
     return Status_OK;
 }
 
-static Status _interp_bool_constant(Visitor visitor, NodeID id) {
-    Context *ctx = visitor_get_context(visitor);
-    Ast ast = visitor_get_ast(visitor);
-
-    const AstNode *node = ast_get_expr(ast, id);
-    assert(node != NULL);
-
+static Status _interp_bool_constant(Context *ctx, const Ast ast, AstNode *node) {
     ctx->last_symbol.ident = NO_ID;
     ctx->last_symbol.type = Type_BOOL;
     ctx->last_symbol.value.v_bool = node->data.BOOL_CONSTANT;
 
-    printf("BOOL: %d\n", ctx->last_symbol.value.v_bool);
+    TRACE(ctx, on_const, _id(ast, node), &ctx->last_symbol);
 
     return Status_OK;
 }
 
-static Status _interp_var(Visitor visitor, NodeID id) {
-    Context *ctx = visitor_get_context(visitor);
-    Ast ast = visitor_get_ast(visitor);
-
-    const AstNode *node = ast_get_expr(ast, id);
-    assert(node != NULL);
-
+static Status _interp_var(Context *ctx, const Ast ast, AstNode *node) {
     const Sym *sym =
         symnode_get_symbol(symtable_get_info(ctx->syms, node->data.VAR));
     assert(sym != NULL);
 
-    printf(
-        "VAR %d: %" PRIi64 "\n",
-        ctx->last_symbol.type,
-        ctx->last_symbol.value.v_int);
-
     memcpy(&ctx->last_symbol, sym, sizeof(*sym));
 
+    TRACE(ctx, on_var, _id(ast, node), &ctx->last_symbol);
+
     return Status_OK;
 }
 
-static Status _interp_binary(Visitor visitor, NodeID id) {
-    Context *ctx = visitor_get_context(visitor);
-    Ast ast = visitor_get_ast(visitor);
-
-    const AstNode *node = ast_get_expr(ast, id);
-    assert(node != NULL);
-
-    Status lhs_res = visit_expr(visitor, node->data.BINOP.lhs);
+static Status _interp_binary(Context *ctx, const Ast ast, AstNode *node) {
+    Status lhs_res = _interp_expr(ctx, ast, node->data.BINOP.lhs);
     (void)lhs_res; // TODO: handle error
     Sym lhs = ctx->last_symbol;
 
-    Status rhs_res = visit_expr(visitor, node->data.BINOP.rhs);
+    Status rhs_res = _interp_expr(ctx, ast, node->data.BINOP.rhs);
     (void)rhs_res; // TODO: handle error
     Sym rhs = ctx->last_symbol;
 
@@ -101,33 +126,28 @@ static Status _interp_binary(Visitor visitor, NodeID id) {
     ctx->last_symbol.ident = NO_ID;
     ctx->last_symbol.type = Type_INT;
 
+    TRACE(
+        ctx, on_binop, _id(ast, node), node->data.BINOP.op, &ctx->last_symbol);
+
     return Status_OK;
 }
 
-static Status _interp_declaration(Visitor visitor, NodeID id) {
-    Context *ctx = visitor_get_context(visitor);
-    Ast ast = visitor_get_ast(visitor);
-
-    const AstNode *node = ast_get_stmt(ast, id);
-    assert(node != NULL);
+static Status _interp_declaration(Context *ctx, const Ast ast, AstNode *node) {
+    (void)ast;
 
     StrID ident = node->data.DECL.var;
     Type type = node->data.DECL.type;
-    symtable_add_symbol(ctx->syms, ident, type);
+    if (!symtable_add_symbol(ctx->syms, ident, type)) {
+        return Status_InternalError;
+    }
 
     ctx->last_symbol = VOID_SYM;
 
     return Status_OK;
 }
 
-static Status _interp_assignment(Visitor visitor, NodeID id) {
-    Context *ctx = visitor_get_context(visitor);
-    Ast ast = visitor_get_ast(visitor);
-
-    const AstNode *node = ast_get_stmt(ast, id);
-    assert(node != NULL);
-
-    Status expr_res = visit_expr(visitor, node->data.ASGN.expr);
+static Status _interp_assignment(Context *ctx, const Ast ast, AstNode *node) {
+    Status expr_res = _interp_expr(ctx, ast, node->data.ASGN.expr);
     (void)expr_res; // TODO: handle error
 
     Sym expr = ctx->last_symbol;
@@ -137,63 +157,162 @@ static Status _interp_assignment(Visitor visitor, NodeID id) {
     assert(sym_entry != NULL);
     sym_entry->value = expr.value;
 
+    TRACE(ctx, on_asgn, _id(ast, node), sym_entry);
+
     ctx->last_symbol = VOID_SYM;
 
     return Status_OK;
 }
 
-static Status _interp_return(Visitor visitor, NodeID id) {
-    Context *ctx = visitor_get_context(visitor);
-    Ast ast = visitor_get_ast(visitor);
-
-    const AstNode *node = ast_get_stmt(ast, id);
-    assert(node != NULL);
-
+static Status _interp_return(Context *ctx, const Ast ast, AstNode *node) {
     if (node->data.RET == NO_ID) {
         ctx->last_symbol = VOID_SYM;
     } else {
-        Status ret_expr_res = visit_expr(visitor, node->data.RET);
+        Status ret_expr_res = _interp_expr(ctx, ast, node->data.RET);
         (void)ret_expr_res; // TODO: handle error
         // ctx->last_symbol is the return value
+        ctx->last_symbol.ident = NO_ID;
     }
 
-    visitor_interrupt(visitor);
+    TRACE(ctx, on_ret, _id(ast, node), &ctx->last_symbol);
+
+    ctx->returned = true;
+
+    return Status_OK;
+}
 
+// parameters bound by the caller keep their value, the others start at 0 or
+// false
+static Status _interp_params(Context *ctx, const Ast ast, const AstNode *main) {
+    for (NodeID id = main->data.MAIN.params; id != NO_ID;
+         id = ast->data[id].header.stmt_next) {
+        const AstNode *param = &ast->data[id];
+        if (symtable_get_info(ctx->syms, param->data.DECL.var) == NULL &&
+            !symtable_add_symbol(
+                ctx->syms, param->data.DECL.var, param->data.DECL.type)) {
+            return Status_InternalError;
+        }
+    }
     return Status_OK;
 }
 
-static Status _interp_main(Visitor visitor, NodeID id) {
-    Ast ast = visitor_get_ast(visitor);
+static Status _interp_main(Context *ctx, const Ast ast, AstNode *node) {
+    Status s = _interp_params(ctx, ast, node);
+    if (s != Status_OK) {
+        return s;
+    }
+    return _interp_seq(ctx, ast, node->data.MAIN.body);
+}
 
-    const AstNode *current_stmt = ast_get_stmt(ast, id);
+Sym interp(
+    Ast ast, NodeID root, StrPool strs, SymTable syms, const Tracer *tracer) {
+    Context ctx = { 0 };
+    ctx.strs = strs;
+    ctx.syms = syms;
+    ctx.tracer = tracer;
 
-    Status s = visit_stmt(visitor, current_stmt->data.MAIN.body);
+    if (root < ast->size) {
+        Status status = _interp_stmt(&ctx, ast, root);
+        (void)status; // TODO: handle error
+    }
+    _trace_flush(&ctx);
 
-    return s;
+    stats_count_callbacks(ctx.dispatches);
+
+    return ctx.last_symbol;
 }
 
-Sym interp(Ast ast, NodeID root, StrPool strs, SymTable syms) {
+Sym interp_profile(
+    Ast ast,
+    NodeID root,
+    StrPool strs,
+    SymTable syms,
+    const Tracer *tracer,
+    Profile profile) {
     Context ctx = { 0 };
     ctx.strs = strs;
     ctx.syms = syms;
+    ctx.tracer = tracer;
+
+    profile_start(profile);
+    if (root < ast->size && ast->data[root].kind == AstNodeKind_MAIN) {
+        uint64_t main_start = profile_ticks();
+        const AstNode *main = &ast->data[root];
+        ++ctx.dispatches;
+
+        // same as `_interp_main`, timing every statement
+        Status status = _interp_params(&ctx, ast, main);
+        for (NodeID id = main->data.MAIN.body;
+             status == Status_OK && id != NO_ID && !ctx.returned;
+             id = ast->data[id].header.stmt_next) {
+            uint64_t start = profile_ticks();
+            status = _interp_stmt(&ctx, ast, id);
+            profile_add(profile, id, profile_ticks() - start);
+        }
+
+        profile_add(profile, root, profile_ticks() - main_start);
+    }
+    profile_stop(profile);
+    _trace_flush(&ctx);
 
-    Visitor visitor = init_visitor(
-        ast,
-        strs,
-        &ctx,
-        _interp_int_constant,
-        _interp_bool_constant,
-        _interp_var,
-        _interp_binary,
-        _interp_declaration,
-        _interp_assignment,
-        _interp_return,
-        _interp_main);
+    stats_count_callbacks(ctx.dispatches);
 
-    Status status = ast_visit(visitor, root);
-    (void)status; // TODO: handle error
+    return ctx.last_symbol;
+}
 
-    visitor_release(visitor);
+//
+// fused pass
+//
 
-    return ctx.last_symbol;
+static Status _interp_pass_enter_main(
+    void *context, const Ast ast, NodeID id) {
+    return _interp_params(context, ast, &ast->data[id]);
+}
+
+static Status _interp_pass_stmt(void *context, const Ast ast, NodeID id) {
+    Context *ctx = context;
+    if (ctx->returned) {
+        return Status_OK;
+    }
+
+    Status status = _interp_stmt(ctx, ast, id);
+    _trace_flush(ctx);
+
+    *ctx->result = ctx->last_symbol;
+    return status;
+}
+
+static void _interp_pass_release(void *context) {
+    Context *ctx = context;
+    stats_count_callbacks(ctx->dispatches);
+    free(ctx);
+}
+
+Status interp_pass(
+    AstPass *pass,
+    StrPool strs,
+    SymTable syms,
+    const Tracer *tracer,
+    Sym *result) {
+    Context *ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL) {
+        return Status_InternalError;
+    }
+
+    ctx->strs = strs;
+    ctx->syms = syms;
+    ctx->tracer = tracer;
+    ctx->result = result;
+    *result = VOID_SYM;
+
+    *pass = (AstPass){
+        .context = ctx,
+        .enter_main = _interp_pass_enter_main,
+        .visit_stmt = _interp_pass_stmt,
+        .leave_main = NULL,
+        .release = _interp_pass_release,
+        .gated = true,
+        .status = Status_OK,
+    };
+    return Status_OK;
 }
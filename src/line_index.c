@@ -0,0 +1,250 @@
+#include "line_index.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ast.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__)
+#define HAVE_SSE2 1
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_AVX2 1
+#endif
+
+#define DEFAULT_CAPACITY 64
+
+typedef struct {
+    // first location after the run of newlines, and its line
+    Location start;
+    uint32_t line;
+} Line;
+
+struct LineIndex_S {
+    // lines after the first, by increasing start
+    Line *data;
+    size_t size;
+    size_t capacity;
+
+    // source to build the index from on the first lookup, NULL once it's
+    // built or if it's recorded as it's read
+    const char *src;
+    size_t len;
+
+    // line and column of the first byte
+    LineCol start;
+};
+
+//
+// constructor & destructor
+//
+
+LineIndex line_index_initialize() {
+    LineIndex self = (LineIndex)calloc(1, sizeof(struct LineIndex_S));
+    if (self != NULL) {
+        self->start = (LineCol){ 1, 1 };
+    }
+    return self;
+}
+
+void line_index_release(LineIndex self) {
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->data);
+    free(self);
+}
+
+void line_index_reset(LineIndex self, const char *src, size_t len) {
+    line_index_reset_at(self, src, len, (LineCol){ 1, 1 });
+}
+
+void line_index_reset_at(
+    LineIndex self, const char *src, size_t len, LineCol start) {
+    self->size = 0;
+    self->src = src;
+    self->len = len;
+    self->start = start;
+}
+
+//
+// helpers
+//
+
+typedef size_t (*FindFn)(const char *p, const char *end);
+
+static inline bool _is_newline(char c) {
+    return c == '\n' || c == '\r';
+}
+
+static size_t _find_scalar(const char *p, const char *end) {
+    const char *c = p;
+    while (c < end && !_is_newline(*c)) {
+        ++c;
+    }
+    return c - p;
+}
+
+#ifdef HAVE_SSE2
+static size_t _find_sse2(const char *p, const char *end) {
+    const char *c = p;
+    __m128i nl = _mm_set1_epi8('\n');
+    __m128i cr = _mm_set1_epi8('\r');
+
+    for (; end - c >= 16; c += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)c);
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+        if (mask != 0) {
+            return (c - p) + __builtin_ctz(mask);
+        }
+    }
+    return (c - p) + _find_scalar(c, end);
+}
+#endif
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2"))) static size_t _find_avx2(
+    const char *p, const char *end) {
+    const char *c = p;
+    __m256i nl = _mm256_set1_epi8('\n');
+    __m256i cr = _mm256_set1_epi8('\r');
+
+    for (; end - c >= 32; c += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)c);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v, nl), _mm256_cmpeq_epi8(v, cr)));
+        if (mask != 0) {
+            return (c - p) + __builtin_ctz(mask);
+        }
+    }
+    return (c - p) + _find_scalar(c, end);
+}
+#endif
+
+static FindFn _select_find() {
+#ifdef HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return _find_avx2;
+    }
+#endif
+#ifdef HAVE_SSE2
+    return _find_sse2;
+#else
+    return _find_scalar;
+#endif
+}
+
+static bool _push(LineIndex self, Location start, uint32_t line) {
+    if (self->size == self->capacity) {
+        size_t capacity =
+            self->capacity == 0 ? DEFAULT_CAPACITY : 2 * self->capacity;
+        Line *dummy = (Line *)realloc(self->data, capacity * sizeof(*dummy));
+        if (dummy == NULL) {
+            return false;
+        }
+
+        self->data = dummy;
+        self->capacity = capacity;
+    }
+
+    self->data[self->size++] = (Line){ start, line };
+    return true;
+}
+
+//
+// indexing
+//
+
+size_t line_index_newlines(const char *p, const char *end) {
+    size_t n = end - p;
+    size_t longest = 0;
+
+    // whether p[0, i), p[0, i + 1) and p[0, i + 2) are runs of newlines
+    bool at = true, next = false, after = false;
+
+    for (size_t i = 0; i <= n && (at || next || after); ++i) {
+        if (at) {
+            longest = i;
+            if (i < n && p[i] == '\n') {
+                next = true;
+                after = after || (i + 1 < n && p[i + 1] == '\r');
+            } else if (i + 1 < n && p[i] == '\r' && p[i + 1] == '\n') {
+                after = true;
+            }
+        }
+
+        at = next;
+        next = after;
+        after = false;
+    }
+
+    return longest;
+}
+
+bool line_index_scan(
+    LineIndex self, const char *text, size_t len, Location offset) {
+    FindFn find = _select_find();
+    const char *end = text + len;
+    uint32_t line =
+        self->size > 0 ? self->data[self->size - 1].line : self->start.line;
+
+    for (const char *p = text + find(text, end); p < end;
+         p += find(p, end)) {
+        size_t n = line_index_newlines(p, end);
+        if (n == 0) {
+            // a lone '\r' is an illegal character, not a newline
+            ++p;
+            continue;
+        }
+
+        p += n;
+        line += n;
+        if (!_push(self, offset + (Location)(p - text), line)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void line_index_trim(LineIndex self) {
+    if (self->size > 1) {
+        self->data[0] = self->data[self->size - 1];
+        self->size = 1;
+    }
+}
+
+LineCol line_index_lookup(LineIndex self, Location loc) {
+    if (self->src != NULL) {
+        // if out of memory, what's past the last line recorded is reported
+        // on it
+        line_index_scan(self, self->src, self->len, 0);
+        self->src = NULL;
+    }
+
+    // last line starting at or before `loc`
+    size_t lo = 0, hi = self->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (self->data[mid].start <= loc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0) {
+        return (LineCol){ self->start.line, self->start.col + loc };
+    }
+
+    const Line *line = &self->data[lo - 1];
+    return (LineCol){ line->line, loc - line->start + 1 };
+}
@@ -1,35 +1,507 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "ast.h"
-#include "parser.h"
-#include "lexer.h"
-#include "str_pool.h"
 #include "ast_visitor.h"
-#include "sempass.h"
+#include "bytecode.h"
+#include "image.h"
+#include "precc.h"
+#include "profile.h"
+#include "stats.h"
+#include "trace.h"
+#include "util.h"
+#include "vm.h"
+
+typedef enum {
+    Report_NONE,
+    Report_TEXT,
+    Report_JSON,
+} Report;
+
+typedef enum {
+    Mode_BATCH,
+    Mode_FUSED,
+    Mode_STREAM,
+    // batch, reading and lexing on other threads while parsing
+    Mode_PIPELINE,
+} Mode;
+
+typedef enum {
+    Trace_NONE,
+    Trace_TEXT,
+    Trace_RING,
+} Trace;
+
+// events kept by --trace=ring
+#define TRACE_RING_CAPACITY (64 * 1024)
+
+// most threads --lex-threads may ask for
+#define LEX_THREADS_MAX 1024
+
+typedef struct {
+    TraceText text;
+    TraceRing ring;
+    Tracer hooks;
+} Tracing;
+
+static void _usage(const char *prog) {
+    fprintf(
+        stderr,
+        "usage: %s [--time-report[=json]] [--fused | --stream | --pipeline] "
+        "[--lex-threads=N] [--lexer=flex|simd] [--parser=bison|pratt] "
+        "[--format=source|sexpr|json|bin|none] [--eval=interp|vm] "
+        "[--no-fuse] [--trace=text|ring|none] [--profile[=folded]] "
+        "[--compile -o IMAGE] < program\n"
+        "       %s [--time-report[=json]] --run IMAGE [ARG...]\n",
+        prog,
+        prog);
+}
+
+static bool _parse_format(const char *name, Format *format) {
+    static const struct {
+        const char *name;
+        Format format;
+    } FORMATS[] = {
+        { "source", Format_SOURCE }, { "sexpr", Format_SEXPR },
+        { "json", Format_JSON },     { "bin", Format_BIN },
+        { "none", Format_NONE },
+    };
+
+    for (size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); ++i) {
+        if (strcmp(name, FORMATS[i].name) == 0) {
+            *format = FORMATS[i].format;
+            return true;
+        }
+    }
+    return false;
+}
+
+// `*src` is left pointing to the source if it was read into memory, for the
+// profile to quote it
+static Status _compile(
+    PreccSession session, Mode mode, Sym *result, char **src, size_t *len) {
+    *src = NULL;
+    *len = 0;
+    if (mode == Mode_STREAM) {
+        return precc_session_stream(session, stdin, stdout, result);
+    }
+    if (mode == Mode_PIPELINE) {
+        return precc_session_compile_file(session, stdin);
+    }
+
+    *src = u_read_all(stdin, len);
+    if (*src == NULL) {
+        return Status_InternalError;
+    }
+
+    return mode == Mode_FUSED
+        ? precc_session_run(session, *src, *len, stdout, result)
+        : precc_session_compile(session, *src, *len);
+}
+
+static bool _parse_threads(const char *arg, unsigned *threads) {
+    char *end;
+    errno = 0;
+    unsigned long n = strtoul(arg, &end, 10);
+    if (errno != 0 || end == arg || *end != '\0' || arg[0] == '-' ||
+        n > LEX_THREADS_MAX) {
+        fprintf(
+            stderr,
+            "--lex-threads: expected a number from 0 to %d, got `%s`\n",
+            LEX_THREADS_MAX,
+            arg);
+        return false;
+    }
+
+    *threads = (unsigned)n;
+    return true;
+}
+
+static bool _parse_trace(const char *name, Trace *trace) {
+    static const struct {
+        const char *name;
+        Trace trace;
+    } TRACES[] = {
+        { "text", Trace_TEXT },
+        { "ring", Trace_RING },
+        { "none", Trace_NONE },
+    };
+
+    for (size_t i = 0; i < sizeof(TRACES) / sizeof(TRACES[0]); ++i) {
+        if (strcmp(name, TRACES[i].name) == 0) {
+            *trace = TRACES[i].trace;
+            return true;
+        }
+    }
+    return false;
+}
+
+// sets up the tracer of the session, false if out of memory
+static bool _tracing_init(Tracing *t, Trace trace, PreccSession session) {
+    *t = (Tracing){ 0 };
+    if (trace == Trace_TEXT) {
+        t->text = trace_text_initialize(precc_session_strs(session), stdout);
+        if (t->text == NULL) {
+            return false;
+        }
+        t->hooks = trace_text_tracer(t->text);
+    } else if (trace == Trace_RING) {
+        t->ring = trace_ring_initialize(TRACE_RING_CAPACITY);
+        if (t->ring == NULL) {
+            return false;
+        }
+        t->hooks = trace_ring_tracer(t->ring);
+    }
+
+    precc_session_set_tracer(
+        session, trace == Trace_NONE ? NULL : &t->hooks);
+    return true;
+}
+
+// writes out what's left of the trace, the ring goes to stdout as is
+static void _tracing_finish(Tracing *t) {
+    trace_text_release(t->text);
+    if (t->ring != NULL) {
+        fflush(stdout);
+        trace_ring_dump(t->ring, stdout);
+        trace_ring_release(t->ring);
+    }
+}
+
+static void _report(const Stats *stats, Report report) {
+    if (report == Report_JSON) {
+        stats_report_json(stats, stderr);
+    } else if (report == Report_TEXT) {
+        stats_report(stats, stderr);
+    }
+}
+
+// runs the program profiling every statement, then prints the profile
+static void _profile(
+    PreccSession session, const char *src, size_t len, ProfileFormat format) {
+    Ast ast = precc_session_ast(session);
+    Profile profile = profile_initialize(ast->size);
+    if (profile == NULL) {
+        return;
+    }
+
+    Sym result;
+    if (precc_session_profile(session, profile, &result) == Status_OK) {
+        profile_report(
+            profile,
+            ast,
+            precc_session_lines(session),
+            src,
+            len,
+            format,
+            stderr);
+    }
+    profile_release(profile);
+}
+
+//
+// images
+//
+
+static const char *_type_name(uint32_t type) {
+    return type == Type_BOOL ? "bool" : "int";
+}
+
+// parses the arguments of `main` in the order of its parameters, the names
+// and types of which come from the image
+static bool _parse_args(
+    const char *path,
+    const Chunk *chunk,
+    char **argv,
+    int argc,
+    int64_t *args) {
+    if ((uint32_t)argc != chunk->params) {
+        fprintf(
+            stderr,
+            "%s: main takes %" PRIu32 " arguments (",
+            path,
+            chunk->params);
+        for (uint32_t i = 0; i < chunk->params; ++i) {
+            const SlotInfo *param = &chunk->slot_info[i];
+            fprintf(
+                stderr,
+                "%s%s %s",
+                i ? ", " : "",
+                _type_name(param->type),
+                chunk->strings + param->name);
+        }
+        fprintf(stderr, "), got %d\n", argc);
+        return false;
+    }
+
+    for (int i = 0; i < argc; ++i) {
+        const SlotInfo *param = &chunk->slot_info[i];
+        char *end;
+        bool ok;
+        if (param->type == Type_BOOL) {
+            ok = strcmp(argv[i], "true") == 0 || strcmp(argv[i], "false") == 0;
+            args[i] = argv[i][0] == 't';
+        } else {
+            errno = 0;
+            args[i] = strtoll(argv[i], &end, 10);
+            ok = errno == 0 && end != argv[i] && *end == '\0';
+        }
+
+        if (!ok) {
+            fprintf(
+                stderr,
+                "%s: expected %s for parameter `%s` of main, got `%s`\n",
+                path,
+                param->type == Type_BOOL ? "true or false" : "an int",
+                chunk->strings + param->name,
+                argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// runs a precompiled program, printing the value returned by `main`
+static int _run_image(
+    const char *path,
+    char **argv,
+    int argc,
+    const Stats *stats,
+    Report report) {
+    stats_phase_begin(Phase_LOAD);
+    Image image = image_open(path, stderr);
+    stats_phase_end(Phase_LOAD);
+    if (image == NULL) {
+        return 1;
+    }
+
+    const Chunk *chunk = image_chunk(image);
+    int64_t *args = (int64_t *)calloc(chunk->params + 1, sizeof(*args));
+    if (args == NULL || !_parse_args(path, chunk, argv, argc, args)) {
+        free(args);
+        image_close(image);
+        return 1;
+    }
+
+    Sym result;
+    stats_phase_begin(Phase_INTERP);
+    Status s = vm_run(chunk, args, &result);
+    stats_phase_end(Phase_INTERP);
+
+    if (s == Status_OK && result.type == Type_INT) {
+        printf("%" PRIi64 "\n", result.value.v_int);
+    } else if (s == Status_OK && result.type == Type_BOOL) {
+        printf("%s\n", result.value.v_bool ? "true" : "false");
+    }
+
+    _report(stats, report);
+    free(args);
+    image_close(image);
+    return s == Status_OK ? 0 : 1;
+}
+
+static int _write_image(PreccSession session, const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    Status s = precc_session_write_image(session, out);
+    if (fclose(out) != 0 || s != Status_OK) {
+        fprintf(stderr, "%s: error writing the image\n", path);
+        remove(path);
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
-    // yydebug = 1;
-    Ast ast = ast_initialize();
-    StrPool strs = str_pool_init();
-    NodeID root = NO_ID;
+    Report report = Report_NONE;
+    Mode mode = Mode_BATCH;
+    unsigned lex_threads = 1;
+    Lexer lexer = Lexer_FLEX;
+    Parser parser = Parser_BISON;
+    Format format = Format_SOURCE;
+    Evaluator evaluator = Evaluator_INTERP;
+    bool fuse = true;
+    Trace trace = Trace_TEXT;
+    // whether batch mode runs the program after printing it
+    bool run = false;
+    bool profile = false;
+    ProfileFormat profile_format = ProfileFormat_TEXT;
+    bool compile = false;
+    const char *output = NULL;
+    const char *image = NULL;
+    int image_argc = 0;
+    char **image_argv = NULL;
+
+    for (int i = 1; i < argc && image == NULL; ++i) {
+        if (strcmp(argv[i], "--time-report") == 0) {
+            report = Report_TEXT;
+        } else if (strcmp(argv[i], "--time-report=json") == 0) {
+            report = Report_JSON;
+        } else if (strcmp(argv[i], "--fused") == 0) {
+            mode = Mode_FUSED;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            mode = Mode_STREAM;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            mode = Mode_PIPELINE;
+        } else if (strncmp(argv[i], "--lex-threads=", 14) == 0) {
+            if (!_parse_threads(argv[i] + 14, &lex_threads)) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--lexer=flex") == 0) {
+            lexer = Lexer_FLEX;
+        } else if (strcmp(argv[i], "--lexer=simd") == 0) {
+            lexer = Lexer_SIMD;
+        } else if (strcmp(argv[i], "--parser=bison") == 0) {
+            parser = Parser_BISON;
+        } else if (strcmp(argv[i], "--parser=pratt") == 0) {
+            parser = Parser_PRATT;
+        } else if (strcmp(argv[i], "--eval=interp") == 0) {
+            evaluator = Evaluator_INTERP;
+            run = true;
+        } else if (strcmp(argv[i], "--eval=vm") == 0) {
+            evaluator = Evaluator_VM;
+            run = true;
+        } else if (strcmp(argv[i], "--no-fuse") == 0) {
+            fuse = false;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+            run = true;
+            profile_format = ProfileFormat_TEXT;
+        } else if (strcmp(argv[i], "--profile=folded") == 0) {
+            profile = true;
+            run = true;
+            profile_format = ProfileFormat_FOLDED;
+        } else if (strcmp(argv[i], "--compile") == 0) {
+            compile = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--run") == 0 && i + 1 < argc) {
+            // the rest are the arguments of `main`
+            image = argv[++i];
+            image_argv = &argv[i + 1];
+            image_argc = argc - i - 1;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            if (!_parse_trace(argv[i] + 8, &trace)) {
+                _usage(argv[0]);
+                return 1;
+            }
+            run = true;
+        } else if (strncmp(argv[i], "--format=", 9) == 0) {
+            if (!_parse_format(argv[i] + 9, &format)) {
+                _usage(argv[0]);
+                return 1;
+            }
+        } else {
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // images are compiled in batch
+    bool batch = mode == Mode_BATCH || mode == Mode_PIPELINE;
+    // profiles quote the source, which only batch mode keeps
+    if (compile != (output != NULL) || (compile && !batch) ||
+        (profile && (mode != Mode_BATCH || evaluator != Evaluator_INTERP ||
+                     compile))) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    // a timing report runs the program to time it, untraced unless asked to
+    // so that it prints the same
+    if (batch && report != Report_NONE && !run) {
+        run = true;
+        trace = Trace_NONE;
+    }
+
+    Stats stats;
+    if (report != Report_NONE) {
+        stats_enable(&stats);
+    }
+
+    if (image != NULL) {
+        return _run_image(image, image_argv, image_argc, &stats, report);
+    }
+
+    PreccSession session = precc_session_create();
+    if (session == NULL) {
+        return 1;
+    }
+    precc_session_set_lex_threads(session, lex_threads);
+    precc_session_set_lexer(session, lexer);
+    precc_session_set_parser(session, parser);
+    precc_session_set_format(session, format);
+    precc_session_set_evaluator(session, evaluator);
+    precc_session_set_fusion(session, fuse);
 
-    yyscan_t scanner;
-    if (yylex_init(&scanner)) {
+    Tracing tracing;
+    if (!_tracing_init(&tracing, trace, session)) {
+        _tracing_finish(&tracing);
+        precc_session_destroy(session);
         return 1;
     }
-    yylex_init_extra(strs, scanner);
 
-    // YY_BUFFER_STATE state = yy_scan_string(argv[1], scanner);
+    Sym result;
+    char *src;
+    size_t len;
+    Status s = _compile(session, mode, &result, &src, &len);
 
-    if (yyparse(ast, &root, scanner)) {
+    if (s == Status_SyntaxError || s == Status_InternalError ||
+        (compile && s != Status_OK)) {
+        _tracing_finish(&tracing);
+        fputs(precc_session_diagnostics(session), stderr);
+        precc_session_destroy(session);
+        free(src);
         return 1;
     }
 
-    // yy_delete_buffer(state, scanner);
-    yylex_destroy(scanner);
+    if (compile) {
+        int status = _write_image(session, output);
+        if (report != Report_NONE) {
+            stats_collect_ast(&stats, precc_session_ast(session));
+            stats_collect_strs(&stats, precc_session_strs(session));
+            _report(&stats, report);
+        }
+        _tracing_finish(&tracing);
+        precc_session_destroy(session);
+        free(src);
+        return status;
+    }
 
-    ast_display(ast, root, strs, stdout);
-    Status s = sempass(ast, root, strs);
+    if (batch) {
+        stats_phase_begin(Phase_DISPLAY);
+        ast_display(
+            precc_session_ast(session),
+            precc_session_root(session),
+            precc_session_strs(session),
+            format,
+            stdout);
+        stats_phase_end(Phase_DISPLAY);
+    }
+
+    fputs(precc_session_diagnostics(session), stderr);
     printf("Status: %d\n", s);
 
-    ast_release(ast);
-    str_pool_release(strs);
+    if (profile) {
+        _profile(session, src, len, profile_format);
+    } else if (batch && run) {
+        precc_session_eval(session, &result);
+    }
+    _tracing_finish(&tracing);
+
+    if (report != Report_NONE) {
+        stats_collect_ast(&stats, precc_session_ast(session));
+        stats_collect_strs(&stats, precc_session_strs(session));
+        _report(&stats, report);
+    }
+
+    precc_session_destroy(session);
+    free(src);
 }
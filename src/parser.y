@@ -5,30 +5,158 @@
 #include <stdint.h>
 
 #include "ast.h"
+#include "ast_visitor.h"
+#include "line_index.h"
 #include "parser.h"
 #include "lexer.h"
 #include "str_pool.h"
+#include "stats.h"
 
 int yyerror(YYLTYPE *loc, Ast ast, NodeID *root, yyscan_t scanner, const char *msg);
 
-NodeID last_stmt = NO_ID;
+/* Last statement or parameter reduced, the next one is chained after it */
+#define LAST_STMT (((LexCtx *)yyget_extra(scanner))->last_stmt)
 
+/* Hands a token lexed beforehand to the parser */
+static int _take_token(const Token *tok, YYSTYPE *lval, YYLTYPE *lloc) {
+    *lloc = tok->loc;
+    if (tok->kind == TOK_IDENT) {
+        lval->TOK_IDENT = tok->value.ident;
+    } else if (tok->kind == TOK_NUM) {
+        lval->TOK_NUM = tok->value.num;
+    }
+    return tok->kind;
+}
+
+/* Pops the next token of the array set in the LexCtx */
+static int _next_token(LexCtx *ctx, YYSTYPE *lval, YYLTYPE *lloc) {
+    if (ctx->next_token >= ctx->tokens->size) {
+        return YYEOF;
+    }
+
+    return _take_token(&ctx->tokens->data[ctx->next_token++], lval, lloc);
+}
+
+/* Times and counts every token pulled by the parser when stats are enabled */
+static int _yylex(YYSTYPE *lval, YYLTYPE *lloc, yyscan_t scanner) {
+    LexCtx *ctx = yyget_extra(scanner);
+    if (ctx->tokens != NULL) {
+        if (stats_active != NULL) {
+            ++stats_active->tokens;
+        }
+        return _next_token(ctx, lval, lloc);
+    }
+
+    if (ctx->pipe != NULL) {
+        if (stats_active != NULL) {
+            ++stats_active->tokens;
+        }
+        return _take_token(token_pipe_next(ctx->pipe), lval, lloc);
+    }
+
+    if (stats_active == NULL) {
+        return yylex(lval, lloc, scanner);
+    }
+
+    stats_phase_begin(Phase_LEX);
+    int tok = yylex(lval, lloc, scanner);
+    stats_phase_end(Phase_LEX);
+
+    ++stats_active->tokens;
+    return tok;
+}
+#define yylex _yylex
+
+/* Streaming: with passes set in the LexCtx, every statement is handed to them
+ * as soon as it's reduced and its nodes are recycled right after, so the AST
+ * never holds more than `main` and the statement being parsed */
+static void _stream_enter_main(
+    Ast ast,
+    LexCtx *ctx,
+    Location loc,
+    Type type,
+    NodeID params) {
+    if (ctx->passes == NULL) {
+        return;
+    }
+
+    // pushed after the parameters, which truncating the AST keeps
+    ctx->main = ast_mk_main(ast, loc, type, params, NO_ID);
+    if (ctx->main != NO_ID) {
+        ast_fused_enter_main(ast, ctx->main, ctx->passes, ctx->n_passes);
+    }
+}
+
+static void _stream_stmt(Ast ast, LexCtx *ctx, NodeID stmt, int nerrs) {
+    if (ctx->passes == NULL || ctx->main == NO_ID) {
+        return;
+    }
+
+    // statements after the first syntax error are not run, those before it
+    // already ran and were printed, unlike in batch mode
+    if (nerrs == 0 && stmt != NO_ID) {
+        ast_fused_stmt(ast, stmt, ctx->passes, ctx->n_passes);
+    }
+
+    ast_truncate(ast, ctx->main + 1);
+    ctx->last_stmt = NO_ID;
+
+    // nothing before the next statement is looked up anymore
+    if (ctx->track_lines) {
+        line_index_trim(ctx->lines);
+    }
+}
 
-# define YYLLOC_DEFAULT(Cur, Rhs, N)        \
-do                                          \
-    if (N) {                                \
-        (Cur).line = YYRHSLOC(Rhs, 1).line; \
-        (Cur).col = YYRHSLOC(Rhs, 1).col;   \
-    } else {                                \
-        (Cur).line = YYRHSLOC(Rhs, 0).line; \
-        (Cur).col = YYRHSLOC(Rhs, 0).col;   \
-    }                                       \
-while (0)
+static NodeID _stream_leave_main(Ast ast, LexCtx *ctx, int nerrs) {
+    if (ctx->main != NO_ID && nerrs == 0) {
+        ast_fused_leave_main(ast, ctx->main, ctx->passes, ctx->n_passes);
+    }
+    return ctx->main;
+}
+
+
+# define YYLLOC_DEFAULT(Cur, Rhs, N) \
+    ((Cur) = (N) ? YYRHSLOC(Rhs, 1) : YYRHSLOC(Rhs, 0))
 
 %}
 
 %code requires {
+  #include <stdbool.h>
+  #include <stdio.h>
+  #include "ast_visitor.h"
+  #include "line_index.h"
+  #include "str_pool.h"
+  #include "token_pipe.h"
+  #include "tokens.h"
+
   typedef void* yyscan_t;
+
+  /* State shared by the scanner (as its extra data) and the parser */
+  typedef struct {
+      StrPool strs;
+      FILE *diag;
+
+      /* Resolves the locations of syntax errors, the scanner records the
+       * newlines it skips in it if `track_lines` is set */
+      LineIndex lines;
+      bool track_lines;
+
+      /* Passes to stream the statements through, NULL to build the AST */
+      AstPass *passes;
+      size_t n_passes;
+      NodeID main;
+
+      /* Tokens to parse instead of scanning, NULL to scan */
+      Tokens tokens;
+      size_t next_token;
+
+      /* Pipe to pull the tokens from instead of scanning, NULL to scan. The
+       * lines are recorded on another thread, looked up through the pipe */
+      TokenPipe pipe;
+
+      /* Last statement reduced, reset by every parse */
+      NodeID last_stmt;
+  } LexCtx;
 }
 
 %output  "src/parser.c"
@@ -43,8 +171,8 @@ while (0)
 %parse-param { Ast ast }
 %parse-param { NodeID *root }
 %initial-action {
-    @$.line = 1;
-    @$.col = 1;
+    @$ = 0;
+    LAST_STMT = NO_ID;
 }
 
 %param { yyscan_t scanner }
@@ -59,11 +187,15 @@ while (0)
 %token TOK_LCURLY    "{"
 %token TOK_RCURLY    "}"
 %token TOK_SEMICOLON ";"
+%token TOK_COMMA     ","
 %token <StrID> TOK_IDENT "identifier"
 %token <int64_t> TOK_NUM "number"
 %token TOK_ILLEGAL_CHAR "illegal character"
 
 %type <NodeID> input
+%type <NodeID> params
+%type <NodeID> param_list
+%type <NodeID> param
 %type <NodeID> seq
 %type <NodeID> stmt
 %type <NodeID> decl
@@ -81,8 +213,16 @@ while (0)
 
 %%
 
-input: main_type TOK_MAIN "(" ")" "{" seq[body] "}" { 
-     *root = ast_mk_main(ast, @2, $1, $body);
+input: main_type TOK_MAIN "(" params ")" "{"
+     {
+     _stream_enter_main(ast, yyget_extra(scanner), @2, $1, $params);
+     LAST_STMT = NO_ID;
+     }
+     seq[body] "}" {
+     LexCtx *ctx = yyget_extra(scanner);
+     *root = ctx->passes != NULL
+        ? _stream_leave_main(ast, ctx, yynerrs)
+        : ast_mk_main(ast, @2, $1, $params, $body);
      return yynerrs;
      }
 
@@ -92,23 +232,43 @@ main_type
     | TOK_INT  { $$ = Type_INT; }
     ;
 
+params
+    : /* empty */ { $$ = NO_ID; }
+    | param_list
+    ;
+
+param_list
+    : param
+    | param_list "," param { $$ = $1; }
+    ;
+
+param
+    : TOK_BOOL TOK_IDENT { $$ = ast_mk_decl(ast, @2, LAST_STMT, Type_BOOL, $2); LAST_STMT = $$; }
+    | TOK_INT TOK_IDENT  { $$ = ast_mk_decl(ast, @2, LAST_STMT, Type_INT, $2); LAST_STMT = $$; }
+    ;
+
 seq
     : /* empty */ { $$ = NO_ID; }
-    | seq stmt { $$ = $1 == NO_ID ? $2 : $1; }
+    | seq stmt {
+        $$ = $1 == NO_ID ? $2 : $1;
+        _stream_stmt(ast, yyget_extra(scanner), $2, yynerrs);
+        }
     ;
 
-stmt: decl | asgn | retn | error ";" { yyerrok; };
+// statements recovered from are left out of the body, rather than taking the
+// value of the lookahead the error was found at
+stmt: decl | asgn | retn | error ";" { $$ = NO_ID; yyerrok; };
 
 decl
-    : TOK_BOOL TOK_IDENT ";" { $$ = ast_mk_decl(ast, @2, last_stmt, Type_BOOL, $2); last_stmt = $$; }
-    | TOK_INT TOK_IDENT ";"  { $$ = ast_mk_decl(ast, @2, last_stmt, Type_INT, $2); last_stmt = $$; }
+    : TOK_BOOL TOK_IDENT ";" { $$ = ast_mk_decl(ast, @2, LAST_STMT, Type_BOOL, $2); LAST_STMT = $$; }
+    | TOK_INT TOK_IDENT ";"  { $$ = ast_mk_decl(ast, @2, LAST_STMT, Type_INT, $2); LAST_STMT = $$; }
     ;
 
-asgn: TOK_IDENT "=" expr ";" { $$ = ast_mk_asgn(ast, @2, last_stmt, $1, $3); last_stmt = $$; };
+asgn: TOK_IDENT "=" expr ";" { $$ = ast_mk_asgn(ast, @2, LAST_STMT, $1, $3); LAST_STMT = $$; };
 
 retn
-    : TOK_RETURN ";"      { $$ = ast_mk_ret(ast, @1, last_stmt, NO_ID); last_stmt = $$; }
-    | TOK_RETURN expr ";" { $$ = ast_mk_ret(ast, @1, last_stmt, $2); last_stmt = $$; }
+    : TOK_RETURN ";"      { $$ = ast_mk_ret(ast, @1, LAST_STMT, NO_ID); LAST_STMT = $$; }
+    | TOK_RETURN expr ";" { $$ = ast_mk_ret(ast, @1, LAST_STMT, $2); LAST_STMT = $$; }
 
 expr
     : expr[L] "+" expr[R] { $$ = ast_mk_binop(ast, @2, $L, $R, BinOp_ADD); }
@@ -123,8 +283,12 @@ expr
 %%
 
 int yyerror(YYLTYPE *loc, Ast ast, NodeID *root, yyscan_t scanner, const char *msg) {
-    (void) ast, (void) root, (void) scanner;
+    (void) ast, (void) root;
 
-    fprintf(stderr, "%d:%d: %s\n", loc->line, loc->col, msg);
+    LexCtx *ctx = yyget_extra(scanner);
+    LineCol pos = ctx->pipe != NULL
+        ? token_pipe_lookup(ctx->pipe, *loc)
+        : line_index_lookup(ctx->lines, *loc);
+    fprintf(ctx->diag, "%u:%u: %s\n", pos.line, pos.col, msg);
     return 1;
 }
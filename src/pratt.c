@@ -0,0 +1,551 @@
+#include "pratt.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "line_index.h"
+#include "parser.h"
+#include "stats.h"
+#include "tokens.h"
+
+#define DEFAULT_CAPACITY 64
+
+typedef struct {
+    // TOK_PLUS, TOK_STAR or TOK_LPAREN
+    int kind;
+    Location loc;
+} Op;
+
+typedef struct {
+    Ast ast;
+    LineIndex lines;
+    FILE *diag;
+
+    // lookahead, never moves past the end of the input
+    const Token *tok;
+    const Token *last;
+
+    NodeID last_stmt;
+    int nerrs;
+    bool out_of_memory;
+
+    // expression stacks, reused by every expression
+    Op *ops;
+    size_t ops_size;
+    size_t ops_capacity;
+    NodeID *operands;
+    size_t operands_size;
+    size_t operands_capacity;
+} Context;
+
+//
+// helpers
+//
+
+// names bison gives the tokens in its messages
+static const char *_token_name(int kind) {
+    switch (kind) {
+    case YYEOF:
+        return "end of file";
+    case TOK_MAIN:
+        return "TOK_MAIN";
+    case TOK_RETURN:
+        return "TOK_RETURN";
+    case TOK_VOID:
+        return "TOK_VOID";
+    case TOK_BOOL:
+        return "TOK_BOOL";
+    case TOK_INT:
+        return "TOK_INT";
+    case TOK_TRUE:
+        return "TOK_TRUE";
+    case TOK_FALSE:
+        return "TOK_FALSE";
+    case TOK_PLUS:
+        return "+";
+    case TOK_STAR:
+        return "*";
+    case TOK_EQUAL:
+        return "=";
+    case TOK_LPAREN:
+        return "(";
+    case TOK_RPAREN:
+        return ")";
+    case TOK_LCURLY:
+        return "{";
+    case TOK_RCURLY:
+        return "}";
+    case TOK_SEMICOLON:
+        return ";";
+    case TOK_COMMA:
+        // bison keeps the quotes of names with a comma
+        return "\",\"";
+    case TOK_IDENT:
+        return "identifier";
+    case TOK_NUM:
+        return "number";
+    case TOK_ILLEGAL_CHAR:
+        return "illegal character";
+    default:
+        return "invalid token";
+    }
+}
+
+static inline int _kind(const Context *ctx) {
+    return ctx->tok->kind;
+}
+
+static inline void _advance(Context *ctx) {
+    if (ctx->tok != ctx->last) {
+        ++ctx->tok;
+    }
+}
+
+// reports the lookahead as unexpected, `expected` being in bison's order
+static void _error(Context *ctx, const int *expected, size_t n) {
+    ++ctx->nerrs;
+    LineCol pos = line_index_lookup(ctx->lines, ctx->tok->loc);
+    fprintf(
+        ctx->diag,
+        "%u:%u: syntax error, unexpected %s",
+        pos.line,
+        pos.col,
+        _token_name(_kind(ctx)));
+
+    for (size_t i = 0; i < n; ++i) {
+        fprintf(
+            ctx->diag, i == 0 ? ", expecting %s" : " or %s",
+            _token_name(expected[i]));
+    }
+    fputc('\n', ctx->diag);
+}
+
+static bool _expect(Context *ctx, int kind) {
+    if (_kind(ctx) != kind) {
+        _error(ctx, &kind, 1);
+        return false;
+    }
+    _advance(ctx);
+    return true;
+}
+
+// same as `stmt: error ";"`, false if the end of the input comes first
+static bool _recover(Context *ctx) {
+    while (_kind(ctx) != TOK_SEMICOLON) {
+        if (_kind(ctx) == YYEOF) {
+            return false;
+        }
+        _advance(ctx);
+    }
+    _advance(ctx);
+    return true;
+}
+
+static bool _reserve(void **data, size_t *capacity, size_t size, size_t elem) {
+    if (size < *capacity) {
+        return true;
+    }
+
+    size_t new_capacity = *capacity == 0 ? DEFAULT_CAPACITY : 2 * *capacity;
+    void *dummy = realloc(*data, new_capacity * elem);
+    if (dummy == NULL) {
+        return false;
+    }
+
+    *data = dummy;
+    *capacity = new_capacity;
+    return true;
+}
+
+// false if out of memory, in which case `node` is NO_ID too
+static bool _push_operand(Context *ctx, NodeID node) {
+    if (node == NO_ID ||
+        !_reserve(
+            (void **)&ctx->operands,
+            &ctx->operands_capacity,
+            ctx->operands_size,
+            sizeof(*ctx->operands))) {
+        ctx->out_of_memory = true;
+        return false;
+    }
+
+    ctx->operands[ctx->operands_size++] = node;
+    return true;
+}
+
+static bool _push_op(Context *ctx, int kind, Location loc) {
+    if (!_reserve(
+            (void **)&ctx->ops,
+            &ctx->ops_capacity,
+            ctx->ops_size,
+            sizeof(*ctx->ops))) {
+        ctx->out_of_memory = true;
+        return false;
+    }
+
+    ctx->ops[ctx->ops_size++] = (Op){ kind, loc };
+    return true;
+}
+
+static NodeID _push_stmt(Context *ctx, NodeID stmt) {
+    if (stmt == NO_ID) {
+        ctx->out_of_memory = true;
+    } else {
+        ctx->last_stmt = stmt;
+    }
+    return stmt;
+}
+
+//
+// expressions
+//
+
+// "(" is lower than any operator, so that it stops the reductions
+static inline int _precedence(int kind) {
+    switch (kind) {
+    case TOK_PLUS:
+        return 1;
+    case TOK_STAR:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+// pops the operators of at least `precedence` into binops, left associative
+static bool _reduce(Context *ctx, int precedence) {
+    while (ctx->ops_size > 0 &&
+           _precedence(ctx->ops[ctx->ops_size - 1].kind) >= precedence) {
+        Op op = ctx->ops[--ctx->ops_size];
+        NodeID rhs = ctx->operands[--ctx->operands_size];
+        NodeID lhs = ctx->operands[--ctx->operands_size];
+        BinOp binop = op.kind == TOK_PLUS ? BinOp_ADD : BinOp_MUL;
+
+        NodeID node = ast_mk_binop(ctx->ast, op.loc, lhs, rhs, binop);
+        if (!_push_operand(ctx, node)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// parses an expression ending with `;`, leaving it as the lookahead
+static NodeID _parse_expr(Context *ctx) {
+    ctx->ops_size = 0;
+    ctx->operands_size = 0;
+    size_t depth = 0;
+
+    for (;;) {
+        while (_kind(ctx) == TOK_LPAREN) {
+            if (!_push_op(ctx, TOK_LPAREN, ctx->tok->loc)) {
+                return NO_ID;
+            }
+            ++depth;
+            _advance(ctx);
+        }
+
+        const Token *tok = ctx->tok;
+        NodeID operand;
+        switch (tok->kind) {
+        case TOK_IDENT:
+            operand = ast_mk_var(ctx->ast, tok->loc, tok->value.ident);
+            break;
+        case TOK_NUM:
+            operand = ast_mk_int(ctx->ast, tok->loc, tok->value.num);
+            break;
+        case TOK_TRUE:
+            operand = ast_mk_bool(ctx->ast, tok->loc, true);
+            break;
+        case TOK_FALSE:
+            operand = ast_mk_bool(ctx->ast, tok->loc, false);
+            break;
+        default:
+            // too many alternatives for bison to list them
+            _error(ctx, NULL, 0);
+            return NO_ID;
+        }
+        if (!_push_operand(ctx, operand)) {
+            return NO_ID;
+        }
+        _advance(ctx);
+
+        // operators and closing parentheses up to the next operand
+        for (;;) {
+            int kind = _kind(ctx);
+            if (kind == TOK_PLUS || kind == TOK_STAR) {
+                if (!_reduce(ctx, _precedence(kind)) ||
+                    !_push_op(ctx, kind, ctx->tok->loc)) {
+                    return NO_ID;
+                }
+                _advance(ctx);
+                break;
+            }
+
+            if (kind == TOK_RPAREN && depth > 0) {
+                if (!_reduce(ctx, 1)) {
+                    return NO_ID;
+                }
+                --ctx->ops_size;
+                --depth;
+                _advance(ctx);
+            } else if (depth > 0) {
+                _error(ctx, (int[]){ TOK_PLUS, TOK_STAR, TOK_RPAREN }, 3);
+                return NO_ID;
+            } else if (kind == TOK_SEMICOLON) {
+                return _reduce(ctx, 1) ? ctx->operands[0] : NO_ID;
+            } else {
+                _error(ctx, (int[]){ TOK_PLUS, TOK_STAR, TOK_SEMICOLON }, 3);
+                return NO_ID;
+            }
+        }
+    }
+}
+
+//
+// statements
+//
+
+// NO_ID on syntax errors, which are reported, and if out of memory
+static NodeID _parse_stmt(Context *ctx) {
+    const Token *first = ctx->tok;
+
+    switch (first->kind) {
+    case TOK_BOOL:
+    case TOK_INT: {
+        _advance(ctx);
+        Type type = first->kind == TOK_BOOL ? Type_BOOL : Type_INT;
+        const Token *ident = ctx->tok;
+        if (!_expect(ctx, TOK_IDENT) || !_expect(ctx, TOK_SEMICOLON)) {
+            return NO_ID;
+        }
+        return _push_stmt(
+            ctx,
+            ast_mk_decl(
+                ctx->ast, ident->loc, ctx->last_stmt, type,
+                ident->value.ident));
+    }
+    case TOK_IDENT: {
+        _advance(ctx);
+        Location loc = ctx->tok->loc;
+        NodeID expr;
+        if (!_expect(ctx, TOK_EQUAL) || (expr = _parse_expr(ctx)) == NO_ID) {
+            return NO_ID;
+        }
+        _advance(ctx);
+        return _push_stmt(
+            ctx,
+            ast_mk_asgn(
+                ctx->ast, loc, ctx->last_stmt, first->value.ident, expr));
+    }
+    case TOK_RETURN: {
+        _advance(ctx);
+        NodeID expr = NO_ID;
+        if (_kind(ctx) != TOK_SEMICOLON &&
+            (expr = _parse_expr(ctx)) == NO_ID) {
+            return NO_ID;
+        }
+        _advance(ctx);
+        return _push_stmt(
+            ctx, ast_mk_ret(ctx->ast, first->loc, ctx->last_stmt, expr));
+    }
+    default:
+        // too many alternatives for bison to list them
+        _error(ctx, NULL, 0);
+        return NO_ID;
+    }
+}
+
+// chains the declarations of the parameters, false on syntax errors and if
+// out of memory
+static bool _parse_params(Context *ctx, NodeID *params) {
+    *params = NO_ID;
+    if (_kind(ctx) != TOK_BOOL && _kind(ctx) != TOK_INT) {
+        return true;
+    }
+
+    for (;;) {
+        Type type = _kind(ctx) == TOK_BOOL ? Type_BOOL : Type_INT;
+        _advance(ctx);
+        const Token *ident = ctx->tok;
+        if (!_expect(ctx, TOK_IDENT)) {
+            return false;
+        }
+
+        NodeID param = _push_stmt(
+            ctx,
+            ast_mk_decl(
+                ctx->ast, ident->loc, ctx->last_stmt, type,
+                ident->value.ident));
+        if (param == NO_ID) {
+            return false;
+        }
+        if (*params == NO_ID) {
+            *params = param;
+        }
+
+        if (_kind(ctx) != TOK_COMMA) {
+            return true;
+        }
+        _advance(ctx);
+        if (_kind(ctx) != TOK_BOOL && _kind(ctx) != TOK_INT) {
+            _error(ctx, (int[]){ TOK_BOOL, TOK_INT }, 2);
+            return false;
+        }
+    }
+}
+
+// everything before the first statement of the body, false on syntax errors
+// and if out of memory
+static bool _parse_header(
+    Context *ctx, Type *ret_type, Location *loc, NodeID *params) {
+    switch (_kind(ctx)) {
+    case TOK_VOID:
+        *ret_type = Type_VOID;
+        break;
+    case TOK_BOOL:
+        *ret_type = Type_BOOL;
+        break;
+    case TOK_INT:
+        *ret_type = Type_INT;
+        break;
+    default:
+        _error(ctx, (int[]){ TOK_VOID, TOK_BOOL, TOK_INT }, 3);
+        return false;
+    }
+    _advance(ctx);
+
+    // errors before the body can't be recovered from
+    *loc = ctx->tok->loc;
+    if (!_expect(ctx, TOK_MAIN) || !_expect(ctx, TOK_LPAREN) ||
+        !_parse_params(ctx, params) || !_expect(ctx, TOK_RPAREN) ||
+        !_expect(ctx, TOK_LCURLY)) {
+        return false;
+    }
+
+    // the body isn't chained after the parameters
+    ctx->last_stmt = NO_ID;
+    return true;
+}
+
+static NodeID _parse_input(Context *ctx) {
+    Type type;
+    Location loc;
+    NodeID params;
+    if (!_parse_header(ctx, &type, &loc, &params)) {
+        return NO_ID;
+    }
+
+    NodeID body = NO_ID;
+    while (_kind(ctx) != TOK_RCURLY) {
+        NodeID stmt = _parse_stmt(ctx);
+        if (ctx->out_of_memory || (stmt == NO_ID && !_recover(ctx))) {
+            return NO_ID;
+        }
+        if (body == NO_ID) {
+            body = stmt;
+        }
+    }
+
+    // like bison, whatever follows the closing "}" isn't looked at, and the
+    // statements recovered from are left out of the body
+    NodeID main = ast_mk_main(ctx->ast, loc, type, params, body);
+    if (main == NO_ID) {
+        ctx->out_of_memory = true;
+    }
+    return main;
+}
+
+//
+// parsing
+//
+
+Status pratt_parse(
+    Ast ast,
+    const Tokens tokens,
+    LineIndex lines,
+    FILE *diag,
+    NodeID *root) {
+    Context ctx = {
+        .ast = ast,
+        .lines = lines,
+        .diag = diag,
+        .tok = tokens->data,
+        .last = &tokens->data[tokens->size - 1],
+        .last_stmt = NO_ID,
+    };
+
+    *root = _parse_input(&ctx);
+
+    // the lookahead was pulled too, same as bison
+    if (stats_active != NULL) {
+        stats_active->tokens += ctx.tok - tokens->data + 1;
+    }
+
+    free(ctx.ops);
+    free(ctx.operands);
+
+    if (ctx.out_of_memory) {
+        return Status_InternalError;
+    }
+    return ctx.nerrs > 0 || *root == NO_ID ? Status_SyntaxError : Status_OK;
+}
+
+Status pratt_parse_main(
+    Ast ast,
+    const Tokens tokens,
+    LineIndex lines,
+    FILE *diag,
+    NodeID *root,
+    size_t *body) {
+    Context ctx = {
+        .ast = ast,
+        .lines = lines,
+        .diag = diag,
+        .tok = tokens->data,
+        .last = &tokens->data[tokens->size - 1],
+        .last_stmt = NO_ID,
+    };
+
+    Type type;
+    Location loc;
+    NodeID params;
+    *root = NO_ID;
+    if (_parse_header(&ctx, &type, &loc, &params)) {
+        *root = ast_mk_main(ast, loc, type, params, NO_ID);
+        ctx.out_of_memory = *root == NO_ID;
+    }
+    *body = ctx.tok - tokens->data;
+
+    if (ctx.out_of_memory) {
+        return Status_InternalError;
+    }
+    return *root == NO_ID ? Status_SyntaxError : Status_OK;
+}
+
+Status pratt_parse_stmt(
+    Ast ast,
+    const Token *tokens,
+    size_t n,
+    LineIndex lines,
+    FILE *diag,
+    NodeID *stmt) {
+    Context ctx = {
+        .ast = ast,
+        .lines = lines,
+        .diag = diag,
+        .tok = tokens,
+        .last = &tokens[n - 1],
+        .last_stmt = NO_ID,
+    };
+
+    *stmt = _parse_stmt(&ctx);
+
+    free(ctx.ops);
+    free(ctx.operands);
+
+    if (ctx.out_of_memory) {
+        return Status_InternalError;
+    }
+    return *stmt == NO_ID ? Status_SyntaxError : Status_OK;
+}
@@ -0,0 +1,657 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "precc.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "ast_visitor.h"
+#include "batch.h"
+#include "bytecode.h"
+#include "document.h"
+#include "parser.h"
+#include "lexer.h"
+#include "image.h"
+#include "initpass.h"
+#include "interp.h"
+#include "line_index.h"
+#include "pratt.h"
+#include "profile.h"
+#include "sempass.h"
+#include "stats.h"
+#include "str_pool.h"
+#include "sym_table.h"
+#include "token_pipe.h"
+#include "tokens.h"
+#include "trace.h"
+#include "type_table.h"
+#include "vm.h"
+
+struct PreccSession_S {
+    Ast ast;
+    StrPool strs;
+    NodeID root;
+    Status status;
+
+    // types of the expressions of `ast`, which is never written after parsing
+    TypeTable types;
+
+    // lex up front into `tokens` with that many threads, unless it's 1,
+    // `lexer` is flex and `parser` is bison, which scan while parsing
+    unsigned lex_threads;
+    Lexer lexer;
+    Parser parser;
+    Tokens tokens;
+
+    // format of the programs printed while they run
+    Format format;
+
+    // how `precc_session_eval` runs programs
+    Evaluator evaluator;
+    bool fuse;
+
+    // hooks of the interpreter, NULL if not tracing
+    const Tracer *tracer;
+
+    // resolves the locations of the diagnostics of the last compilation
+    LineIndex lines;
+
+    // program kept open for edits, created by the first
+    // `precc_session_open`
+    Document document;
+
+    // diagnostics of the last compilation, backed by `diag_buf`
+    FILE *diag;
+    char *diag_buf;
+    size_t diag_size;
+};
+
+//
+// constructor & destructor
+//
+
+PreccSession precc_session_create() {
+    PreccSession self = (PreccSession)calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->ast = ast_initialize();
+    self->strs = str_pool_init();
+    self->types = type_table_initialize();
+    self->root = NO_ID;
+    self->status = Status_InternalError;
+    self->lex_threads = 1;
+    self->lexer = Lexer_FLEX;
+    self->parser = Parser_BISON;
+    self->format = Format_SOURCE;
+    self->evaluator = Evaluator_INTERP;
+    self->fuse = true;
+    self->tokens = tokens_initialize();
+    self->lines = line_index_initialize();
+    self->diag = open_memstream(&self->diag_buf, &self->diag_size);
+
+    if (self->ast == NULL || self->strs == NULL || self->types == NULL ||
+        self->tokens == NULL || self->lines == NULL || self->diag == NULL) {
+        precc_session_destroy(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void precc_session_destroy(PreccSession self) {
+    if (self == NULL) {
+        return;
+    }
+
+    if (self->diag != NULL) {
+        fclose(self->diag);
+    }
+    free(self->diag_buf);
+    document_release(self->document);
+    ast_release(self->ast);
+    str_pool_release(self->strs);
+    type_table_release(self->types);
+    tokens_release(self->tokens);
+    line_index_release(self->lines);
+    free(self);
+}
+
+//
+// compilation
+//
+
+void precc_session_set_lex_threads(PreccSession self, unsigned threads) {
+    self->lex_threads = threads;
+}
+
+void precc_session_set_lexer(PreccSession self, Lexer lexer) {
+    self->lexer = lexer;
+}
+
+void precc_session_set_parser(PreccSession self, Parser parser) {
+    self->parser = parser;
+}
+
+void precc_session_set_format(PreccSession self, Format format) {
+    self->format = format;
+}
+
+void precc_session_set_evaluator(PreccSession self, Evaluator evaluator) {
+    self->evaluator = evaluator;
+}
+
+void precc_session_set_fusion(PreccSession self, bool fuse) {
+    self->fuse = fuse;
+}
+
+void precc_session_set_tracer(PreccSession self, const Tracer *tracer) {
+    self->tracer = tracer;
+}
+
+static void _clear_diag(PreccSession self) {
+    fflush(self->diag);
+    rewind(self->diag);
+    if (self->diag_size > 0) {
+        self->diag_buf[0] = '\0';
+    }
+}
+
+void precc_session_reset(PreccSession self) {
+    if (self->document != NULL) {
+        document_clear(self->document);
+    }
+    ast_clear(self->ast);
+    type_table_clear(self->types);
+    tokens_clear(self->tokens);
+    self->root = NO_ID;
+    self->status = Status_InternalError;
+
+    // nothing references the identifiers of the previous program anymore
+    StrGen gen = str_pool_begin_generation(self->strs);
+    str_pool_collect(self->strs, gen);
+
+    _clear_diag(self);
+}
+
+static Status _lex(PreccSession self, const char *src, size_t len) {
+    stats_phase_begin(Phase_LEX);
+    Status s = tokens_lex(
+        self->tokens, src, len, self->strs, self->lexer, self->lex_threads,
+        self->diag);
+    stats_phase_end(Phase_LEX);
+    return s;
+}
+
+// parses `src`, or `in` if `src` is NULL, streaming it through `passes` if any
+static Status _parse(
+    PreccSession self,
+    const char *src,
+    size_t len,
+    FILE *in,
+    AstPass *passes,
+    size_t n_passes) {
+    // locations are 32-bit offsets
+    if (src != NULL && len > UINT32_MAX) {
+        fputs("source too large, it must be under 4 GiB\n", self->diag);
+        return Status_InternalError;
+    }
+
+    // only sources that aren't kept in memory are indexed as they're read
+    line_index_reset(self->lines, src, len);
+
+    // flex takes buffer lengths as `int`, longer sources are lexed in chunks
+    bool up_front = src != NULL &&
+        (self->lex_threads != 1 || self->lexer != Lexer_FLEX ||
+         self->parser != Parser_BISON || len > INT_MAX);
+
+    if (up_front) {
+        Status s = _lex(self, src, len);
+        if (s != Status_OK) {
+            return s;
+        }
+        if (self->parser == Parser_PRATT) {
+            return pratt_parse(
+                self->ast, self->tokens, self->lines, self->diag, &self->root);
+        }
+    }
+
+    LexCtx lex_ctx = {
+        .strs = self->strs,
+        .diag = self->diag,
+        .lines = self->lines,
+        .track_lines = src == NULL,
+        .passes = passes,
+        .n_passes = n_passes,
+        .main = NO_ID,
+        .tokens = up_front ? self->tokens : NULL,
+        .next_token = 0,
+        .pipe = NULL,
+        .last_stmt = NO_ID,
+    };
+
+    yyscan_t scanner;
+    if (yylex_init_extra(&lex_ctx, &scanner)) {
+        return Status_InternalError;
+    }
+
+    YY_BUFFER_STATE state = NULL;
+    if (src != NULL && !up_front) {
+        state = yy_scan_bytes(src, (int)len, scanner);
+    } else if (src == NULL) {
+        yyset_in(in, scanner);
+    }
+    int res = yyparse(self->ast, &self->root, scanner);
+
+    if (state != NULL) {
+        yy_delete_buffer(state, scanner);
+    }
+    yylex_destroy(scanner);
+
+    if (res != 0 || self->root == NO_ID) {
+        return Status_SyntaxError;
+    }
+    return Status_OK;
+}
+
+// parses `in` with reading and lexing pipelined on other threads
+static Status _parse_piped(PreccSession self, FILE *in) {
+    line_index_reset(self->lines, NULL, 0);
+
+    TokenPipe pipe =
+        token_pipe_start(in, self->strs, self->lines, self->lexer);
+    if (pipe == NULL) {
+        return Status_InternalError;
+    }
+
+    LexCtx lex_ctx = {
+        .strs = self->strs,
+        .diag = self->diag,
+        .lines = self->lines,
+        .track_lines = false,
+        .passes = NULL,
+        .n_passes = 0,
+        .main = NO_ID,
+        .tokens = NULL,
+        .next_token = 0,
+        .pipe = pipe,
+        .last_stmt = NO_ID,
+    };
+
+    yyscan_t scanner;
+    if (yylex_init_extra(&lex_ctx, &scanner)) {
+        token_pipe_finish(pipe, self->diag);
+        return Status_InternalError;
+    }
+    int res = yyparse(self->ast, &self->root, scanner);
+    yylex_destroy(scanner);
+
+    Status s = token_pipe_finish(pipe, self->diag);
+    if (s != Status_OK) {
+        return s;
+    }
+    if (res != 0 || self->root == NO_ID) {
+        return Status_SyntaxError;
+    }
+    return Status_OK;
+}
+
+// type checks the program just parsed, then checks its reads
+static Status _check(PreccSession self) {
+    if (self->status == Status_OK) {
+        stats_phase_begin(Phase_SEMPASS);
+        self->status =
+            sempass_report(
+                self->ast, self->root, self->strs, self->types, self->diag);
+        stats_phase_end(Phase_SEMPASS);
+    }
+
+    if (self->status == Status_OK) {
+        stats_phase_begin(Phase_INITPASS);
+        self->status = initpass(
+            self->ast, self->root, self->strs, self->lines, self->diag);
+        stats_phase_end(Phase_INITPASS);
+    }
+
+    fflush(self->diag);
+    return self->status;
+}
+
+Status precc_session_compile(PreccSession self, const char *src, size_t len) {
+    precc_session_reset(self);
+
+    stats_phase_begin(Phase_PARSE);
+    self->status = _parse(self, src, len, NULL, NULL, 0);
+    stats_phase_end(Phase_PARSE);
+
+    return _check(self);
+}
+
+Status precc_session_compile_file(PreccSession self, FILE *in) {
+    precc_session_reset(self);
+
+    // reading and lexing overlap with parsing, all of it is timed as parsing
+    stats_phase_begin(Phase_PARSE);
+    self->status = _parse_piped(self, in);
+    stats_phase_end(Phase_PARSE);
+
+    return _check(self);
+}
+
+//
+// editing
+//
+
+Status precc_session_open(PreccSession self, const char *src, size_t len) {
+    precc_session_reset(self);
+
+    if (self->document == NULL) {
+        self->document = document_initialize(
+            self->ast, self->strs, self->types, self->tokens);
+        if (self->document == NULL) {
+            return Status_InternalError;
+        }
+    }
+
+    self->status = document_open(
+        self->document, src, len, self->lexer, self->lex_threads, self->diag);
+    self->root = document_root(self->document);
+
+    // the document keeps a copy of the source
+    precc_session_source(self, &len);
+
+    fflush(self->diag);
+    return self->status;
+}
+
+Status precc_session_edit(
+    PreccSession self,
+    size_t offset,
+    size_t removed,
+    const char *text,
+    size_t len) {
+    if (self->document == NULL) {
+        return Status_InternalError;
+    }
+
+    _clear_diag(self);
+    self->status =
+        document_edit(self->document, offset, removed, text, len, self->diag);
+    self->root = document_root(self->document);
+
+    fflush(self->diag);
+    return self->status;
+}
+
+const char *precc_session_source(PreccSession self, size_t *len) {
+    if (self->document == NULL) {
+        *len = 0;
+        return NULL;
+    }
+
+    const char *src = document_source(self->document, len);
+    if (src != NULL) {
+        line_index_reset(self->lines, src, *len);
+    }
+    return src;
+}
+
+static Bytecode _lower(PreccSession self) {
+    stats_phase_begin(Phase_LOWER);
+    Bytecode bytecode =
+        bytecode_compile(self->ast, self->root, self->strs, self->fuse);
+    stats_phase_end(Phase_LOWER);
+    return bytecode;
+}
+
+static Status _eval_vm(PreccSession self, Sym *result) {
+    Bytecode bytecode = _lower(self);
+    if (bytecode == NULL) {
+        return Status_InternalError;
+    }
+
+    stats_phase_begin(Phase_INTERP);
+    Status s = vm_run(bytecode_chunk(bytecode), NULL, result);
+    stats_phase_end(Phase_INTERP);
+
+    bytecode_release(bytecode);
+    return s;
+}
+
+Status precc_session_eval(PreccSession self, Sym *result) {
+    if (self->status != Status_OK) {
+        return self->status;
+    }
+
+    if (self->evaluator == Evaluator_VM) {
+        return _eval_vm(self, result);
+    }
+
+    SymTable syms = symtable_initialize();
+    if (syms == NULL) {
+        return Status_InternalError;
+    }
+
+    stats_phase_begin(Phase_INTERP);
+    *result = interp(self->ast, self->root, self->strs, syms, self->tracer);
+    symtable_release(syms);
+    stats_phase_end(Phase_INTERP);
+
+    return Status_OK;
+}
+
+Status precc_session_profile(
+    PreccSession self, Profile profile, Sym *result) {
+    if (self->status != Status_OK) {
+        return self->status;
+    }
+
+    SymTable syms = symtable_initialize();
+    if (syms == NULL) {
+        return Status_InternalError;
+    }
+
+    stats_phase_begin(Phase_INTERP);
+    *result = interp_profile(
+        self->ast, self->root, self->strs, syms, self->tracer, profile);
+    symtable_release(syms);
+    stats_phase_end(Phase_INTERP);
+
+    return Status_OK;
+}
+
+Status precc_session_write_image(PreccSession self, FILE *out) {
+    if (self->status != Status_OK) {
+        return self->status;
+    }
+
+    Bytecode bytecode = _lower(self);
+    if (bytecode == NULL) {
+        return Status_InternalError;
+    }
+
+    Status s = image_write(bytecode_chunk(bytecode), out);
+    bytecode_release(bytecode);
+    return s;
+}
+
+Status precc_session_eval_batch(
+    PreccSession self,
+    const int64_t *const *inputs,
+    size_t rows,
+    int64_t *results) {
+    if (self->status != Status_OK) {
+        return self->status;
+    }
+
+    stats_phase_begin(Phase_INTERP);
+    Batch batch = batch_compile(self->ast, self->root);
+    Status s = batch == NULL
+        ? Status_InternalError
+        : batch_eval(batch, inputs, rows, results);
+    batch_release(batch);
+    stats_phase_end(Phase_INTERP);
+
+    return s;
+}
+
+// check, then run, then print each statement
+static Status _passes_init(
+    PreccSession self,
+    AstPass passes[4],
+    size_t *n,
+    SymTable syms,
+    FILE *display,
+    Sym *result) {
+    *n = 0;
+
+    Status s =
+        sempass_pass(&passes[*n], self->strs, self->types, self->diag);
+    if (s != Status_OK) {
+        return s;
+    }
+    ++*n;
+
+    s = initpass_pass(&passes[*n], self->strs, self->lines, self->diag);
+    if (s != Status_OK) {
+        return s;
+    }
+    ++*n;
+
+    s = interp_pass(&passes[*n], self->strs, syms, self->tracer, result);
+    if (s != Status_OK) {
+        return s;
+    }
+    ++*n;
+
+    if (display != NULL && self->format != Format_NONE) {
+        s = ast_display_pass(&passes[*n], self->strs, self->format, display);
+        if (s != Status_OK) {
+            return s;
+        }
+        ++*n;
+    }
+
+    return Status_OK;
+}
+
+static void _passes_release(AstPass *passes, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        ast_pass_release(&passes[i]);
+    }
+}
+
+Status precc_session_run(
+    PreccSession self,
+    const char *src,
+    size_t len,
+    FILE *display,
+    Sym *result) {
+    precc_session_reset(self);
+
+    stats_phase_begin(Phase_PARSE);
+    self->status = _parse(self, src, len, NULL, NULL, 0);
+    stats_phase_end(Phase_PARSE);
+
+    if (self->status != Status_OK) {
+        fflush(self->diag);
+        return self->status;
+    }
+
+    SymTable syms = symtable_initialize();
+    if (syms == NULL) {
+        self->status = Status_InternalError;
+        return self->status;
+    }
+
+    stats_phase_begin(Phase_FUSED);
+    AstPass passes[4];
+    size_t n;
+    Status s = _passes_init(self, passes, &n, syms, display, result);
+    if (s == Status_OK) {
+        ast_visit_fused(self->ast, self->root, passes, n);
+        s = ast_fused_status(passes, n);
+    }
+    _passes_release(passes, n);
+    stats_phase_end(Phase_FUSED);
+    symtable_release(syms);
+
+    self->status = s;
+    fflush(self->diag);
+    return self->status;
+}
+
+Status precc_session_stream(
+    PreccSession self,
+    FILE *in,
+    FILE *display,
+    Sym *result) {
+    precc_session_reset(self);
+
+    SymTable syms = symtable_initialize();
+    if (syms == NULL) {
+        self->status = Status_InternalError;
+        return self->status;
+    }
+
+    AstPass passes[4];
+    size_t n;
+    Status s = _passes_init(self, passes, &n, syms, display, result);
+    if (s == Status_OK) {
+        // parsing and the passes interleave, all of it is timed as parsing
+        stats_phase_begin(Phase_PARSE);
+        s = _parse(self, NULL, 0, in, passes, n);
+        stats_phase_end(Phase_PARSE);
+
+        if (s == Status_OK) {
+            s = ast_fused_status(passes, n);
+        }
+    }
+
+    stats_phase_begin(Phase_FUSED);
+    _passes_release(passes, n);
+    stats_phase_end(Phase_FUSED);
+    symtable_release(syms);
+
+    self->status = s;
+    fflush(self->diag);
+    return self->status;
+}
+
+//
+// getters
+//
+
+const char *precc_session_diagnostics(PreccSession self) {
+    fflush(self->diag);
+    return self->diag_size > 0 ? self->diag_buf : "";
+}
+
+Status precc_session_status(PreccSession self) {
+    return self->status;
+}
+
+Ast precc_session_ast(PreccSession self) {
+    return self->ast;
+}
+
+NodeID precc_session_root(PreccSession self) {
+    return self->root;
+}
+
+StrPool precc_session_strs(PreccSession self) {
+    return self->strs;
+}
+
+TypeTable precc_session_types(PreccSession self) {
+    return self->types;
+}
+
+LineIndex precc_session_lines(PreccSession self) {
+    return self->lines;
+}
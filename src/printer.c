@@ -0,0 +1,52 @@
+#include "printer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+void printer_init(Printer *self, FILE *stream) {
+    self->stream = stream;
+    self->size = 0;
+}
+
+void printer_flush(Printer *self) {
+    if (self->size > 0) {
+        fwrite(self->data, 1, self->size, self->stream);
+        self->size = 0;
+    }
+}
+
+void printer_write_slow(Printer *self, const void *bytes, size_t len) {
+    const char *p = bytes;
+    while (len > 0) {
+        if (self->size == PRINTER_CAPACITY) {
+            printer_flush(self);
+        }
+
+        size_t n = PRINTER_CAPACITY - self->size;
+        n = n < len ? n : len;
+        memcpy(self->data + self->size, p, n);
+        self->size += n;
+        p += n;
+        len -= n;
+    }
+}
+
+void printer_int(Printer *self, int64_t v) {
+    // digits are written backwards from the end, INT64_MIN has 19 plus sign
+    char buf[20];
+    char *p = buf + sizeof(buf);
+
+    // negated as unsigned so INT64_MIN doesn't overflow
+    uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+
+    if (v < 0) {
+        *--p = '-';
+    }
+
+    printer_write(self, p, buf + sizeof(buf) - p);
+}
@@ -0,0 +1,303 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "profile.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ast.h"
+#include "line_index.h"
+
+// statements listed by the text report, the folded one lists all of them
+#define TOP_STMTS 20
+
+// longest source text printed for a statement
+#define MAX_TEXT 48
+
+typedef struct {
+    NodeID id;
+    uint64_t count;
+    uint64_t ticks;
+} Entry;
+
+struct Profile_S {
+    // runs and ticks by NodeID
+    uint64_t *counts;
+    uint64_t *ticks;
+    size_t nodes;
+
+    // span of the whole run, in ticks and in nanoseconds
+    uint64_t start_ticks;
+    uint64_t stop_ticks;
+    uint64_t start_ns;
+    uint64_t stop_ns;
+};
+
+static uint64_t _now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#if !defined(__x86_64__) && !defined(__i386__)
+uint64_t profile_ticks(void) {
+    return _now_ns();
+}
+#endif
+
+//
+// constructor & destructor
+//
+
+Profile profile_initialize(size_t nodes) {
+    Profile self = (Profile)calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->nodes = nodes;
+    self->counts = (uint64_t *)calloc(nodes + 1, sizeof(*self->counts));
+    self->ticks = (uint64_t *)calloc(nodes + 1, sizeof(*self->ticks));
+    if (self->counts == NULL || self->ticks == NULL) {
+        profile_release(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void profile_release(Profile self) {
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->counts);
+    free(self->ticks);
+    free(self);
+}
+
+//
+// recording
+//
+
+void profile_start(Profile self) {
+    self->start_ns = _now_ns();
+    self->start_ticks = profile_ticks();
+}
+
+void profile_stop(Profile self) {
+    self->stop_ticks = profile_ticks();
+    self->stop_ns = _now_ns();
+}
+
+void profile_add(Profile self, NodeID id, uint64_t ticks) {
+    if (id < self->nodes) {
+        ++self->counts[id];
+        self->ticks[id] += ticks;
+    }
+}
+
+//
+// reports
+//
+
+static int _by_ticks(const void *lhs, const void *rhs) {
+    const Entry *a = lhs;
+    const Entry *b = rhs;
+    if (a->ticks != b->ticks) {
+        return a->ticks < b->ticks ? 1 : -1;
+    }
+    return a->id < b->id ? -1 : a->id > b->id;
+}
+
+// the statements that ran, hottest first
+static Entry *_entries(const Profile self, size_t *n) {
+    *n = 0;
+    for (size_t id = 0; id < self->nodes; ++id) {
+        *n += self->counts[id] > 0;
+    }
+
+    Entry *entries = (Entry *)malloc((*n + 1) * sizeof(*entries));
+    if (entries == NULL) {
+        return NULL;
+    }
+
+    size_t i = 0;
+    for (size_t id = 0; id < self->nodes; ++id) {
+        if (self->counts[id] > 0) {
+            entries[i++] = (Entry){
+                .id = (NodeID)id,
+                .count = self->counts[id],
+                .ticks = self->ticks[id],
+            };
+        }
+    }
+
+    qsort(entries, *n, sizeof(*entries), _by_ticks);
+    return entries;
+}
+
+static inline bool _is_newline(char c) {
+    return c == '\n' || c == '\r';
+}
+
+// prints the line of `loc` with its indentation trimmed, up to MAX_TEXT
+// bytes. Semicolons are left out, they separate frames in folded stacks
+static void _print_text(
+    const char *src, size_t len, Location loc, bool folded, FILE *out) {
+    if (src == NULL || loc >= len) {
+        return;
+    }
+
+    size_t begin = loc;
+    while (begin > 0 && !_is_newline(src[begin - 1])) {
+        --begin;
+    }
+    while (begin < len && (src[begin] == ' ' || src[begin] == '\t')) {
+        ++begin;
+    }
+    size_t end = loc;
+    while (end < len && !_is_newline(src[end])) {
+        ++end;
+    }
+    while (end > begin && (src[end - 1] == ' ' || src[end - 1] == '\t')) {
+        --end;
+    }
+
+    size_t shown = end - begin > MAX_TEXT ? MAX_TEXT : end - begin;
+    for (size_t i = begin; i < begin + shown; ++i) {
+        if (!folded || src[i] != ';') {
+            fputc(src[i] == '\t' ? ' ' : src[i], out);
+        }
+    }
+    if (shown < end - begin) {
+        fputs("...", out);
+    }
+}
+
+static void _report_text(
+    const Profile self,
+    const Ast ast,
+    LineIndex lines,
+    const char *src,
+    size_t len,
+    const Entry *entries,
+    size_t n,
+    FILE *out) {
+    uint64_t total = self->stop_ticks - self->start_ticks;
+    double ns_per_tick =
+        total > 0 ? (double)(self->stop_ns - self->start_ns) / total : 0;
+
+    uint64_t runs = 0;
+    uint64_t in_stmts = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (ast->data[entries[i].id].kind != AstNodeKind_MAIN) {
+            runs += entries[i].count;
+            in_stmts += entries[i].ticks;
+        }
+    }
+
+    fprintf(
+        out,
+        "profile: %" PRIu64 " statements run in %.3f ms (%" PRIu64
+        " ticks)\n\n",
+        runs,
+        (self->stop_ns - self->start_ns) * 1e-6,
+        total);
+    fprintf(
+        out,
+        "%8s %8s %12s %10s %10s  %s\n",
+        "incl %",
+        "self %",
+        "time (ms)",
+        "count",
+        "line:col",
+        "source");
+
+    for (size_t i = 0; i < n && i < TOP_STMTS; ++i) {
+        const Entry *e = &entries[i];
+        const AstNode *node = &ast->data[e->id];
+
+        // the statements of main are timed on their own
+        uint64_t self_ticks = e->ticks;
+        if (node->kind == AstNodeKind_MAIN) {
+            self_ticks = e->ticks > in_stmts ? e->ticks - in_stmts : 0;
+        }
+
+        LineCol pos = line_index_lookup(lines, node->loc);
+        char where[32];
+        snprintf(where, sizeof(where), "%u:%u", pos.line, pos.col);
+
+        fprintf(
+            out,
+            "%8.2f %8.2f %12.3f %10" PRIu64 " %10s  ",
+            total > 0 ? 100.0 * e->ticks / total : 0,
+            total > 0 ? 100.0 * self_ticks / total : 0,
+            e->ticks * ns_per_tick * 1e-6,
+            e->count,
+            where);
+        _print_text(src, len, node->loc, false, out);
+        fputc('\n', out);
+    }
+
+    if (n > TOP_STMTS) {
+        fprintf(out, "%8s (%zu more)\n", "...", n - TOP_STMTS);
+    }
+}
+
+static void _report_folded(
+    const Ast ast,
+    LineIndex lines,
+    const char *src,
+    size_t len,
+    const Entry *entries,
+    size_t n,
+    FILE *out) {
+    uint64_t in_stmts = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (ast->data[entries[i].id].kind != AstNodeKind_MAIN) {
+            in_stmts += entries[i].ticks;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        const Entry *e = &entries[i];
+        const AstNode *node = &ast->data[e->id];
+
+        if (node->kind == AstNodeKind_MAIN) {
+            uint64_t self_ticks = e->ticks > in_stmts ? e->ticks - in_stmts : 0;
+            fprintf(out, "main %" PRIu64 "\n", self_ticks);
+            continue;
+        }
+
+        LineCol pos = line_index_lookup(lines, node->loc);
+        fprintf(out, "main;%u:%u ", pos.line, pos.col);
+        _print_text(src, len, node->loc, true, out);
+        fprintf(out, " %" PRIu64 "\n", e->ticks);
+    }
+}
+
+void profile_report(
+    const Profile self,
+    const Ast ast,
+    LineIndex lines,
+    const char *src,
+    size_t len,
+    ProfileFormat format,
+    FILE *out) {
+    size_t n;
+    Entry *entries = _entries(self, &n);
+    if (entries == NULL) {
+        return;
+    }
+
+    if (format == ProfileFormat_FOLDED) {
+        _report_folded(ast, lines, src, len, entries, n, out);
+    } else {
+        _report_text(self, ast, lines, src, len, entries, n, out);
+    }
+
+    free(entries);
+}
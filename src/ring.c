@@ -0,0 +1,164 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ring.h"
+
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CACHE_LINE 64
+
+// a waiting side yields the CPU that many times, then sleeps between checks
+#define YIELDS 64
+#define SLEEP_NS 20000
+
+struct Ring_S {
+    char *data;
+    size_t mask;
+    size_t item_size;
+    atomic_bool closed;
+
+    // written by the producer, with the last head it saw
+    alignas(CACHE_LINE) atomic_size_t tail;
+    size_t head_cache;
+
+    // written by the consumer, with the last tail it saw
+    alignas(CACHE_LINE) atomic_size_t head;
+    size_t tail_cache;
+};
+
+//
+// constructor & destructor
+//
+
+Ring ring_initialize(size_t capacity, size_t item_size) {
+    Ring self = (Ring)aligned_alloc(alignof(struct Ring_S), sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    size_t slots = 2;
+    while (slots < capacity) {
+        slots *= 2;
+    }
+
+    self->data = (char *)malloc(slots * item_size);
+    if (self->data == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    self->mask = slots - 1;
+    self->item_size = item_size;
+    atomic_init(&self->closed, false);
+    atomic_init(&self->tail, 0);
+    self->head_cache = 0;
+    atomic_init(&self->head, 0);
+    self->tail_cache = 0;
+    return self;
+}
+
+void ring_release(Ring self) {
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->data);
+    free(self);
+}
+
+//
+// helpers
+//
+
+static void _wait(unsigned waits) {
+    if (waits < YIELDS) {
+        sched_yield();
+        return;
+    }
+
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = SLEEP_NS };
+    nanosleep(&ts, NULL);
+}
+
+static inline size_t _min(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+//
+// interface
+//
+
+void *ring_reserve(Ring self, size_t *n) {
+    size_t capacity = self->mask + 1;
+    size_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+
+    for (unsigned waits = 0; tail - self->head_cache == capacity; ++waits) {
+        self->head_cache =
+            atomic_load_explicit(&self->head, memory_order_acquire);
+        if (tail - self->head_cache < capacity) {
+            break;
+        }
+        if (atomic_load_explicit(&self->closed, memory_order_acquire)) {
+            return NULL;
+        }
+        _wait(waits);
+    }
+
+    // the consumer closing the ring means nothing else will be read
+    if (atomic_load_explicit(&self->closed, memory_order_relaxed)) {
+        return NULL;
+    }
+
+    size_t offset = tail & self->mask;
+    *n = _min(
+        *n,
+        _min(capacity - (tail - self->head_cache), capacity - offset));
+    return self->data + offset * self->item_size;
+}
+
+void ring_commit(Ring self, size_t n) {
+    size_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+    atomic_store_explicit(&self->tail, tail + n, memory_order_release);
+}
+
+const void *ring_peek(Ring self, size_t *n) {
+    size_t capacity = self->mask + 1;
+    size_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+
+    for (unsigned waits = 0; head == self->tail_cache; ++waits) {
+        self->tail_cache =
+            atomic_load_explicit(&self->tail, memory_order_acquire);
+        if (head != self->tail_cache) {
+            break;
+        }
+
+        // the producer commits before closing, what it committed last may
+        // only be visible after seeing it closed
+        if (atomic_load_explicit(&self->closed, memory_order_acquire)) {
+            self->tail_cache =
+                atomic_load_explicit(&self->tail, memory_order_acquire);
+            if (head == self->tail_cache) {
+                return NULL;
+            }
+            break;
+        }
+        _wait(waits);
+    }
+
+    size_t offset = head & self->mask;
+    *n = _min(*n, _min(self->tail_cache - head, capacity - offset));
+    return self->data + offset * self->item_size;
+}
+
+void ring_consume(Ring self, size_t n) {
+    size_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+    atomic_store_explicit(&self->head, head + n, memory_order_release);
+}
+
+void ring_close(Ring self) {
+    atomic_store_explicit(&self->closed, true, memory_order_release);
+}
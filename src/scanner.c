@@ -0,0 +1,335 @@
+#include "scanner.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "line_index.h"
+#include "parser.h"
+#include "str_pool.h"
+#include "tokens.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__)
+#define HAVE_SSE2 1
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_AVX2 1
+#endif
+
+#define DEFAULT_CAPACITY 64
+// bytes checked one at a time before switching to SIMD
+#define SHORT_SPAN 8
+
+//
+// character classes
+//
+
+#define CLASS_WS 1
+#define CLASS_DIGIT 2
+#define CLASS_ALPHA 4
+#define CLASS_ALNUM (CLASS_DIGIT | CLASS_ALPHA)
+#define CLASS_NL 8
+
+#define RANGE_10(c, f) \
+    [(c)] = (f), [(c) + 1] = (f), [(c) + 2] = (f), [(c) + 3] = (f), \
+    [(c) + 4] = (f), [(c) + 5] = (f), [(c) + 6] = (f), [(c) + 7] = (f), \
+    [(c) + 8] = (f), [(c) + 9] = (f)
+
+#define RANGE_26(c, f) \
+    RANGE_10((c), (f)), RANGE_10((c) + 10, (f)), [(c) + 20] = (f), \
+    [(c) + 21] = (f), [(c) + 22] = (f), [(c) + 23] = (f), \
+    [(c) + 24] = (f), [(c) + 25] = (f)
+
+static const uint8_t CLASSES[256] = {
+    [' '] = CLASS_WS,
+    ['\t'] = CLASS_WS,
+    ['\n'] = CLASS_NL,
+    ['\r'] = CLASS_NL,
+    RANGE_10('0', CLASS_DIGIT),
+    RANGE_26('a', CLASS_ALPHA),
+    RANGE_26('A', CLASS_ALPHA),
+};
+
+static inline bool _is(char c, uint8_t cls) {
+    return (CLASSES[(uint8_t)c] & cls) != 0;
+}
+
+//
+// spans, length of the run of a class at the start of `p`
+//
+
+typedef size_t (*SpanFn)(const char *p, const char *end, uint8_t cls);
+
+static size_t _span_scalar(const char *p, const char *end, uint8_t cls) {
+    const char *c = p;
+    while (c < end && _is(*c, cls)) {
+        ++c;
+    }
+    return c - p;
+}
+
+#ifdef HAVE_SSE2
+// bytes >= 0x80 are negative, so they fail every `> lo` below
+static inline __m128i _class_sse2(__m128i v, uint8_t cls) {
+    __m128i digit = _mm_and_si128(
+        _mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+        _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+
+    switch (cls) {
+    case CLASS_WS:
+        return _mm_or_si128(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    case CLASS_DIGIT:
+        return digit;
+    case CLASS_ALNUM: {
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i alpha = _mm_and_si128(
+            _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+            _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+        return _mm_or_si128(alpha, digit);
+    }
+    }
+    return _mm_setzero_si128();
+}
+
+static size_t _span_sse2(const char *p, const char *end, uint8_t cls) {
+    const char *c = p;
+    for (; end - c >= 16; c += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)c);
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(_class_sse2(v, cls));
+        if ((mask & 0xFFFF) != 0) {
+            return (c - p) + __builtin_ctz(mask);
+        }
+    }
+    return (c - p) + _span_scalar(c, end, cls);
+}
+#endif
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2"))) static inline __m256i _class_avx2(
+    __m256i v, uint8_t cls) {
+    __m256i digit = _mm256_and_si256(
+        _mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+
+    switch (cls) {
+    case CLASS_WS:
+        return _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    case CLASS_DIGIT:
+        return digit;
+    case CLASS_ALNUM: {
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i alpha = _mm256_and_si256(
+            _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        return _mm256_or_si256(alpha, digit);
+    }
+    }
+    return _mm256_setzero_si256();
+}
+
+__attribute__((target("avx2"))) static size_t _span_avx2(
+    const char *p, const char *end, uint8_t cls) {
+    const char *c = p;
+    for (; end - c >= 32; c += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)c);
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_class_avx2(v, cls));
+        if (mask != 0) {
+            return (c - p) + __builtin_ctz(mask);
+        }
+    }
+    return (c - p) + _span_scalar(c, end, cls);
+}
+#endif
+
+static ScannerSpan forced_span = ScannerSpan_AUTO;
+
+// NULL if `span` isn't available
+static SpanFn _span_fn(ScannerSpan span) {
+    switch (span) {
+    case ScannerSpan_AUTO:
+#ifdef HAVE_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            return _span_avx2;
+        }
+#endif
+#ifdef HAVE_SSE2
+        return _span_sse2;
+#else
+        return _span_scalar;
+#endif
+
+    case ScannerSpan_SCALAR:
+        return _span_scalar;
+
+    case ScannerSpan_SSE2:
+#ifdef HAVE_SSE2
+        return _span_sse2;
+#else
+        return NULL;
+#endif
+
+    case ScannerSpan_AVX2:
+#ifdef HAVE_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            return _span_avx2;
+        }
+#endif
+        return NULL;
+    }
+    return NULL;
+}
+
+// most runs are a few bytes long, not worth a call to the vectorized span
+static inline size_t _span(
+    SpanFn span, const char *p, const char *end, uint8_t cls) {
+    const char *c = p;
+    for (const char *short_end = end - p > SHORT_SPAN ? p + SHORT_SPAN : end;
+         c < short_end;
+         ++c) {
+        if (!_is(*c, cls)) {
+            return c - p;
+        }
+    }
+    return c == end ? (size_t)(c - p) : (size_t)(c - p) + span(c, end, cls);
+}
+
+//
+// keywords, by a perfect hash of their length and first and last characters
+//
+
+typedef struct {
+    const char *word;
+    size_t len;
+    int kind;
+} Keyword;
+
+#define KEYWORD_HASH(first, last, len) \
+    (((uint8_t)(first) + (uint8_t)(last) + ((len) << 3)) & 15)
+
+static const Keyword KEYWORDS[16] = {
+    [KEYWORD_HASH('m', 'n', 4)] = { "main", 4, TOK_MAIN },
+    [KEYWORD_HASH('r', 'n', 6)] = { "return", 6, TOK_RETURN },
+    [KEYWORD_HASH('v', 'd', 4)] = { "void", 4, TOK_VOID },
+    [KEYWORD_HASH('b', 'l', 4)] = { "bool", 4, TOK_BOOL },
+    [KEYWORD_HASH('i', 't', 3)] = { "int", 3, TOK_INT },
+    [KEYWORD_HASH('t', 'e', 4)] = { "true", 4, TOK_TRUE },
+    [KEYWORD_HASH('f', 'e', 5)] = { "false", 5, TOK_FALSE },
+};
+
+static inline int _keyword(const char *s, size_t len) {
+    const Keyword *kw = &KEYWORDS[KEYWORD_HASH(s[0], s[len - 1], len)];
+    if (kw->len == len && memcmp(kw->word, s, len) == 0) {
+        return kw->kind;
+    }
+    return TOK_IDENT;
+}
+
+// same as `atoll`, saturating on overflow
+static int64_t _number(const char *s, size_t len) {
+    int64_t value = 0;
+    for (size_t i = 0; i < len; ++i) {
+        int digit = s[i] - '0';
+        if (value > (INT64_MAX - digit) / 10) {
+            return INT64_MAX;
+        }
+        value = value * 10 + digit;
+    }
+    return value;
+}
+
+static int _punctuator(char c) {
+    switch (c) {
+    case '*':
+        return TOK_STAR;
+    case '+':
+        return TOK_PLUS;
+    case '=':
+        return TOK_EQUAL;
+    case '(':
+        return TOK_LPAREN;
+    case ')':
+        return TOK_RPAREN;
+    case '{':
+        return TOK_LCURLY;
+    case '}':
+        return TOK_RCURLY;
+    case ';':
+        return TOK_SEMICOLON;
+    case ',':
+        return TOK_COMMA;
+    default:
+        return TOK_ILLEGAL_CHAR;
+    }
+}
+
+//
+// scanning
+//
+
+Status scanner_scan(Tokens out, const char *src, size_t len, StrPool strs) {
+    if (!tokens_reserve(out, out->size + len / 4 + DEFAULT_CAPACITY)) {
+        return Status_InternalError;
+    }
+
+    SpanFn span = _span_fn(forced_span);
+    const char *p = src;
+    const char *end = src + len;
+
+    for (;;) {
+        // whitespace and newline runs, a lone '\r' is an illegal character
+        for (size_t n = 1; p < end && n > 0; p += n) {
+            n = _is(*p, CLASS_WS) ? _span(span, p, end, CLASS_WS)
+                : _is(*p, CLASS_NL) ? line_index_newlines(p, end)
+                                    : 0;
+        }
+
+        if (out->size == out->capacity &&
+            !tokens_reserve(out, 2 * out->capacity)) {
+            return Status_InternalError;
+        }
+        Token *tok = &out->data[out->size++];
+        tok->loc = (Location)(p - src);
+
+        if (p == end) {
+            tok->kind = YYEOF;
+            return Status_OK;
+        }
+
+        size_t n = 1;
+        if (_is(*p, CLASS_ALPHA)) {
+            n += _span(span, p + 1, end, CLASS_ALNUM);
+            tok->kind = _keyword(p, n);
+            if (tok->kind == TOK_IDENT) {
+                tok->value.ident = str_pool_put_len(strs, p, n);
+                if (tok->value.ident == NO_ID) {
+                    tok->kind = TOK_ILLEGAL_CHAR;
+                }
+            }
+        } else if (_is(*p, CLASS_DIGIT)) {
+            n = _span(span, p, end, CLASS_DIGIT);
+            tok->kind = TOK_NUM;
+            tok->value.num = _number(p, n);
+        } else {
+            tok->kind = _punctuator(*p);
+        }
+
+        p += n;
+    }
+}
+
+bool scanner_set_span(ScannerSpan span) {
+    if (_span_fn(span) == NULL) {
+        return false;
+    }
+    forced_span = span;
+    return true;
+}
@@ -1,21 +1,48 @@
-#include "../include/ast_visitor.h"
+#include "../include/ast.h"
+#include "../include/stats.h"
+#include "../include/str_pool.h"
 #include "../include/sym_table.h"
 #include "../include/error.h"
+#include "../include/sempass.h"
+#include "../include/type_table.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// TODO: When we define blocks and functions these workarounds should go
-#define MAIN_STR "main"
-bool pending_return = false;
+typedef struct {
+    SymTable syms;
+    bool owns_syms;
+    StrPool strs;
+    FILE *diag;
+    bool pending_return;
+    size_t dispatches;
 
-void error_msg(Status status, const char *detailed_msg) {
+    // type `main` returns, which every `return` must match
+    Type ret_type;
+
+    // types of the expressions, by NodeID, reserved in `table` for every
+    // node of the AST before walking it
+    TypeTable table;
+    Type *types;
+    bool owns_table;
+
+    // type expressions with `_sweep_expr` instead of walking them
+    bool linear;
+
+    // first error in the body of main, only tracked by the fused pass
+    Status body_status;
+} Context;
+
+void error_msg(FILE *stream, Status status, const char *detailed_msg) {
     char *error_msg;
     switch (status) {
     case Status_UndeclSymbol:
         error_msg = "Undeclared symbol";
         break;
+    case Status_UninitSymbol:
+        error_msg = "Use of uninitialized symbol";
+        break;
     case Status_TypeError:
         error_msg = "Incompatible types";
         break;
@@ -29,171 +56,468 @@ void error_msg(Status status, const char *detailed_msg) {
         return;
     }
 
-    fprintf(stderr, "Error: %s %s\n", error_msg, detailed_msg);
+    fprintf(stream, "Error: %s %s\n", error_msg, detailed_msg);
+}
+
+static Status _tyck_int_constant(Context *ctx, const Ast ast, AstNode *e);
+static Status _tyck_bool_constant(Context *ctx, const Ast ast, AstNode *e);
+static Status _tyck_var(Context *ctx, const Ast ast, AstNode *e);
+static Status _tyck_binary_expr(Context *ctx, const Ast ast, AstNode *expr);
+static Status _tyck_declaration(Context *ctx, const Ast ast, AstNode *stmt);
+static Status _tyck_assignment(Context *ctx, const Ast ast, AstNode *stmt);
+static Status _tyck_return(Context *ctx, const Ast ast, AstNode *stmt);
+static Status _tyck_main(Context *ctx, const Ast ast, AstNode *stmt);
+static Status _tyck_check_expr(Context *ctx, const Ast ast, NodeID id);
+
+#define WALK_NAME _tyck
+#define WALK_CTX Context
+#define WALK_ON_DISPATCH(ctx) (++(ctx)->dispatches)
+#define WALK_INT_CONSTANT _tyck_int_constant
+#define WALK_BOOL_CONSTANT _tyck_bool_constant
+#define WALK_VAR _tyck_var
+#define WALK_BINOP _tyck_binary_expr
+#define WALK_DECL _tyck_declaration
+#define WALK_ASGN _tyck_assignment
+#define WALK_RET _tyck_return
+#define WALK_MAIN _tyck_main
+#include "../include/ast_walk.h"
+
+static inline void _set_type(
+    Context *ctx, const Ast ast, const AstNode *e, Type type) {
+    ctx->types[e - ast->data] = type;
 }
 
-Status _tyck_int_constant(Visitor v, NodeID e_id) {
-    ast_get_expr(visitor_get_ast(v), e_id)->header.expr_type = Type_INT;
+static Status _tyck_int_constant(Context *ctx, const Ast ast, AstNode *e) {
+    _set_type(ctx, ast, e, Type_INT);
     return Status_OK;
 }
 
-Status _tyck_bool_constant(Visitor v, NodeID e_id) {
-    ast_get_expr(visitor_get_ast(v), e_id)->header.expr_type = Type_BOOL;
+static Status _tyck_bool_constant(Context *ctx, const Ast ast, AstNode *e) {
+    _set_type(ctx, ast, e, Type_BOOL);
     return Status_OK;
 }
 
-Status _tyck_var(Visitor v, NodeID e_id) {
-    AstNode *e = ast_get_expr(visitor_get_ast(v), e_id);
-    SymNode symnode =
-        symtable_get_info((SymTable)visitor_get_context(v), e->data.VAR);
+static Status _tyck_var(Context *ctx, const Ast ast, AstNode *e) {
+    SymNode symnode = symtable_get_info(ctx->syms, e->data.VAR);
 
     if (symnode == NULL) {
         error_msg(
+            ctx->diag,
             Status_UndeclSymbol,
-            str_pool_get(visitor_get_strs(v), e->data.VAR));
+            str_pool_get(ctx->strs, e->data.VAR));
         return Status_UndeclSymbol;
     }
 
-    e->header.expr_type = symnode_get_symbol(symnode)->type;
+    _set_type(ctx, ast, e, symnode_get_symbol(symnode)->type);
     return Status_OK;
 }
 
-Status _tyck_binary_expr(Visitor v, NodeID e_id) {
-    Ast ast = visitor_get_ast(v);
-    AstNode *expr = ast_get_expr(ast, e_id);
-
+static Status _tyck_binary_expr(Context *ctx, const Ast ast, AstNode *expr) {
     Status s_l, s_r;
-    if ((s_l = visit_expr(v, expr->data.BINOP.lhs)) != Status_OK)
+    if ((s_l = _tyck_expr(ctx, ast, expr->data.BINOP.lhs)) != Status_OK)
         return s_l;
-    if ((s_r = visit_expr(v, expr->data.BINOP.rhs)) != Status_OK)
+    if ((s_r = _tyck_expr(ctx, ast, expr->data.BINOP.rhs)) != Status_OK)
         return s_r;
 
-    if (ast_get_expr(ast, expr->data.BINOP.lhs)->header.expr_type != Type_INT ||
-        ast_get_expr(ast, expr->data.BINOP.rhs)->header.expr_type != Type_INT) {
-        error_msg(Status_TypeError, "in binary operation, int expected");
+    if (ctx->types[expr->data.BINOP.lhs] != Type_INT ||
+        ctx->types[expr->data.BINOP.rhs] != Type_INT) {
+        error_msg(
+            ctx->diag, Status_TypeError, "in binary operation, int expected");
         return Status_TypeError;
     }
 
-    expr->header.expr_type = Type_INT;
+    _set_type(ctx, ast, expr, Type_INT);
     return Status_OK;
 }
 
-Status _tyck_declaration(Visitor v, NodeID s_id) {
-    SymTable sym_table = (SymTable)visitor_get_context(v);
-    AstNode *stmt = ast_get_stmt(visitor_get_ast(v), s_id);
-
-    if (symtable_get_info(sym_table, stmt->data.DECL.var) != NULL) {
+static Status _tyck_declaration(Context *ctx, const Ast ast, AstNode *stmt) {
+    (void)ast;
+    if (symtable_get_info(ctx->syms, stmt->data.DECL.var) != NULL) {
         error_msg(
+            ctx->diag,
             Status_MultiDeclSymbol,
-            str_pool_get(visitor_get_strs(v), stmt->data.DECL.var));
+            str_pool_get(ctx->strs, stmt->data.DECL.var));
         return Status_MultiDeclSymbol;
     }
 
-    symtable_add_symbol(sym_table, stmt->data.DECL.var, stmt->data.DECL.type);
+    if (!symtable_add_symbol(
+            ctx->syms, stmt->data.DECL.var, stmt->data.DECL.type)) {
+        return Status_InternalError;
+    }
     return Status_OK;
 }
 
-Status _tyck_assignment(Visitor v, NodeID s_id) {
-    Ast ast = visitor_get_ast(v);
-    AstNode *stmt = ast_get_stmt(ast, s_id);
-
-    SymNode symnode = symtable_get_info(
-        (SymTable)visitor_get_context(v), stmt->data.DECL.var);
+static Status _tyck_assignment(Context *ctx, const Ast ast, AstNode *stmt) {
+    SymNode symnode = symtable_get_info(ctx->syms, stmt->data.ASGN.var);
 
     if (symnode == NULL) {
         error_msg(
+            ctx->diag,
             Status_UndeclSymbol,
-            str_pool_get(visitor_get_strs(v), stmt->data.DECL.var));
+            str_pool_get(ctx->strs, stmt->data.ASGN.var));
         return Status_UndeclSymbol;
     }
 
-    Status s;
-    if ((s = visit_expr(v, stmt->data.ASGN.expr)) != Status_OK) {
+    Status s = _tyck_check_expr(ctx, ast, stmt->data.ASGN.expr);
+    if (s != Status_OK) {
         return s;
     }
 
-    Type expr_type = ast_get_expr(ast, stmt->data.ASGN.expr)->header.expr_type;
+    Type expr_type = ctx->types[stmt->data.ASGN.expr];
 
     if (symnode_get_symbol(symnode)->type != expr_type) {
-        error_msg(Status_TypeError, "in assignment");
+        error_msg(ctx->diag, Status_TypeError, "in assignment");
         return Status_TypeError;
     }
 
     return Status_OK;
 }
 
-Status _tyck_return(Visitor v, NodeID s_id) {
-    pending_return = false;
-    Type main_sym_type =
-        symnode_get_symbol(symtable_get_info(
-                               (SymTable)visitor_get_context(v),
-                               str_pool_put(visitor_get_strs(v), MAIN_STR)))
-            ->type;
+static Status _tyck_return(Context *ctx, const Ast ast, AstNode *stmt) {
+    ctx->pending_return = false;
+    Type main_sym_type = ctx->ret_type;
 
-    Ast ast = visitor_get_ast(v);
-    AstNode *stmt = ast_get_stmt(ast, s_id);
-
-    if (ast_get_expr(ast, stmt->data.RET) == NULL) {
+    if (stmt->data.RET == NO_ID) {
         if (main_sym_type != Type_VOID) {
-            error_msg(Status_MissingReturn, "");
+            error_msg(ctx->diag, Status_MissingReturn, "");
             return Status_TypeError;
         }
         return Status_OK;
     }
 
     Status s;
-    if ((s = visit_expr(v, stmt->data.RET)) != Status_OK) {
+    if ((s = _tyck_check_expr(ctx, ast, stmt->data.RET)) != Status_OK) {
         return s;
     }
 
-    if (ast_get_expr(ast, stmt->data.RET)->header.expr_type != main_sym_type) {
-        error_msg(Status_TypeError, "in return Expr");
+    if (ctx->types[stmt->data.RET] != main_sym_type) {
+        error_msg(ctx->diag, Status_TypeError, "in return Expr");
         return Status_TypeError;
     }
 
     return Status_OK;
 }
 
-Status _tyck_main(Visitor v, NodeID s_id) {
-    AstNode *stmt = ast_get_stmt(visitor_get_ast(v), s_id);
-    pending_return = stmt->data.MAIN.ret_type != Type_VOID;
+//
+// linear sweep
+//
+
+/*
+ * `ast_mk_*` pushes children before their parent, so the nodes of an
+ * expression sit in post-order right before its root. Scanning them forward
+ * finds the types of the operands already written to `ctx->types`.
+ *
+ * The walk stops at the first error, left to right, which is also the first
+ * node in the range that fails on its own: an operation whose operand failed
+ * is given Type_VOID, which no valid expression has, and reports nothing.
+ */
+static Status _sweep_expr(Context *ctx, const Ast ast, NodeID root) {
+    NodeID start = root;
+    while (ast->data[start].kind == AstNodeKind_BINOP &&
+           ast->data[start].data.BINOP.lhs < start) {
+        start = ast->data[start].data.BINOP.lhs;
+    }
 
-    symtable_add_symbol(
-        (SymTable)visitor_get_context(v),
-        str_pool_put(visitor_get_strs(v), MAIN_STR),
-        stmt->data.MAIN.ret_type);
+    Status status = Status_OK;
+    StrID undecl = NO_ID;
+    size_t binops = 0;
+
+    for (NodeID id = start; id <= root; ++id) {
+        AstNode *e = &ast->data[id];
+        Type type;
+
+        switch (e->kind) {
+        case AstNodeKind_INT_CONSTANT:
+            type = Type_INT;
+            break;
+
+        case AstNodeKind_BOOL_CONSTANT:
+            type = Type_BOOL;
+            break;
+
+        case AstNodeKind_VAR: {
+            SymNode symnode = symtable_get_info(ctx->syms, e->data.VAR);
+            if (symnode != NULL) {
+                type = symnode_get_symbol(symnode)->type;
+                break;
+            }
+
+            type = Type_VOID;
+            if (status == Status_OK) {
+                status = Status_UndeclSymbol;
+                undecl = e->data.VAR;
+            }
+            break;
+        }
 
-    Status s;
-    if ((s = visit_stmt(v, stmt->data.MAIN.body)) != Status_OK) {
-        return s;
+        case AstNodeKind_BINOP: {
+            NodeID lhs = e->data.BINOP.lhs, rhs = e->data.BINOP.rhs;
+            if (lhs < start || lhs >= id || rhs < start || rhs >= id) {
+                // not laid out in post-order, walk it instead
+                return _tyck_expr(ctx, ast, root);
+            }
+
+            ++binops;
+            Type lhs_type = ctx->types[lhs];
+            Type rhs_type = ctx->types[rhs];
+            if (lhs_type == Type_VOID || rhs_type == Type_VOID) {
+                type = Type_VOID;
+            } else if (lhs_type != Type_INT || rhs_type != Type_INT) {
+                type = Type_VOID;
+                if (status == Status_OK) {
+                    status = Status_TypeError;
+                }
+            } else {
+                type = Type_INT;
+            }
+            break;
+        }
+
+        default:
+            return _tyck_expr(ctx, ast, root);
+        }
+
+        ctx->types[id] = type;
+    }
+
+    // a binary tree has one more leaf than operations, anything else in the
+    // range isn't part of the expression
+    if (root - start + 1 != 2 * binops + 1) {
+        return _tyck_expr(ctx, ast, root);
+    }
+    ctx->dispatches += root - start + 1;
+
+    switch (status) {
+    case Status_UndeclSymbol:
+        error_msg(ctx->diag, status, str_pool_get(ctx->strs, undecl));
+        break;
+    case Status_TypeError:
+        error_msg(ctx->diag, status, "in binary operation, int expected");
+        break;
+    default:
+        break;
     }
 
-    if (pending_return) {
-        error_msg(Status_MissingReturn, "");
+    return status;
+}
+
+static Status _tyck_check_expr(Context *ctx, const Ast ast, NodeID id) {
+    return ctx->linear ? _sweep_expr(ctx, ast, id) : _tyck_expr(ctx, ast, id);
+}
+
+static void _tyck_enter_main(Context *ctx, AstNode *stmt) {
+    ctx->ret_type = stmt->data.MAIN.ret_type;
+    ctx->pending_return = ctx->ret_type != Type_VOID;
+}
+
+static Status _tyck_leave_main(Context *ctx) {
+    if (ctx->pending_return) {
+        error_msg(ctx->diag, Status_MissingReturn, "");
         return Status_MissingReturn;
     }
 
     return Status_OK;
 }
 
+static Status _tyck_main(Context *ctx, const Ast ast, AstNode *stmt) {
+    _tyck_enter_main(ctx, stmt);
+
+    // parameters are declared like the variables of the body
+    Status s;
+    if ((s = _tyck_seq(ctx, ast, stmt->data.MAIN.params)) != Status_OK ||
+        (s = _tyck_seq(ctx, ast, stmt->data.MAIN.body)) != Status_OK) {
+        return s;
+    }
+
+    return _tyck_leave_main(ctx);
+}
+
+// `syms` and `types` NULL to check with tables of its own
+static bool _context_init(
+    Context *ctx,
+    SymTable syms,
+    StrPool strs,
+    TypeTable types,
+    FILE *diag,
+    bool linear) {
+    *ctx = (Context){
+        .syms = syms != NULL ? syms : symtable_initialize(),
+        .owns_syms = syms == NULL,
+        .strs = strs,
+        .diag = diag,
+        .pending_return = false,
+        .dispatches = 0,
+        .ret_type = Type_VOID,
+        .table = types != NULL ? types : type_table_initialize(),
+        .types = NULL,
+        .owns_table = types == NULL,
+        .linear = linear,
+        .body_status = Status_OK,
+    };
+
+    return ctx->syms != NULL && ctx->table != NULL;
+}
+
+// the types of a previous check are forgotten by whole program checks
+static void _context_forget_types(Context *ctx) {
+    if (ctx->table != NULL) {
+        type_table_clear(ctx->table);
+    }
+}
+
+static void _context_release(Context *ctx) {
+    stats_count_callbacks(ctx->dispatches);
+    if (ctx->owns_syms && ctx->syms != NULL) {
+        symtable_release(ctx->syms);
+    }
+    if (ctx->owns_table) {
+        type_table_release(ctx->table);
+    }
+}
+
 Status sempass(const Ast ast, NodeID node_id, StrPool strs) {
-    SymTable sym_table = symtable_initialize();
-
-    Visitor visitor = init_visitor(
-        ast,
-        strs,
-        sym_table,
-        _tyck_int_constant,
-        _tyck_bool_constant,
-        _tyck_var,
-        _tyck_binary_expr,
-        _tyck_declaration,
-        _tyck_assignment,
-        _tyck_return,
-        _tyck_main);
-
-    Status status = ast_visit(visitor, node_id);
-
-    symtable_release(sym_table);
+    return sempass_report(ast, node_id, strs, NULL, stderr);
+}
+
+static Status _sempass(
+    const Ast ast,
+    NodeID node_id,
+    StrPool strs,
+    TypeTable types,
+    FILE *diag,
+    bool linear) {
+    if (ast->size <= node_id) {
+        return Status_InternalError;
+    }
+
+    Context ctx;
+    Status status = Status_InternalError;
+    bool ok = _context_init(&ctx, NULL, strs, types, diag, linear);
+    _context_forget_types(&ctx);
+    if (ok && (ctx.types = type_table_reserve(ctx.table, ast->size)) != NULL) {
+        status = _tyck_stmt(&ctx, ast, node_id);
+    }
+
+    _context_release(&ctx);
     return status;
 }
+
+Status sempass_report(
+    const Ast ast,
+    NodeID node_id,
+    StrPool strs,
+    TypeTable types,
+    FILE *diag) {
+    return _sempass(ast, node_id, strs, types, diag, false);
+}
+
+Status sempass_linear(
+    const Ast ast,
+    NodeID node_id,
+    StrPool strs,
+    TypeTable types,
+    FILE *diag) {
+    return _sempass(ast, node_id, strs, types, diag, true);
+}
+
+Status sempass_stmt(
+    const Ast ast,
+    NodeID stmt,
+    StrPool strs,
+    SymTable syms,
+    Type ret_type,
+    TypeTable types,
+    FILE *diag) {
+    if (ast->size <= stmt) {
+        return Status_InternalError;
+    }
+
+    Context ctx;
+    Status status = Status_InternalError;
+    if (_context_init(&ctx, syms, strs, types, diag, false)) {
+        ctx.ret_type = ret_type;
+        ctx.types = type_table_reserve(ctx.table, ast->size);
+        if (ctx.types != NULL) {
+            status = _tyck_stmt(&ctx, ast, stmt);
+        }
+    }
+
+    _context_release(&ctx);
+    return status;
+}
+
+//
+// fused pass
+//
+
+static Status _tyck_pass_enter_main(void *context, const Ast ast, NodeID id) {
+    Context *ctx = context;
+    _tyck_enter_main(ctx, &ast->data[id]);
+
+    ctx->types = type_table_reserve(ctx->table, ast->size);
+    if (ctx->types == NULL) {
+        return Status_InternalError;
+    }
+
+    ctx->body_status = _tyck_seq(ctx, ast, ast->data[id].data.MAIN.params);
+    return ctx->body_status;
+}
+
+static Status _tyck_pass_stmt(void *context, const Ast ast, NodeID id) {
+    Context *ctx = context;
+
+    // the AST grows between statements
+    ctx->types = type_table_reserve(ctx->table, ast->size);
+    if (ctx->types == NULL) {
+        return Status_InternalError;
+    }
+
+    Status s = _tyck_stmt(ctx, ast, id);
+    if (ctx->body_status == Status_OK) {
+        ctx->body_status = s;
+    }
+    return s;
+}
+
+static Status _tyck_pass_leave_main(void *context, const Ast ast, NodeID id) {
+    (void)ast, (void)id;
+    Context *ctx = context;
+
+    // same as `_tyck_main`, a broken body hides the missing return
+    if (ctx->body_status != Status_OK) {
+        return Status_OK;
+    }
+    return _tyck_leave_main(ctx);
+}
+
+static void _tyck_pass_release(void *context) {
+    Context *ctx = context;
+    _context_release(ctx);
+    free(ctx);
+}
+
+Status sempass_pass(AstPass *pass, StrPool strs, TypeTable types, FILE *diag) {
+    Context *ctx = malloc(sizeof(*ctx));
+    if (ctx == NULL) {
+        return Status_InternalError;
+    }
+
+    bool ok = _context_init(ctx, NULL, strs, types, diag, false);
+    _context_forget_types(ctx);
+    if (!ok) {
+        _context_release(ctx);
+        free(ctx);
+        return Status_InternalError;
+    }
+
+    *pass = (AstPass){
+        .context = ctx,
+        .enter_main = _tyck_pass_enter_main,
+        .visit_stmt = _tyck_pass_stmt,
+        .leave_main = _tyck_pass_leave_main,
+        .release = _tyck_pass_release,
+        .gated = false,
+        .status = Status_OK,
+    };
+    return Status_OK;
+}
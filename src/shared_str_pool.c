@@ -0,0 +1,374 @@
+#include "shared_str_pool.h"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CAPACITY 64
+#define CACHE_LINE 64
+
+#define SHARD_BITS 6
+#define SHARDS (1 << SHARD_BITS)
+
+// string storage of a shard grows in blocks doubling up to the largest size
+#define BLOCK_MIN 1024
+#define BLOCK_MAX (64 * 1024)
+
+// segment `k` of the entries holds DEFAULT_CAPACITY << k of them, enough
+// segments to cover every StrID
+#define SEGMENTS 27
+
+typedef struct {
+    const char *str;
+    uint32_t len;
+    uint32_t hash;
+} SharedEntry;
+
+// open addressing with linear probing, read without locking
+typedef struct Index_S {
+    size_t mask;
+    // tables this one replaced, readers may still be probing them so they're
+    // only freed with the pool
+    struct Index_S *retired;
+    _Atomic StrID slots[];
+} Index;
+
+typedef struct Block_S {
+    struct Block_S *next;
+    size_t size;
+    size_t capacity;
+    char data[];
+} Block;
+
+typedef struct {
+    // taken to add strings, never to look them up
+    alignas(CACHE_LINE) pthread_mutex_t lock;
+    _Atomic(Index *) index;
+    size_t count;
+    Block *blocks;
+} Shard;
+
+struct SharedStrPool_S {
+    Shard shards[SHARDS];
+
+    // StrID -> string, segments are allocated once and never move
+    _Atomic(SharedEntry *) segments[SEGMENTS];
+    alignas(CACHE_LINE) _Atomic uint32_t next_id;
+};
+
+//
+// helpers
+//
+
+// FNV-1a, the same as `StrPool`
+static uint32_t _hash(const char *sym, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)sym[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static Index *_index_new(size_t capacity) {
+    Index *index =
+        (Index *)malloc(sizeof(*index) + capacity * sizeof(index->slots[0]));
+    if (index == NULL) {
+        return NULL;
+    }
+
+    index->mask = capacity - 1;
+    index->retired = NULL;
+    for (size_t i = 0; i < capacity; ++i) {
+        atomic_init(&index->slots[i], NO_ID);
+    }
+    return index;
+}
+
+static inline size_t _segment(StrID id, size_t *offset) {
+    uint64_t v = (uint64_t)id + DEFAULT_CAPACITY;
+    int high = 63 - __builtin_clzll(v);
+    *offset = v - ((uint64_t)1 << high);
+    return high - __builtin_ctz(DEFAULT_CAPACITY);
+}
+
+static inline const SharedEntry *_entry(SharedStrPool self, StrID id) {
+    size_t offset;
+    size_t segment = _segment(id, &offset);
+    // ordered by the acquire load of the slot that led to `id`
+    return &atomic_load_explicit(
+        &self->segments[segment], memory_order_relaxed)[offset];
+}
+
+// the entry of a freshly handed out `id`, allocating its segment if no other
+// thread did
+static SharedEntry *_entry_reserve(SharedStrPool self, StrID id) {
+    size_t offset;
+    size_t segment = _segment(id, &offset);
+
+    SharedEntry *entries =
+        atomic_load_explicit(&self->segments[segment], memory_order_acquire);
+    if (entries != NULL) {
+        return &entries[offset];
+    }
+
+    SharedEntry *dummy = (SharedEntry *)calloc(
+        (size_t)DEFAULT_CAPACITY << segment, sizeof(*dummy));
+    if (dummy == NULL) {
+        return NULL;
+    }
+    if (!atomic_compare_exchange_strong_explicit(
+            &self->segments[segment],
+            &entries,
+            dummy,
+            memory_order_acq_rel,
+            memory_order_acquire)) {
+        // another shard got there first
+        free(dummy);
+        return &entries[offset];
+    }
+    return &dummy[offset];
+}
+
+static StrID _index_find(
+    SharedStrPool self,
+    const Index *index,
+    const char *sym,
+    size_t len,
+    uint32_t hash) {
+    for (size_t slot = hash & index->mask;; slot = (slot + 1) & index->mask) {
+        StrID id = atomic_load_explicit(
+            &index->slots[slot], memory_order_acquire);
+        if (id == NO_ID) {
+            return NO_ID;
+        }
+
+        const SharedEntry *entry = _entry(self, id);
+        if (entry->hash == hash && entry->len == len &&
+            memcmp(entry->str, sym, len) == 0) {
+            return id;
+        }
+    }
+}
+
+// publishes `id`, its entry must be filled in already
+static void _index_insert(Index *index, StrID id, uint32_t hash) {
+    size_t slot = hash & index->mask;
+    while (atomic_load_explicit(&index->slots[slot], memory_order_relaxed) !=
+           NO_ID) {
+        slot = (slot + 1) & index->mask;
+    }
+    atomic_store_explicit(&index->slots[slot], id, memory_order_release);
+}
+
+// replaces the index of `shard` with one twice as large, called with its lock
+static Index *_index_grow(SharedStrPool self, Shard *shard, Index *index) {
+    Index *dummy = _index_new(2 * (index->mask + 1));
+    if (dummy == NULL) {
+        return NULL;
+    }
+
+    for (size_t slot = 0; slot <= index->mask; ++slot) {
+        StrID id =
+            atomic_load_explicit(&index->slots[slot], memory_order_relaxed);
+        if (id != NO_ID) {
+            _index_insert(dummy, id, _entry(self, id)->hash);
+        }
+    }
+
+    dummy->retired = index;
+    atomic_store_explicit(&shard->index, dummy, memory_order_release);
+    return dummy;
+}
+
+// copies `sym` into the storage of `shard`, called with its lock
+static const char *_store(Shard *shard, const char *sym, size_t len) {
+    Block *block = shard->blocks;
+    if (block == NULL || block->capacity - block->size < len + 1) {
+        size_t capacity = block == NULL ? BLOCK_MIN : 2 * block->capacity;
+        capacity = capacity < BLOCK_MAX ? capacity : BLOCK_MAX;
+        capacity = capacity < len + 1 ? len + 1 : capacity;
+
+        Block *dummy = (Block *)malloc(sizeof(*dummy) + capacity);
+        if (dummy == NULL) {
+            return NULL;
+        }
+        dummy->next = block;
+        dummy->size = 0;
+        dummy->capacity = capacity;
+        shard->blocks = block = dummy;
+    }
+
+    char *str = &block->data[block->size];
+    memcpy(str, sym, len);
+    str[len] = '\0';
+    block->size += len + 1;
+    return str;
+}
+
+// adds a string known not to be in `shard`, called with its lock
+static StrID _add(
+    SharedStrPool self,
+    Shard *shard,
+    const char *sym,
+    size_t len,
+    uint32_t hash) {
+    // keeping the index at most half full
+    Index *index = atomic_load_explicit(&shard->index, memory_order_relaxed);
+    if (2 * (shard->count + 1) > index->mask + 1 &&
+        (index = _index_grow(self, shard, index)) == NULL) {
+        return NO_ID;
+    }
+
+    const char *str = _store(shard, sym, len);
+    if (str == NULL) {
+        return NO_ID;
+    }
+
+    StrID id =
+        atomic_fetch_add_explicit(&self->next_id, 1, memory_order_relaxed);
+    if (id == NO_ID) {
+        return NO_ID;
+    }
+
+    // a failure here leaves a hole in the IDs, which `get` reports as NULL
+    SharedEntry *entry = _entry_reserve(self, id);
+    if (entry == NULL) {
+        return NO_ID;
+    }
+    *entry = (SharedEntry){ .str = str, .len = len, .hash = hash };
+
+    _index_insert(index, id, hash);
+    ++shard->count;
+    return id;
+}
+
+//
+// constructor & destructor
+//
+
+SharedStrPool shared_str_pool_init() {
+    SharedStrPool self = (SharedStrPool)aligned_alloc(
+        alignof(struct SharedStrPool_S), sizeof(struct SharedStrPool_S));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    size_t shard = 0;
+    for (; shard < SHARDS; ++shard) {
+        Shard *s = &self->shards[shard];
+        Index *index = _index_new(DEFAULT_CAPACITY);
+        if (index == NULL) {
+            break;
+        }
+        if (pthread_mutex_init(&s->lock, NULL)) {
+            free(index);
+            break;
+        }
+
+        atomic_init(&s->index, index);
+        s->count = 0;
+        s->blocks = NULL;
+    }
+
+    if (shard < SHARDS) {
+        while (shard-- > 0) {
+            pthread_mutex_destroy(&self->shards[shard].lock);
+            free(atomic_load(&self->shards[shard].index));
+        }
+        free(self);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < SEGMENTS; ++i) {
+        atomic_init(&self->segments[i], NULL);
+    }
+    atomic_init(&self->next_id, 0);
+    return self;
+}
+
+void shared_str_pool_release(SharedStrPool self) {
+    if (self == NULL) {
+        return;
+    }
+
+    for (size_t shard = 0; shard < SHARDS; ++shard) {
+        Shard *s = &self->shards[shard];
+        pthread_mutex_destroy(&s->lock);
+
+        for (Index *index = atomic_load(&s->index); index != NULL;) {
+            Index *retired = index->retired;
+            free(index);
+            index = retired;
+        }
+        for (Block *block = s->blocks; block != NULL;) {
+            Block *next = block->next;
+            free(block);
+            block = next;
+        }
+    }
+
+    for (size_t i = 0; i < SEGMENTS; ++i) {
+        free(atomic_load(&self->segments[i]));
+    }
+    free(self);
+}
+
+//
+// interface
+//
+
+StrID shared_str_pool_put(SharedStrPool self, const char *sym) {
+    return shared_str_pool_put_len(self, sym, strlen(sym));
+}
+
+StrID shared_str_pool_put_len(SharedStrPool self, const char *sym, size_t len) {
+    uint32_t hash = _hash(sym, len);
+    // the low bits pick the slot, the high ones the shard
+    Shard *shard = &self->shards[hash >> (32 - SHARD_BITS)];
+
+    // already in table, a table being replaced may miss strings that the
+    // locked lookup below finds
+    StrID id = _index_find(
+        self,
+        atomic_load_explicit(&shard->index, memory_order_acquire),
+        sym,
+        len,
+        hash);
+    if (id != NO_ID) {
+        return id;
+    }
+
+    pthread_mutex_lock(&shard->lock);
+    id = _index_find(
+        self,
+        atomic_load_explicit(&shard->index, memory_order_relaxed),
+        sym,
+        len,
+        hash);
+    if (id == NO_ID) {
+        id = _add(self, shard, sym, len, hash);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return id;
+}
+
+const char *shared_str_pool_get(SharedStrPool self, StrID id) {
+    if (shared_str_pool_id_bound(self) <= id) {
+        return NULL;
+    }
+
+    size_t offset;
+    SharedEntry *entries = atomic_load_explicit(
+        &self->segments[_segment(id, &offset)], memory_order_acquire);
+    return entries == NULL ? NULL : entries[offset].str;
+}
+
+size_t shared_str_pool_id_bound(SharedStrPool self) {
+    return atomic_load_explicit(&self->next_id, memory_order_relaxed);
+}
@@ -0,0 +1,279 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+_Thread_local Stats *stats_active = NULL;
+
+#define MK_NAMES(name, str) str,
+static const char *PHASE_NAMES[] = { FOR_PHASES(MK_NAMES) };
+#undef MK_NAMES
+
+#define MK_NAMES(name, type) #name,
+static const char *NODE_NAMES[] = { FOR_AST_NODES(MK_NAMES) };
+#undef MK_NAMES
+
+static double _clock(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long _peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void stats_enable(Stats *stats) {
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+        stats->current = Phase_COUNT;
+    }
+    stats_active = stats;
+}
+
+void stats_phase_begin(Phase phase) {
+    Stats *stats = stats_active;
+    if (stats == NULL) {
+        return;
+    }
+
+    PhaseStats *p = &stats->phases[phase];
+    p->parent = stats->current;
+    stats->current = phase;
+
+    p->wall_start = _clock(CLOCK_MONOTONIC);
+    if (phase != Phase_LEX) {
+        p->cpu_start = _clock(CLOCK_PROCESS_CPUTIME_ID);
+    }
+}
+
+void stats_phase_end(Phase phase) {
+    Stats *stats = stats_active;
+    if (stats == NULL) {
+        return;
+    }
+
+    PhaseStats *p = &stats->phases[phase];
+    p->wall += _clock(CLOCK_MONOTONIC) - p->wall_start;
+    if (phase != Phase_LEX) {
+        p->cpu += _clock(CLOCK_PROCESS_CPUTIME_ID) - p->cpu_start;
+        p->peak_rss_kb = _peak_rss_kb();
+    }
+
+    stats->current = p->parent;
+}
+
+void stats_count_callbacks(size_t n) {
+    Stats *stats = stats_active;
+    if (stats != NULL && stats->current != Phase_COUNT) {
+        stats->phases[stats->current].visitor_callbacks += n;
+    }
+}
+
+void stats_collect_ast(Stats *stats, const Ast ast) {
+    memset(stats->ast_nodes, 0, sizeof(stats->ast_nodes));
+    for (size_t i = 0; i < ast->size; ++i) {
+        ++stats->ast_nodes[ast->data[i].kind];
+    }
+    stats->ast_capacity = ast->capacity;
+}
+
+void stats_collect_strs(Stats *stats, StrPool strs) {
+    stats->strings = str_pool_count(strs);
+    stats->string_bytes = str_pool_bytes(strs);
+    stats->str_pool_peak_bytes = str_pool_peak_bytes(strs);
+}
+
+//
+// report
+//
+
+// pairs of opcodes shown in the text report, the most dispatched first
+#define TOP_PAIRS 8
+
+typedef struct {
+    size_t count;
+    Opcode first;
+    Opcode second;
+} OpcodePair;
+
+static int _cmp_pairs(const void *a, const void *b) {
+    const OpcodePair *x = a, *y = b;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+typedef struct {
+    double wall;
+    double cpu;
+    long peak_rss_kb;
+} PhaseTimes;
+
+// lexing happens inside yyparse, report both exclusively
+static void _phase_times(const Stats *stats, PhaseTimes times[Phase_COUNT]) {
+    for (Phase i = 0; i < Phase_COUNT; ++i) {
+        times[i].wall = stats->phases[i].wall;
+        times[i].cpu = stats->phases[i].cpu;
+        times[i].peak_rss_kb = stats->phases[i].peak_rss_kb;
+    }
+
+    PhaseTimes *lex = &times[Phase_LEX];
+    PhaseTimes *parse = &times[Phase_PARSE];
+    if (parse->wall > 0) {
+        lex->cpu = parse->cpu * (lex->wall / parse->wall);
+    }
+    parse->wall -= lex->wall;
+    parse->cpu -= lex->cpu;
+    lex->peak_rss_kb = parse->peak_rss_kb;
+}
+
+void stats_report(const Stats *stats, FILE *stream) {
+    PhaseTimes times[Phase_COUNT];
+    _phase_times(stats, times);
+
+    fprintf(
+        stream,
+        "%-12s %12s %12s %14s %12s\n",
+        "phase",
+        "wall (ms)",
+        "cpu (ms)",
+        "peak rss (kB)",
+        "callbacks");
+    for (Phase i = 0; i < Phase_COUNT; ++i) {
+        fprintf(
+            stream,
+            "%-12s %12.3f %12.3f %14ld %12zu\n",
+            PHASE_NAMES[i],
+            times[i].wall * 1e3,
+            times[i].cpu * 1e3,
+            times[i].peak_rss_kb,
+            stats->phases[i].visitor_callbacks);
+    }
+
+    fprintf(stream, "\n%-24s %12zu\n", "tokens", stats->tokens);
+    for (size_t i = 0; i <= AstNodeKind_MAIN; ++i) {
+        fprintf(stream, "ast nodes %-14s %12zu\n", NODE_NAMES[i], stats->ast_nodes[i]);
+    }
+    fprintf(stream, "%-24s %12zu\n", "ast capacity", stats->ast_capacity);
+    fprintf(stream, "%-24s %12zu\n", "interned strings", stats->strings);
+    fprintf(stream, "%-24s %12zu\n", "interned bytes", stats->string_bytes);
+    fprintf(stream, "%-24s %12zu\n", "str pool peak bytes", stats->str_pool_peak_bytes);
+    fprintf(stream, "%-24s %12zu\n", "symbols", stats->symbols);
+    fprintf(stream, "%-24s %12zu\n", "symbol lookups", stats->sym_lookups);
+    fprintf(stream, "%-24s %12zu\n", "symbol slots", stats->sym_slots);
+
+    if (stats->vm_dispatches == 0) {
+        return;
+    }
+    fprintf(stream, "%-24s %12zu\n", "vm dispatches", stats->vm_dispatches);
+    fprintf(stream, "%-24s %12zu\n", "vm statements", stats->vm_stmts);
+    fprintf(
+        stream,
+        "%-24s %12.2f\n",
+        "vm dispatches/stmt",
+        stats->vm_stmts ? (double)stats->vm_dispatches / stats->vm_stmts : 0);
+    for (Opcode i = 0; i < Opcode_COUNT; ++i) {
+        if (stats->vm_ops[i] > 0) {
+            fprintf(
+                stream,
+                "vm op %-18s %12zu\n",
+                bytecode_opcode_name(i),
+                stats->vm_ops[i]);
+        }
+    }
+
+    OpcodePair pairs[Opcode_COUNT * Opcode_COUNT];
+    for (Opcode i = 0; i < Opcode_COUNT; ++i) {
+        for (Opcode j = 0; j < Opcode_COUNT; ++j) {
+            pairs[i * Opcode_COUNT + j] =
+                (OpcodePair){ stats->vm_pairs[i][j], i, j };
+        }
+    }
+    qsort(pairs, Opcode_COUNT * Opcode_COUNT, sizeof(*pairs), _cmp_pairs);
+    for (size_t i = 0; i < TOP_PAIRS && pairs[i].count > 0; ++i) {
+        char name[64];
+        snprintf(
+            name,
+            sizeof(name),
+            "%s %s",
+            bytecode_opcode_name(pairs[i].first),
+            bytecode_opcode_name(pairs[i].second));
+        fprintf(stream, "vm pair %-28s %12zu\n", name, pairs[i].count);
+    }
+}
+
+void stats_report_json(const Stats *stats, FILE *stream) {
+    PhaseTimes times[Phase_COUNT];
+    _phase_times(stats, times);
+
+    fprintf(stream, "{\"phases\":{");
+    for (Phase i = 0; i < Phase_COUNT; ++i) {
+        fprintf(
+            stream,
+            "%s\"%s\":{\"wall_s\":%.9f,\"cpu_s\":%.9f,\"peak_rss_kb\":%ld,"
+            "\"visitor_callbacks\":%zu}",
+            i ? "," : "",
+            PHASE_NAMES[i],
+            times[i].wall,
+            times[i].cpu,
+            times[i].peak_rss_kb,
+            stats->phases[i].visitor_callbacks);
+    }
+
+    fprintf(stream, "},\"counters\":{\"tokens\":%zu,\"ast_nodes\":{", stats->tokens);
+    for (size_t i = 0; i <= AstNodeKind_MAIN; ++i) {
+        fprintf(stream, "%s\"%s\":%zu", i ? "," : "", NODE_NAMES[i], stats->ast_nodes[i]);
+    }
+    fprintf(
+        stream,
+        "},\"ast_capacity\":%zu,\"strings\":%zu,\"string_bytes\":%zu,"
+        "\"str_pool_peak_bytes\":%zu,\"symbols\":%zu,\"sym_lookups\":%zu,"
+        "\"sym_slots\":%zu,",
+        stats->ast_capacity,
+        stats->strings,
+        stats->string_bytes,
+        stats->str_pool_peak_bytes,
+        stats->symbols,
+        stats->sym_lookups,
+        stats->sym_slots);
+
+    fprintf(
+        stream,
+        "\"vm_dispatches\":%zu,\"vm_stmts\":%zu,\"vm_ops\":{",
+        stats->vm_dispatches,
+        stats->vm_stmts);
+    const char *sep = "";
+    for (Opcode i = 0; i < Opcode_COUNT; ++i) {
+        if (stats->vm_ops[i] > 0) {
+            fprintf(
+                stream,
+                "%s\"%s\":%zu",
+                sep,
+                bytecode_opcode_name(i),
+                stats->vm_ops[i]);
+            sep = ",";
+        }
+    }
+    fprintf(stream, "},\"vm_pairs\":{");
+    sep = "";
+    for (Opcode i = 0; i < Opcode_COUNT; ++i) {
+        for (Opcode j = 0; j < Opcode_COUNT; ++j) {
+            if (stats->vm_pairs[i][j] > 0) {
+                fprintf(
+                    stream,
+                    "%s\"%s %s\":%zu",
+                    sep,
+                    bytecode_opcode_name(i),
+                    bytecode_opcode_name(j),
+                    stats->vm_pairs[i][j]);
+                sep = ",";
+            }
+        }
+    }
+    fprintf(stream, "}}}\n");
+}
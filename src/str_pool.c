@@ -1,16 +1,51 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "str_pool.h"
 
+#define DEFAULT_CAPACITY 64
+// percentage of dead bytes in the storage that triggers a compaction
+#define COMPACT_THRESHOLD 50
+#define FREE_ENTRY UINT32_MAX
+
+typedef struct {
+    uint32_t offset; // FREE_ENTRY while the slot is in the free list
+    uint32_t len;    // next free slot while the slot is in the free list
+    uint32_t hash;
+    StrGen gen;
+} StrEntry;
+
 struct StrPool_S {
+    // NUL terminated strings, back to back
     char *data;
     size_t size;
     size_t capacity;
+    size_t dead_bytes;
+    size_t limit;
+
+    // StrID -> string
+    StrEntry *entries;
+    size_t entries_size;
+    size_t entries_capacity;
+    size_t live;
+    StrID free_list;
+
+    // string -> StrID, open addressing with linear probing
+    StrID *index;
+    size_t index_capacity;
+
+    StrGen gen;
+    size_t peak_bytes;
 };
 
 StrPool str_pool_init() {
     StrPool self = (StrPool)calloc(1, sizeof(struct StrPool_S));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->free_list = NO_ID;
     return self;
 }
 
@@ -20,51 +55,301 @@ void str_pool_release(StrPool self) {
     }
 
     free(self->data);
+    free(self->entries);
+    free(self->index);
     free(self);
 }
 
-StrID str_pool_put(StrPool self, const char *sym) {
-    // already in table
-    for (StrID i = 0; i < self->size; i += strlen(&self->data[i]) + 1) {
-        if (strcmp(sym, &self->data[i]) == 0) {
-            return i;
+//
+// helpers
+//
+
+static size_t _next_pow2(size_t n) {
+    size_t res = DEFAULT_CAPACITY;
+    while (res < n) {
+        res *= 2;
+    }
+    return res;
+}
+
+// FNV-1a
+static uint32_t _hash(const char *sym, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)sym[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline bool _is_live(const StrEntry *entry) {
+    return entry->offset != FREE_ENTRY;
+}
+
+static void _index_insert(StrPool self, StrID id) {
+    size_t mask = self->index_capacity - 1;
+    size_t slot = self->entries[id].hash & mask;
+
+    while (self->index[slot] != NO_ID) {
+        slot = (slot + 1) & mask;
+    }
+    self->index[slot] = id;
+}
+
+// rehashes every live string, reusing the current table if `capacity` matches
+static bool _index_rebuild(StrPool self, size_t capacity) {
+    if (capacity != self->index_capacity) {
+        StrID *index = (StrID *)malloc(capacity * sizeof(*index));
+        if (index == NULL) {
+            return false;
         }
+        free(self->index);
+        self->index = index;
+        self->index_capacity = capacity;
+    }
+
+    memset(self->index, 0xff, self->index_capacity * sizeof(*self->index));
+    for (StrID id = 0; id < self->entries_size; ++id) {
+        if (_is_live(&self->entries[id])) {
+            _index_insert(self, id);
+        }
+    }
+    return true;
+}
+
+static StrID _index_find(StrPool self, const char *sym, size_t len, uint32_t hash) {
+    if (self->index_capacity == 0) {
+        return NO_ID;
+    }
+
+    size_t mask = self->index_capacity - 1;
+    for (size_t slot = hash & mask; self->index[slot] != NO_ID;
+         slot = (slot + 1) & mask) {
+        const StrEntry *entry = &self->entries[self->index[slot]];
+        if (entry->hash == hash && entry->len == len &&
+            memcmp(&self->data[entry->offset], sym, len) == 0) {
+            return self->index[slot];
+        }
+    }
+    return NO_ID;
+}
+
+// moves every live string into a fresh buffer sized for the live bytes and
+// `bytes` more, false if they don't fit in the limit
+static bool _compact(StrPool self, size_t bytes) {
+    size_t live_bytes = self->size - self->dead_bytes;
+    if (self->limit != 0 && live_bytes + bytes > self->limit) {
+        return false;
+    }
+
+    size_t new_capacity = _next_pow2(live_bytes + bytes + 1);
+    if (self->limit != 0 && new_capacity > self->limit) {
+        new_capacity = self->limit;
+    }
+
+    char *data = (char *)malloc(new_capacity);
+    if (data == NULL) {
+        return false;
+    }
+
+    size_t size = 0;
+    for (StrID id = 0; id < self->entries_size; ++id) {
+        StrEntry *entry = &self->entries[id];
+        if (!_is_live(entry)) {
+            continue;
+        }
+        memcpy(&data[size], &self->data[entry->offset], entry->len + 1);
+        entry->offset = size;
+        size += entry->len + 1;
+    }
+
+    free(self->data);
+    self->data = data;
+    self->size = size;
+    self->capacity = new_capacity;
+    self->dead_bytes = 0;
+    return true;
+}
+
+static bool _reserve_bytes(StrPool self, size_t bytes) {
+    if (self->limit != 0 && self->size + bytes > self->limit &&
+        !_compact(self, bytes)) {
+        return false;
+    }
+
+    if (self->size + bytes < self->capacity) {
+        return true;
+    }
+
+    size_t new_capacity = _next_pow2(self->size + bytes + 1);
+    if (self->limit != 0 && new_capacity > self->limit) {
+        new_capacity = self->limit;
     }
-    // must add to table
-    const size_t new_size = self->size + strlen(sym) + 1;
-    if (new_size >= self->capacity) {
-        size_t new_capacity = new_size;
-        // compute the next highest power of 2 of 64-bit new_capacity
-        new_capacity--;
-        new_capacity |= new_capacity >> 1;
-        new_capacity |= new_capacity >> 2;
-        new_capacity |= new_capacity >> 4;
-        new_capacity |= new_capacity >> 8;
-        new_capacity |= new_capacity >> 16;
-        new_capacity |= new_capacity >> 32;
-        new_capacity++;
-
-        // char *new_data = realloc(self->data, new_capacity);
-        self->data = realloc(self->data, new_capacity);
-        if (self->data == NULL) {
+
+    char *data = (char *)realloc(self->data, new_capacity);
+    if (data == NULL) {
+        return false;
+    }
+    self->data = data;
+    self->capacity = new_capacity;
+    return true;
+}
+
+static StrID _alloc_entry(StrPool self) {
+    if (self->free_list != NO_ID) {
+        StrID id = self->free_list;
+        self->free_list = self->entries[id].len;
+        return id;
+    }
+
+    if (self->entries_size == self->entries_capacity) {
+        size_t new_capacity = _next_pow2(self->entries_capacity + 1);
+        StrEntry *entries = (StrEntry *)realloc(
+            self->entries, new_capacity * sizeof(*entries));
+        if (entries == NULL) {
             return NO_ID;
         }
-        // self->data = new_data;
-        self->capacity = new_capacity;
+        self->entries = entries;
+        self->entries_capacity = new_capacity;
     }
 
-    const StrID res = self->size;
-    self->size = new_size;
+    return self->entries_size++;
+}
 
-    strcpy(&self->data[res], sym);
+//
+// interface
+//
 
-    return res;
+StrID str_pool_put(StrPool self, const char *sym) {
+    return str_pool_put_len(self, sym, strlen(sym));
+}
+
+StrID str_pool_put_len(StrPool self, const char *sym, size_t len) {
+    uint32_t hash = _hash(sym, len);
+
+    // already in table
+    StrID id = _index_find(self, sym, len, hash);
+    if (id != NO_ID) {
+        self->entries[id].gen = self->gen;
+        return id;
+    }
+
+    // must add to table, keeping the index at most half full
+    if (2 * (self->live + 1) > self->index_capacity &&
+        !_index_rebuild(self, _next_pow2(4 * (self->live + 1)))) {
+        return NO_ID;
+    }
+    if (!_reserve_bytes(self, len + 1)) {
+        return NO_ID;
+    }
+    if ((id = _alloc_entry(self)) == NO_ID) {
+        return NO_ID;
+    }
+
+    self->entries[id] = (StrEntry){
+        .offset = self->size,
+        .len = len,
+        .hash = hash,
+        .gen = self->gen,
+    };
+    memcpy(&self->data[self->size], sym, len);
+    self->data[self->size + len] = '\0';
+    self->size += len + 1;
+    ++self->live;
+    _index_insert(self, id);
+
+    size_t resident = str_pool_resident_bytes(self);
+    if (resident > self->peak_bytes) {
+        self->peak_bytes = resident;
+    }
+
+    return id;
 }
 
 const char *str_pool_get(StrPool self, StrID id) {
-    if (self->size <= id) {
+    if (self->entries_size <= id || !_is_live(&self->entries[id])) {
         return NULL;
     }
 
-    return &self->data[id];
+    return &self->data[self->entries[id].offset];
+}
+
+StrGen str_pool_begin_generation(StrPool self) {
+    return ++self->gen;
+}
+
+size_t str_pool_collect(StrPool self, StrGen oldest_live) {
+    size_t dropped = 0;
+    for (StrID id = 0; id < self->entries_size; ++id) {
+        StrEntry *entry = &self->entries[id];
+        if (_is_live(entry) && entry->gen < oldest_live) {
+            self->dead_bytes += entry->len + 1;
+            entry->offset = FREE_ENTRY;
+            ++dropped;
+        }
+    }
+
+    if (dropped == 0) {
+        return 0;
+    }
+    self->live -= dropped;
+
+    // trailing free slots are given back, the rest are chained for reuse
+    while (self->entries_size > 0 &&
+           !_is_live(&self->entries[self->entries_size - 1])) {
+        --self->entries_size;
+    }
+    self->free_list = NO_ID;
+    for (StrID id = self->entries_size; id-- > 0;) {
+        if (!_is_live(&self->entries[id])) {
+            self->entries[id].len = self->free_list;
+            self->free_list = id;
+        }
+    }
+    if (self->entries_capacity > 4 * _next_pow2(self->entries_size)) {
+        size_t new_capacity = 2 * _next_pow2(self->entries_size);
+        StrEntry *entries = (StrEntry *)realloc(
+            self->entries, new_capacity * sizeof(*entries));
+        if (entries != NULL) {
+            self->entries = entries;
+            self->entries_capacity = new_capacity;
+        }
+    }
+
+    // shrinking is best effort, rebuilding in place cannot fail
+    if (!_index_rebuild(self, _next_pow2(4 * self->live))) {
+        _index_rebuild(self, self->index_capacity);
+    }
+
+    if (self->dead_bytes * 100 >= self->size * COMPACT_THRESHOLD) {
+        _compact(self, 0);
+    }
+
+    return dropped;
+}
+
+void str_pool_set_limit(StrPool self, size_t max_bytes) {
+    self->limit = max_bytes;
+}
+
+size_t str_pool_resident_bytes(StrPool self) {
+    return sizeof(*self) + self->capacity +
+           self->entries_capacity * sizeof(*self->entries) +
+           self->index_capacity * sizeof(*self->index);
+}
+
+size_t str_pool_peak_bytes(StrPool self) {
+    return self->peak_bytes;
+}
+
+size_t str_pool_id_bound(StrPool self) {
+    return self->entries_size;
+}
+
+size_t str_pool_count(StrPool self) {
+    return self->live;
+}
+
+size_t str_pool_bytes(StrPool self) {
+    return self->size - self->dead_bytes;
 }
@@ -5,107 +5,96 @@
 #include <string.h>
 #include "sym_table.h"
 #include "ast.h"
+#include "stats.h"
 
-#define DEFAULT_SIZE 64;
+#define DEFAULT_CAPACITY 64
 
 //////// SYMBOL //////////////
 
 struct SymNode_S {
-    bool has_value;
+    // `symbol.ident` is NO_ID while the slot is empty
     Sym symbol;
-    SymNode _next;
 };
 
 Sym *symnode_get_symbol(SymNode symnode) {
     return &symnode->symbol;
 }
 
-SymNode _create_symbol(const StrID ident, const Type type) {
-    SymNode self = (SymNode)malloc(sizeof(struct SymNode_S));
-
-    self->has_value = false;
-    self->symbol.ident = ident;
-    self->symbol.type = type;
-    self->_next = NULL;
-
-    return self;
-};
-
-void _set_symbol(SymNode self, const SymValue value) {
-    self->has_value = true;
-    self->symbol.value = value;
-}
-
 /////////// SYMBOL TABLE ////////////////
 
 struct SymTable_S {
-    size_t size;
-    SymNode *hash_table; // Separate Chaining algorithm
+    // StrID -> symbol, StrIDs are dense so they index it directly
+    struct SymNode_S *slots;
+    size_t capacity;
+
+    // usage counters, handed to the active stats on release
+    size_t symbols;
+    size_t lookups;
 };
 
 // symbol table constructor
 SymTable symtable_initialize() {
-    SymTable self = (SymTable)malloc(sizeof(struct SymTable_S));
-
-    if (self == NULL)
-        return NULL;
-
-    self->size = DEFAULT_SIZE;
-    self->hash_table = (SymNode *)calloc(self->size, sizeof(SymNode));
+    return (SymTable)calloc(1, sizeof(struct SymTable_S));
+}
 
-    if (self->hash_table == NULL) {
-        free(self);
-        return NULL;
+void symtable_release(SymTable self) {
+    Stats *stats = stats_active;
+    if (stats != NULL) {
+        stats->symbols += self->symbols;
+        stats->sym_lookups += self->lookups;
+        stats->sym_slots += self->capacity;
     }
 
-    return self;
-}
-
-int _hash_function(const SymTable self, const StrID key) {
-    return key % self->size;
+    free(self->slots);
+    free(self);
 }
 
-void _symtable_insert(SymTable self, SymNode symnode) {
-    int bucket_idx = _hash_function(self, symnode->symbol.ident);
-
-    if (self->hash_table[bucket_idx] == NULL) {
-        self->hash_table[bucket_idx] = symnode;
-    } else {
-        symnode->_next = self->hash_table[bucket_idx];
-        self->hash_table[bucket_idx] = symnode;
+// makes room for `ident`, leaving the new slots empty
+static bool _reserve(SymTable self, StrID ident) {
+    if (ident < self->capacity) {
+        return true;
     }
-}
 
-void symtable_release(SymTable self) {
-    SymNode next_node, current_node;
+    size_t capacity =
+        self->capacity == 0 ? DEFAULT_CAPACITY : 2 * self->capacity;
+    while (capacity <= ident) {
+        capacity *= 2;
+    }
 
-    for (size_t i = 0; i < self->size; i++) {
-        current_node = self->hash_table[i];
+    struct SymNode_S *dummy = (struct SymNode_S *)realloc(
+        self->slots, capacity * sizeof(*dummy));
+    if (dummy == NULL) {
+        return false;
+    }
 
-        while (current_node != NULL) {
-            next_node = current_node->_next;
-            free(current_node);
-            current_node = next_node;
-        }
+    for (size_t i = self->capacity; i < capacity; ++i) {
+        dummy[i].symbol.ident = NO_ID;
     }
-    free(self->hash_table);
-    free(self);
+    self->slots = dummy;
+    self->capacity = capacity;
+    return true;
 }
 
 SymNode symtable_get_info(const SymTable self, StrID ident) {
-    int bucket_idx = _hash_function(self, ident);
-    SymNode sym_node = self->hash_table[bucket_idx];
-
-    while (sym_node != NULL) {
-        if (sym_node->symbol.ident == ident) {
-            return sym_node;
-        }
-        sym_node = sym_node->_next;
+    ++self->lookups;
+    if (ident >= self->capacity || self->slots[ident].symbol.ident != ident) {
+        return NULL;
     }
-    return NULL;
+    return &self->slots[ident];
 }
 
-void symtable_add_symbol(SymTable self, const StrID ident, const Type type) {
-    SymNode symnode = _create_symbol(ident, type);
-    _symtable_insert(self, symnode);
+bool symtable_add_symbol(SymTable self, const StrID ident, const Type type) {
+    if (ident == NO_ID || !_reserve(self, ident)) {
+        return false;
+    }
+
+    self->slots[ident].symbol = (Sym){ .ident = ident, .type = type };
+    ++self->symbols;
+    return true;
+}
+
+void symtable_remove_symbol(SymTable self, const StrID ident) {
+    if (ident < self->capacity) {
+        self->slots[ident].symbol.ident = NO_ID;
+    }
 }
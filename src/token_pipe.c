@@ -0,0 +1,325 @@
+#include "token_pipe.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "line_index.h"
+#include "ring.h"
+#include "str_pool.h"
+#include "tokens.h"
+
+// bytes read at once, and buffered between the reader and the lexer
+#define READ_SIZE (1024 * 1024)
+#define BYTES_CAPACITY (4 * READ_SIZE)
+
+// tokens buffered between the lexer and the parser, and pulled at once
+#define TOKENS_CAPACITY (64 * 1024)
+#define TOKENS_BATCH 4096
+
+struct TokenPipe_S {
+    FILE *in;
+    StrPool strs;
+    Lexer lexer;
+
+    // the lexer records newlines while the parser may look up the location
+    // of a syntax error
+    LineIndex lines;
+    pthread_mutex_t lines_lock;
+
+    // reader -> lexer -> parser
+    Ring bytes;
+    Ring tokens;
+
+    pthread_t reader;
+    pthread_t scanner;
+
+    // written by each stage before closing its ring
+    Status read_status;
+    const char *read_error;
+    Status lex_status;
+    const char *lex_error;
+
+    // span of tokens the parser is pulling from
+    const Token *next;
+    const Token *end;
+    size_t peeked;
+};
+
+// pulled past the end of the input if the lexer stopped before it
+static const Token END = { .kind = 0, .loc = 0 };
+
+//
+// reader
+//
+
+static void *_read_stage(void *arg) {
+    TokenPipe self = arg;
+
+    for (;;) {
+        size_t n = READ_SIZE;
+        char *block = ring_reserve(self->bytes, &n);
+        if (block == NULL) {
+            break;
+        }
+
+        size_t read = fread(block, 1, n, self->in);
+        ring_commit(self->bytes, read);
+        if (read < n) {
+            if (ferror(self->in)) {
+                self->read_status = Status_InternalError;
+                self->read_error = "error reading the source\n";
+            }
+            break;
+        }
+    }
+
+    ring_close(self->bytes);
+    return NULL;
+}
+
+//
+// lexer
+//
+
+// hands the tokens of a piece starting at `base` to the parser, false if it
+// stopped pulling them
+static bool _push(TokenPipe self, const Token *tokens, size_t n, Location base) {
+    while (n > 0) {
+        size_t count = n;
+        Token *slots = ring_reserve(self->tokens, &count);
+        if (slots == NULL) {
+            return false;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            slots[i] = tokens[i];
+            slots[i].loc += base;
+        }
+        ring_commit(self->tokens, count);
+        tokens += count;
+        n -= count;
+    }
+    return true;
+}
+
+// lexes a piece starting at `base`, which must end the input or right after
+// a `;`, `pulled` is cleared if the parser stopped pulling tokens
+static Status _lex_piece(
+    TokenPipe self,
+    Tokens piece,
+    const char *src,
+    size_t len,
+    Location base,
+    bool last,
+    bool *pulled) {
+    pthread_mutex_lock(&self->lines_lock);
+    bool indexed = line_index_scan(self->lines, src, len, base);
+    pthread_mutex_unlock(&self->lines_lock);
+    if (!indexed) {
+        return Status_InternalError;
+    }
+
+    Status s =
+        tokens_lex(piece, src, len, self->strs, self->lexer, 1, NULL);
+    if (s != Status_OK) {
+        // a statement too long for flex, unless out of memory
+        if (self->lexer == Lexer_FLEX && len > INT_MAX) {
+            self->lex_error = "statement too long, it must be under 2 GiB\n";
+        }
+        return s;
+    }
+
+    // only the last piece ends the input
+    *pulled = _push(self, piece->data, piece->size - !last, base);
+    return Status_OK;
+}
+
+static Status _lex_all(TokenPipe self, Tokens piece) {
+    // input not lexed yet, starting at `base`
+    char *buf = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    size_t base = 0;
+
+    Status s = Status_OK;
+    bool pulled = true;
+    bool last = false;
+    while (s == Status_OK && pulled && !last) {
+        size_t n = READ_SIZE;
+        const char *block = ring_peek(self->bytes, &n);
+        last = block == NULL;
+        if (last) {
+            n = 0;
+        }
+
+        if (size + n > capacity) {
+            size_t new_capacity = capacity == 0 ? READ_SIZE : 2 * capacity;
+            while (new_capacity < size + n) {
+                new_capacity *= 2;
+            }
+
+            char *dummy = (char *)realloc(buf, new_capacity);
+            if (dummy == NULL) {
+                s = Status_InternalError;
+                break;
+            }
+            buf = dummy;
+            capacity = new_capacity;
+        }
+        if (n > 0) {
+            memcpy(buf + size, block, n);
+            size += n;
+            ring_consume(self->bytes, n);
+        }
+
+        // up to right after the last `;`, which no token spans, the bytes
+        // before the block have none
+        size_t cut = size;
+        if (!last) {
+            while (cut > size - n && buf[cut - 1] != ';') {
+                --cut;
+            }
+            if (cut == size - n) {
+                continue;
+            }
+        }
+
+        // locations are 32-bit offsets
+        if (base + cut > UINT32_MAX) {
+            self->lex_error = "source too large, it must be under 4 GiB\n";
+            s = Status_InternalError;
+            break;
+        }
+
+        s = _lex_piece(self, piece, buf, cut, (Location)base, last, &pulled);
+        memmove(buf, buf + cut, size - cut);
+        size -= cut;
+        base += cut;
+    }
+
+    free(buf);
+    return s;
+}
+
+static void *_lex_stage(void *arg) {
+    TokenPipe self = arg;
+
+    Tokens piece = tokens_initialize();
+    self->lex_status =
+        piece == NULL ? Status_InternalError : _lex_all(self, piece);
+    tokens_release(piece);
+
+    // the reader stops too if lexing failed
+    ring_close(self->tokens);
+    ring_close(self->bytes);
+    return NULL;
+}
+
+//
+// constructor & destructor
+//
+
+static void _release(TokenPipe self) {
+    ring_release(self->bytes);
+    ring_release(self->tokens);
+    pthread_mutex_destroy(&self->lines_lock);
+    free(self);
+}
+
+TokenPipe token_pipe_start(
+    FILE *in,
+    StrPool strs,
+    LineIndex lines,
+    Lexer lexer) {
+    TokenPipe self = (TokenPipe)calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&self->lines_lock, NULL)) {
+        free(self);
+        return NULL;
+    }
+
+    self->in = in;
+    self->strs = strs;
+    self->lexer = lexer;
+    self->lines = lines;
+    self->read_status = Status_OK;
+    self->lex_status = Status_OK;
+    self->bytes = ring_initialize(BYTES_CAPACITY, 1);
+    self->tokens = ring_initialize(TOKENS_CAPACITY, sizeof(Token));
+    if (self->bytes == NULL || self->tokens == NULL) {
+        _release(self);
+        return NULL;
+    }
+
+    if (pthread_create(&self->reader, NULL, _read_stage, self)) {
+        _release(self);
+        return NULL;
+    }
+    if (pthread_create(&self->scanner, NULL, _lex_stage, self)) {
+        ring_close(self->bytes);
+        pthread_join(self->reader, NULL);
+        _release(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+Status token_pipe_finish(TokenPipe self, FILE *diag) {
+    // no-ops if the parser got to the end of the input
+    ring_close(self->tokens);
+    ring_close(self->bytes);
+    pthread_join(self->scanner, NULL);
+    pthread_join(self->reader, NULL);
+
+    Status s = self->read_status;
+    const char *error = self->read_error;
+    if (s == Status_OK) {
+        s = self->lex_status;
+        error = self->lex_error;
+    }
+    if (error != NULL) {
+        fputs(error, diag);
+    }
+
+    _release(self);
+    return s;
+}
+
+//
+// parser
+//
+
+const Token *token_pipe_next(TokenPipe self) {
+    if (self->next == self->end) {
+        ring_consume(self->tokens, self->peeked);
+
+        size_t n = TOKENS_BATCH;
+        self->next = ring_peek(self->tokens, &n);
+        if (self->next == NULL) {
+            self->end = NULL;
+            self->peeked = 0;
+            return &END;
+        }
+        self->end = self->next + n;
+        self->peeked = n;
+    }
+
+    return self->next++;
+}
+
+LineCol token_pipe_lookup(TokenPipe self, Location loc) {
+    pthread_mutex_lock(&self->lines_lock);
+    LineCol pos = line_index_lookup(self->lines, loc);
+    pthread_mutex_unlock(&self->lines_lock);
+    return pos;
+}
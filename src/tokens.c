@@ -0,0 +1,358 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tokens.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "parser.h"
+#include "lexer.h"
+#include "scanner.h"
+#include "str_pool.h"
+
+#define DEFAULT_CAPACITY 64
+
+// flex takes buffer lengths as `int`, chunks are cut at a `;` past this so
+// they may still be longer
+#define CHUNK_MAX ((size_t)INT_MAX / 2)
+
+typedef struct {
+    const char *src;
+    size_t len;
+
+    // tokens of the chunk, with locations relative to its start and
+    // identifiers interned in `strs`, which is private to the chunk
+    struct TokenArray_S tokens;
+    StrPool strs;
+    Status status;
+    Location start;
+
+    // filled by the merge
+    StrID *remap;
+    size_t offset;
+} Chunk;
+
+typedef struct {
+    Lexer lexer;
+    Chunk *chunks;
+    size_t n_chunks;
+    size_t first;
+    size_t stride;
+    Token *out;
+} Worker;
+
+//
+// constructor & destructor
+//
+
+Tokens tokens_initialize() {
+    return (Tokens)calloc(1, sizeof(struct TokenArray_S));
+}
+
+void tokens_release(Tokens self) {
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->data);
+    free(self);
+}
+
+void tokens_clear(Tokens self) {
+    self->size = 0;
+}
+
+bool tokens_reserve(Tokens self, size_t capacity) {
+    if (capacity <= self->capacity) {
+        return true;
+    }
+
+    Token *dummy = (Token *)realloc(self->data, capacity * sizeof(*dummy));
+    if (dummy == NULL) {
+        return false;
+    }
+
+    self->data = dummy;
+    self->capacity = capacity;
+    return true;
+}
+
+//
+// helpers
+//
+
+// lexes `src` into `out` with flex, with locations relative to `src`
+static Status _lex_flex(Tokens out, const char *src, size_t len, StrPool strs) {
+    // longer than flex can scan, see CHUNK_MAX
+    if (len > INT_MAX) {
+        return Status_InternalError;
+    }
+
+    LexCtx ctx = { .strs = strs, .diag = NULL, .main = NO_ID };
+
+    yyscan_t scanner;
+    if (yylex_init_extra(&ctx, &scanner)) {
+        return Status_InternalError;
+    }
+
+    // generated programs average a few bytes per token
+    if (!tokens_reserve(out, len / 4 + DEFAULT_CAPACITY)) {
+        yylex_destroy(scanner);
+        return Status_InternalError;
+    }
+
+    YY_BUFFER_STATE state = yy_scan_bytes(src, (int)len, scanner);
+    Location loc = 0;
+    Status status = Status_OK;
+
+    for (;;) {
+        YYSTYPE val;
+        int kind = yylex(&val, &loc, scanner);
+
+        if (out->size == out->capacity &&
+            !tokens_reserve(out, 2 * out->capacity)) {
+            status = Status_InternalError;
+            break;
+        }
+
+        Token *tok = &out->data[out->size++];
+        tok->kind = kind;
+        tok->loc = loc;
+        if (kind == TOK_IDENT) {
+            tok->value.ident = val.TOK_IDENT;
+        } else if (kind == TOK_NUM) {
+            tok->value.num = val.TOK_NUM;
+        }
+
+        if (kind == YYEOF) {
+            break;
+        }
+    }
+
+    yy_delete_buffer(state, scanner);
+    yylex_destroy(scanner);
+    return status;
+}
+
+static Status _lex(
+    Tokens out, const char *src, size_t len, StrPool strs, Lexer lexer) {
+    if (lexer == Lexer_SIMD) {
+        return scanner_scan(out, src, len, strs);
+    }
+    return _lex_flex(out, src, len, strs);
+}
+
+//
+// workers
+//
+
+static void *_lex_worker(void *arg) {
+    Worker *w = arg;
+    for (size_t i = w->first; i < w->n_chunks; i += w->stride) {
+        Chunk *c = &w->chunks[i];
+        c->strs = str_pool_init();
+        c->status = c->strs == NULL
+            ? Status_InternalError
+            : _lex(&c->tokens, c->src, c->len, c->strs, w->lexer);
+    }
+    return NULL;
+}
+
+static void *_merge_worker(void *arg) {
+    Worker *w = arg;
+    for (size_t i = w->first; i < w->n_chunks; i += w->stride) {
+        Chunk *c = &w->chunks[i];
+        Token *out = w->out + c->offset;
+
+        for (size_t j = 0; j < c->tokens.size; ++j) {
+            Token tok = c->tokens.data[j];
+            tok.loc += c->start;
+            if (tok.kind == TOK_IDENT) {
+                tok.value.ident = c->remap[tok.value.ident];
+            }
+            out[j] = tok;
+        }
+    }
+    return NULL;
+}
+
+// runs `fn` on `n` threads, the calling one included, or on fewer if they
+// can't be started
+static void _run(void *(*fn)(void *), Worker *workers, size_t n) {
+    pthread_t *threads = (pthread_t *)malloc(n * sizeof(*threads));
+    size_t started = 1;
+
+    for (; threads != NULL && started < n; ++started) {
+        if (pthread_create(&threads[started], NULL, fn, &workers[started])) {
+            break;
+        }
+    }
+
+    fn(&workers[0]);
+
+    for (size_t i = 1; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // chunks of the threads that couldn't start
+    for (size_t i = started; i < n; ++i) {
+        fn(&workers[i]);
+    }
+
+    free(threads);
+}
+
+//
+// lexing
+//
+
+// splits `src` right after a `;` every `len / n` bytes or so
+static size_t _split(Chunk *chunks, size_t n, const char *src, size_t len) {
+    size_t count = 0;
+    size_t start = 0;
+
+    while (start < len || count == 0) {
+        size_t end = count + 1 == n
+            ? len
+            : start + (len - start) / (n - count);
+        if (end < len) {
+            const char *semi = memchr(src + end, ';', len - end);
+            end = semi != NULL ? (size_t)(semi - src) + 1 : len;
+        }
+
+        chunks[count++] = (Chunk){
+            .src = src + start,
+            .len = end - start,
+            .start = (Location)start,
+        };
+        start = end;
+    }
+
+    return count;
+}
+
+// interns the identifiers of every chunk into `strs` and places the chunks
+static Status _merge_chunks(
+    Tokens self, Chunk *chunks, size_t n, StrPool strs) {
+    size_t total = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        Chunk *c = &chunks[i];
+
+        // only the last chunk ends the input
+        if (i + 1 < n) {
+            --c->tokens.size;
+        }
+
+        size_t count = str_pool_count(c->strs);
+        c->remap = (StrID *)malloc((count + 1) * sizeof(*c->remap));
+        if (c->remap == NULL) {
+            return Status_InternalError;
+        }
+        for (StrID id = 0; id < count; ++id) {
+            c->remap[id] = str_pool_put(strs, str_pool_get(c->strs, id));
+            if (c->remap[id] == NO_ID) {
+                return Status_InternalError;
+            }
+        }
+
+        c->offset = total;
+        total += c->tokens.size;
+    }
+
+    if (!tokens_reserve(self, total)) {
+        return Status_InternalError;
+    }
+    self->size = total;
+    return Status_OK;
+}
+
+Status tokens_lex(
+    Tokens self,
+    const char *src,
+    size_t len,
+    StrPool strs,
+    Lexer lexer,
+    unsigned threads,
+    FILE *diag) {
+    tokens_clear(self);
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned)cpus : 1;
+    }
+
+    size_t n = len / CHUNK_MAX + 1;
+    if (n < threads) {
+        n = threads;
+    }
+
+    if (n == 1) {
+        return _lex(self, src, len, strs, lexer);
+    }
+
+    Chunk *chunks = (Chunk *)calloc(n, sizeof(*chunks));
+    Worker *workers = (Worker *)calloc(threads, sizeof(*workers));
+    if (chunks == NULL || workers == NULL) {
+        free(chunks);
+        free(workers);
+        return Status_InternalError;
+    }
+
+    n = _split(chunks, n, src, len);
+    for (size_t i = 0; lexer == Lexer_FLEX && i < n; ++i) {
+        if (chunks[i].len > INT_MAX) {
+            if (diag != NULL) {
+                fputs("statement too long, it must be under 2 GiB\n", diag);
+            }
+            free(chunks);
+            free(workers);
+            return Status_InternalError;
+        }
+    }
+    if (threads > n) {
+        threads = (unsigned)n;
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        workers[i] = (Worker){
+            .lexer = lexer,
+            .chunks = chunks,
+            .n_chunks = n,
+            .first = i,
+            .stride = threads,
+        };
+    }
+
+    _run(_lex_worker, workers, threads);
+
+    Status status = Status_OK;
+    for (size_t i = 0; i < n && status == Status_OK; ++i) {
+        status = chunks[i].status;
+    }
+
+    if (status == Status_OK) {
+        status = _merge_chunks(self, chunks, n, strs);
+    }
+
+    if (status == Status_OK) {
+        for (unsigned i = 0; i < threads; ++i) {
+            workers[i].out = self->data;
+        }
+        _run(_merge_worker, workers, threads);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        str_pool_release(chunks[i].strs);
+        free(chunks[i].tokens.data);
+        free(chunks[i].remap);
+    }
+    free(chunks);
+    free(workers);
+
+    return status;
+}
@@ -0,0 +1,218 @@
+#include "trace.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "defs.h"
+#include "error.h"
+#include "printer.h"
+#include "str_pool.h"
+#include "sym_table.h"
+
+static inline int64_t _raw_value(const Sym *value) {
+    return value->type == Type_BOOL ? value->value.v_bool : value->value.v_int;
+}
+
+//
+// text tracer
+//
+
+struct TraceText_S {
+    StrPool strs;
+    Printer out;
+};
+
+TraceText trace_text_initialize(StrPool strs, FILE *stream) {
+    TraceText self = (TraceText)malloc(sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->strs = strs;
+    printer_init(&self->out, stream);
+    return self;
+}
+
+void trace_text_release(TraceText self) {
+    if (self == NULL) {
+        return;
+    }
+
+    printer_flush(&self->out);
+    free(self);
+}
+
+// `label: value\n`, or `label name: value\n` if the value is in a variable
+static void _print_event(TraceText self, const char *label, const Sym *value) {
+    printer_puts(&self->out, label);
+    if (value->ident != NO_ID) {
+        printer_putc(&self->out, ' ');
+        printer_puts(&self->out, str_pool_get(self->strs, value->ident));
+    }
+    if (value->type != Type_VOID) {
+        printer_write(&self->out, ": ", 2);
+        printer_int(&self->out, _raw_value(value));
+    }
+    printer_putc(&self->out, '\n');
+}
+
+static void _text_const(void *context, NodeID id, const Sym *value) {
+    (void)id;
+    _print_event(context, value->type == Type_BOOL ? "BOOL" : "INT", value);
+}
+
+static void _text_var(void *context, NodeID id, const Sym *value) {
+    (void)id;
+    _print_event(context, "VAR", value);
+}
+
+static void _text_binop(void *context, NodeID id, BinOp op, const Sym *value) {
+    (void)id;
+    _print_event(context, op == BinOp_ADD ? "ADD" : "MUL", value);
+}
+
+static void _text_asgn(void *context, NodeID id, const Sym *value) {
+    (void)id;
+    _print_event(context, "ASGN", value);
+}
+
+static void _text_ret(void *context, NodeID id, const Sym *value) {
+    (void)id;
+    _print_event(context, "RET", value);
+}
+
+static void _text_flush(void *context) {
+    TraceText self = context;
+    printer_flush(&self->out);
+}
+
+Tracer trace_text_tracer(TraceText self) {
+    return (Tracer){
+        .context = self,
+        .on_const = _text_const,
+        .on_var = _text_var,
+        .on_binop = _text_binop,
+        .on_asgn = _text_asgn,
+        .on_ret = _text_ret,
+        .flush = _text_flush,
+    };
+}
+
+//
+// ring tracer
+//
+
+struct TraceRing_S {
+    TraceRecord *data;
+    // capacity - 1, the capacity being a power of 2
+    size_t mask;
+    // records ever pushed, the next one goes to `total & mask`
+    uint64_t total;
+};
+
+TraceRing trace_ring_initialize(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        rounded *= 2;
+    }
+
+    TraceRing self = (TraceRing)calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->data = (TraceRecord *)calloc(rounded, sizeof(*self->data));
+    if (self->data == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    self->mask = rounded - 1;
+    return self;
+}
+
+void trace_ring_release(TraceRing self) {
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->data);
+    free(self);
+}
+
+static inline void _push(
+    TraceRing self,
+    TraceEvent event,
+    NodeID id,
+    uint32_t arg,
+    const Sym *value) {
+    self->data[self->total++ & self->mask] = (TraceRecord){
+        .value = _raw_value(value),
+        .node = id,
+        .arg = arg,
+        .event = (uint8_t)event,
+        .type = (uint8_t)value->type,
+    };
+}
+
+static void _ring_const(void *context, NodeID id, const Sym *value) {
+    _push(context, TraceEvent_CONST, id, NO_ID, value);
+}
+
+static void _ring_var(void *context, NodeID id, const Sym *value) {
+    _push(context, TraceEvent_VAR, id, value->ident, value);
+}
+
+static void _ring_binop(void *context, NodeID id, BinOp op, const Sym *value) {
+    _push(context, TraceEvent_BINOP, id, (uint32_t)op, value);
+}
+
+static void _ring_asgn(void *context, NodeID id, const Sym *value) {
+    _push(context, TraceEvent_ASGN, id, value->ident, value);
+}
+
+static void _ring_ret(void *context, NodeID id, const Sym *value) {
+    _push(context, TraceEvent_RET, id, NO_ID, value);
+}
+
+Tracer trace_ring_tracer(TraceRing self) {
+    return (Tracer){
+        .context = self,
+        .on_const = _ring_const,
+        .on_var = _ring_var,
+        .on_binop = _ring_binop,
+        .on_asgn = _ring_asgn,
+        .on_ret = _ring_ret,
+        .flush = NULL,
+    };
+}
+
+size_t trace_ring_size(const TraceRing self) {
+    return self->total <= self->mask ? (size_t)self->total : self->mask + 1;
+}
+
+uint64_t trace_ring_total(const TraceRing self) {
+    return self->total;
+}
+
+const TraceRecord *trace_ring_get(const TraceRing self, size_t i) {
+    uint64_t oldest = self->total - trace_ring_size(self);
+    return &self->data[(oldest + i) & self->mask];
+}
+
+Status trace_ring_dump(const TraceRing self, FILE *out) {
+    size_t size = trace_ring_size(self);
+    size_t first = (size_t)((self->total - size) & self->mask);
+
+    // the oldest records are at the end of the array once it wrapped around
+    size_t tail = size < self->mask + 1 - first ? size : self->mask + 1 - first;
+    if (fwrite(&self->data[first], sizeof(TraceRecord), tail, out) != tail ||
+        fwrite(self->data, sizeof(TraceRecord), size - tail, out) !=
+            size - tail) {
+        return Status_InternalError;
+    }
+    return Status_OK;
+}
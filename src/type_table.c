@@ -0,0 +1,69 @@
+#include "type_table.h"
+
+#include <stdlib.h>
+
+#include "ast.h"
+#include "defs.h"
+
+#define DEFAULT_CAPACITY 64
+
+struct TypeTable_S {
+    Type *data;
+    size_t size;
+    size_t capacity;
+};
+
+//
+// constructor & destructor
+//
+
+TypeTable type_table_initialize() {
+    return (TypeTable)calloc(1, sizeof(struct TypeTable_S));
+}
+
+void type_table_release(TypeTable self) {
+    if (self == NULL) {
+        return;
+    }
+
+    free(self->data);
+    free(self);
+}
+
+//
+// interface
+//
+
+Type *type_table_reserve(TypeTable self, size_t nodes) {
+    if (nodes > self->capacity) {
+        size_t capacity =
+            self->capacity == 0 ? DEFAULT_CAPACITY : 2 * self->capacity;
+        while (capacity < nodes) {
+            capacity *= 2;
+        }
+
+        Type *dummy = (Type *)realloc(self->data, capacity * sizeof(*dummy));
+        if (dummy == NULL) {
+            return NULL;
+        }
+
+        self->data = dummy;
+        self->capacity = capacity;
+    }
+
+    for (size_t i = self->size; i < nodes; ++i) {
+        self->data[i] = Type_VOID;
+    }
+    if (nodes > self->size) {
+        self->size = nodes;
+    }
+    return self->data;
+}
+
+Type type_table_get(const TypeTable self, NodeID id) {
+    return id < self->size ? self->data[id] : Type_VOID;
+}
+
+void type_table_clear(TypeTable self) {
+    self->size = 0;
+}
@@ -16,3 +16,33 @@ char *u_strdup(const char *src) {
 
     return dest;
 }
+
+char *u_read_all(FILE *stream, size_t *len) {
+    size_t capacity = 4096;
+    size_t size = 0;
+    char *buf = (char *)malloc(capacity);
+
+    while (buf != NULL) {
+        size += fread(buf + size, 1, capacity - size - 1, stream);
+
+        if (size < capacity - 1) {
+            break;
+        }
+
+        capacity *= 2;
+        char *dummy = (char *)realloc(buf, capacity);
+        if (dummy == NULL) {
+            free(buf);
+        }
+        buf = dummy;
+    }
+
+    if (buf == NULL || ferror(stream)) {
+        free(buf);
+        return NULL;
+    }
+
+    buf[size] = '\0';
+    *len = size;
+    return buf;
+}
@@ -0,0 +1,169 @@
+#include "vm.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "defs.h"
+#include "error.h"
+#include "stats.h"
+#include "sym_table.h"
+
+// runs `chunk` on `slots`, true if it returned a value, which is left in
+// `ret`. Inlined twice, with and without the counting, so that running
+// without stats doesn't even check for them
+static inline __attribute__((always_inline)) bool _run(
+    const Chunk *chunk,
+    uint64_t *slots,
+    uint64_t *stack,
+    uint64_t *ret,
+    Stats *stats) {
+    const uint64_t *k = (const uint64_t *)chunk->consts;
+    uint64_t *s = slots;
+    uint64_t *sp = stack;
+    Opcode prev = Opcode_COUNT;
+
+    for (const Insn *insn = chunk->code;; ++insn) {
+        uint32_t a = insn->a;
+        uint32_t b = insn->b;
+        uint32_t c = insn->c;
+
+        if (stats != NULL) {
+            ++stats->vm_dispatches;
+            ++stats->vm_ops[insn->op];
+            if (prev != Opcode_COUNT) {
+                ++stats->vm_pairs[prev][insn->op];
+            }
+            prev = (Opcode)insn->op;
+        }
+
+        switch ((Opcode)insn->op) {
+        case Opcode_CONST:
+            *sp++ = k[a];
+            break;
+        case Opcode_LOAD:
+            *sp++ = s[a];
+            break;
+        case Opcode_STORE:
+            s[a] = *--sp;
+            break;
+        case Opcode_ADD:
+            --sp;
+            sp[-1] += sp[0];
+            break;
+        case Opcode_MUL:
+            --sp;
+            sp[-1] *= sp[0];
+            break;
+        case Opcode_RET:
+            *ret = *--sp;
+            return true;
+        case Opcode_RET_VOID:
+            return false;
+        case Opcode_SET_CONST:
+            s[a] = k[b];
+            break;
+        case Opcode_COPY:
+            s[a] = s[b];
+            break;
+        case Opcode_ADD_VV:
+            *sp++ = s[a] + s[b];
+            break;
+        case Opcode_MUL_VV:
+            *sp++ = s[a] * s[b];
+            break;
+        case Opcode_ADD_VC:
+            *sp++ = s[a] + k[b];
+            break;
+        case Opcode_MUL_VC:
+            *sp++ = s[a] * k[b];
+            break;
+        case Opcode_ADD_V:
+            sp[-1] += s[a];
+            break;
+        case Opcode_MUL_V:
+            sp[-1] *= s[a];
+            break;
+        case Opcode_ADD_C:
+            sp[-1] += k[a];
+            break;
+        case Opcode_MUL_C:
+            sp[-1] *= k[a];
+            break;
+        case Opcode_ADD_STORE:
+            sp -= 2;
+            s[a] = sp[0] + sp[1];
+            break;
+        case Opcode_MUL_STORE:
+            sp -= 2;
+            s[a] = sp[0] * sp[1];
+            break;
+        case Opcode_ADD_VV_STORE:
+            s[a] = s[b] + s[c];
+            break;
+        case Opcode_MUL_VV_STORE:
+            s[a] = s[b] * s[c];
+            break;
+        case Opcode_ADD_VC_STORE:
+            s[a] = s[b] + k[c];
+            break;
+        case Opcode_MUL_VC_STORE:
+            s[a] = s[b] * k[c];
+            break;
+        case Opcode_RET_VAR:
+            *ret = s[a];
+            return true;
+        case Opcode_RET_CONST:
+            *ret = k[a];
+            return true;
+        case Opcode_COUNT:
+            return false;
+        }
+    }
+}
+
+static bool _run_plain(
+    const Chunk *chunk, uint64_t *slots, uint64_t *stack, uint64_t *ret) {
+    return _run(chunk, slots, stack, ret, NULL);
+}
+
+static bool _run_counted(
+    const Chunk *chunk,
+    uint64_t *slots,
+    uint64_t *stack,
+    uint64_t *ret,
+    Stats *stats) {
+    stats->vm_stmts += chunk->stmts;
+    return _run(chunk, slots, stack, ret, stats);
+}
+
+Status vm_run(const Chunk *chunk, const int64_t *args, Sym *result) {
+    size_t size = (size_t)chunk->slots + chunk->stack;
+    uint64_t *slots = (uint64_t *)calloc(size > 0 ? size : 1, sizeof(*slots));
+    if (slots == NULL) {
+        return Status_InternalError;
+    }
+    if (args != NULL && chunk->params > 0) {
+        memcpy(slots, args, chunk->params * sizeof(*slots));
+    }
+
+    uint64_t ret = 0;
+    uint64_t *stack = slots + chunk->slots;
+    Stats *stats = stats_active;
+    bool returned = stats == NULL
+        ? _run_plain(chunk, slots, stack, &ret)
+        : _run_counted(chunk, slots, stack, &ret, stats);
+    free(slots);
+
+    *result = (Sym){ .ident = NO_ID, .type = Type_VOID };
+    if (returned && chunk->ret_type == Type_BOOL) {
+        result->type = Type_BOOL;
+        result->value.v_bool = ret != 0;
+    } else if (returned && chunk->ret_type == Type_INT) {
+        result->type = Type_INT;
+        result->value.v_int = (int64_t)ret;
+    }
+    return Status_OK;
+}